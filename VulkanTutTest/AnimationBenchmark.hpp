@@ -0,0 +1,364 @@
+#pragma once
+
+#include <Model.hpp>
+#include <KeyframeSampler.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif // _MSC_VER
+
+// Heap allocation counter, fed by the global operator new below.
+// The replacement operators are not inline, so this header must only be included by main.cpp
+std::atomic<uint64_t> g_heapAllocations{ 0 };
+
+void* operator new(size_t size)
+{
+	g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void* ptr = std::malloc(size ? size : 1))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	std::free(ptr);
+}
+
+// Over-aligned types, e.g. the pose kernel blocks
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	const size_t align = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+	void* ptr = _aligned_malloc(size ? size : 1, align);
+#else
+	void* ptr = std::aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align);
+#endif // _MSC_VER
+	if (ptr)
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+#ifdef _MSC_VER
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif // _MSC_VER
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+/// <summary>
+/// Linear keyframe scan on the compressed or raw keyframes of a track channel
+/// </summary>
+inline uint32_t FindKeyframeLinear(const AnimationPose& pose, const TrackChannel channel, const double time)
+{
+	return FindKeyframeLinear(pose.KeyTimes(channel), time);
+}
+
+/// <summary>
+/// Compares the linear keyframe scan with the KeyframeSampler on every clip of a model.
+///
+/// Playback is simulated at a fixed frame time, looping at the clip duration like AnimationPlayer::UpdateTime.
+/// Both lookups must agree on the keyframe segment for every track channel and frame
+/// </summary>
+/// <param name="model">: model with animations</param>
+/// <param name="frames">: number of simulated frames per clip</param>
+/// <param name="frameTime">: simulated frame time in seconds</param>
+inline void RunKeyframeBenchmark(const Model& model, const uint32_t frames = 2000, const double frameTime = 1.0 / 60.0)
+{
+	const Mesh& mesh = model.meshes[0];
+
+	std::cout << "Keyframe benchmark for " << model.name << ":" << std::endl;
+
+	for (uint32_t clip_index = 0; clip_index < mesh.animations.size(); clip_index++)
+	{
+		const AnimationClip& clip = mesh.animations[clip_index];
+
+		std::vector<const AnimationPose*> tracks;
+		for (const AnimationPose& pose : clip.tracks)
+			tracks.push_back(&pose);
+
+		// Simulated playback times
+		std::vector<double> times(frames);
+		double time = 0.0;
+		for (uint32_t f = 0; f < frames; f++)
+		{
+			time += frameTime;
+			if (time > clip.duration)
+				time = 0.0;
+
+			times[f] = time;
+		}
+
+		// Linear scan
+		uint64_t linearChecksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t f = 0; f < frames; f++)
+			for (const AnimationPose* track : tracks)
+				for (const TrackChannel channel : TRACK_CHANNELS)
+					linearChecksum += FindKeyframeLinear(*track, channel, times[f]);
+		auto end = std::chrono::high_resolution_clock::now();
+		const double linearMs = std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+
+		// Cursor sampler
+		KeyframeSampler sampler;
+		uint64_t samplerChecksum = 0;
+		float factor;
+		start = std::chrono::high_resolution_clock::now();
+		for (uint32_t f = 0; f < frames; f++)
+			for (const AnimationPose* track : tracks)
+				for (const TrackChannel channel : TRACK_CHANNELS)
+					samplerChecksum += sampler.FindKeyframe(clip_index, *track, channel, times[f], factor);
+		end = std::chrono::high_resolution_clock::now();
+		const double samplerMs = std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+
+		// Validate segments, only where the linear scan is defined (inside the keyframe range)
+		uint32_t mismatches = 0;
+		KeyframeSampler validationSampler;
+		for (uint32_t f = 0; f < frames; f++)
+		{
+			for (const AnimationPose* track : tracks)
+			{
+				for (const TrackChannel channel : TRACK_CHANNELS)
+				{
+					const std::vector<float>& keyTimes = track->KeyTimes(channel);
+					const uint32_t frame_index = validationSampler.FindKeyframe(clip_index, *track, channel, times[f], factor);
+					if (keyTimes.size() < 2 || times[f] < keyTimes.front() || times[f] >= keyTimes.back())
+						continue;
+
+					if (frame_index != FindKeyframeLinear(*track, channel, times[f]))
+						mismatches++;
+				}
+			}
+		}
+
+		const double lookups = static_cast<double>(frames) * tracks.size() * TRACK_CHANNEL_COUNT;
+		std::cout << std::fixed << std::setprecision(2)
+			<< "  [" << clip_index << "] " << clip.nameID
+			<< ": tracks " << tracks.size() << ", max keyframes " << clip.max_frames
+			<< " | linear " << linearMs * 1.0e6 / lookups << " ns/lookup"
+			<< " | sampler " << samplerMs * 1.0e6 / lookups << " ns/lookup"
+			<< " | speedup " << (samplerMs > 0.0 ? linearMs / samplerMs : 0.0) << "x"
+			<< " | mismatches " << mismatches << std::endl;
+
+		// Keep the lookups from being optimized away
+		static volatile uint64_t sink;
+		sink = linearChecksum + samplerChecksum;
+	}
+}
+
+/// <summary>
+/// Checks the pose kernel against the per-joint glm reference (AnimateReference) on every clip of a model,
+/// for linear and cubic interpolation and every instruction set supported by the CPU, and times both paths
+/// </summary>
+/// <param name="model">: model with animations. Its bone transforms are overwritten</param>
+/// <param name="frames">: number of sampled frames per clip</param>
+/// <param name="tolerance">: maximum allowed error, relative to the magnitude of the reference matrix elements</param>
+/// <returns>Whether all poses are within tolerance</returns>
+inline bool RunPoseKernelValidation(Model& model, const uint32_t frames = 240, const float tolerance = 1.0e-3f)
+{
+	const Mesh& mesh = model.meshes[0];
+	const int previousAnim = model.currentAnim;
+	const PoseKernelISA detectedISA = DetectPoseKernelISA();
+
+	std::cout << "Pose kernel validation for " << model.name << " (detected " << PoseKernelISAName(detectedISA) << "):" << std::endl;
+
+	bool passed = true;
+	std::vector<glm::mat4> reference(mesh.boneCounter), kernel(mesh.boneCounter);
+	const BonePaletteSpan referencePalette{ reference.data(), reference.size() };
+	const BonePaletteSpan kernelPalette{ kernel.data(), kernel.size() };
+	for (uint32_t clip_index = 0; clip_index < mesh.animations.size(); clip_index++)
+	{
+		model.currentAnim = static_cast<int>(clip_index);
+		const double duration = mesh.animations[clip_index].duration;
+
+		for (const bool cubic : { false, true })
+		{
+			for (int isa = static_cast<int>(PoseKernelISA::Scalar); isa <= static_cast<int>(detectedISA); isa++)
+			{
+				KeyframeSampler referenceSampler, kernelSampler;
+				float maxError = 0.0f;
+				double referenceMs = 0.0, kernelMs = 0.0;
+
+				for (uint32_t f = 0; f < frames; f++)
+				{
+					const double time = duration * f / frames;
+
+					auto start = std::chrono::high_resolution_clock::now();
+					model.AnimateReference(time, referencePalette, referenceSampler, cubic);
+					auto end = std::chrono::high_resolution_clock::now();
+					referenceMs += std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+
+					start = std::chrono::high_resolution_clock::now();
+					model.AnimateBatch(time, kernelPalette, kernelSampler, cubic, nullptr, static_cast<PoseKernelISA>(isa));
+					end = std::chrono::high_resolution_clock::now();
+					kernelMs += std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+
+					for (size_t bone = 0; bone < reference.size(); bone++)
+					{
+						for (int col = 0; col < 4; col++)
+						{
+							for (int row = 0; row < 4; row++)
+							{
+								const float expected = reference[bone][col][row];
+								const float error = std::abs(kernel[bone][col][row] - expected) / std::max(1.0f, std::abs(expected));
+								maxError = std::max(maxError, error);
+							}
+						}
+					}
+				}
+
+				const bool clipPassed = maxError <= tolerance;
+				passed = passed && clipPassed;
+
+				std::cout << std::scientific << std::setprecision(2)
+					<< "  [" << clip_index << "] " << (cubic ? "cubic " : "linear") << " " << PoseKernelISAName(static_cast<PoseKernelISA>(isa))
+					<< ": max error " << maxError << (clipPassed ? " OK" : " FAILED")
+					<< std::fixed << " | reference " << referenceMs * 1000.0 / frames << " us/frame"
+					<< " | kernel " << kernelMs * 1000.0 / frames << " us/frame" << std::endl;
+			}
+		}
+	}
+
+	model.currentAnim = previousAnim;
+
+	return passed;
+}
+
+/// <summary>
+/// Counts heap allocations made while running a function, e.g. a number of animation updates
+/// </summary>
+/// <param name="func">: function to run</param>
+/// <returns>Number of calls to operator new</returns>
+template<typename Func>
+inline uint64_t CountHeapAllocations(const Func& func)
+{
+	const uint64_t before = g_heapAllocations.load();
+	func();
+
+	return g_heapAllocations.load() - before;
+}
+
+/// <summary>
+/// Rebuilds a bone transform from an encoded palette on the CPU, the same way bone_palette.glsl does on the GPU
+/// </summary>
+inline glm::mat4 DecodeBoneTransform(const BonePaletteSpan& palette, const size_t bone)
+{
+	const glm::vec4* data = reinterpret_cast<const glm::vec4*>(palette.data);
+
+	switch (palette.encoding)
+	{
+	case PaletteEncoding::Affine3x4:
+		return glm::transpose(glm::mat4(data[3 * bone], data[3 * bone + 1], data[3 * bone + 2], glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+	case PaletteEncoding::DualQuat:
+	{
+		const glm::vec4 real = data[2 * bone];
+		const glm::vec4 dual = data[2 * bone + 1];
+		const glm::quat rotation(real.w, real.x, real.y, real.z);
+		const glm::vec3 translation = 2.0f * (real.w * glm::vec3(dual) - dual.w * glm::vec3(real) + glm::cross(glm::vec3(real), glm::vec3(dual)));
+
+		glm::mat4 transform = glm::mat4_cast(rotation);
+		transform[3] = glm::vec4(translation, 1.0f);
+		return transform;
+	}
+	default:
+		return palette.data[bone];
+	}
+}
+
+/// <summary>
+/// Checks every palette encoding against the mat4 palette on every clip of a model, and reports the bytes written per frame.
+/// Dual quaternions drop scale, so a large error means the rig needs a matrix encoding
+/// </summary>
+/// <param name="model">: model with animations. Its bone transforms are overwritten</param>
+/// <param name="frames">: number of sampled frames per clip</param>
+/// <param name="tolerance">: maximum allowed error, relative to the magnitude of the mat4 elements</param>
+/// <returns>Whether the matrix encodings are within tolerance. Dual quaternion error is only reported</returns>
+inline bool RunPaletteEncodingValidation(Model& model, const uint32_t frames = 60, const float tolerance = 1.0e-3f)
+{
+	const Mesh& mesh = model.meshes[0];
+	const int previousAnim = model.currentAnim;
+	const size_t boneCount = static_cast<size_t>(mesh.boneCounter);
+
+	std::cout << "Palette encodings for " << model.name << ":" << std::endl;
+
+	bool passed = true;
+	std::vector<glm::mat4> reference(boneCount), encoded(boneCount);
+	const BonePaletteSpan referencePalette{ reference.data(), reference.size() };
+	for (const PaletteEncoding encoding : { PaletteEncoding::Mat4, PaletteEncoding::Affine3x4, PaletteEncoding::DualQuat })
+	{
+		const BonePaletteSpan encodedPalette{ encoded.data(), encoded.size(), encoding };
+		float maxError = 0.0f;
+		double encodeMs = 0.0;
+
+		for (uint32_t clip_index = 0; clip_index < mesh.animations.size(); clip_index++)
+		{
+			model.currentAnim = static_cast<int>(clip_index);
+			KeyframeSampler referenceSampler, encodedSampler;
+
+			for (uint32_t f = 0; f < frames; f++)
+			{
+				const double time = mesh.animations[clip_index].duration * f / frames;
+				model.AnimateBatch(time, referencePalette, referenceSampler, false);
+
+				auto start = std::chrono::high_resolution_clock::now();
+				model.AnimateBatch(time, encodedPalette, encodedSampler, false);
+				auto end = std::chrono::high_resolution_clock::now();
+				encodeMs += std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+
+				for (size_t bone = 0; bone < boneCount; bone++)
+				{
+					const glm::mat4 decoded = DecodeBoneTransform(encodedPalette, bone);
+					for (int col = 0; col < 4; col++)
+					{
+						for (int row = 0; row < 4; row++)
+						{
+							const float expected = reference[bone][col][row];
+							maxError = std::max(maxError, std::abs(decoded[col][row] - expected) / std::max(1.0f, std::abs(expected)));
+						}
+					}
+				}
+			}
+		}
+
+		const bool encodingPassed = maxError <= tolerance;
+		if (encoding != PaletteEncoding::DualQuat)
+			passed = passed && encodingPassed;
+
+		const size_t totalFrames = std::max<size_t>(1, frames * mesh.animations.size());
+		std::cout << std::scientific << std::setprecision(2)
+			<< "  " << std::setw(15) << PaletteEncodingName(encoding)
+			<< ": " << std::fixed << boneCount * PaletteVec4sPerBone(encoding) * sizeof(glm::vec4) << " bytes/frame"
+			<< " | animate+encode " << encodeMs * 1000.0 / totalFrames << " us/frame"
+			<< std::scientific << " | max error " << maxError << (encodingPassed ? " OK" : (encoding == PaletteEncoding::DualQuat ? " (rig is not rigid)" : " FAILED"))
+			<< std::endl;
+	}
+
+	model.currentAnim = previousAnim;
+
+	return passed;
+}
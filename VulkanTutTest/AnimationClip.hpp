@@ -3,6 +3,9 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <AnimationCompression.hpp>
+#include <CubicInterpolation.hpp>
+#include <KeyChannel.hpp>
 #include <string>
 #include <vector>
 #include <map>
@@ -19,26 +22,248 @@ struct SQT {
 	glm::vec3 translation;
 };
 
+const float CONSTANT_CHANNEL_TOLERANCE = 1.0e-6f;	// Keys closer than this are equal when collapsing raw channels
+
 /// <summary>
-/// The Pose list for a single Bone
+/// The keyframes of a single Bone, as independent scale, rotation and translation channels.
+/// Constant channels hold a single key and identity scale is dropped, so empty channels sample to their default value
 /// 
 /// XXX: The Bone is referred to by name
 /// </summary>
 struct AnimationPose {
-	std::vector<SQT> bonePoses;		// SQTs for each keyframe
-	std::string bone_name;			// Name of bone
+	KeyChannel<glm::vec3> scales;			// Raw scale keys. Empty if compressed or identity
+	KeyChannel<glm::quat> rotations;		// Raw rotation keys. Empty if compressed
+	KeyChannel<glm::vec3> translations;		// Raw translation keys. Empty if compressed
+	CompressedTrack compressed;				// Compressed keyframes, replacing the raw channels if not empty
+	CubicTrack cubic;						// Tangents for cubic interpolation, built at load. Empty if not built
+	std::string bone_name;					// Name of bone
+	uint32_t trackIndex = 0;				// Index of the channel in the clip. Addresses per-track sampler state
+
+	inline bool IsCompressed() const
+	{
+		return !compressed.Empty();
+	}
+
+	/// <summary>
+	/// Whether the track has no keys in any channel
+	/// </summary>
+	inline bool Empty() const
+	{
+		return !IsCompressed() && scales.Empty() && rotations.Empty() && translations.Empty();
+	}
+
+	/// <summary>
+	/// Keyframe times of a channel, compressed or not
+	/// </summary>
+	inline const std::vector<float>& KeyTimes(const TrackChannel channel) const
+	{
+		switch (channel)
+		{
+		case TrackChannel::Scale:
+			return IsCompressed() ? compressed.scales.times : scales.times;
+		case TrackChannel::Rotation:
+			return IsCompressed() ? compressed.rotations.times : rotations.times;
+		default:
+			return IsCompressed() ? compressed.translations.times : translations.times;
+		}
+	}
+
+	/// <summary>
+	/// Number of keyframes of a channel, compressed or not
+	/// </summary>
+	inline size_t KeyCount(const TrackChannel channel) const
+	{
+		return KeyTimes(channel).size();
+	}
+
+	/// <summary>
+	/// Returns a scale key, decompressing it if needed. Identity if the channel is empty
+	/// </summary>
+	inline glm::vec3 GetScale(const size_t index) const
+	{
+		if (IsCompressed())
+			return compressed.DecodeScale(index);
+
+		return scales.Empty() ? glm::vec3(1.0f) : scales.values[index];
+	}
+
+	/// <summary>
+	/// Returns a rotation key, decompressing it if needed. Identity if the channel is empty
+	/// </summary>
+	inline glm::quat GetRotation(const size_t index) const
+	{
+		if (IsCompressed())
+			return compressed.DecodeRotation(index);
+
+		return rotations.Empty() ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : rotations.values[index];
+	}
+
+	/// <summary>
+	/// Returns a translation key, decompressing it if needed. Zero if the channel is empty
+	/// </summary>
+	inline glm::vec3 GetTranslation(const size_t index) const
+	{
+		if (IsCompressed())
+			return compressed.DecodeTranslation(index);
+
+		return translations.Empty() ? glm::vec3(0.0f) : translations.values[index];
+	}
+
+	/// <summary>
+	/// Size of the keyframes in bytes, compressed or not
+	/// </summary>
+	inline size_t MemorySize() const
+	{
+		return IsCompressed() ? compressed.MemorySize() : scales.MemorySize() + rotations.MemorySize() + translations.MemorySize();
+	}
+
+	/// <summary>
+	/// Collapses raw channels whose keys are all equal to a single key, and drops the scale channel if it is identity.
+	/// Lossless, for tracks that are not compressed
+	/// </summary>
+	void CollapseConstantChannels()
+	{
+		auto vectorEqual = [](const glm::vec3& a, const glm::vec3& b) { return glm::length(a - b) <= CONSTANT_CHANNEL_TOLERANCE; };
+		auto rotationEqual = [](const glm::quat& a, const glm::quat& b) { return std::abs(glm::dot(a, b)) >= 1.0f - CONSTANT_CHANNEL_TOLERANCE; };
+
+		CollapseChannel(scales, vectorEqual);
+		CollapseChannel(rotations, rotationEqual);
+		CollapseChannel(translations, vectorEqual);
+
+		if (scales.KeyCount() == 1 && vectorEqual(scales.values[0], glm::vec3(1.0f)))
+			scales.Clear();
+	}
+
+	/// <summary>
+	/// Builds the cubic tangents of each channel from its keyframes, compressed if they are, so the curves pass through the stored keys
+	/// </summary>
+	void BuildCubicTrack()
+	{
+		std::vector<glm::vec3> values(KeyCount(TrackChannel::Scale));
+		for (size_t k = 0; k < values.size(); k++)
+			values[k] = GetScale(k);
+		cubic.scaleTangents = ComputeHermiteTangents(KeyTimes(TrackChannel::Scale), values);
+
+		std::vector<glm::quat> rotationValues(KeyCount(TrackChannel::Rotation));
+		for (size_t k = 0; k < rotationValues.size(); k++)
+			rotationValues[k] = GetRotation(k);
+		cubic.rotationControls = ComputeSquadControls(rotationValues);
+
+		values.resize(KeyCount(TrackChannel::Translation));
+		for (size_t k = 0; k < values.size(); k++)
+			values[k] = GetTranslation(k);
+		cubic.translationTangents = ComputeHermiteTangents(KeyTimes(TrackChannel::Translation), values);
+	}
+
+private:
+	template<typename T, typename Equal>
+	static void CollapseChannel(KeyChannel<T>& channel, const Equal& equal)
+	{
+		for (const T& value : channel.values)
+		{
+			if (!equal(value, channel.values[0]))
+				return;
+		}
+
+		channel.times.resize(std::min<size_t>(channel.times.size(), 1));
+		channel.values.resize(channel.times.size());
+	}
+};
+
+const uint64_t HASH_SEED = 14695981039346656037ull;	// FNV-1a offset basis
+
+/// <summary>
+/// FNV-1a hash of a byte range, chained through seed
+/// </summary>
+inline uint64_t HashBytes(const void* data, const size_t size, uint64_t seed = HASH_SEED)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+		seed = (seed ^ bytes[i]) * 1099511628211ull;
+
+	return seed;
+}
+
+template<typename T>
+inline uint64_t HashValue(const T& value, const uint64_t seed)
+{
+	return HashBytes(&value, sizeof(T), seed);
+}
+
+inline uint64_t HashString(const std::string& value, const uint64_t seed)
+{
+	return HashBytes(value.data(), value.size(), HashValue(value.size(), seed));
+}
+
+const uint32_t MAX_BLEND_LAYERS = 4;				// Clips an animation player can blend over its current animation
+
+/// <summary>
+/// A clip sampled at its own time and weight, as input to Model::AnimateBlend
+/// </summary>
+struct BlendLayer {
+	uint32_t clip;					// Index of the clip in the mesh animations
+	double time;					// Sampling time in the clip
+	float weight;					// Blend weight. Layers with zero weight are skipped
 };
 
 struct AnimationClip {
 	double duration;									// Animation duration
 	double ticks_per_second;							// Ticks per second
-	std::map<std::string, AnimationPose> poseSamples;	// Map from bone name to AnimationPose
+	std::vector<AnimationPose> tracks;					// AnimationPose of each channel, indexed by AnimationPose::trackIndex
+	std::map<std::string, uint32_t> trackMap;			// Map from bone name to track index. Only used to resolve tracks at import
 	std::string nameID;									// Name of animation (currently not used)
 	int n_bones;										// Number of bones in animation
 	int max_frames;										// Maximum number of keyframes in a channel
+	uint64_t contentHash = 0;							// Hash of the tracks, equal for the same clip loaded from different files. 0 if not computed
 
-	AnimationClip(std::string nameID, int n_bones, int max_frames, double duration, double ticks_per_second, std::map<std::string, AnimationPose > poseSamples)
+	AnimationClip(std::string nameID, int n_bones, int max_frames, double duration, double ticks_per_second, std::vector<AnimationPose> tracks)
 		:
-		nameID(nameID), n_bones(n_bones), max_frames(max_frames), duration(duration), ticks_per_second(ticks_per_second), poseSamples(poseSamples)
-	{};
+		nameID(nameID), n_bones(n_bones), max_frames(max_frames), duration(duration), ticks_per_second(ticks_per_second), tracks(tracks)
+	{
+		// First channel wins if a bone is animated twice
+		for (const AnimationPose& track : AnimationClip::tracks)
+			trackMap.insert({ track.bone_name, track.trackIndex });
+	};
+
+	/// <summary>
+	/// Builds the cubic tangents of every track. Call again after compressing
+	/// </summary>
+	void BuildCubicTracks()
+	{
+		for (AnimationPose& track : tracks)
+			track.BuildCubicTrack();
+	}
+
+	/// <summary>
+	/// Hashes duration, bone names and keyframes of all tracks, compressed if they are. Call again after compressing
+	/// </summary>
+	void ComputeContentHash()
+	{
+		uint64_t hash = HashValue(duration, HASH_SEED);
+		for (const AnimationPose& track : tracks)
+		{
+			hash = HashString(track.bone_name, hash);
+
+			// Channel by channel, field by field, padding is not hashed
+			for (const TrackChannel channel : TRACK_CHANNELS)
+			{
+				const std::vector<float>& times = track.KeyTimes(channel);
+				hash = HashValue(times.size(), hash);
+
+				for (size_t k = 0; k < times.size(); k++)
+				{
+					hash = HashValue(times[k], hash);
+					if (channel == TrackChannel::Scale)
+						hash = HashValue(track.GetScale(k), hash);
+					else if (channel == TrackChannel::Rotation)
+						hash = HashValue(track.GetRotation(k), hash);
+					else
+						hash = HashValue(track.GetTranslation(k), hash);
+				}
+			}
+		}
+
+		// 0 marks a missing hash
+		contentHash = hash ? hash : 1;
+	}
 };
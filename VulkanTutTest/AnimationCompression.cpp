@@ -0,0 +1,245 @@
+#include <AnimationCompression.hpp>
+#include <AnimationClip.hpp>
+
+#include <glm/gtx/quaternion.hpp>
+
+PackedQuat PackQuat(const glm::quat& rotation)
+{
+    const float components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+
+    // Drop the largest component. q and -q are the same rotation, so it is made positive and rebuilt from the others
+    uint32_t largest = 0;
+    for (uint32_t i = 1; i < 4; i++)
+    {
+        if (std::abs(components[i]) > std::abs(components[largest]))
+            largest = i;
+    }
+    const float sign = (components[largest] < 0.0f) ? -1.0f : 1.0f;
+
+    PackedQuat packed;
+    for (uint32_t i = 0, c = 0; i < 4; i++)
+    {
+        if (i == largest)
+            continue;
+
+        const float normalized = (std::clamp(components[i] * sign, -QUAT_COMPONENT_RANGE, QUAT_COMPONENT_RANGE) + QUAT_COMPONENT_RANGE)
+            / (2.0f * QUAT_COMPONENT_RANGE);
+        packed.data[c++] = static_cast<uint16_t>(normalized * QUAT_COMPONENT_MAX + 0.5f);
+    }
+
+    packed.data[0] |= static_cast<uint16_t>((largest >> 1) << QUAT_COMPONENT_BITS);
+    packed.data[1] |= static_cast<uint16_t>((largest & 1) << QUAT_COMPONENT_BITS);
+
+    return packed;
+}
+
+/// <summary>
+/// Angle of the rotation between two quaternions, in radians. Robust for nearly equal rotations, unlike acos of the dot product
+/// </summary>
+static float RotationAngle(const glm::quat& a, const glm::quat& b)
+{
+    const glm::quat closest = (glm::dot(a, b) < 0.0f) ? -b : b;
+    const float distance = glm::length(glm::vec4(a.x - closest.x, a.y - closest.y, a.z - closest.z, a.w - closest.w));
+
+    return 4.0f * std::asin(std::min(1.0f, 0.5f * distance));
+}
+
+/// <summary>
+/// Checks whether interpolating between keys first and last of a channel reproduces every key in between within the budget
+/// </summary>
+template<typename T, typename Interpolate, typename Distance>
+static bool SegmentFits(const KeyChannel<T>& channel, const size_t first, const size_t last, const float budget,
+    const Interpolate& interpolate, const Distance& distance)
+{
+    const double span = static_cast<double>(channel.times[last]) - channel.times[first];
+
+    for (size_t k = first + 1; k < last; k++)
+    {
+        const float t = (span > 0.0) ? static_cast<float>((channel.times[k] - channel.times[first]) / span) : 0.0f;
+
+        if (distance(interpolate(channel.values[first], channel.values[last], t), channel.values[k]) > budget)
+            return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Greedily extends each segment of a channel while the keys inside stay predictable
+/// </summary>
+/// <returns>Indices of the kept keys</returns>
+template<typename T, typename Interpolate, typename Distance>
+static std::vector<size_t> ReduceChannel(const KeyChannel<T>& channel, const float budget, const Interpolate& interpolate, const Distance& distance)
+{
+    std::vector<size_t> kept = { 0 };
+    for (size_t first = 0; first + 1 < channel.KeyCount();)
+    {
+        size_t last = first + 1;
+        while (last + 1 < channel.KeyCount() && SegmentFits(channel, first, last + 1, budget, interpolate, distance))
+            last++;
+
+        kept.push_back(last);
+        first = last;
+    }
+
+    return kept;
+}
+
+/// <summary>
+/// Checks whether every key of a channel is within the tolerance of the first one
+/// </summary>
+template<typename T, typename Distance>
+static bool IsConstant(const KeyChannel<T>& channel, const float tolerance, const Distance& distance)
+{
+    for (const T& value : channel.values)
+    {
+        if (distance(value, channel.values[0]) > tolerance)
+            return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Measures the error of a compressed channel at every source keyframe, using linear interpolation like the sampler
+/// </summary>
+/// <param name="source">: source keyframes</param>
+/// <param name="times">: times of the kept keyframes</param>
+/// <param name="decode">: decompresses a kept keyframe, returning the default value if the channel was dropped</param>
+template<typename T, typename Decode, typename Interpolate, typename Distance>
+static float MeasureChannelError(const KeyChannel<T>& source, const std::vector<float>& times, const Decode& decode,
+    const Interpolate& interpolate, const Distance& distance)
+{
+    float maxError = 0.0f;
+    size_t segment = 0;
+    for (size_t k = 0; k < source.KeyCount(); k++)
+    {
+        while (segment + 2 < times.size() && times[segment + 1] <= source.times[k])
+            segment++;
+
+        const size_t next = times.empty() ? 0 : std::min(segment + 1, times.size() - 1);
+        const double span = times.empty() ? 0.0 : static_cast<double>(times[next]) - times[segment];
+        const float t = (span > 0.0) ? static_cast<float>(std::clamp((source.times[k] - times[segment]) / span, 0.0, 1.0)) : 0.0f;
+
+        maxError = std::max(maxError, distance(interpolate(decode(segment), decode(next), t), source.values[k]));
+    }
+
+    return maxError;
+}
+
+static glm::vec3 MixVec3(const glm::vec3& a, const glm::vec3& b, const float t)
+{
+    return glm::mix(a, b, t);
+}
+
+static float VectorDistance(const glm::vec3& a, const glm::vec3& b)
+{
+    return glm::length(a - b);
+}
+
+static glm::quat SlerpQuat(const glm::quat& a, const glm::quat& b, const float t)
+{
+    return glm::slerp(a, b, t);
+}
+
+/// <summary>
+/// Reduces and quantizes a scale or translation channel. Constant channels keep a single key,
+/// and are dropped if dropValue is given and they stay within the error of it
+/// </summary>
+/// <param name="source">: source keyframes</param>
+/// <param name="error">: maximum error, in the units of the channel</param>
+/// <param name="dropValue">: optional value of an empty channel</param>
+/// <param name="channel">: output keyframes</param>
+/// <param name="min">: output quantization minimum</param>
+/// <param name="extent">: output quantization extent</param>
+static void CompressVec3Channel(const KeyChannel<glm::vec3>& source, const float error, const glm::vec3* dropValue,
+    KeyChannel<QuantizedVec3>& channel, glm::vec3& min, glm::vec3& extent)
+{
+    if (source.Empty())
+        return;
+
+    // Quantization bounds
+    min = source.values[0];
+    glm::vec3 max = source.values[0];
+    for (const glm::vec3& value : source.values)
+    {
+        min = glm::min(min, value);
+        max = glm::max(max, value);
+    }
+    extent = max - min;
+
+    // Collapse channels that stay within the bounds of the first key
+    if (IsConstant(source, error, VectorDistance))
+    {
+        min = source.values[0];
+        extent = glm::vec3(0.0f);
+
+        // Only drop the channel if every key, not only the first one, is within the error of the drop value
+        bool droppable = dropValue != nullptr;
+        for (size_t i = 0; droppable && i < source.values.size(); i++)
+            droppable = glm::length(source.values[i] - *dropValue) <= error;
+
+        if (!droppable)
+            channel.Add(source.times[0], QuantizeVec3(source.values[0], min, extent));
+
+        return;
+    }
+
+    // Half a quantization step per component
+    const float quantization = 0.5f * glm::length(extent) / VEC3_COMPONENT_MAX;
+    const float budget = std::max(0.0f, error - quantization);
+
+    for (const size_t index : ReduceChannel(source, budget, MixVec3, VectorDistance))
+        channel.Add(source.times[index], QuantizeVec3(source.values[index], min, extent));
+}
+
+/// <summary>
+/// Reduces and packs a rotation channel. Constant channels keep a single key
+/// </summary>
+static void CompressRotationChannel(const KeyChannel<glm::quat>& source, const float error, KeyChannel<PackedQuat>& channel)
+{
+    if (source.Empty())
+        return;
+
+    const float quantization = 2.0f * std::sqrt(3.0f) * QUAT_COMPONENT_RANGE / QUAT_COMPONENT_MAX;
+    const float budget = std::max(0.0f, error - quantization);
+
+    if (IsConstant(source, budget, RotationAngle))
+    {
+        channel.Add(source.times[0], PackQuat(source.values[0]));
+        return;
+    }
+
+    for (const size_t index : ReduceChannel(source, budget, SlerpQuat, RotationAngle))
+        channel.Add(source.times[index], PackQuat(source.values[index]));
+}
+
+CompressedTrack CompressTrack(const AnimationPose& source, const AnimationCompressionSettings& settings, CompressionStats* stats)
+{
+    CompressedTrack track;
+
+    const glm::vec3 identityScale(1.0f);
+    CompressVec3Channel(source.scales, settings.scaleError, &identityScale, track.scales, track.scaleMin, track.scaleExtent);
+    CompressRotationChannel(source.rotations, settings.angularError, track.rotations);
+    CompressVec3Channel(source.translations, settings.positionError, nullptr, track.translations, track.translationMin, track.translationExtent);
+
+    if (stats)
+    {
+        CompressionStats trackStats;
+        trackStats.rawKeys = source.scales.KeyCount() + source.rotations.KeyCount() + source.translations.KeyCount();
+        trackStats.keptKeys = track.scales.KeyCount() + track.rotations.KeyCount() + track.translations.KeyCount();
+        trackStats.rawBytes = source.scales.MemorySize() + source.rotations.MemorySize() + source.translations.MemorySize();
+        trackStats.compressedBytes = track.MemorySize();
+
+        trackStats.maxScaleError = MeasureChannelError(source.scales, track.scales.times,
+            [&](const size_t index) { return track.DecodeScale(index); }, MixVec3, VectorDistance);
+        trackStats.maxAngularError = MeasureChannelError(source.rotations, track.rotations.times,
+            [&](const size_t index) { return track.DecodeRotation(index); }, SlerpQuat, RotationAngle);
+        trackStats.maxPositionError = MeasureChannelError(source.translations, track.translations.times,
+            [&](const size_t index) { return track.DecodeTranslation(index); }, MixVec3, VectorDistance);
+
+        stats->Add(trackStats);
+    }
+
+    return track;
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <KeyChannel.hpp>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+struct AnimationPose;
+
+const float QUAT_COMPONENT_RANGE = 0.70710678f;		// Components other than the largest are in [-1/sqrt(2), 1/sqrt(2)]
+const uint32_t QUAT_COMPONENT_BITS = 15;			// Bits of each stored quaternion component
+const uint32_t QUAT_COMPONENT_MAX = (1u << QUAT_COMPONENT_BITS) - 1;
+const uint32_t VEC3_COMPONENT_MAX = 0xFFFF;			// Quantization steps of translation and scale components
+
+/// <summary>
+/// Error bounds for keyframe reduction. Keys are dropped while interpolation between the kept ones stays within them
+/// </summary>
+struct AnimationCompressionSettings {
+	float positionError = 0.01f;					// Maximum translation error, in model units
+	float angularError = 0.001f;					// Maximum rotation error, in radians
+	float scaleError = 0.001f;						// Maximum scale error
+};
+
+/// <summary>
+/// Rotation in smallest-three form: the largest component is dropped and rebuilt from the other three,
+/// which are stored with QUAT_COMPONENT_BITS each. The index of the dropped component is kept in the top bits of data[0] and data[1]
+/// </summary>
+struct PackedQuat {
+	uint16_t data[3];
+};
+
+/// <summary>
+/// Vector quantized to 16 bits per component, relative to per-track bounds
+/// </summary>
+struct QuantizedVec3 {
+	uint16_t data[3];
+};
+
+/// <summary>
+/// Packs a rotation into smallest-three form
+/// </summary>
+/// <param name="rotation">: normalized quaternion</param>
+/// <returns></returns>
+PackedQuat PackQuat(const glm::quat& rotation);
+
+/// <summary>
+/// Rebuilds a rotation from smallest-three form
+/// </summary>
+/// <param name="packed"></param>
+/// <returns>Normalized quaternion, with a positive largest component</returns>
+inline glm::quat UnpackQuat(const PackedQuat& packed)
+{
+	const uint32_t largest = ((packed.data[0] >> QUAT_COMPONENT_BITS) << 1) | (packed.data[1] >> QUAT_COMPONENT_BITS);
+	const float scale = 2.0f * QUAT_COMPONENT_RANGE / QUAT_COMPONENT_MAX;
+
+	float components[4];
+	float sum = 0.0f;
+	for (uint32_t i = 0, c = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+
+		components[i] = (packed.data[c++] & QUAT_COMPONENT_MAX) * scale - QUAT_COMPONENT_RANGE;
+		sum += components[i] * components[i];
+	}
+	components[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+
+	// Components are stored as x, y, z, w
+	return glm::normalize(glm::quat(components[3], components[0], components[1], components[2]));
+}
+
+/// <summary>
+/// Quantizes a vector to the given bounds
+/// </summary>
+inline QuantizedVec3 QuantizeVec3(const glm::vec3& value, const glm::vec3& min, const glm::vec3& extent)
+{
+	QuantizedVec3 quantized;
+	for (int c = 0; c < 3; c++)
+	{
+		const float normalized = (extent[c] > 0.0f) ? (value[c] - min[c]) / extent[c] : 0.0f;
+		quantized.data[c] = static_cast<uint16_t>(std::clamp(normalized, 0.0f, 1.0f) * VEC3_COMPONENT_MAX + 0.5f);
+	}
+
+	return quantized;
+}
+
+/// <summary>
+/// Rebuilds a vector quantized with QuantizeVec3
+/// </summary>
+inline glm::vec3 DequantizeVec3(const QuantizedVec3& quantized, const glm::vec3& min, const glm::vec3& extent)
+{
+	return min + extent * glm::vec3(quantized.data[0], quantized.data[1], quantized.data[2]) * (1.0f / VEC3_COMPONENT_MAX);
+}
+
+/// <summary>
+/// Keyframes of a track after reduction and quantization. Each channel is reduced on its own keyframe times.
+///
+/// Channels that stay constant within the error bounds are collapsed to a single key, and identity scale is dropped
+/// </summary>
+struct CompressedTrack {
+	KeyChannel<QuantizedVec3> scales;				// Empty if the scale is identity
+	KeyChannel<PackedQuat> rotations;
+	KeyChannel<QuantizedVec3> translations;
+
+	// Quantization bounds
+	glm::vec3 scaleMin = glm::vec3(0.0f);
+	glm::vec3 scaleExtent = glm::vec3(0.0f);
+	glm::vec3 translationMin = glm::vec3(0.0f);
+	glm::vec3 translationExtent = glm::vec3(0.0f);
+
+	inline bool Empty() const
+	{
+		return scales.Empty() && rotations.Empty() && translations.Empty();
+	}
+
+	/// <summary>
+	/// Decompresses a kept scale key. Identity if the channel is empty
+	/// </summary>
+	inline glm::vec3 DecodeScale(const size_t index) const
+	{
+		return scales.Empty() ? glm::vec3(1.0f) : DequantizeVec3(scales.values[index], scaleMin, scaleExtent);
+	}
+
+	/// <summary>
+	/// Decompresses a kept rotation key. Identity if the channel is empty
+	/// </summary>
+	inline glm::quat DecodeRotation(const size_t index) const
+	{
+		return rotations.Empty() ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : UnpackQuat(rotations.values[index]);
+	}
+
+	/// <summary>
+	/// Decompresses a kept translation key. Zero if the channel is empty
+	/// </summary>
+	inline glm::vec3 DecodeTranslation(const size_t index) const
+	{
+		return translations.Empty() ? glm::vec3(0.0f) : DequantizeVec3(translations.values[index], translationMin, translationExtent);
+	}
+
+	/// <summary>
+	/// Size of the keyframe data and bounds in bytes
+	/// </summary>
+	inline size_t MemorySize() const
+	{
+		return scales.MemorySize() + rotations.MemorySize() + translations.MemorySize() + 4 * sizeof(glm::vec3);
+	}
+};
+
+/// <summary>
+/// Memory and error of compressed tracks, compared to the source keyframes
+/// </summary>
+struct CompressionStats {
+	size_t rawKeys = 0;
+	size_t keptKeys = 0;
+	size_t rawBytes = 0;
+	size_t compressedBytes = 0;
+	float maxPositionError = 0.0f;
+	float maxAngularError = 0.0f;					// In radians
+	float maxScaleError = 0.0f;
+
+	void Add(const CompressionStats& other)
+	{
+		rawKeys += other.rawKeys;
+		keptKeys += other.keptKeys;
+		rawBytes += other.rawBytes;
+		compressedBytes += other.compressedBytes;
+		maxPositionError = std::max(maxPositionError, other.maxPositionError);
+		maxAngularError = std::max(maxAngularError, other.maxAngularError);
+		maxScaleError = std::max(maxScaleError, other.maxScaleError);
+	}
+};
+
+/// <summary>
+/// Compresses the keyframes of a track, one channel at a time: constant channels are collapsed and identity scale is dropped,
+/// keys that linear interpolation of their neighbours predicts within the error bounds are dropped, rotations are packed
+/// in smallest-three form and scale and translation are quantized to the track bounds.
+/// Quantization error is taken from the bounds before keys are dropped
+/// </summary>
+/// <param name="source">: track with raw keyframes</param>
+/// <param name="settings">: error bounds</param>
+/// <param name="stats">: optional output for memory and the measured error at every source keyframe</param>
+/// <returns></returns>
+CompressedTrack CompressTrack(const AnimationPose& source, const AnimationCompressionSettings& settings = AnimationCompressionSettings(),
+	CompressionStats* stats = nullptr);
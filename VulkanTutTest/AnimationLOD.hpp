@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <Skeleton.hpp>
+
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+
+/// <summary>
+/// Animation level of detail. Coarser levels evaluate less often and skip joints with a small reach, e.g. fingers and face
+/// </summary>
+struct AnimationLODLevel {
+	float minScreenSize;							// Smallest projected size, as a fraction of the screen height, that uses this level
+	uint32_t updateInterval;						// Evaluate every N frames and hold the palette in between
+	float minJointReach;							// Joints with a smaller Skeleton::jointReach keep their last local transform
+};
+
+const AnimationLODLevel ANIMATION_LOD_LEVELS[] = {
+	{ 0.25f, 1, 0.0f },
+	{ 0.1f, 2, 0.02f },
+	{ 0.04f, 4, 0.04f },
+	{ 0.0f, 8, 0.06f }
+};
+const uint32_t ANIMATION_LOD_COUNT = sizeof(ANIMATION_LOD_LEVELS) / sizeof(AnimationLODLevel);
+const float ANIMATION_LOD_HYSTERESIS = 0.15f;		// Relative margin a size must cross a threshold by before the level changes
+const float ANIMATION_LOD_FADE_TIME = 0.25f;		// Seconds for joints culled by a coarser level to fade back in
+
+/// <summary>
+/// Projected size of a bounding sphere, as a fraction of the screen height
+/// </summary>
+/// <param name="center">: world space center</param>
+/// <param name="radius">: world space radius</param>
+/// <param name="cameraPosition"></param>
+/// <param name="fovY">: vertical field of view in radians</param>
+/// <returns>1 if the camera is inside the sphere</returns>
+inline float ProjectedSize(const glm::vec3& center, const float radius, const glm::vec3& cameraPosition, const float fovY)
+{
+	const float distance = glm::length(center - cameraPosition);
+	if (distance <= radius)
+		return 1.0f;
+
+	return std::min(1.0f, radius / (distance * std::tan(0.5f * fovY)));
+}
+
+/// <summary>
+/// Picks the level of a projected size. A level only changes once the size is past the threshold by ANIMATION_LOD_HYSTERESIS,
+/// so a model near a threshold doesn't flicker between levels
+/// </summary>
+/// <param name="screenSize">: projected size, as a fraction of the screen height</param>
+/// <param name="currentLevel">: level of the previous frame</param>
+/// <returns></returns>
+inline uint32_t SelectAnimationLOD(const float screenSize, const uint32_t currentLevel)
+{
+	uint32_t level = 0;
+	while (level + 1 < ANIMATION_LOD_COUNT && screenSize < ANIMATION_LOD_LEVELS[level].minScreenSize)
+		level++;
+
+	// Finer level, the size must clear the lower bound of the next finer level
+	if (level < currentLevel && screenSize < ANIMATION_LOD_LEVELS[currentLevel - 1].minScreenSize * (1.0f + ANIMATION_LOD_HYSTERESIS))
+		return currentLevel;
+
+	// Coarser level, the size must drop clearly below the lower bound of the current level
+	if (level > currentLevel && screenSize > ANIMATION_LOD_LEVELS[currentLevel].minScreenSize * (1.0f - ANIMATION_LOD_HYSTERESIS))
+		return currentLevel;
+
+	return level;
+}
@@ -2,6 +2,102 @@
 
 #include <AnimationClip.hpp>
 #include <Model.hpp>
+#include <KeyframeSampler.hpp>
+#include <AnimationLOD.hpp>
+
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+
+inline std::atomic<uint64_t> g_poseVersion{ 0 };	// Source of pose versions, unique across players
+
+/// <summary>
+/// Inputs that decide the pose of a player. Equal keys give equal palettes
+/// </summary>
+struct PoseKey {
+	int clip = -1;							// Current animation of the model
+	double time = 0.0;
+	BlendLayer layers[MAX_BLEND_LAYERS];
+	uint32_t layer_count = 0;				// Layers with weight, 0 if not blending
+	bool cubic = false;
+	PaletteEncoding encoding = PaletteEncoding::Mat4;
+	JointLOD lod;
+
+	bool operator==(const PoseKey& other) const
+	{
+		if (clip != other.clip || time != other.time || layer_count != other.layer_count || cubic != other.cubic || encoding != other.encoding)
+			return false;
+
+		if (lod.minReach != other.lod.minReach || lod.fadeReach != other.lod.fadeReach || lod.fade != other.lod.fade)
+			return false;
+
+		for (uint32_t i = 0; i < layer_count; i++)
+		{
+			if (layers[i].clip != other.layers[i].clip || layers[i].time != other.layers[i].time || layers[i].weight != other.layers[i].weight)
+				return false;
+		}
+
+		return true;
+	}
+
+	/// <summary>
+	/// Same clips, layer weights, interpolation and encoding, so only time or joint LOD tell the poses apart
+	/// </summary>
+	bool SameInputs(const PoseKey& other) const
+	{
+		if (clip != other.clip || layer_count != other.layer_count || cubic != other.cubic || encoding != other.encoding)
+			return false;
+
+		for (uint32_t i = 0; i < layer_count; i++)
+		{
+			if (layers[i].clip != other.layers[i].clip || layers[i].weight != other.layers[i].weight)
+				return false;
+		}
+
+		return true;
+	}
+};
+
+const double SHARED_POSE_TIME_STEP = 1.0 / 240.0;	// Players whose times fall in the same step can share a pose
+
+/// <summary>
+/// Pose inputs that are comparable across models: rig and clips are identified by content hashes and times are quantized.
+/// Players with equal keys produce the same palette, up to one time step
+/// </summary>
+struct SharedPoseKey {
+	uint64_t rig = 0;						// 0 if the pose can't be shared
+	uint64_t clips[MAX_BLEND_LAYERS + 1];	// Current animation, then the blend layers
+	int64_t steps[MAX_BLEND_LAYERS + 1];	// Times in SHARED_POSE_TIME_STEP
+	float weights[MAX_BLEND_LAYERS];
+	uint32_t layer_count = 0;
+	bool cubic = false;
+	PaletteEncoding encoding = PaletteEncoding::Mat4;
+	float min_reach = 0.0f;					// Joint LOD
+
+	bool operator==(const SharedPoseKey& other) const
+	{
+		if (rig != other.rig || layer_count != other.layer_count || cubic != other.cubic || encoding != other.encoding || min_reach != other.min_reach)
+			return false;
+
+		for (uint32_t i = 0; i <= layer_count; i++)
+		{
+			if (clips[i] != other.clips[i] || steps[i] != other.steps[i] || (i > 0 && weights[i - 1] != other.weights[i - 1]))
+				return false;
+		}
+
+		return true;
+	}
+};
+
+/// <summary>
+/// What AnimationPlayer::Animate had to do for a palette
+/// </summary>
+enum class PoseUpdate {
+	Evaluated,								// Pose inputs changed, the animation was evaluated
+	Copied,									// Pose was cached, but the palette held an older one
+	Cached,									// Palette already held the pose
+	Shared									// Pose was taken from another player with the same SharedPoseKey
+};
 
 struct AnimationPlayer {
 	double animation_time = 0.0;
@@ -10,6 +106,16 @@ struct AnimationPlayer {
 	uint32_t current_anim;					// Animation index
 	Model* tgt_model;
 	uint32_t modelIndex;
+	KeyframeSampler sampler;				// Keyframe cursors of this player
+	BlendLayer layers[MAX_BLEND_LAYERS];	// Clips blended over the current animation, each with its own time
+	uint32_t layer_count = 0;
+	PoseKey pose_key;						// Inputs of the pose last evaluated into the bones of the target model
+	uint64_t pose_version = 0;				// Version of that pose, 0 if there is none
+	PoseUpdate last_update = PoseUpdate::Cached;
+	uint32_t lod_level = 0;					// Animation LOD level, see ANIMATION_LOD_LEVELS
+	uint32_t lod_frame = 0;					// Frames animated, for the update interval of the LOD level
+	JointLOD joint_lod;						// Joints evaluated at the LOD level
+	bool held_pose_stale = true;			// Held local transforms of the model don't come from this player, so culled joints can't use them
 
 	AnimationPlayer(uint32_t animIndex, Model* model, uint32_t modelIndex) : current_anim(animIndex), tgt_model(model), modelIndex(modelIndex) {};
 
@@ -32,10 +138,19 @@ struct AnimationPlayer {
 
 		double new_time = animation_time + global_time * animation_speed;
 
-		// Check whether time exceeds animation duration, then reset
+		// Blend layers loop on their own durations, also when the current animation loops
+		for (uint32_t i = 0; i < layer_count; i++)
+		{
+			const double duration = tgt_model->meshes[0].animations[layers[i].clip].duration;
+			if (duration > 0.0)
+				layers[i].time = std::fmod(layers[i].time + global_time * animation_speed, duration);
+		}
+
+		// Check whether time exceeds animation duration, then reset. Only the current animation restarts, ResetTime restarts the layers too
 		if (new_time > tgt_model->meshes[0].animations[current_anim].duration)
 		{
-			ResetTime();
+			animation_time = 0.0;
+			sampler.Reset();
 
 			return animation_time;
 		}
@@ -46,12 +161,208 @@ struct AnimationPlayer {
 		return animation_time;
 	}
 
+	/// <summary>
+	/// Sets a clip blended over the current animation. Its time keeps running as long as the clip doesn't change
+	/// </summary>
+	/// <param name="index">: layer index, below MAX_BLEND_LAYERS</param>
+	/// <param name="clip">: clip index in the mesh animations</param>
+	/// <param name="weight">: blend weight. The current animation gets what the layers leave of 1</param>
+	void SetBlendLayer(const uint32_t index, const uint32_t clip, const float weight)
+	{
+		if (index >= layer_count || layers[index].clip != clip)
+			layers[index].time = 0.0;
+
+		layers[index].clip = clip;
+		layers[index].weight = weight;
+		layer_count = std::max(layer_count, index + 1);
+	}
+
+	inline void ClearBlendLayers()
+	{
+		layer_count = 0;
+	}
+
+	/// <summary>
+	/// Evaluates the current animation of the target model into a palette, blended with the layers if any has weight.
+	///
+	/// If the pose inputs didn't change since the last evaluation, e.g. while paused, the pose still held by the bones of the model
+	/// is reused: it is only written if the palette holds an older version. Anything else that animates the target model
+	/// must call InvalidatePose
+	/// </summary>
+	/// <param name="palette">: output for the final bone matrices</param>
+	/// <param name="cubic">: cubic interpolation when not blending</param>
+	/// <param name="paletteVersion">: pose version held by the palette, updated when it is written</param>
+	/// <returns>What was done for the palette</returns>
+	PoseUpdate Animate(const BonePaletteSpan palette, const bool cubic, uint64_t& paletteVersion)
+	{
+		// Coarser LOD levels hold the last pose between evaluations. Players are staggered by model, so they don't all evaluate on the same frame.
+		// Only time may move while holding, a new clip, weight or encoding from the GUI is evaluated right away
+		const uint32_t interval = ANIMATION_LOD_LEVELS[lod_level].updateInterval;
+		const bool holdFrame = (lod_frame++ + modelIndex) % interval != 0;
+
+		PoseKey key = MakePoseKey(cubic, palette.encoding);
+		if (pose_version != 0 && holdFrame && key.SameInputs(pose_key))
+			key = pose_key;
+
+		if (pose_version != 0 && key == pose_key)
+		{
+			if (paletteVersion == pose_version)
+				return last_update = PoseUpdate::Cached;
+
+			Model::WriteBoneTransforms(tgt_model->meshes[0], palette);
+			paletteVersion = pose_version;
+
+			return last_update = PoseUpdate::Copied;
+		}
+
+		if (key.layer_count == 0)
+		{
+			if (key.cubic)
+				tgt_model->AnimateCI(key.time, palette, sampler, nullptr, key.lod);
+			else
+				tgt_model->AnimateLI(key.time, palette, sampler, nullptr, key.lod);
+		}
+		else
+		{
+			float layerWeight = 0.0f;
+			for (uint32_t i = 0; i < key.layer_count; i++)
+				layerWeight += std::max(0.0f, key.layers[i].weight);
+
+			BlendLayer active[MAX_BLEND_LAYERS + 1];
+			active[0] = { static_cast<uint32_t>(key.clip), key.time, std::max(0.0f, 1.0f - layerWeight) };
+			std::copy(key.layers, key.layers + key.layer_count, active + 1);
+
+			tgt_model->AnimateBlend(active, key.layer_count + 1, palette, sampler, nullptr, key.lod);
+		}
+
+		pose_key = key;
+		held_pose_stale = false;
+		pose_version = paletteVersion = g_poseVersion.fetch_add(1, std::memory_order_relaxed) + 1;
+
+		return last_update = PoseUpdate::Evaluated;
+	}
+
+	/// <summary>
+	/// Inputs of the pose Animate would evaluate now
+	/// </summary>
+	PoseKey MakePoseKey(const bool cubic, const PaletteEncoding encoding) const
+	{
+		PoseKey key;
+		key.clip = tgt_model->currentAnim;
+		key.time = animation_time;
+		key.cubic = cubic;
+		key.encoding = encoding;
+
+		// Culled joints need held transforms of this player, otherwise everything is evaluated once
+		if (!held_pose_stale)
+			key.lod = joint_lod;
+
+		float layerWeight = 0.0f;
+		for (uint32_t i = 0; i < layer_count; i++)
+			layerWeight += std::max(0.0f, layers[i].weight);
+
+		if (layerWeight > 0.0f)
+		{
+			std::copy(layers, layers + layer_count, key.layers);
+			key.layer_count = layer_count;
+		}
+
+		return key;
+	}
+
+	/// <summary>
+	/// Inputs of the pose Animate would evaluate now, comparable with players of other models
+	/// </summary>
+	SharedPoseKey MakeSharedPoseKey(const bool cubic, const PaletteEncoding encoding) const
+	{
+		const Mesh& mesh = tgt_model->meshes[0];
+		const PoseKey key = MakePoseKey(cubic, encoding);
+
+		// From the LOD level even while held joints are stale, so followers keep matching their leader.
+		// The stale flag only widens the evaluation once a follower evaluates on its own
+		SharedPoseKey shared;
+		shared.layer_count = key.layer_count;
+		shared.cubic = key.cubic;
+		shared.encoding = key.encoding;
+		shared.min_reach = joint_lod.minReach;
+		shared.clips[0] = mesh.animations[key.clip].contentHash;
+		shared.steps[0] = static_cast<int64_t>(std::floor(key.time / SHARED_POSE_TIME_STEP));
+		for (uint32_t i = 0; i < key.layer_count; i++)
+		{
+			shared.clips[i + 1] = mesh.animations[key.layers[i].clip].contentHash;
+			shared.steps[i + 1] = static_cast<int64_t>(std::floor(key.layers[i].time / SHARED_POSE_TIME_STEP));
+			shared.weights[i] = key.layers[i].weight;
+		}
+
+		// Only share when every hash is known, and not while joints fade in from held transforms of this model
+		shared.rig = (joint_lod.fade < 1.0f) ? 0 : mesh.rigHash;
+		for (uint32_t i = 0; i <= key.layer_count; i++)
+			shared.rig = shared.clips[i] ? shared.rig : 0;
+
+		return shared;
+	}
+
+	/// <summary>
+	/// Takes the pose of another player with the same SharedPoseKey instead of evaluating it.
+	/// The bones of the target model are left as they were, so the own pose cache is invalidated
+	/// </summary>
+	/// <param name="source">: palette of the other player, already holding its pose</param>
+	/// <param name="sourceVersion">: pose version held by source</param>
+	/// <param name="palette">: output for the final bone matrices</param>
+	/// <param name="paletteVersion">: pose version held by the palette, updated when it is written</param>
+	void SharePose(const BonePaletteSpan& source, const uint64_t sourceVersion, const BonePaletteSpan palette, uint64_t& paletteVersion)
+	{
+		InvalidatePose();
+		last_update = PoseUpdate::Shared;
+
+		if (paletteVersion == sourceVersion)
+			return;
+
+		const size_t vec4Count = std::min({ static_cast<size_t>(tgt_model->meshes[0].boneCounter), source.count, palette.count })
+			* PaletteVec4sPerBone(palette.encoding);
+		const glm::vec4* from = reinterpret_cast<const glm::vec4*>(source.data);
+		std::copy(from, from + vec4Count, reinterpret_cast<glm::vec4*>(palette.data));
+		paletteVersion = sourceVersion;
+	}
+
+	/// <summary>
+	/// Forces the next Animate to evaluate the pose, with all joints
+	/// </summary>
+	inline void InvalidatePose()
+	{
+		pose_version = 0;
+		held_pose_stale = true;
+	}
+
+	/// <summary>
+	/// Sets the animation LOD level. Joints culled by the previous level fade back in when moving to a finer one
+	/// </summary>
+	/// <param name="level">: index in ANIMATION_LOD_LEVELS</param>
+	/// <param name="deltaTime">: frame time in seconds, advances the fade</param>
+	void SetLOD(const uint32_t level, const double deltaTime)
+	{
+		const float minReach = ANIMATION_LOD_LEVELS[level].minJointReach;
+		if (minReach < joint_lod.minReach)
+		{
+			joint_lod.fadeReach = std::max(joint_lod.minReach, (joint_lod.fade < 1.0f) ? joint_lod.fadeReach : 0.0f);
+			joint_lod.fade = 0.0f;
+		}
+		else
+			joint_lod.fade = std::min(1.0f, joint_lod.fade + static_cast<float>(deltaTime) / ANIMATION_LOD_FADE_TIME);
+
+		joint_lod.minReach = minReach;
+		lod_level = level;
+	}
+
 	/// <summary>
 	/// Resets time
 	/// </summary>
 	inline void ResetTime()
 	{
 		animation_time = 0.0;			// Unexpected functionality is unexpected
+		for (uint32_t i = 0; i < layer_count; i++)
+			layers[i].time = 0.0;
+		sampler.Reset();
 	}
 
 	/// <summary>
@@ -66,5 +377,6 @@ struct AnimationPlayer {
 		current_anim = anim_index;
 
 		ResetTime();
+		InvalidatePose();
 	}
 };
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <Model.hpp>
+#include <KeyframeSampler.hpp>
+#include <GpuAnimation.hpp>
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+const float BAKE_SAMPLE_RATE = 30.0f;				// Baked frames per second
+
+/// <summary>
+/// Range of a clip in the baked palettes
+/// </summary>
+struct BakedClip {
+	uint32_t firstFrame;							// First baked frame of the clip
+	uint32_t frameCount;							// Number of baked frames, the last one is sampled at exactly the duration
+	float sampleRate;								// Baked frames per second
+	float duration;									// Clip duration in seconds
+};
+
+/// <summary>
+/// Bone palettes of every clip of a model, sampled at a fixed rate.
+/// The palette of frame f of a clip starts at palettes[(clip.firstFrame + f) * boneCount]
+/// </summary>
+struct BakedAnimation {
+	uint32_t boneCount = 0;
+	std::vector<BakedClip> clips;
+	std::vector<glm::mat4> palettes;
+
+	inline size_t MemorySize() const
+	{
+		return palettes.size() * sizeof(glm::mat4);
+	}
+};
+
+/// <summary>
+/// Samples every clip of a model at a fixed rate into bone palettes, using the pose kernel with linear interpolation
+/// </summary>
+/// <param name="model">: model with animations. Its bone transforms are overwritten</param>
+/// <param name="sampleRate">: baked frames per second</param>
+/// <param name="samplePalettes">: whether to sample the palettes, or only fill in the clip ranges and durations</param>
+/// <returns></returns>
+inline BakedAnimation BakeAnimations(Model& model, const float sampleRate = BAKE_SAMPLE_RATE, const bool samplePalettes = true)
+{
+	Mesh& mesh = model.meshes[0];
+	const int previousAnim = model.currentAnim;
+
+	BakedAnimation baked;
+	baked.boneCount = static_cast<uint32_t>(mesh.boneCounter);
+
+	uint32_t totalFrames = 0;
+	for (const AnimationClip& clip : mesh.animations)
+	{
+		BakedClip bakedClip;
+		bakedClip.firstFrame = totalFrames;
+		// One frame per sample interval plus a closing frame at the duration, so the loop point is baked instead of
+		// interpolated back to the first frame over a whole interval
+		bakedClip.frameCount = std::max(1u, static_cast<uint32_t>(std::ceil(clip.duration * sampleRate))) + 1;
+		bakedClip.sampleRate = sampleRate;
+		bakedClip.duration = static_cast<float>(clip.duration);
+
+		baked.clips.push_back(bakedClip);
+		totalFrames += bakedClip.frameCount;
+	}
+
+	if (!samplePalettes)
+		return baked;
+
+	baked.palettes.resize(static_cast<size_t>(totalFrames) * baked.boneCount);
+
+	for (uint32_t clip_index = 0; clip_index < baked.clips.size(); clip_index++)
+	{
+		const BakedClip& bakedClip = baked.clips[clip_index];
+		const double clip_duration = mesh.animations[clip_index].duration;
+		model.currentAnim = static_cast<int>(clip_index);
+
+		KeyframeSampler sampler;
+		for (uint32_t frame = 0; frame < bakedClip.frameCount; frame++)
+		{
+			const BonePaletteSpan palette{ baked.palettes.data() + static_cast<size_t>(bakedClip.firstFrame + frame) * baked.boneCount, baked.boneCount };
+			model.AnimateBatch(std::min(frame / static_cast<double>(sampleRate), clip_duration), palette, sampler, false);
+		}
+	}
+
+	model.currentAnim = previousAnim;
+
+	return baked;
+}
+
+/// <summary>
+/// Per-instance data read by baked_skinning.vert, in std430 layout
+/// </summary>
+struct CrowdInstanceData {
+	glm::vec4 offset;								// Model space offset of the instance in xyz
+	uint32_t firstFrame;							// First baked frame of the clip
+	uint32_t frameCount;							// Number of baked frames of the clip
+	float frame;									// Current baked frame. The fractional part interpolates to the next one, clamped to the last frame
+	uint32_t boneCount;								// Bones per baked palette
+};
+
+/// <summary>
+/// Instances playing baked animations. The CPU only advances their time, skinning and palette lookups happen on the GPU
+/// </summary>
+class Crowd {
+public:
+	/// <summary>
+	/// Places instances on a square grid in the XZ plane, with random clips and start times
+	/// </summary>
+	/// <param name="baked">: baked animations of the instanced model. Must outlive the crowd</param>
+	/// <param name="count">: number of instances</param>
+	/// <param name="spacing">: distance between instances, in model units</param>
+	/// <param name="seed">: seed for clips and start times</param>
+	void Populate(const BakedAnimation& baked, const uint32_t count, const float spacing, const uint32_t seed = 0)
+	{
+		m_baked = &baked;
+		m_instances.resize(count);
+
+		std::mt19937 rng(seed);
+		const uint32_t columns = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count)))));
+		for (uint32_t i = 0; i < count; i++)
+		{
+			Instance& instance = m_instances[i];
+
+			// Start one cell away, leaving the origin to the animated model itself
+			instance.offset = glm::vec3((i % columns + 1) * spacing, 0.0f, (i / columns) * spacing);
+			instance.clip = baked.clips.empty() ? 0 : rng() % static_cast<uint32_t>(baked.clips.size());
+			instance.time = baked.clips.empty() ? 0.0 : std::uniform_real_distribution<double>(0.0, baked.clips[instance.clip].duration)(rng);
+		}
+	}
+
+	/// <summary>
+	/// Advances the time of every instance and writes the instance data.
+	///
+	/// With gpuOutput, palettes are evaluated per instance by animation_eval.comp instead of baked, so each instance
+	/// reads a single palette of its own and only its clip and time are written for the compute pass
+	/// </summary>
+	/// <param name="deltaTime">: frame time in seconds</param>
+	/// <param name="speed">: playback speed</param>
+	/// <param name="playing">: whether time advances</param>
+	/// <param name="output">: instance data of all instances, e.g. a persistently mapped storage buffer</param>
+	/// <param name="gpuOutput">: optional input of the animation compute pass for all instances</param>
+	void Update(const double deltaTime, const float speed, const bool playing, CrowdInstanceData* output, GpuAnimationInstance* gpuOutput = nullptr)
+	{
+		for (size_t i = 0; i < m_instances.size(); i++)
+		{
+			Instance& instance = m_instances[i];
+			const BakedClip& clip = m_baked->clips[instance.clip];
+
+			if (playing && clip.duration > 0.0f)
+				instance.time = std::fmod(instance.time + deltaTime * speed, static_cast<double>(clip.duration));
+
+			CrowdInstanceData& data = output[i];
+			data.offset = glm::vec4(instance.offset, 0.0f);
+			data.firstFrame = clip.firstFrame;
+			data.frameCount = clip.frameCount;
+			data.frame = BakedFrame(clip, instance.time);
+			data.boneCount = m_baked->boneCount;
+
+			if (gpuOutput)
+			{
+				data.firstFrame = static_cast<uint32_t>(i);
+				data.frameCount = 1;
+				data.frame = 0.0f;
+
+				gpuOutput[i].clip = instance.clip;
+				gpuOutput[i].time = static_cast<float>(instance.time);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Baked frame of a clip at the given time. The last interval ends at the duration and is usually shorter than
+	/// the others, so its interpolation factor is scaled to its real length
+	/// </summary>
+	/// <param name="clip">: baked clip</param>
+	/// <param name="time">: time in seconds, in [0, duration]</param>
+	/// <returns></returns>
+	static float BakedFrame(const BakedClip& clip, const double time)
+	{
+		const uint32_t lastInterval = clip.frameCount - 2;
+		const double lastStart = lastInterval / static_cast<double>(clip.sampleRate);
+		if (time < lastStart)
+			return static_cast<float>(time * clip.sampleRate);
+
+		const double lastSpan = clip.duration - lastStart;
+		const double factor = lastSpan > 0.0 ? std::clamp((time - lastStart) / lastSpan, 0.0, 1.0) : 0.0;
+
+		return static_cast<float>(lastInterval + factor);
+	}
+
+	inline uint32_t Size() const
+	{
+		return static_cast<uint32_t>(m_instances.size());
+	}
+
+private:
+	struct Instance {
+		glm::vec3 offset;
+		uint32_t clip;
+		double time;
+	};
+
+	const BakedAnimation* m_baked = nullptr;
+	std::vector<Instance> m_instances;
+};
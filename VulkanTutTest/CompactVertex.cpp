@@ -0,0 +1,124 @@
+#include <CompactVertex.hpp>
+
+#include <glm/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    inline float SignNotZero(const float value)
+    {
+        return (value >= 0.0f) ? 1.0f : -1.0f;
+    }
+
+    inline uint16_t QuantizeUnorm16(const float value)
+    {
+        return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+    }
+}
+
+glm::vec2 OctahedralEncode(const glm::vec3& direction)
+{
+    const float l1 = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    if (l1 == 0.0f)
+        return glm::vec2(0.0f);
+
+    const glm::vec3 n = direction / l1;
+    if (n.z >= 0.0f)
+        return glm::vec2(n.x, n.y);
+
+    // Fold the lower hemisphere over the diagonals
+    return glm::vec2((1.0f - std::abs(n.y)) * SignNotZero(n.x), (1.0f - std::abs(n.x)) * SignNotZero(n.y));
+}
+
+glm::vec3 OctahedralDecode(const glm::vec2& encoded)
+{
+    glm::vec3 n(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+    if (n.z < 0.0f)
+    {
+        const float x = n.x;
+        n.x = (1.0f - std::abs(n.y)) * SignNotZero(x);
+        n.y = (1.0f - std::abs(x)) * SignNotZero(n.y);
+    }
+
+    return glm::normalize(n);
+}
+
+void PackVertices(const std::vector<Vertex>& vertices, const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<CompactVertex>& packed)
+{
+    const glm::vec3 scale = 1.0f / QuantizationExtent(boundsMin, boundsMax);
+
+    packed.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& vertex = vertices[i];
+        CompactVertex& compact = packed[i];
+
+        const glm::vec3 position = (vertex.pos - boundsMin) * scale;
+        compact.pos[0] = QuantizeUnorm16(position.x);
+        compact.pos[1] = QuantizeUnorm16(position.y);
+        compact.pos[2] = QuantizeUnorm16(position.z);
+        compact.pos[3] = (glm::dot(glm::cross(vertex.norm, vertex.tangent), vertex.biTangent) < 0.0f) ? 0 : 65535;
+
+        compact.texCoord = glm::packHalf2x16(vertex.texCoord);
+        compact.norm = glm::packSnorm2x16(OctahedralEncode(vertex.norm));
+        compact.tangent = glm::packSnorm2x16(OctahedralEncode(vertex.tangent));
+    }
+}
+
+bool PackSkinning(const std::vector<Vertex>& vertices, std::vector<SkinningVertex>& packed)
+{
+    packed.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& vertex = vertices[i];
+        SkinningVertex& skinning = packed[i];
+
+        int sum = 0, largest = 0;
+        for (int j = 0; j < MAXIMUM_BONES; j++)
+        {
+            if (vertex.boneIDs[j] < 0 || vertex.boneIDs[j] > 255)
+                return false;
+
+            skinning.boneIDs[j] = static_cast<uint8_t>(vertex.boneIDs[j]);
+            skinning.weights[j] = static_cast<uint8_t>(std::lround(std::clamp(vertex.weights[j], 0.0f, 1.0f) * 255.0f));
+            sum += skinning.weights[j];
+            if (skinning.weights[j] > skinning.weights[largest])
+                largest = j;
+        }
+
+        // Rounding error goes to the largest weight, so the blended transform keeps its scale
+        if (sum > 0)
+            skinning.weights[largest] = static_cast<uint8_t>(std::clamp(skinning.weights[largest] + 255 - sum, 0, 255));
+    }
+
+    return true;
+}
+
+void PackSkinning(const std::vector<Vertex>& vertices, std::vector<FloatSkinningVertex>& packed)
+{
+    packed.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        for (int j = 0; j < MAXIMUM_BONES; j++)
+        {
+            packed[i].boneIDs[j] = vertices[i].boneIDs[j];
+            packed[i].weights[j] = vertices[i].weights[j];
+        }
+    }
+}
+
+void PackPositions(const std::vector<Vertex>& vertices, std::vector<PositionVertex>& packed)
+{
+    packed.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+        packed[i].pos = vertices[i].pos;
+}
+
+void PackPositions(const std::vector<CompactVertex>& vertices, std::vector<CompactPositionVertex>& packed)
+{
+    packed.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+        std::copy(std::begin(vertices[i].pos), std::end(vertices[i].pos), packed[i].pos);
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <Vertex.hpp>
+
+#include <glm/common.hpp>
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+const uint32_t COMPACT_VERTEX_BINDING = 0;
+const uint32_t POSITION_VERTEX_BINDING = 0;             // Position-only stream of depth passes, in place of the full vertex
+const uint32_t SKINNING_VERTEX_BINDING = 1;             // Only bound by skinned pipelines
+const uint32_t TANGENT_LOCATION = 6;                    // Vertex has no tangent attribute, so it gets a location of its own
+
+static_assert(MAXIMUM_BONES == 4, "SkinningVertex packs 4 bone IDs and weights per vertex!");
+
+/// <summary>
+/// Quantized vertex of a model mesh, 20 bytes against the 104 of Vertex. Locations match those of Vertex, only the formats change.
+/// Color is dropped, shaders read white
+/// </summary>
+struct CompactVertex {
+    uint16_t pos[4];                                    // unorm16 within the model bounds in xyz, bitangent sign in w (0 negative, 65535 positive)
+    uint32_t texCoord;                                  // Two half floats
+    uint32_t norm;                                      // Octahedral, two snorm16
+    uint32_t tangent;                                   // Octahedral, two snorm16
+
+    static VkVertexInputBindingDescription GetBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = COMPACT_VERTEX_BINDING;
+        bindingDescription.stride = sizeof(CompactVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 4> GetAttributeDescriptions()
+    {
+        std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+        attributeDescriptions[0].binding = COMPACT_VERTEX_BINDING;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+        attributeDescriptions[0].offset = offsetof(CompactVertex, pos);
+
+        attributeDescriptions[1].binding = COMPACT_VERTEX_BINDING;
+        attributeDescriptions[1].location = 2;
+        attributeDescriptions[1].format = VK_FORMAT_R16G16_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(CompactVertex, texCoord);
+
+        attributeDescriptions[2].binding = COMPACT_VERTEX_BINDING;
+        attributeDescriptions[2].location = 3;
+        attributeDescriptions[2].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[2].offset = offsetof(CompactVertex, norm);
+
+        attributeDescriptions[3].binding = COMPACT_VERTEX_BINDING;
+        attributeDescriptions[3].location = TANGENT_LOCATION;
+        attributeDescriptions[3].format = VK_FORMAT_R16G16_SNORM;
+        attributeDescriptions[3].offset = offsetof(CompactVertex, tangent);
+
+        return attributeDescriptions;
+    }
+};
+
+/// <summary>
+/// Bone influences of a vertex, in a second vertex stream that only skinned meshes upload and only skinned pipelines bind
+/// </summary>
+struct SkinningVertex {
+    uint8_t boneIDs[MAXIMUM_BONES] = { 0 };             // Bones of rigs with up to 256 bones
+    uint8_t weights[MAXIMUM_BONES] = { 0 };             // unorm8, summing to exactly 255 for weighted vertices
+
+    static VkVertexInputBindingDescription GetBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = SKINNING_VERTEX_BINDING;
+        bindingDescription.stride = sizeof(SkinningVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescriptions()
+    {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+        attributeDescriptions[0].binding = SKINNING_VERTEX_BINDING;
+        attributeDescriptions[0].location = 4;
+        attributeDescriptions[0].format = VK_FORMAT_R8G8B8A8_UINT;
+        attributeDescriptions[0].offset = offsetof(SkinningVertex, boneIDs);
+
+        attributeDescriptions[1].binding = SKINNING_VERTEX_BINDING;
+        attributeDescriptions[1].location = 5;
+        attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attributeDescriptions[1].offset = offsetof(SkinningVertex, weights);
+
+        return attributeDescriptions;
+    }
+};
+
+/// <summary>
+/// Bone influences of a vertex at full precision, the skin stream of depth passes without COMPACT_VERTICES.
+/// The Vertex shaders skin with these exact values, so both passes compute the same depth
+/// </summary>
+struct FloatSkinningVertex {
+    int32_t boneIDs[MAXIMUM_BONES] = { 0 };
+    float weights[MAXIMUM_BONES] = { 0.0f };
+
+    static VkVertexInputBindingDescription GetBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = SKINNING_VERTEX_BINDING;
+        bindingDescription.stride = sizeof(FloatSkinningVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescriptions()
+    {
+        std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+        attributeDescriptions[0].binding = SKINNING_VERTEX_BINDING;
+        attributeDescriptions[0].location = 4;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32B32A32_SINT;
+        attributeDescriptions[0].offset = offsetof(FloatSkinningVertex, boneIDs);
+
+        attributeDescriptions[1].binding = SKINNING_VERTEX_BINDING;
+        attributeDescriptions[1].location = 5;
+        attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        attributeDescriptions[1].offset = offsetof(FloatSkinningVertex, weights);
+
+        return attributeDescriptions;
+    }
+};
+
+/// <summary>
+/// Tightly packed position of a vertex, the only stream static meshes bind in depth passes. 12 bytes against the 104 of Vertex
+/// </summary>
+struct PositionVertex {
+    glm::vec3 pos;
+
+    static VkVertexInputBindingDescription GetBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = POSITION_VERTEX_BINDING;
+        bindingDescription.stride = sizeof(PositionVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 1> GetAttributeDescriptions()
+    {
+        std::array<VkVertexInputAttributeDescription, 1> attributeDescriptions{};
+        attributeDescriptions[0].binding = POSITION_VERTEX_BINDING;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescriptions[0].offset = offsetof(PositionVertex, pos);
+
+        return attributeDescriptions;
+    }
+};
+
+/// <summary>
+/// Position of a vertex quantized like CompactVertex::pos, the position-only stream with COMPACT_VERTICES. 8 bytes
+/// </summary>
+struct CompactPositionVertex {
+    uint16_t pos[4];                                    // Copied from CompactVertex, so depth passes decode the same position. w is unused
+
+    static VkVertexInputBindingDescription GetBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = POSITION_VERTEX_BINDING;
+        bindingDescription.stride = sizeof(CompactPositionVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 1> GetAttributeDescriptions()
+    {
+        std::array<VkVertexInputAttributeDescription, 1> attributeDescriptions{};
+        attributeDescriptions[0].binding = POSITION_VERTEX_BINDING;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+        attributeDescriptions[0].offset = offsetof(CompactPositionVertex, pos);
+
+        return attributeDescriptions;
+    }
+};
+
+/// <summary>
+/// Size of the box positions are quantized in. Flat axes get a tiny extent, so decoding never divides by zero
+/// </summary>
+inline glm::vec3 QuantizationExtent(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    return glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+}
+
+/// <summary>
+/// Maps a unit vector to the octahedron, unfolded to [-1, 1]^2 (Cigolle et al. 2014)
+/// </summary>
+glm::vec2 OctahedralEncode(const glm::vec3& direction);
+
+/// <summary>
+/// Inverse of OctahedralEncode, as in vertex_input.glsl
+/// </summary>
+glm::vec3 OctahedralDecode(const glm::vec2& encoded);
+
+/// <summary>
+/// Quantizes vertices to CompactVertex. Positions are stored within boundsMin and boundsMin + QuantizationExtent(boundsMin, boundsMax)
+/// </summary>
+void PackVertices(const std::vector<Vertex>& vertices, const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<CompactVertex>& packed);
+
+/// <summary>
+/// Quantizes bone IDs and weights to SkinningVertex. Weights are rounded so they still sum to 1
+/// </summary>
+/// <returns>false if a bone ID doesn't fit in 8 bits</returns>
+bool PackSkinning(const std::vector<Vertex>& vertices, std::vector<SkinningVertex>& packed);
+
+/// <summary>
+/// Copies the bone IDs and weights of vertices to FloatSkinningVertex
+/// </summary>
+void PackSkinning(const std::vector<Vertex>& vertices, std::vector<FloatSkinningVertex>& packed);
+
+/// <summary>
+/// Copies the positions of vertices to a position-only stream
+/// </summary>
+void PackPositions(const std::vector<Vertex>& vertices, std::vector<PositionVertex>& packed);
+
+/// <summary>
+/// Copies the quantized positions of compact vertices to a position-only stream
+/// </summary>
+void PackPositions(const std::vector<CompactVertex>& vertices, std::vector<CompactPositionVertex>& packed);
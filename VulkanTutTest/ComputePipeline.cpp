@@ -0,0 +1,61 @@
+#include <ComputePipeline.hpp>
+
+ComputePipeline::ComputePipeline(VkDevice& device, VkPipelineLayout& pipelineLayout, VkDescriptorSetLayout& descriptorSetLayout,
+    const char* compShaderFile, const std::string name, VkPipeline& computePipeline, const uint32_t pushConstantSize)
+    :
+    device(device),
+    pipeline(&computePipeline),
+    name(name)
+{
+    auto compShaderCode = ReadFile(compShaderFile);
+
+    VkShaderModule compShaderModule = CreateShaderModule(device, compShaderCode);
+
+    // Compute shader to pipeline
+    VkPipelineShaderStageCreateInfo compShaderStageInfo{};
+    compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    compShaderStageInfo.module = compShaderModule;
+    compShaderStageInfo.pName = "main";
+
+    // Push constants, if any
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = pushConstantSize;
+
+    // Create pipeline layout
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = (pushConstantSize > 0) ? 1 : 0;
+    pipelineLayoutInfo.pPushConstantRanges = (pushConstantSize > 0) ? &pushConstantRange : nullptr;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+        throw std::runtime_error("failed to create pipeline layout!");
+
+    // Create pipeline
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = compShaderStageInfo;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+    pipelineInfo.basePipelineIndex = -1; // Optional
+
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
+        throw std::runtime_error("failed to create compute pipeline!");
+    else
+        std::cout << "Created compute pipeline: " << name << std::endl;
+
+    vkDestroyShaderModule(device, compShaderModule, nullptr);
+}
+
+ComputePipeline::ComputePipeline()
+{
+    device = NULL;
+    pipeline = nullptr;
+}
+
+ComputePipeline::~ComputePipeline()
+{}
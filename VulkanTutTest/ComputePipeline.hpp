@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <MemoryOps.hpp>
+#include <string>
+
+class ComputePipeline {
+public:
+	VkPipeline* pipeline;
+
+	/// <summary>
+	/// Constructor for compute shader pipeline
+	/// </summary>
+	/// <param name="device"></param>
+	/// <param name="pipelineLayout"></param>
+	/// <param name="descriptorSetLayout"></param>
+	/// <param name="compShaderFile"></param>
+	/// <param name="name"></param>
+	/// <param name="computePipeline"></param>
+	/// <param name="pushConstantSize">: size in bytes of the push constant block of the shader, 0 if it has none</param>
+	ComputePipeline(VkDevice& device, VkPipelineLayout& pipelineLayout, VkDescriptorSetLayout& descriptorSetLayout,
+		const char* compShaderFile, const std::string name, VkPipeline& computePipeline, const uint32_t pushConstantSize = 0);
+
+	ComputePipeline();
+
+	~ComputePipeline();
+
+private:
+	VkDevice device;
+	std::string name;
+};
@@ -2,53 +2,138 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
+#include <vector>
+#include <cmath>
 
 /// <summary>
-/// Cubic Interpolation for glm::vec3
+/// Per-key tangents of a track for cubic interpolation, built once at load on the keys of each channel.
+/// Scale and translation are cubic Hermite curves, rotation is squad through per-key control points
 /// </summary>
-/// <param name="p0"></param>
-/// <param name="p1"></param>
-/// <param name="p2"></param>
-/// <param name="p3"></param>
-/// <param name="t"></param>
+struct CubicTrack {
+    std::vector<glm::vec3> scaleTangents;			// Derivative at each key, per second
+    std::vector<glm::quat> rotationControls;		// Squad control point at each key
+    std::vector<glm::vec3> translationTangents;		// Derivative at each key, per second
+
+    inline bool Empty() const
+    {
+        return scaleTangents.empty() && rotationControls.empty() && translationTangents.empty();
+    }
+
+    inline size_t MemorySize() const
+    {
+        return scaleTangents.size() * sizeof(glm::vec3) + rotationControls.size() * sizeof(glm::quat) + translationTangents.size() * sizeof(glm::vec3);
+    }
+};
+
+/// <summary>
+/// Catmull-Rom tangents for keys at non-uniform times: central differences inside, one-sided differences at the ends
+/// </summary>
+/// <param name="times">: key times in seconds</param>
+/// <param name="values">: key values</param>
+/// <returns>Derivative at each key, per second</returns>
+inline std::vector<glm::vec3> ComputeHermiteTangents(const std::vector<float>& times, const std::vector<glm::vec3>& values)
+{
+    std::vector<glm::vec3> tangents(values.size(), glm::vec3(0.0f));
+
+    for (size_t k = 0; k < values.size() && values.size() > 1; k++)
+    {
+        const size_t previous = (k > 0) ? k - 1 : k;
+        const size_t next = (k + 1 < values.size()) ? k + 1 : k;
+        const float span = times[next] - times[previous];
+
+        if (span > 0.0f)
+            tangents[k] = (values[next] - values[previous]) / span;
+    }
+
+    return tangents;
+}
+
+/// <summary>
+/// Cubic Hermite interpolation inside a keyframe segment
+/// </summary>
+/// <param name="p0">: value at the first key</param>
+/// <param name="m0">: tangent at the first key, per second</param>
+/// <param name="p1">: value at the second key</param>
+/// <param name="m1">: tangent at the second key, per second</param>
+/// <param name="span">: segment duration in seconds</param>
+/// <param name="t">: interpolation factor in [0, 1]</param>
 /// <returns></returns>
-glm::vec3 CubicInterpolate(
-    const glm::vec3& p0, const glm::vec3& p1,
-    const glm::vec3& p2, const glm::vec3& p3,
-    float t)
+inline glm::vec3 HermiteInterpolate(const glm::vec3& p0, const glm::vec3& m0, const glm::vec3& p1, const glm::vec3& m1, const float span, const float t)
 {
-    float t2 = t * t;
-    float t3 = t2 * t;
+    const float t2 = t * t;
+    const float t3 = t2 * t;
 
-    glm::vec3 a = (3.0f * p1 - 3.0f * p2 + p3 - p0) / 2.0f;
-    glm::vec3 b = (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) / 2.0f;
-    glm::vec3 c = (p2 - p0) / 2.0f;
-    glm::vec3 d = p1;
+    const float h00 = 2.0f * t3 - 3.0f * t2 + 1.0f;
+    const float h10 = t3 - 2.0f * t2 + t;
+    const float h01 = -2.0f * t3 + 3.0f * t2;
+    const float h11 = t3 - t2;
+
+    return h00 * p0 + (h10 * span) * m0 + h01 * p1 + (h11 * span) * m1;
+}
+
+/// <summary>
+/// Logarithm of a unit quaternion, as a pure quaternion
+/// </summary>
+inline glm::vec3 QuatLog(const glm::quat& q)
+{
+    const glm::vec3 axis(q.x, q.y, q.z);
+    const float sinAngle = glm::length(axis);
+    if (sinAngle < 1.0e-6f)
+        return axis;
 
-    return a * t3 + b * t2 + c * t + d;
+    return axis * (std::atan2(sinAngle, q.w) / sinAngle);
 }
 
 /// <summary>
-/// Cubic Interpolation for glm::quaternion
+/// Exponential of a pure quaternion
 /// </summary>
-/// <param name="q0"></param>
-/// <param name="q1"></param>
-/// <param name="q2"></param>
-/// <param name="q3"></param>
-/// <param name="t"></param>
+inline glm::quat QuatExp(const glm::vec3& v)
+{
+    const float angle = glm::length(v);
+    if (angle < 1.0e-6f)
+        return glm::normalize(glm::quat(1.0f, v.x, v.y, v.z));
+
+    const glm::vec3 axis = v * (std::sin(angle) / angle);
+    return glm::quat(std::cos(angle), axis.x, axis.y, axis.z);
+}
+
+/// <summary>
+/// Squad control point of a key from its neighbours, which must be in the hemisphere of the key
+/// </summary>
+inline glm::quat SquadControlPoint(const glm::quat& previous, const glm::quat& current, const glm::quat& next)
+{
+    const glm::quat inverse = glm::conjugate(current);
+    const glm::vec3 tangent = (QuatLog(inverse * next) + QuatLog(inverse * previous)) * -0.25f;
+
+    return glm::normalize(current * QuatExp(tangent));
+}
+
+/// <summary>
+/// Squad control points of a rotation track. End keys are their own control points
+/// </summary>
+/// <param name="rotations">: key rotations</param>
 /// <returns></returns>
-glm::quat CubicInterpolate(
-    const glm::quat& q0, const glm::quat& q1,
-    const glm::quat& q2, const glm::quat& q3,
-    float t)
+inline std::vector<glm::quat> ComputeSquadControls(const std::vector<glm::quat>& rotations)
 {
-    float t2 = t * t;
-    float t3 = t2 * t;
+    std::vector<glm::quat> controls(rotations);
 
-    glm::quat a = (q3 - q2 + 3.0f * (q1 - q0)) / 2.0f;
-    glm::quat b = (q0 + q2 - 2.0f * q1) / 2.0f;
-    glm::quat c = (q2 - q0) / 2.0f;
-    glm::quat d = q1;
+    for (size_t k = 1; k + 1 < rotations.size(); k++)
+    {
+        // q and -q are the same rotation, take the shortest path to both neighbours
+        const glm::quat& current = rotations[k];
+        const glm::quat previous = (glm::dot(current, rotations[k - 1]) < 0.0f) ? -rotations[k - 1] : rotations[k - 1];
+        const glm::quat next = (glm::dot(current, rotations[k + 1]) < 0.0f) ? -rotations[k + 1] : rotations[k + 1];
 
-    return (a * t3) + (b * t2) + (c * t) + d;
+        controls[k] = SquadControlPoint(previous, current, next);
+    }
+
+    return controls;
+}
+
+/// <summary>
+/// Weight between the two inner slerps of squad: squad(q0, q1, s0, s1, t) = slerp(slerp(q0, q1, t), slerp(s0, s1, t), SquadFactor(t))
+/// </summary>
+inline float SquadFactor(const float t)
+{
+    return 2.0f * t * (1.0f - t);
 }
@@ -2,6 +2,8 @@
 
 #include<AnimationPlayer.hpp>
 
+#include <deque>
+
 enum GUI_BUTTON {
     RESET_BUTTON,
     PLAY_PAUSE_BUTTON
@@ -18,6 +20,7 @@ struct GUI {
     float animated_scale = 1.0f;
     float animation_speed = 1.0f;
     float animation_interpolation_value = 0.0f;
+    int blend_animation = 9;                    // Clip blended over the current animation, clamped to the clips of each model
 	bool spacebar_down = false;
 	bool first_mouse_flag = true;
     bool wireframe_flag = false;
@@ -28,11 +31,41 @@ struct GUI {
     bool cubic_interpolation_flag = false;
     bool grid_flag = false;
     bool normals_flag = false;
+    bool depth_prepass_flag = true;             // Only used with DEPTH_PREPASS
+    uint32_t palette_bytes = 0;                 // Bone palette bytes written per frame
+    const char* palette_encoding = "";
+    uint32_t evaluated_poses = 0;               // Players that evaluated their pose this frame
+    uint32_t cached_poses = 0;                  // Players that reused their last pose
+    uint32_t shared_poses = 0;                  // Players that took the pose of another player instead of evaluating it
+    bool share_poses_flag = true;
+    bool animation_lod_flag = true;
+    uint32_t lod_players[ANIMATION_LOD_COUNT] = {};     // Animated players at each animation LOD level
+    bool mesh_lod_flag = true;                  // Only used with MESH_LODS
+    float lod_pixel_error = MESH_LOD_PIXEL_ERROR;       // Projected error a mesh LOD may have, in pixels
+    uint32_t lod_models[MESH_LOD_COUNT] = {};   // Drawn models at each mesh LOD level
+    uint32_t drawn_triangles = 0;               // Triangles of the drawn models at their mesh LOD, and at full detail
+    uint32_t full_triangles = 0;
+    bool cluster_culling_flag = true;           // Only used with CLUSTER_CULLING
+    bool cluster_backface_flag = true;          // Cull meshlets by their normal cones, besides the frustum
+    uint32_t cluster_visible_triangles = 0;     // Triangles of cluster culled meshes in visible meshlets, and in all of their meshlets
+    uint32_t cluster_tested_triangles = 0;
+    float model_pass_ms = 0.0f;                 // GPU time of model draws, if measured
+    char stream_model_file[256] = "models/suzanne.obj";         // Model streamed in by the load button
+    char stream_diffuse_file[256] = "textures/marble.png";
+    char stream_normal_file[256] = "textures/marble_normal.png";
+    bool load_model_flag = false;               // Set by the load button, cleared by the renderer once it requested the model
+    int remove_model_index = -1;                // Model whose remove button was pressed, -1 if none
+    uint32_t streaming_models = 0;              // Models importing or uploading in the background
+    bool compact_geometry_flag = false;         // Set by the compact button, cleared by the renderer once no upload is in flight
+    uint32_t geometry_blocks = 0;               // Geometry arena blocks and their vertex usage
+    uint32_t geometry_used_vertices = 0;
+    uint32_t geometry_capacity_vertices = 0;
+    uint32_t geometry_largest_free_vertices = 0;
 	float lastX = 0.0f;
 	float lastY = 0.0f;
     Camera* cam;
     Timer* timer;
-    Model* models = nullptr;
+    std::deque<Model>* models = nullptr;
     AnimationPlayer* animationPlayers = nullptr;
     uint32_t nModels = 0;
     uint32_t nAnimationPlayers = 0;
@@ -41,10 +74,23 @@ struct GUI {
 
     void Setup()
     {
-        model_scales = std::vector<float>(nModels, 1.0f);
+        // Called again whenever models are added, so settings of existing models are kept
+        model_scales.resize(nModels, 1.0f);
         model_translations.resize(nModels);
         explode_flags.resize(nModels);
-        explosion_rates = std::vector<float>(nModels, 4.7f);
+        explosion_rates.resize(nModels, 4.7f);
+    }
+
+    // Called when a new model reuses the slot of a removed one, so it doesn't inherit its settings
+    void ResetModel(size_t i)
+    {
+        if (i >= model_scales.size())
+            return;
+
+        model_scales[i] = 1.0f;
+        model_translations[i] = {};
+        explode_flags[i] = 0;
+        explosion_rates[i] = 4.7f;
     }
 
 	void Render()
@@ -57,6 +103,15 @@ struct GUI {
         ImGui::Text("FPS: %.2f", timer->GetData().FPS);
         //ImGui::PlotLines("FPS", timer->GetFPSS(), FPS_SAMPLES);
         ImGui::PlotLines("ms", timer->GetDeltas(), FPS_SAMPLES);
+        ImGui::Text("Bone palettes: %u bytes/frame (%s)", palette_bytes, palette_encoding);
+        ImGui::Text("Poses: %u evaluated, %u cached, %u shared", evaluated_poses, cached_poses, shared_poses);
+        ImGui::Text("Animation LOD players: %u / %u / %u / %u", lod_players[0], lod_players[1], lod_players[2], lod_players[3]);
+        if (model_pass_ms > 0.0f)
+            ImGui::Text("Model draws (GPU): %.3f ms", model_pass_ms);
+        ImGui::Text("Mesh LOD models: %u / %u / %u / %u", lod_models[0], lod_models[1], lod_models[2], lod_models[3]);
+        ImGui::Text("Triangles: %u of %u", drawn_triangles, full_triangles);
+        if (cluster_tested_triangles > 0)
+            ImGui::Text("Cluster culling: %u of %u triangles visible", cluster_visible_triangles, cluster_tested_triangles);
         ImGui::Separator();
         ImGui::Text("Campos: %.2f, %.2f, %.2f", cam->position.x, cam->position.y, cam->position.z);
         ImGui::Checkbox("Arcball mode", &cam->arcball_mode);
@@ -74,10 +129,24 @@ struct GUI {
         ImGui::Checkbox("Skybox rendering", &skybox_flag);
         ImGui::Checkbox("Grid rendering", &grid_flag);
         ImGui::Checkbox("Draw normals", &normals_flag);
+        ImGui::Checkbox("Depth pre-pass", &depth_prepass_flag);
+        ImGui::Checkbox("Mesh LOD", &mesh_lod_flag);
+        ImGui::SliderFloat("Mesh LOD pixel error", &lod_pixel_error, 0.25f, 8.0f, "%.2f");
+        ImGui::Checkbox("Cluster culling", &cluster_culling_flag);
+        ImGui::Checkbox("Cluster backface culling", &cluster_backface_flag);
         ImGui::Separator();
         ImGui::SliderFloat("Animation speed", &animation_speed, 0.1f, 2.0f, "%.2f");
         ImGui::SliderFloat("Animation interpolation", &animation_interpolation_value, 0.0f, 1.0f, "%.2f");
+        int maxClip = 0;
+        for (size_t i = 0; i < nModels; i++)
+        {
+            if ((*models)[i].resident)
+                maxClip = std::max(maxClip, static_cast<int>((*models)[i].meshes[0].animations.size()) - 1);
+        }
+        ImGui::SliderInt("Blend animation", &blend_animation, 0, maxClip);
         ImGui::Checkbox("Cubic interpolation", &cubic_interpolation_flag);
+        ImGui::Checkbox("Share poses between players", &share_poses_flag);
+        ImGui::Checkbox("Animation LOD", &animation_lod_flag);
         ImGui::BeginGroup();
         if (ImGui::Button("Reset animation"))
             ButtonCallback(RESET_BUTTON);
@@ -85,8 +154,24 @@ struct GUI {
             ButtonCallback(PLAY_PAUSE_BUTTON);
         ImGui::EndGroup();
         ImGui::Separator();
+        ImGui::InputText("Stream model", stream_model_file, sizeof(stream_model_file));
+        ImGui::InputText("Stream diffuse", stream_diffuse_file, sizeof(stream_diffuse_file));
+        ImGui::InputText("Stream normal", stream_normal_file, sizeof(stream_normal_file));
+        if (ImGui::Button("Load model"))
+            load_model_flag = true;
+        if (streaming_models > 0)
+            ImGui::Text("Streaming %u model(s)", streaming_models);
+        ImGui::Text("Geometry: %u block(s), %u / %u vertices, largest free range %u", geometry_blocks,
+            geometry_used_vertices, geometry_capacity_vertices, geometry_largest_free_vertices);
+        if (ImGui::Button("Compact geometry"))
+            compact_geometry_flag = true;
+        ImGui::Separator();
         for (size_t i = 0; i < nModels; i++)
         {
+            Model& model = (*models)[i];
+            if (!model.resident)
+                continue;
+
             const std::string strIndex = std::string("Model ") + std::to_string(i);
             const std::string strEnabled = std::string("Model ") + std::to_string(i) + " enabled";
             const std::string strTranslation = std::string("Model ") + std::to_string(i) + " translation";
@@ -94,14 +179,17 @@ struct GUI {
             const std::string strExplodeFlag = std::string("Model ") + std::to_string(i) + " explode";
             const std::string strExplodeRate = std::string("Model ") + std::to_string(i) + " explode rate";
             const std::string strAnim = std::string(" Model ") + std::to_string(i) + " current animation";
+            const std::string strRemove = std::string("Remove model ") + std::to_string(i);
             ImGui::TextColored(ImVec4(1, 1, 0, 1), strIndex.c_str());
-            ImGui::Checkbox(strEnabled.c_str(), &models[i].enabled);
+            ImGui::Checkbox(strEnabled.c_str(), &model.enabled);
             ImGui::SliderFloat3(strTranslation.c_str(), model_translations[i].data(), -10.0f, 10.0f, "%.2f");
             ImGui::SliderFloat(strScale.c_str(), &model_scales[i], 0.01f, 5.0f, "%.02f");
             ImGui::Checkbox(strExplodeFlag.c_str(), (bool*)&explode_flags[i]);
             ImGui::SliderFloat(strExplodeRate.c_str(), &explosion_rates[i], 0.0f, 10.0f, "%.1f");
-            if (models[i].meshes[0].animations.size() > 0)
-                ImGui::SliderInt(strAnim.c_str(), &models[i].currentAnim, 0, std::max(0, static_cast<int>(models[i].meshes[0].animations.size()) - 1));
+            if (model.meshes[0].animations.size() > 0)
+                ImGui::SliderInt(strAnim.c_str(), &model.currentAnim, 0, std::max(0, static_cast<int>(model.meshes[0].animations.size()) - 1));
+            if (ImGui::Button(strRemove.c_str()))
+                remove_model_index = static_cast<int>(i);
         }
         ImGui::End();
 
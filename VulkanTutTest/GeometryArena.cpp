@@ -0,0 +1,80 @@
+#include <GeometryArena.hpp>
+
+#include <algorithm>
+#include <iterator>
+
+RangeAllocator::RangeAllocator(const uint32_t capacity)
+    :
+    capacity(capacity)
+{
+    if (capacity > 0)
+        freeRanges[0] = capacity;
+}
+
+bool RangeAllocator::Allocate(const uint32_t size, const uint32_t alignment, uint32_t& offset)
+{
+    if (size == 0)
+    {
+        offset = 0;
+        return true;
+    }
+
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+    {
+        const uint32_t rangeOffset = it->first;
+        const uint32_t rangeEnd = it->first + it->second;
+        const uint32_t aligned = ((rangeOffset + alignment - 1) / alignment) * alignment;
+        if (aligned >= rangeEnd || rangeEnd - aligned < size)
+            continue;
+
+        // Split off what stays free before and after the allocation
+        freeRanges.erase(it);
+        if (aligned > rangeOffset)
+            freeRanges[rangeOffset] = aligned - rangeOffset;
+        if (aligned + size < rangeEnd)
+            freeRanges[aligned + size] = rangeEnd - (aligned + size);
+
+        offset = aligned;
+        used += size;
+        return true;
+    }
+
+    return false;
+}
+
+void RangeAllocator::Free(uint32_t offset, uint32_t size)
+{
+    if (size == 0)
+        return;
+
+    used -= size;
+
+    // Merge with the free ranges right after and right before
+    auto next = freeRanges.lower_bound(offset);
+    if (next != freeRanges.end() && next->first == offset + size)
+    {
+        size += next->second;
+        next = freeRanges.erase(next);
+    }
+
+    if (next != freeRanges.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset)
+        {
+            previous->second += size;
+            return;
+        }
+    }
+
+    freeRanges[offset] = size;
+}
+
+uint32_t RangeAllocator::LargestFreeRange() const
+{
+    uint32_t largest = 0;
+    for (const auto& range : freeRanges)
+        largest = std::max(largest, range.second);
+
+    return largest;
+}
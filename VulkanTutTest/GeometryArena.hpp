@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <map>
+#include <cstdint>
+
+const uint32_t GEOMETRY_BLOCK_VERTICES = 1 << 18;       // Vertices of a geometry block, unless a mesh needs more
+const uint32_t GEOMETRY_BLOCK_INDICES = 1 << 20;        // Indices of a geometry block, unless a mesh needs more
+const uint32_t GEOMETRY_BLOCK_MESHLETS = 1 << 14;       // Meshlets of a geometry block, unless a mesh needs more
+
+/// <summary>
+/// First fit allocator of ranges in [0, capacity). Free ranges are coalesced, so freeing everything leaves a single range
+/// </summary>
+class RangeAllocator {
+public:
+    RangeAllocator(uint32_t capacity = 0);
+
+    /// <summary>
+    /// Allocates size units at an offset that is a multiple of alignment. Allocations of size 0 always succeed at offset 0
+    /// </summary>
+    /// <returns>false if no free range fits</returns>
+    bool Allocate(uint32_t size, uint32_t alignment, uint32_t& offset);
+
+    /// <summary>
+    /// Frees a range returned by Allocate
+    /// </summary>
+    void Free(uint32_t offset, uint32_t size);
+
+    uint32_t Capacity() const { return capacity; }
+    uint32_t Used() const { return used; }
+    uint32_t LargestFreeRange() const;
+
+private:
+    std::map<uint32_t, uint32_t> freeRanges;            // Offset to size of each free range
+    uint32_t capacity = 0;
+    uint32_t used = 0;
+};
+
+/// <summary>
+/// Where a mesh lives in the geometry arena. Indices are relative to firstVertex, which draws pass as vertexOffset.
+/// Meshlet index ranges are relative to firstIndex
+/// </summary>
+struct GeometryAllocation {
+    uint32_t block = 0;
+    uint32_t firstVertex = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    uint32_t firstMeshlet = 0;
+    uint32_t meshletCount = 0;
+};
+
+/// <summary>
+/// Device local buffers that meshes are suballocated from. Every vertex stream of a block is indexed by the same vertex ranges,
+/// so binding a block once serves all of its meshes. Streams a build doesn't use are null
+/// </summary>
+struct GeometryBlock {
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;             // Vertex, or CompactVertex with COMPACT_VERTICES
+    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+    VkBuffer skinningBuffer = VK_NULL_HANDLE;           // Bone influences, with COMPACT_VERTICES or DEPTH_PREPASS. Only skinned meshes fill their range
+    VkDeviceMemory skinningBufferMemory = VK_NULL_HANDLE;
+    VkBuffer positionBuffer = VK_NULL_HANDLE;           // Position-only stream, with DEPTH_PREPASS
+    VkDeviceMemory positionBufferMemory = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+    VkBuffer meshletBuffer = VK_NULL_HANDLE;            // Meshlet bounds read by the cluster culling pass, with CLUSTER_CULLING
+    VkDeviceMemory meshletBufferMemory = VK_NULL_HANDLE;
+    RangeAllocator vertices;                            // In vertices
+    RangeAllocator indices;                             // In indices
+    RangeAllocator meshlets;                            // In meshlets
+};
+
+/// <summary>
+/// A buffer that frames in flight may still read, destroyed once they complete
+/// </summary>
+struct RetiredBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    uint64_t frame = 0;                                 // Frame counter when the buffer was retired
+};
+
+/// <summary>
+/// Compaction copies submitted to the graphics queue, freed once their fence signals
+/// </summary>
+struct GeometryCompaction {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+};
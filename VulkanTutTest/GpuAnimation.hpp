@@ -0,0 +1,293 @@
+#pragma once
+
+#include <Model.hpp>
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+const uint32_t GPU_ANIMATION_GROUP_SIZE = 64;		// Invocations per animation_eval.comp workgroup
+
+/// <summary>
+/// Per-instance input of animation_eval.comp, in std430 layout. The only data uploaded every frame
+/// </summary>
+struct GpuAnimationInstance {
+	uint32_t clip;									// Clip index of the model
+	float time;										// Time inside the clip in seconds, already looped
+};
+
+// Passes of animation_eval.comp
+const uint32_t GPU_ANIMATION_PASS_SAMPLE = 0;		// One invocation per instance and joint, writes local transforms
+const uint32_t GPU_ANIMATION_PASS_HIERARCHY = 1;	// One invocation per instance and joint of a depth level, writes global transforms and palettes
+
+/// <summary>
+/// Push constants of animation_eval.comp
+/// </summary>
+struct GpuAnimationPass {
+	uint32_t pass;
+	uint32_t levelOffset;							// First joint of the level in the sorted joint indices
+	uint32_t levelCount;							// Joints in the level
+	uint32_t instanceCount;
+};
+
+/// <summary>
+/// Start of the packed animation data. Offsets are in 32-bit words from the start of the buffer
+/// </summary>
+struct GpuRigHeader {
+	float inverseTransform[16];						// Mesh::inverseTransform
+	uint32_t jointCount;
+	uint32_t boneCount;
+	uint32_t clipCount;
+	uint32_t jointsOffset;							// GpuJoint of each joint
+	uint32_t bonesOffset;							// Offset matrix of each bone
+	uint32_t levelsOffset;							// Joint indices sorted by depth in the hierarchy
+	uint32_t tracksOffset;							// GpuTrack of each [clip][joint]
+	uint32_t unused;
+};
+
+/// <summary>
+/// Joint of the flattened skeleton
+/// </summary>
+struct GpuJoint {
+	float localBind[16];							// Skeleton::localBindTransforms, used when a clip has no track for the joint
+	int32_t parent;									// -1 for the root
+	int32_t bone;									// -1 if the joint doesn't deform the mesh
+};
+
+/// <summary>
+/// Channel of a track, with its own keyframe times. A keyCount of 1 is constant, 0 uses the default value of the channel
+/// </summary>
+struct GpuChannel {
+	uint32_t timesOffset;
+	uint32_t keyCount;
+	uint32_t valuesOffset;
+};
+
+/// <summary>
+/// Track of a joint in a clip. Compressed channels take 2 words per key (16-bit components), raw ones 3 or 4 floats
+/// </summary>
+struct GpuTrack {
+	float scaleMin[3];
+	float scaleExtent[3];
+	float translationMin[3];
+	float translationExtent[3];
+	GpuChannel scale;
+	GpuChannel rotation;
+	GpuChannel translation;
+	uint32_t animated;								// 0 if the clip doesn't animate the joint
+	uint32_t raw;									// Channels are stored as floats, the track was not compressed
+};
+
+// animation_eval.comp reads the packed data by word offset
+static_assert(sizeof(GpuRigHeader) == 24 * sizeof(uint32_t), "animation_eval.comp must match the GpuRigHeader layout!");
+static_assert(sizeof(GpuJoint) == 18 * sizeof(uint32_t), "animation_eval.comp must match the GpuJoint layout!");
+static_assert(sizeof(GpuTrack) == 23 * sizeof(uint32_t), "animation_eval.comp must match the GpuTrack layout!");
+
+/// <summary>
+/// Skeleton and every clip of a model packed into one array of 32-bit words, uploaded once for animation_eval.comp.
+/// Joints are also grouped by depth, so each level of the hierarchy can be resolved by one dispatch
+/// </summary>
+struct GpuAnimationData {
+	std::vector<uint32_t> words;
+	std::vector<uint32_t> levelOffsets;				// First entry of each depth level in the sorted joint indices
+	std::vector<uint32_t> levelCounts;				// Joints in each depth level
+	uint32_t jointCount = 0;
+	uint32_t boneCount = 0;
+
+	inline size_t MemorySize() const
+	{
+		return words.size() * sizeof(uint32_t);
+	}
+
+	inline uint32_t LevelCount() const
+	{
+		return static_cast<uint32_t>(levelOffsets.size());
+	}
+
+	/// <summary>
+	/// Appends a trivially copyable value and returns its word offset
+	/// </summary>
+	template<typename T>
+	uint32_t Append(const T& value)
+	{
+		static_assert(sizeof(T) % sizeof(uint32_t) == 0, "Packed values must be whole words!");
+
+		const uint32_t offset = static_cast<uint32_t>(words.size());
+		words.resize(words.size() + sizeof(T) / sizeof(uint32_t));
+		std::memcpy(words.data() + offset, &value, sizeof(T));
+
+		return offset;
+	}
+
+	/// <summary>
+	/// Appends two 16-bit values per word, the last word of odd counts is padded
+	/// </summary>
+	void AppendShorts(const uint16_t* data, const size_t count)
+	{
+		for (size_t i = 0; i < count; i += 2)
+			words.push_back(data[i] | ((i + 1 < count) ? static_cast<uint32_t>(data[i + 1]) << 16 : 0u));
+	}
+
+	inline void Write(const uint32_t offset, const void* data, const size_t size)
+	{
+		std::memcpy(words.data() + offset, data, size);
+	}
+};
+
+/// <summary>
+/// Packs the times and values of a channel
+/// </summary>
+/// <param name="channel">: keyframes of the channel</param>
+/// <param name="data">: packed data the keys are appended to</param>
+/// <param name="pack">: appends one value</param>
+/// <returns>Header of the channel</returns>
+template<typename T, typename Pack>
+inline GpuChannel PackGpuChannel(const KeyChannel<T>& channel, GpuAnimationData& data, const Pack& pack)
+{
+	GpuChannel gpuChannel;
+	gpuChannel.keyCount = static_cast<uint32_t>(channel.KeyCount());
+
+	gpuChannel.timesOffset = static_cast<uint32_t>(data.words.size());
+	for (const float time : channel.times)
+		data.Append(time);
+
+	gpuChannel.valuesOffset = static_cast<uint32_t>(data.words.size());
+	for (const T& value : channel.values)
+		pack(value);
+
+	return gpuChannel;
+}
+
+/// <summary>
+/// Packs a track for animation_eval.comp: compressed keys stay quantized, raw keys are converted to floats
+/// </summary>
+/// <param name="pose">: track of the clip</param>
+/// <param name="data">: packed data the keys are appended to</param>
+/// <returns>Header of the track</returns>
+inline GpuTrack PackGpuTrack(const AnimationPose& pose, GpuAnimationData& data)
+{
+	GpuTrack track{};
+	track.animated = 1;
+	track.raw = !pose.IsCompressed();
+
+	if (!track.raw)
+	{
+		const CompressedTrack& compressed = pose.compressed;
+		for (int c = 0; c < 3; c++)
+		{
+			track.scaleMin[c] = compressed.scaleMin[c];
+			track.scaleExtent[c] = compressed.scaleExtent[c];
+			track.translationMin[c] = compressed.translationMin[c];
+			track.translationExtent[c] = compressed.translationExtent[c];
+		}
+
+		auto appendVec3 = [&](const QuantizedVec3& value) { data.AppendShorts(value.data, 3); };
+		track.scale = PackGpuChannel(compressed.scales, data, appendVec3);
+		track.rotation = PackGpuChannel(compressed.rotations, data, [&](const PackedQuat& value) { data.AppendShorts(value.data, 3); });
+		track.translation = PackGpuChannel(compressed.translations, data, appendVec3);
+
+		return track;
+	}
+
+	auto appendVec3 = [&](const glm::vec3& value) { data.Append(value); };
+	track.scale = PackGpuChannel(pose.scales, data, appendVec3);
+	// Stored as x, y, z, w
+	track.rotation = PackGpuChannel(pose.rotations, data, [&](const glm::quat& value) { data.Append(glm::vec4(value.x, value.y, value.z, value.w)); });
+	track.translation = PackGpuChannel(pose.translations, data, appendVec3);
+
+	return track;
+}
+
+/// <summary>
+/// Packs the skeleton, bones and every clip of a model for animation_eval.comp
+/// </summary>
+/// <param name="model">: model with animations</param>
+/// <returns></returns>
+inline GpuAnimationData PackGpuAnimation(const Model& model)
+{
+	// TODO: Handle multi-mesh models
+	const Mesh& mesh = model.meshes[0];
+	const Skeleton& skeleton = mesh.skeleton;
+
+	GpuAnimationData data;
+	data.jointCount = static_cast<uint32_t>(skeleton.JointCount());
+	data.boneCount = static_cast<uint32_t>(mesh.boneCounter);
+
+	GpuRigHeader header{};
+	std::memcpy(header.inverseTransform, &mesh.inverseTransform, sizeof(header.inverseTransform));
+	header.jointCount = data.jointCount;
+	header.boneCount = data.boneCount;
+	header.clipCount = static_cast<uint32_t>(mesh.animations.size());
+	data.Append(header);
+
+	// Joints
+	header.jointsOffset = static_cast<uint32_t>(data.words.size());
+	for (size_t joint = 0; joint < skeleton.JointCount(); joint++)
+	{
+		GpuJoint gpuJoint;
+		std::memcpy(gpuJoint.localBind, &skeleton.localBindTransforms[joint], sizeof(gpuJoint.localBind));
+		gpuJoint.parent = skeleton.parents[joint];
+		gpuJoint.bone = skeleton.boneIndices[joint];
+		data.Append(gpuJoint);
+	}
+
+	// Bone offsets
+	header.bonesOffset = static_cast<uint32_t>(data.words.size());
+	for (uint32_t bone = 0; bone < data.boneCount; bone++)
+		data.Append(mesh.bones[bone].offsetMatrix);
+
+	// Joints grouped by depth. Parents come before their children, so a single forward pass finds the depths
+	std::vector<uint32_t> depths(skeleton.JointCount(), 0);
+	for (size_t joint = 0; joint < skeleton.JointCount(); joint++)
+	{
+		if (skeleton.parents[joint] >= 0)
+			depths[joint] = depths[skeleton.parents[joint]] + 1;
+	}
+
+	const uint32_t levelCount = depths.empty() ? 0 : *std::max_element(depths.begin(), depths.end()) + 1;
+	data.levelCounts.assign(levelCount, 0);
+	for (const uint32_t depth : depths)
+		data.levelCounts[depth]++;
+
+	data.levelOffsets.assign(levelCount, 0);
+	for (uint32_t level = 1; level < levelCount; level++)
+		data.levelOffsets[level] = data.levelOffsets[level - 1] + data.levelCounts[level - 1];
+
+	header.levelsOffset = static_cast<uint32_t>(data.words.size());
+	data.words.resize(data.words.size() + skeleton.JointCount());
+	std::vector<uint32_t> levelFill = data.levelOffsets;
+	for (uint32_t joint = 0; joint < data.jointCount; joint++)
+		data.words[header.levelsOffset + levelFill[depths[joint]]++] = joint;
+
+	// Track headers, then the keys they point to
+	header.tracksOffset = static_cast<uint32_t>(data.words.size());
+	data.words.resize(data.words.size() + static_cast<size_t>(header.clipCount) * data.jointCount * sizeof(GpuTrack) / sizeof(uint32_t));
+
+	for (uint32_t clip = 0; clip < header.clipCount; clip++)
+	{
+		for (uint32_t joint = 0; joint < data.jointCount; joint++)
+		{
+			const int32_t trackIndex = skeleton.clipTracks[clip][joint];
+			const GpuTrack track = (trackIndex >= 0) ? PackGpuTrack(mesh.animations[clip].tracks[trackIndex], data) : GpuTrack{};
+
+			data.Write(header.tracksOffset + (clip * data.jointCount + joint) * static_cast<uint32_t>(sizeof(GpuTrack) / sizeof(uint32_t)), &track, sizeof(track));
+		}
+	}
+
+	data.Write(0, &header, sizeof(header));
+
+	return data;
+}
+
+/// <summary>
+/// Workgroups for one invocation per item, within the guaranteed maxComputeWorkGroupCount
+/// </summary>
+inline uint32_t GpuAnimationGroupCount(const size_t items)
+{
+	const size_t groups = (items + GPU_ANIMATION_GROUP_SIZE - 1) / GPU_ANIMATION_GROUP_SIZE;
+	if (groups > 65535)
+		throw std::runtime_error("too many animation instances for one dispatch!");
+
+	return static_cast<uint32_t>(groups);
+}
@@ -30,12 +30,13 @@ public:
 	/// <param name="geomShaderFile"></param>
 	/// <param name="name"></param>
 	/// <param name="graphicsPipeline"></param>
+	/// <param name="depthCompareOp">: LESS_OR_EQUAL lets pipelines shade over the depth laid down by a depth-only pipeline</param>
 	GraphicsPipeline(VkDevice& device, Swapchain& swapChain, const VkSampleCountFlagBits msaaSamples, const VkBool32 sampleShading,
 		const VkPolygonMode polygonMode, const VkBool32 const depthTest, VkBool32 depthWrite,
-		const VkVertexInputBindingDescription vertexBindingDescriptions, const std::vector<VkVertexInputAttributeDescription>& vertexAttributeDescriptions,
+		const std::vector<VkVertexInputBindingDescription>& vertexBindingDescriptions, const std::vector<VkVertexInputAttributeDescription>& vertexAttributeDescriptions,
 		VkPipelineLayout& pipelineLayout, VkDescriptorSetLayout& descriptorSetLayout, VkRenderPass& renderPass,
 		const char* vertShaderFile, const char* fragShaderFile, const char* geomShaderFile, const std::string name,
-		VkPipeline& graphicsPipeline);
+		VkPipeline& graphicsPipeline, const VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS);
 
 	/// <summary>
 	/// Constructor for vertex and fragment shader graphics pipeline
@@ -59,11 +60,31 @@ public:
 	/// <param name="graphicsPipeline"></param>
 	GraphicsPipeline(VkDevice& device, Swapchain& swapChain, const VkSampleCountFlagBits msaaSamples, const VkBool32 sampleShading,
 		const VkPolygonMode polygonMode, const VkBool32 depthTest, const VkBool32 depthWrite,
-		const VkVertexInputBindingDescription vertexBindingDescriptions, const std::vector<VkVertexInputAttributeDescription>& vertexAttributeDescriptions,
+		const std::vector<VkVertexInputBindingDescription>& vertexBindingDescriptions, const std::vector<VkVertexInputAttributeDescription>& vertexAttributeDescriptions,
 		VkPipelineLayout& pipelineLayout, VkDescriptorSetLayout& descriptorSetLayout, VkRenderPass& renderPass,
 		const char* vertShaderFile, const char* fragShaderFile, const std::string name,
 		VkPipeline& graphicsPipeline);
 
+	/// <summary>
+	/// Constructor for vertex shader only, depth-only graphics pipeline. Writes depth and no color, for depth pre-passes
+	/// </summary>
+	/// <param name="device"></param>
+	/// <param name="swapChain"></param>
+	/// <param name="msaaSamples"></param>
+	/// <param name="vertexBindingDescriptions"></param>
+	/// <param name="vertexAttributeDescriptions"></param>
+	/// <param name="pipelineLayout"></param>
+	/// <param name="descriptorSetLayout"></param>
+	/// <param name="renderPass"></param>
+	/// <param name="vertShaderFile"></param>
+	/// <param name="name"></param>
+	/// <param name="graphicsPipeline"></param>
+	GraphicsPipeline(VkDevice& device, Swapchain& swapChain, const VkSampleCountFlagBits msaaSamples,
+		const std::vector<VkVertexInputBindingDescription>& vertexBindingDescriptions, const std::vector<VkVertexInputAttributeDescription>& vertexAttributeDescriptions,
+		VkPipelineLayout& pipelineLayout, VkDescriptorSetLayout& descriptorSetLayout, VkRenderPass& renderPass,
+		const char* vertShaderFile, const std::string name,
+		VkPipeline& graphicsPipeline);
+
 	GraphicsPipeline();
 
 	~GraphicsPipeline();
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+/// <summary>
+/// Channels of an animation track. Each one has its own keyframe times
+/// </summary>
+enum class TrackChannel {
+	Scale,
+	Rotation,
+	Translation
+};
+
+const uint32_t TRACK_CHANNEL_COUNT = 3;
+const TrackChannel TRACK_CHANNELS[TRACK_CHANNEL_COUNT] = { TrackChannel::Scale, TrackChannel::Rotation, TrackChannel::Translation };
+
+/// <summary>
+/// Keyframes of one channel in SoA layout: key times and values in separate arrays.
+/// A constant channel keeps a single key, an empty one uses the default value of the channel
+/// </summary>
+template<typename T>
+struct KeyChannel {
+	std::vector<float> times;						// Time of each keyframe, in seconds
+	std::vector<T> values;							// Value of each keyframe
+
+	inline bool Empty() const
+	{
+		return times.empty();
+	}
+
+	inline size_t KeyCount() const
+	{
+		return times.size();
+	}
+
+	inline void Add(const float time, const T& value)
+	{
+		times.push_back(time);
+		values.push_back(value);
+	}
+
+	inline void Clear()
+	{
+		times.clear();
+		values.clear();
+	}
+
+	/// <summary>
+	/// Size of the times and values in bytes
+	/// </summary>
+	inline size_t MemorySize() const
+	{
+		return times.size() * sizeof(float) + values.size() * sizeof(T);
+	}
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <AnimationClip.hpp>
+#include <vector>
+#include <algorithm>
+
+/// <summary>
+/// Time of a keyframe in seconds. Lookups work on the time array of a channel
+/// </summary>
+inline double KeyTime(const float time)
+{
+	return time;
+}
+
+/// <summary>
+/// Keyframe pair of a channel around a sampling time
+/// </summary>
+struct KeyframeSegment {
+	uint32_t frame;									// First keyframe of the segment
+	uint32_t next;									// Second keyframe. Equal to frame if the channel has a single key or none
+	float factor;									// Interpolation factor between the keyframes
+	float span;										// Time between the keyframes in seconds
+};
+
+/// <summary>
+/// Finds the keyframe segment containing the given time by scanning every keyframe of the track.
+///
+/// XXX: This is the original per-node lookup, kept as a reference for the keyframe benchmark
+/// </summary>
+/// <param name="keys">: keyframes of the track</param>
+/// <param name="time">: sampling time in seconds</param>
+/// <returns>Index of the first keyframe of the segment</returns>
+template<typename Key>
+inline uint32_t FindKeyframeLinear(const std::vector<Key>& keys, const double time)
+{
+	uint32_t frame_index = 0;
+	for (uint32_t i = 0; i + 1 < keys.size(); i++)
+	{
+		if (KeyTime(keys[i]) <= time && time < KeyTime(keys[i + 1]))
+			frame_index = i;
+	}
+
+	return frame_index;
+}
+
+/// <summary>
+/// Finds the keyframe segment containing the given time using binary search.
+/// Times past the last keyframe are clamped to the last segment
+/// </summary>
+/// <param name="keys">: keyframes of the track</param>
+/// <param name="time">: sampling time in seconds</param>
+/// <returns>Index of the first keyframe of the segment</returns>
+template<typename Key>
+inline uint32_t FindKeyframeBinary(const std::vector<Key>& keys, const double time)
+{
+	if (keys.size() < 2)
+		return 0;
+
+	// First keyframe strictly after time
+	auto next_it = std::upper_bound(keys.begin(), keys.end(), time,
+		[](const double t, const Key& key) { return t < KeyTime(key); });
+
+	const uint32_t next_index = static_cast<uint32_t>(next_it - keys.begin());
+	if (next_index == 0)
+		return 0;
+
+	return std::min(next_index - 1, static_cast<uint32_t>(keys.size()) - 2);
+}
+
+/// <summary>
+/// Interpolation factor of the given time inside a keyframe segment, clamped to [0, 1]
+/// </summary>
+/// <param name="keys">: keyframes of the track</param>
+/// <param name="frame_index">: first keyframe of the segment</param>
+/// <param name="time">: sampling time in seconds</param>
+template<typename Key>
+inline float KeyframeFactor(const std::vector<Key>& keys, const uint32_t frame_index, const double time)
+{
+	if (frame_index + 1 >= keys.size())
+		return 0.0f;
+
+	const double span = KeyTime(keys[frame_index + 1]) - KeyTime(keys[frame_index]);
+	if (span <= 0.0)
+		return 0.0f;
+
+	return static_cast<float>(std::clamp((time - KeyTime(keys[frame_index])) / span, 0.0, 1.0));
+}
+
+/// <summary>
+/// Per-player keyframe lookup state.
+///
+/// Keeps a cursor per clip and track channel pointing to the last used keyframe segment. During normal playback
+/// time only moves forward by a fraction of a segment, so the lookup is a couple of comparisons.
+/// Seeks, loops and resets fall back to a binary search
+/// </summary>
+struct KeyframeSampler {
+	std::vector<std::vector<uint32_t>> cursors;			// Segment cursor for each [clip][track * TRACK_CHANNEL_COUNT + channel]
+
+	/// <summary>
+	/// Finds the keyframe segment containing the given time, updating the cursor of the track
+	/// </summary>
+	/// <param name="clip_index">: index of the clip in the mesh animations</param>
+	/// <param name="track_index">: cursor index of the track channel in the clip</param>
+	/// <param name="keys">: keyframes of the track</param>
+	/// <param name="time">: sampling time in seconds</param>
+	/// <returns>Index of the first keyframe of the segment</returns>
+	template<typename Key>
+	uint32_t FindKeyframe(const uint32_t clip_index, const uint32_t track_index, const std::vector<Key>& keys, const double time)
+	{
+		if (keys.size() < 2)
+			return 0;
+
+		uint32_t& cursor = GetCursor(clip_index, track_index);
+		const uint32_t last_segment = static_cast<uint32_t>(keys.size()) - 2;
+
+		if (cursor <= last_segment)
+		{
+			// Still inside the current segment
+			if ((cursor == 0 || KeyTime(keys[cursor]) <= time) && (time < KeyTime(keys[cursor + 1]) || cursor == last_segment))
+				return cursor;
+
+			// Moved forward to the next segment
+			if (KeyTime(keys[cursor]) <= time && (cursor + 1 == last_segment || time < KeyTime(keys[cursor + 2])))
+				return ++cursor;
+		}
+
+		// Seek, loop or reset
+		cursor = FindKeyframeBinary(keys, time);
+
+		return cursor;
+	}
+
+	/// <summary>
+	/// Finds the keyframe segment of a track channel containing the given time, on the compressed keyframes if the track has them
+	/// </summary>
+	/// <param name="clip_index">: index of the clip in the mesh animations</param>
+	/// <param name="pose">: track</param>
+	/// <param name="channel">: channel of the track</param>
+	/// <param name="time">: sampling time in seconds</param>
+	/// <param name="factor">: output for the interpolation factor inside the segment</param>
+	/// <returns>Index of the first keyframe of the segment</returns>
+	uint32_t FindKeyframe(const uint32_t clip_index, const AnimationPose& pose, const TrackChannel channel, const double time, float& factor)
+	{
+		const std::vector<float>& times = pose.KeyTimes(channel);
+		const uint32_t frame_index = FindKeyframe(clip_index, pose.trackIndex * TRACK_CHANNEL_COUNT + static_cast<uint32_t>(channel), times, time);
+		factor = KeyframeFactor(times, frame_index, time);
+
+		return frame_index;
+	}
+
+	/// <summary>
+	/// Finds the keyframe pair of a track channel around the given time
+	/// </summary>
+	/// <param name="clip_index">: index of the clip in the mesh animations</param>
+	/// <param name="pose">: track</param>
+	/// <param name="channel">: channel of the track</param>
+	/// <param name="time">: sampling time in seconds</param>
+	/// <returns></returns>
+	KeyframeSegment FindSegment(const uint32_t clip_index, const AnimationPose& pose, const TrackChannel channel, const double time)
+	{
+		KeyframeSegment segment;
+		segment.frame = FindKeyframe(clip_index, pose, channel, time, segment.factor);
+
+		const std::vector<float>& times = pose.KeyTimes(channel);
+		segment.next = (segment.frame + 1 < times.size()) ? segment.frame + 1 : segment.frame;
+		segment.span = times.empty() ? 0.0f : times[segment.next] - times[segment.frame];
+
+		return segment;
+	}
+
+	/// <summary>
+	/// Rewinds all cursors to the first segment
+	/// </summary>
+	void Reset()
+	{
+		for (auto& clip_cursors : cursors)
+			std::fill(clip_cursors.begin(), clip_cursors.end(), 0);
+	}
+
+private:
+	uint32_t& GetCursor(const uint32_t clip_index, const uint32_t track_index)
+	{
+		if (clip_index >= cursors.size())
+			cursors.resize(clip_index + 1);
+
+		std::vector<uint32_t>& clip_cursors = cursors[clip_index];
+		if (track_index >= clip_cursors.size())
+			clip_cursors.resize(track_index + 1, 0);
+
+		return clip_cursors[track_index];
+	}
+};
@@ -39,7 +39,7 @@ static std::vector<char> ReadFile(const std::string& filename)
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
     if (!file.is_open()) {
-        throw std::runtime_error("failed to open file!");
+        throw std::runtime_error("failed to open file " + filename + "!");
     }
 
     // Allocate memory
@@ -0,0 +1,515 @@
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include <MeshCache.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#include <type_traits>
+#include <thread>
+#include <functional>
+
+// Cached structs are copied byte for byte
+static_assert(std::is_trivially_copyable<Vertex>::value, "Vertex must be trivially copyable to be cached");
+static_assert(std::is_trivially_copyable<SQT>::value, "SQT must be trivially copyable to be cached");
+static_assert(std::is_trivially_copyable<PackedQuat>::value && std::is_trivially_copyable<QuantizedVec3>::value,
+    "Compressed keys must be trivially copyable to be cached");
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file = file;
+    m_mapping = mapping;
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        close(file);
+        return false;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED)
+        return false;
+
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = static_cast<size_t>(status.st_size);
+#endif // _WIN32
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+
+    m_file = nullptr;
+    m_mapping = nullptr;
+#else
+    if (m_data)
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif // _WIN32
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+uint64_t HashFile(const std::string& path)
+{
+    MappedFile file;
+    if (!file.Open(path))
+        return 0;
+
+    // FNV-1a over 64-bit words, then the trailing bytes. Source models are large, so bytewise hashing would dominate a warm start
+    uint64_t hash = HashValue(file.Size(), HASH_SEED);
+    const size_t words = file.Size() / sizeof(uint64_t);
+    for (size_t i = 0; i < words; i++)
+    {
+        uint64_t word;
+        std::memcpy(&word, file.Data() + i * sizeof(uint64_t), sizeof(uint64_t));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    hash = HashBytes(file.Data() + words * sizeof(uint64_t), file.Size() - words * sizeof(uint64_t), hash);
+
+    // 0 marks an unreadable file
+    return hash ? hash : 1;
+}
+
+std::string MeshCachePath(const std::string& folder, const std::string& sourcePath)
+{
+    return folder + std::filesystem::path(sourcePath).filename().string() + MESH_CACHE_EXTENSION;
+}
+
+/// <summary>
+/// Appends values to the cache file contents. Arrays are written as their size followed by their elements
+/// </summary>
+class CacheWriter
+{
+public:
+    std::vector<uint8_t> bytes;
+
+    template<typename T>
+    void Write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be written");
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(&value);
+        bytes.insert(bytes.end(), data, data + sizeof(T));
+    }
+
+    template<typename T>
+    void WriteArray(const std::vector<T>& values)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be written");
+        Write(static_cast<uint64_t>(values.size()));
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(values.data());
+        bytes.insert(bytes.end(), data, data + values.size() * sizeof(T));
+    }
+
+    void WriteString(const std::string& value)
+    {
+        Write(static_cast<uint64_t>(value.size()));
+        bytes.insert(bytes.end(), value.begin(), value.end());
+    }
+
+    template<typename T>
+    void WriteChannel(const KeyChannel<T>& channel)
+    {
+        WriteArray(channel.times);
+        WriteArray(channel.values);
+    }
+};
+
+/// <summary>
+/// Reads values back from mapped cache file contents. Reading past the end fails the reader instead of throwing,
+/// so a truncated or corrupt file is rejected like a stale one
+/// </summary>
+class CacheReader
+{
+public:
+    CacheReader(const uint8_t* data, const size_t size) : m_data(data), m_size(size) {}
+
+    inline bool Ok() const
+    {
+        return m_ok;
+    }
+
+    inline bool AtEnd() const
+    {
+        return m_offset == m_size;
+    }
+
+    template<typename T>
+    T Read()
+    {
+        T value{};
+        if (Reserve(sizeof(T)))
+            std::memcpy(&value, m_data + m_offset - sizeof(T), sizeof(T));
+
+        return value;
+    }
+
+    template<typename T>
+    void ReadArray(std::vector<T>& values)
+    {
+        const uint64_t count = Read<uint64_t>();
+        if (!m_ok || count > (m_size - m_offset) / sizeof(T) || !Reserve(count * sizeof(T)))
+        {
+            m_ok = false;
+            values.clear();
+            return;
+        }
+
+        values.resize(static_cast<size_t>(count));
+        if (count > 0)
+            std::memcpy(values.data(), m_data + m_offset - count * sizeof(T), static_cast<size_t>(count * sizeof(T)));
+    }
+
+    std::string ReadString()
+    {
+        const uint64_t size = Read<uint64_t>();
+        if (!m_ok || !Reserve(size))
+            return std::string();
+
+        return std::string(reinterpret_cast<const char*>(m_data + m_offset - size), static_cast<size_t>(size));
+    }
+
+    template<typename T>
+    void ReadChannel(KeyChannel<T>& channel)
+    {
+        ReadArray(channel.times);
+        ReadArray(channel.values);
+        if (channel.times.size() != channel.values.size())
+            m_ok = false;
+    }
+
+    /// <summary>
+    /// Reads an element count that must fit in the remaining bytes at one byte per element, failing the reader if it doesn't
+    /// </summary>
+    size_t ReadCount()
+    {
+        const uint64_t count = Read<uint64_t>();
+        if (count > m_size - m_offset)
+            m_ok = false;
+
+        return m_ok ? static_cast<size_t>(count) : 0;
+    }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_offset = 0;
+    bool m_ok = true;
+
+    /// <summary>
+    /// Moves past size bytes if they are available
+    /// </summary>
+    bool Reserve(const uint64_t size)
+    {
+        if (!m_ok || size > m_size - m_offset)
+        {
+            m_ok = false;
+            return false;
+        }
+
+        m_offset += static_cast<size_t>(size);
+        return true;
+    }
+};
+
+static void WriteTrack(CacheWriter& writer, const AnimationPose& track)
+{
+    writer.WriteString(track.bone_name);
+    writer.Write(track.trackIndex);
+
+    writer.WriteChannel(track.scales);
+    writer.WriteChannel(track.rotations);
+    writer.WriteChannel(track.translations);
+
+    const CompressedTrack& compressed = track.compressed;
+    writer.WriteChannel(compressed.scales);
+    writer.WriteChannel(compressed.rotations);
+    writer.WriteChannel(compressed.translations);
+    writer.Write(compressed.scaleMin);
+    writer.Write(compressed.scaleExtent);
+    writer.Write(compressed.translationMin);
+    writer.Write(compressed.translationExtent);
+
+    writer.WriteArray(track.cubic.scaleTangents);
+    writer.WriteArray(track.cubic.rotationControls);
+    writer.WriteArray(track.cubic.translationTangents);
+}
+
+static AnimationPose ReadTrack(CacheReader& reader)
+{
+    AnimationPose track;
+    track.bone_name = reader.ReadString();
+    track.trackIndex = reader.Read<uint32_t>();
+
+    reader.ReadChannel(track.scales);
+    reader.ReadChannel(track.rotations);
+    reader.ReadChannel(track.translations);
+
+    CompressedTrack& compressed = track.compressed;
+    reader.ReadChannel(compressed.scales);
+    reader.ReadChannel(compressed.rotations);
+    reader.ReadChannel(compressed.translations);
+    compressed.scaleMin = reader.Read<glm::vec3>();
+    compressed.scaleExtent = reader.Read<glm::vec3>();
+    compressed.translationMin = reader.Read<glm::vec3>();
+    compressed.translationExtent = reader.Read<glm::vec3>();
+
+    reader.ReadArray(track.cubic.scaleTangents);
+    reader.ReadArray(track.cubic.rotationControls);
+    reader.ReadArray(track.cubic.translationTangents);
+
+    return track;
+}
+
+static void WriteMesh(CacheWriter& writer, const Mesh& mesh)
+{
+    writer.WriteString(mesh.name);
+    writer.Write(mesh.inverseTransform);
+    writer.Write(mesh.boneCounter);
+    writer.Write(mesh.rigHash);
+    writer.WriteArray(mesh.vertices);
+    writer.WriteArray(mesh.indices);
+    writer.WriteArray(mesh.lods);
+    writer.WriteArray(mesh.meshlets);
+
+    writer.Write(static_cast<uint64_t>(mesh.boneMap.size()));
+    for (const auto& bone : mesh.boneMap)
+    {
+        writer.WriteString(bone.first);
+        writer.Write(bone.second);
+    }
+
+    // Final transforms are recomputed every frame
+    writer.Write(static_cast<uint64_t>(mesh.bones.size()));
+    for (const BoneInfo& bone : mesh.bones)
+    {
+        writer.Write(bone.id);
+        writer.Write(bone.offsetMatrix);
+    }
+
+    const Skeleton& skeleton = mesh.skeleton;
+    writer.Write(static_cast<uint64_t>(skeleton.jointNames.size()));
+    for (const std::string& jointName : skeleton.jointNames)
+        writer.WriteString(jointName);
+    writer.WriteArray(skeleton.parents);
+    writer.WriteArray(skeleton.localBindTransforms);
+    writer.WriteArray(skeleton.localBindPoses);
+    writer.WriteArray(skeleton.boneIndices);
+    writer.Write(static_cast<uint64_t>(skeleton.clipTracks.size()));
+    for (const std::vector<int32_t>& tracks : skeleton.clipTracks)
+        writer.WriteArray(tracks);
+    writer.WriteArray(skeleton.jointReach);
+
+    writer.Write(static_cast<uint64_t>(mesh.animations.size()));
+    for (const AnimationClip& clip : mesh.animations)
+    {
+        writer.WriteString(clip.nameID);
+        writer.Write(clip.n_bones);
+        writer.Write(clip.max_frames);
+        writer.Write(clip.duration);
+        writer.Write(clip.ticks_per_second);
+        writer.Write(clip.contentHash);
+
+        writer.Write(static_cast<uint64_t>(clip.tracks.size()));
+        for (const AnimationPose& track : clip.tracks)
+            WriteTrack(writer, track);
+    }
+}
+
+static void ReadMesh(CacheReader& reader, Mesh& mesh)
+{
+    mesh.name = reader.ReadString();
+    mesh.inverseTransform = reader.Read<glm::mat4>();
+    mesh.boneCounter = reader.Read<int>();
+    mesh.rigHash = reader.Read<uint64_t>();
+    reader.ReadArray(mesh.vertices);
+    reader.ReadArray(mesh.indices);
+    reader.ReadArray(mesh.lods);
+    reader.ReadArray(mesh.meshlets);
+
+    const size_t boneMapSize = reader.ReadCount();
+    for (size_t i = 0; i < boneMapSize && reader.Ok(); i++)
+    {
+        std::string boneName = reader.ReadString();
+        mesh.boneMap.insert({ boneName, reader.Read<int>() });
+    }
+
+    mesh.bones.resize(reader.ReadCount());
+    for (BoneInfo& bone : mesh.bones)
+    {
+        bone.id = reader.Read<int>();
+        bone.offsetMatrix = reader.Read<glm::mat4>();
+    }
+
+    Skeleton& skeleton = mesh.skeleton;
+    skeleton.jointNames.resize(reader.ReadCount());
+    for (std::string& jointName : skeleton.jointNames)
+        jointName = reader.ReadString();
+    reader.ReadArray(skeleton.parents);
+    reader.ReadArray(skeleton.localBindTransforms);
+    reader.ReadArray(skeleton.localBindPoses);
+    reader.ReadArray(skeleton.boneIndices);
+    skeleton.clipTracks.resize(reader.ReadCount());
+    for (std::vector<int32_t>& tracks : skeleton.clipTracks)
+        reader.ReadArray(tracks);
+    reader.ReadArray(skeleton.jointReach);
+
+    const size_t clipCount = reader.ReadCount();
+    for (size_t c = 0; c < clipCount && reader.Ok(); c++)
+    {
+        const std::string nameID = reader.ReadString();
+        const int n_bones = reader.Read<int>();
+        const int max_frames = reader.Read<int>();
+        const double duration = reader.Read<double>();
+        const double ticks_per_second = reader.Read<double>();
+        const uint64_t contentHash = reader.Read<uint64_t>();
+
+        std::vector<AnimationPose> tracks(reader.ReadCount());
+        for (AnimationPose& track : tracks)
+            track = ReadTrack(reader);
+
+        // The constructor rebuilds the track map
+        mesh.animations.push_back(AnimationClip(nameID, n_bones, max_frames, duration, ticks_per_second, tracks));
+        mesh.animations.back().contentHash = contentHash;
+    }
+}
+
+bool LoadMeshCache(const std::string& path, const MeshCacheKey& key, Model& model)
+{
+    MappedFile file;
+    if (!file.Open(path))
+        return false;
+
+    CacheReader reader(file.Data(), file.Size());
+    if (reader.Read<uint32_t>() != MESH_CACHE_MAGIC || reader.Read<uint32_t>() != MESH_CACHE_VERSION)
+        return false;
+
+    MeshCacheKey fileKey;
+    fileKey.sourceHash = reader.Read<uint64_t>();
+    fileKey.optionsHash = reader.Read<uint64_t>();
+    if (!reader.Ok() || !(fileKey == key))
+        return false;
+
+    Model loaded;
+    loaded.name = reader.ReadString();
+    loaded.boundsCenter = reader.Read<glm::vec3>();
+    loaded.boundsRadius = reader.Read<float>();
+    loaded.boundsMin = reader.Read<glm::vec3>();
+    loaded.boundsMax = reader.Read<glm::vec3>();
+
+    loaded.meshes.resize(reader.ReadCount());
+    for (Mesh& mesh : loaded.meshes)
+        ReadMesh(reader, mesh);
+
+    // Every byte must be accounted for
+    if (!reader.Ok() || !reader.AtEnd() || loaded.meshes.empty())
+        return false;
+
+    model = std::move(loaded);
+    return true;
+}
+
+bool WriteMeshCache(const std::string& path, const MeshCacheKey& key, const Model& model)
+{
+    CacheWriter writer;
+    writer.Write(MESH_CACHE_MAGIC);
+    writer.Write(MESH_CACHE_VERSION);
+    writer.Write(key.sourceHash);
+    writer.Write(key.optionsHash);
+
+    writer.WriteString(model.name);
+    writer.Write(model.boundsCenter);
+    writer.Write(model.boundsRadius);
+    writer.Write(model.boundsMin);
+    writer.Write(model.boundsMax);
+
+    writer.Write(static_cast<uint64_t>(model.meshes.size()));
+    for (const Mesh& mesh : model.meshes)
+        WriteMesh(writer, mesh);
+
+    std::error_code error;
+    const std::filesystem::path target(path);
+    if (target.has_parent_path())
+        std::filesystem::create_directories(target.parent_path(), error);
+
+    // Models can be imported concurrently, possibly the same file twice, so each thread writes its own temporary file
+    const std::filesystem::path temporary = target.string() + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(writer.bytes.data()), static_cast<std::streamsize>(writer.bytes.size()));
+    out.close();
+    if (!out)
+    {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    std::filesystem::rename(temporary, target, error);
+    if (error)
+    {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    return true;
+}
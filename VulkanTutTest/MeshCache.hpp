@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Model.hpp>
+
+#include <string>
+#include <cstdint>
+
+const uint32_t MESH_CACHE_MAGIC = 0x4D43524Bu;          // "KRCM" in file byte order
+const uint32_t MESH_CACHE_VERSION = 4;                  // Bump whenever the layout of the file or of a cached struct changes
+const std::string MESH_CACHE_EXTENSION = ".meshcache";
+
+/// <summary>
+/// Identifies the import a cache file was written from. A cache is only used if both hashes match
+/// </summary>
+struct MeshCacheKey {
+    uint64_t sourceHash = 0;                            // Hash of the contents of the source file
+    uint64_t optionsHash = 0;                           // Hash of the import flags and settings that shape the imported data
+
+    inline bool operator==(const MeshCacheKey& other) const
+    {
+        return sourceHash == other.sourceHash && optionsHash == other.optionsHash;
+    }
+};
+
+/// <summary>
+/// Read-only memory mapping of a whole file
+/// </summary>
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// <summary>
+    /// Maps a file, unmapping the previous one
+    /// </summary>
+    /// <returns>false if the file can't be opened or is empty</returns>
+    bool Open(const std::string& path);
+
+    void Close();
+
+    inline const uint8_t* Data() const
+    {
+        return m_data;
+    }
+
+    inline size_t Size() const
+    {
+        return m_size;
+    }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif // _WIN32
+};
+
+/// <summary>
+/// Hashes the contents of a file through a memory mapping, 8 bytes at a time
+/// </summary>
+/// <returns>0 if the file can't be read</returns>
+uint64_t HashFile(const std::string& path);
+
+/// <summary>
+/// Cache file of a source model, next to the other cache files in folder
+/// </summary>
+std::string MeshCachePath(const std::string& folder, const std::string& sourcePath);
+
+/// <summary>
+/// Loads a model written by WriteMeshCache. Meshes, skeleton and clips come back as after import, without an Assimp scene
+/// </summary>
+/// <param name="path">: cache file</param>
+/// <param name="key">: expected key. Any mismatch, as well as a different magic or version, rejects the file</param>
+/// <param name="model">: output, only written if the file is accepted</param>
+/// <returns>Whether the model was loaded</returns>
+bool LoadMeshCache(const std::string& path, const MeshCacheKey& key, Model& model);
+
+/// <summary>
+/// Writes the imported data of a model: vertices, indices, bones, skeleton, clips and bounds.
+/// The file is written next to its final path and renamed over it, so a failed write never leaves a truncated cache behind.
+/// Safe to call from several threads at once
+/// </summary>
+/// <returns>Whether the file was written</returns>
+bool WriteMeshCache(const std::string& path, const MeshCacheKey& key, const Model& model);
@@ -0,0 +1,338 @@
+#include <MeshLOD.hpp>
+#include <MeshOptimizer.hpp>
+
+#include <queue>
+#include <functional>
+#include <numeric>
+#include <limits>
+#include <unordered_map>
+
+namespace
+{
+    /// <summary>
+    /// Sum of squared distances to a set of planes, as the upper triangle of a symmetric 4x4 matrix
+    /// </summary>
+    struct Quadric {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+        double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+        double a22 = 0.0, a23 = 0.0;
+        double a33 = 0.0;
+
+        void AddPlane(const glm::dvec3& normal, const double distance)
+        {
+            a00 += normal.x * normal.x; a01 += normal.x * normal.y; a02 += normal.x * normal.z; a03 += normal.x * distance;
+            a11 += normal.y * normal.y; a12 += normal.y * normal.z; a13 += normal.y * distance;
+            a22 += normal.z * normal.z; a23 += normal.z * distance;
+            a33 += distance * distance;
+        }
+
+        Quadric& operator+=(const Quadric& other)
+        {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+            a11 += other.a11; a12 += other.a12; a13 += other.a13;
+            a22 += other.a22; a23 += other.a23;
+            a33 += other.a33;
+            return *this;
+        }
+
+        double Error(const glm::dvec3& p) const
+        {
+            const double error = a00 * p.x * p.x + 2.0 * a01 * p.x * p.y + 2.0 * a02 * p.x * p.z + 2.0 * a03 * p.x
+                + a11 * p.y * p.y + 2.0 * a12 * p.y * p.z + 2.0 * a13 * p.y
+                + a22 * p.z * p.z + 2.0 * a23 * p.z
+                + a33;
+            return std::max(error, 0.0);
+        }
+    };
+
+    /// <summary>
+    /// Moving vertex from onto vertex to. Stale once either vertex changed after the collapse was queued
+    /// </summary>
+    struct Collapse {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+        uint32_t fromVersion;
+        uint32_t toVersion;
+
+        bool operator>(const Collapse& other) const
+        {
+            return cost > other.cost;
+        }
+    };
+
+    /// <summary>
+    /// Share of bone influence that differs between two vertices, 0 if they are skinned alike and 1 if they share no bone
+    /// </summary>
+    float InfluenceDistance(const Vertex& a, const Vertex& b)
+    {
+        float shared = 0.0f;
+        for (uint32_t i = 0; i < MAXIMUM_BONES; i++)
+        {
+            for (uint32_t j = 0; j < MAXIMUM_BONES; j++)
+            {
+                if (a.boneIDs[i] == b.boneIDs[j])
+                    shared += std::min(a.weights[i], b.weights[j]);
+            }
+        }
+
+        float total = 0.0f;
+        for (uint32_t i = 0; i < MAXIMUM_BONES; i++)
+            total += std::max(a.weights[i], b.weights[i]);
+
+        return (total > 0.0f) ? std::clamp(1.0f - shared / total, 0.0f, 1.0f) : 0.0f;
+    }
+
+    /// <summary>
+    /// Marks vertices on open or non-manifold edges, and vertices sharing their position with another vertex, i.e. on a UV or normal seam
+    /// </summary>
+    std::vector<bool> FindLockedVertices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+    {
+        std::vector<bool> locked(vertices.size(), false);
+
+        // Seams
+        std::vector<uint32_t> order(vertices.size());
+        std::iota(order.begin(), order.end(), 0);
+        auto lessPosition = [&vertices](const uint32_t a, const uint32_t b)
+            {
+                const glm::vec3& pa = vertices[a].pos;
+                const glm::vec3& pb = vertices[b].pos;
+                return (pa.x != pb.x) ? pa.x < pb.x : (pa.y != pb.y) ? pa.y < pb.y : pa.z < pb.z;
+            };
+        std::sort(order.begin(), order.end(), lessPosition);
+        for (size_t i = 1; i < order.size(); i++)
+        {
+            if (vertices[order[i]].pos == vertices[order[i - 1]].pos)
+            {
+                locked[order[i]] = true;
+                locked[order[i - 1]] = true;
+            }
+        }
+
+        // Edges of anything but two triangles
+        std::unordered_map<uint64_t, uint32_t> edgeTriangles;
+        edgeTriangles.reserve(indices.size());
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            for (uint32_t e = 0; e < 3; e++)
+            {
+                const uint32_t a = indices[t + e], b = indices[t + (e + 1) % 3];
+                edgeTriangles[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)]++;
+            }
+        }
+        for (const auto& edge : edgeTriangles)
+        {
+            if (edge.second != 2)
+            {
+                locked[static_cast<uint32_t>(edge.first >> 32)] = true;
+                locked[static_cast<uint32_t>(edge.first)] = true;
+            }
+        }
+
+        return locked;
+    }
+}
+
+void BuildMeshLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const bool skinned, std::vector<MeshLod>& lods)
+{
+    lods.clear();
+    lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || vertices.empty())
+        return;
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(std::numeric_limits<float>::lowest());
+    for (const Vertex& vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+    const double radius = 0.5 * glm::length(glm::dvec3(boundsMax - boundsMin));
+    const double maxCost = (MESH_LOD_MAX_ERROR * radius) * (MESH_LOD_MAX_ERROR * radius);
+    const double skinningError = MESH_LOD_SKINNING_ERROR * radius;
+
+    const std::vector<bool> locked = FindLockedVertices(vertices, indices);
+
+    // Triangles stay in place, with collapsed vertices replaced in their indices
+    std::vector<uint32_t> triangles(indices.begin(), indices.begin() + 3 * triangleCount);
+    std::vector<bool> triangleAlive(triangleCount, true);
+    std::vector<std::vector<uint32_t>> vertexTriangles(vertices.size());
+    std::vector<Quadric> quadrics(vertices.size());
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        const glm::dvec3 p0 = vertices[triangles[3 * t]].pos, p1 = vertices[triangles[3 * t + 1]].pos, p2 = vertices[triangles[3 * t + 2]].pos;
+        const glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+        const double length = glm::length(normal);
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            vertexTriangles[triangles[3 * t + c]].push_back(t);
+            if (length > 0.0)
+                quadrics[triangles[3 * t + c]].AddPlane(normal / length, -glm::dot(normal / length, p0));
+        }
+    }
+
+    std::vector<uint32_t> versions(vertices.size(), 0);
+    std::vector<bool> collapsed(vertices.size(), false);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+    auto collapseCost = [&](const uint32_t from, const uint32_t to)
+        {
+            Quadric quadric = quadrics[from];
+            quadric += quadrics[to];
+            double cost = quadric.Error(glm::dvec3(vertices[to].pos));
+            if (skinned)
+            {
+                const double skinDistance = InfluenceDistance(vertices[from], vertices[to]) * skinningError;
+                cost += skinDistance * skinDistance;
+            }
+            return cost;
+        };
+
+    auto queueCollapses = [&](const uint32_t vertex)
+        {
+            for (const uint32_t t : vertexTriangles[vertex])
+            {
+                if (!triangleAlive[t])
+                    continue;
+
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    const uint32_t other = triangles[3 * t + c];
+                    if (other == vertex)
+                        continue;
+
+                    if (!locked[vertex])
+                        queue.push({ collapseCost(vertex, other), vertex, other, versions[vertex], versions[other] });
+                    if (!locked[other])
+                        queue.push({ collapseCost(other, vertex), other, vertex, versions[other], versions[vertex] });
+                }
+            }
+        };
+
+    // Whether moving from onto to keeps the facing of every triangle that stays
+    auto keepsOrientation = [&](const uint32_t from, const uint32_t to)
+        {
+            const glm::vec3 target = vertices[to].pos;
+            for (const uint32_t t : vertexTriangles[from])
+            {
+                if (!triangleAlive[t])
+                    continue;
+
+                const uint32_t* corners = &triangles[3 * t];
+                if (corners[0] == to || corners[1] == to || corners[2] == to)
+                    continue;
+
+                glm::vec3 p[3], q[3];
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    p[c] = vertices[corners[c]].pos;
+                    q[c] = (corners[c] == from) ? target : p[c];
+                }
+
+                const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                const glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                if (glm::dot(before, after) <= 0.0f)
+                    return false;
+            }
+
+            return true;
+        };
+
+    for (uint32_t v = 0; v < vertices.size(); v++)
+    {
+        if (!locked[v])
+            queueCollapses(v);
+    }
+
+    size_t liveTriangles = triangleCount;
+    size_t targetTriangles = static_cast<size_t>(triangleCount * MESH_LOD_REDUCTION);
+    size_t lastLevelTriangles = triangleCount;
+    double levelCost = 0.0;
+
+    // Appends the live triangles as a level if they are enough of a reduction
+    auto emitLevel = [&]()
+        {
+            if (liveTriangles > lastLevelTriangles * MESH_LOD_MIN_REDUCTION || liveTriangles == 0)
+                return;
+
+            std::vector<uint32_t> levelIndices;
+            levelIndices.reserve(3 * liveTriangles);
+            for (uint32_t t = 0; t < triangleCount; t++)
+            {
+                if (triangleAlive[t])
+                    levelIndices.insert(levelIndices.end(), triangles.begin() + 3 * t, triangles.begin() + 3 * t + 3);
+            }
+
+            std::vector<uint32_t> clusters;
+            OptimizeVertexCache(levelIndices, vertices.size(), clusters);
+
+            lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(levelIndices.size()), static_cast<float>(std::sqrt(levelCost)) });
+            indices.insert(indices.end(), levelIndices.begin(), levelIndices.end());
+            lastLevelTriangles = liveTriangles;
+        };
+
+    while (lods.size() < MESH_LOD_COUNT && !queue.empty())
+    {
+        const Collapse collapse = queue.top();
+        queue.pop();
+
+        if (collapsed[collapse.from] || collapsed[collapse.to]
+            || versions[collapse.from] != collapse.fromVersion || versions[collapse.to] != collapse.toVersion)
+            continue;
+
+        // Coarser levels would drift too far from the surface
+        if (collapse.cost > maxCost)
+            break;
+
+        if (!keepsOrientation(collapse.from, collapse.to))
+            continue;
+
+        // Triangles on the collapsed edge disappear, the others move their corner onto the target
+        for (const uint32_t t : vertexTriangles[collapse.from])
+        {
+            if (!triangleAlive[t])
+                continue;
+
+            uint32_t* corners = &triangles[3 * t];
+            if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to)
+            {
+                triangleAlive[t] = false;
+                liveTriangles--;
+                continue;
+            }
+
+            for (uint32_t c = 0; c < 3; c++)
+            {
+                if (corners[c] == collapse.from)
+                    corners[c] = collapse.to;
+            }
+            vertexTriangles[collapse.to].push_back(t);
+        }
+
+        quadrics[collapse.to] += quadrics[collapse.from];
+        if (skinned)
+        {
+            // The influence mismatch stays part of the error of the merged vertex
+            const double skinDistance = InfluenceDistance(vertices[collapse.from], vertices[collapse.to]) * skinningError;
+            quadrics[collapse.to].a33 += skinDistance * skinDistance;
+        }
+        collapsed[collapse.from] = true;
+        vertexTriangles[collapse.from].clear();
+        levelCost = std::max(levelCost, collapse.cost);
+
+        // Collapses to and from the target have new costs. Other queued collapses keep theirs, and are checked for flips when popped
+        versions[collapse.to]++;
+        queueCollapses(collapse.to);
+
+        if (liveTriangles <= targetTriangles)
+        {
+            emitLevel();
+            targetTriangles = static_cast<size_t>(liveTriangles * MESH_LOD_REDUCTION);
+        }
+    }
+
+    // Whatever the error bound allowed, if the last target wasn't reached
+    if (lods.size() < MESH_LOD_COUNT)
+        emitLevel();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Vertex.hpp>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+
+const uint32_t MESH_LOD_VERSION = 1;                    // Bump whenever the output of BuildMeshLods changes, so cached meshes are rebuilt
+const uint32_t MESH_LOD_COUNT = 4;                      // Most levels of a mesh, the full mesh included
+const float MESH_LOD_REDUCTION = 0.5f;                  // Triangles of each level, relative to the level before
+const float MESH_LOD_MIN_REDUCTION = 0.8f;              // A level keeping more of the triangles of the level before is dropped
+const float MESH_LOD_MAX_ERROR = 0.1f;                  // Largest error of any level, relative to the mesh radius
+const float MESH_LOD_SKINNING_ERROR = 0.05f;            // Error of a collapse that swaps every bone influence of a vertex, relative to the mesh radius
+const float MESH_LOD_PIXEL_ERROR = 1.0f;                // Default projected error, in pixels, a level may have on screen
+const float MESH_LOD_HYSTERESIS = 0.15f;                // Relative margin an error must cross the threshold by before the level changes
+
+/// <summary>
+/// A level of detail of a mesh: an index range drawing a simplified surface over the vertices of the full mesh
+/// </summary>
+struct MeshLod {
+    uint32_t firstIndex = 0;                            // Into the index list of the mesh
+    uint32_t indexCount = 0;
+    float error = 0.0f;                                 // Bound on the distance between the level and the full mesh surface, in model units. 0 for the full mesh
+};
+
+/// <summary>
+/// Simplifies a triangle list by quadric error edge collapses onto existing vertices (Garland and Heckbert 1997), so every level
+/// reuses the vertices of the full mesh. Vertices on open borders and on attribute seams never move, so levels don't crack.
+/// Levels are appended to indices after the full mesh, each reordered for the vertex cache
+/// </summary>
+/// <param name="vertices">: vertices of the mesh, unchanged</param>
+/// <param name="indices">: full triangle list, followed by the simplified levels on return</param>
+/// <param name="skinned">: whether collapses between vertices with different bone influences add error, as they deform differently</param>
+/// <param name="lods">: output, the full mesh first and then up to MESH_LOD_COUNT - 1 coarser levels</param>
+void BuildMeshLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool skinned, std::vector<MeshLod>& lods);
+
+/// <summary>
+/// Pixels covered by one world space unit at the point of a bounding sphere nearest the camera
+/// </summary>
+/// <param name="center">: world space center</param>
+/// <param name="radius">: world space radius</param>
+/// <param name="cameraPosition"></param>
+/// <param name="fovY">: vertical field of view in radians</param>
+/// <param name="screenHeight">: in pixels</param>
+/// <param name="zNear">: distance the nearest point is clamped to, e.g. when the camera is inside the sphere</param>
+inline float PixelsPerUnit(const glm::vec3& center, const float radius, const glm::vec3& cameraPosition, const float fovY, const float screenHeight, const float zNear)
+{
+    const float distance = std::max(glm::length(center - cameraPosition) - radius, zNear);
+    return screenHeight / (2.0f * distance * std::tan(0.5f * fovY));
+}
+
+/// <summary>
+/// Picks the coarsest level whose projected error stays within a pixel threshold. A level only changes once its error is past
+/// the threshold by MESH_LOD_HYSTERESIS, so a model near a threshold doesn't flicker between levels
+/// </summary>
+/// <param name="levelErrors">: world space error of each level, ascending</param>
+/// <param name="levelCount"></param>
+/// <param name="pixelsPerUnit">: from PixelsPerUnit</param>
+/// <param name="pixelThreshold">: largest projected error, in pixels</param>
+/// <param name="currentLevel">: level of the previous frame</param>
+inline uint32_t SelectMeshLOD(const float* levelErrors, const uint32_t levelCount, const float pixelsPerUnit, const float pixelThreshold, const uint32_t currentLevel)
+{
+    uint32_t level = 0;
+    while (level + 1 < levelCount && levelErrors[level + 1] * pixelsPerUnit <= pixelThreshold)
+        level++;
+
+    // Coarser level, its error must be clearly below the threshold
+    if (level > currentLevel && levelErrors[level] * pixelsPerUnit > pixelThreshold * (1.0f - MESH_LOD_HYSTERESIS))
+    {
+        while (level > currentLevel && levelErrors[level] * pixelsPerUnit > pixelThreshold * (1.0f - MESH_LOD_HYSTERESIS))
+            level--;
+        return level;
+    }
+
+    // Finer level, the current level's error must be clearly above the threshold
+    if (level < currentLevel && currentLevel < levelCount && levelErrors[currentLevel] * pixelsPerUnit <= pixelThreshold * (1.0f + MESH_LOD_HYSTERESIS))
+        return currentLevel;
+
+    return level;
+}
@@ -0,0 +1,315 @@
+#include <MeshOptimizer.hpp>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+namespace
+{
+    /// <summary>
+    /// Triangles around each vertex. The triangles of vertex v are triangles[offsets[v]] to triangles[offsets[v + 1] - 1]
+    /// </summary>
+    struct TriangleAdjacency {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> triangles;
+    };
+
+    TriangleAdjacency BuildAdjacency(const std::vector<uint32_t>& indices, const size_t vertexCount)
+    {
+        TriangleAdjacency adjacency;
+        adjacency.offsets.assign(vertexCount + 1, 0);
+        for (const uint32_t index : indices)
+            adjacency.offsets[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+        std::vector<uint32_t> next(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        adjacency.triangles.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency.triangles[next[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+        return adjacency;
+    }
+
+    /// <summary>
+    /// Uses a vertex in a FIFO cache kept as the time each vertex entered it. Adding cacheSize + 1 to time empties the cache
+    /// </summary>
+    /// <returns>1 if the vertex missed the cache</returns>
+    inline uint32_t TouchCache(const uint32_t vertex, std::vector<uint32_t>& timestamps, uint32_t& time, const uint32_t cacheSize)
+    {
+        if (time - timestamps[vertex] <= cacheSize)
+            return 0;
+
+        timestamps[vertex] = time++;
+        return 1;
+    }
+
+    inline uint32_t TouchTriangle(const std::vector<uint32_t>& indices, const size_t triangle, std::vector<uint32_t>& timestamps, uint32_t& time, const uint32_t cacheSize)
+    {
+        return TouchCache(indices[3 * triangle], timestamps, time, cacheSize)
+            + TouchCache(indices[3 * triangle + 1], timestamps, time, cacheSize)
+            + TouchCache(indices[3 * triangle + 2], timestamps, time, cacheSize);
+    }
+}
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, const size_t vertexCount, const uint32_t cacheSize)
+{
+    VertexCacheStats stats;
+    if (indices.size() < 3 || vertexCount == 0)
+        return stats;
+
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t time = cacheSize + 1;
+    size_t misses = 0, uniqueVertices = 0;
+    for (const uint32_t index : indices)
+    {
+        misses += TouchCache(index, timestamps, time, cacheSize);
+        if (!referenced[index])
+        {
+            referenced[index] = true;
+            uniqueVertices++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(uniqueVertices);
+
+    return stats;
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, const size_t vertexCount, std::vector<uint32_t>& clusters, const uint32_t cacheSize)
+{
+    clusters.clear();
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    const TriangleAdjacency adjacency = BuildAdjacency(indices, vertexCount);
+
+    // Triangles of each vertex not emitted yet
+    std::vector<uint32_t> liveTriangles(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;                      // Vertices of emitted triangles, most recent last
+    std::vector<uint32_t> candidates;                   // Vertices of the triangles emitted around the current fanning vertex
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    uint32_t time = cacheSize + 1;
+    size_t cursor = 0;
+
+    // Recently used vertex with triangles left, or else the next one in input order. -1 once every triangle is emitted
+    auto skipDeadEnd = [&]() -> int64_t
+        {
+            while (!deadEnd.empty())
+            {
+                const uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0)
+                    return v;
+            }
+
+            for (; cursor < vertexCount; cursor++)
+            {
+                if (liveTriangles[cursor] > 0)
+                    return static_cast<int64_t>(cursor);
+            }
+
+            return -1;
+        };
+
+    int64_t fanning = skipDeadEnd();
+    clusters.push_back(0);
+    while (fanning >= 0)
+    {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; a++)
+        {
+            const uint32_t triangle = adjacency.triangles[a];
+            if (emitted[triangle])
+                continue;
+
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                const uint32_t v = indices[3 * triangle + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                TouchCache(v, timestamps, time, cacheSize);
+            }
+            emitted[triangle] = true;
+        }
+
+        // Next fanning vertex: the oldest candidate that stays in the cache while its remaining triangles are emitted
+        int64_t next = -1;
+        int64_t bestPriority = 0;
+        for (const uint32_t v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+
+            int64_t priority = 0;
+            if (time - timestamps[v] + 2 * liveTriangles[v] <= cacheSize)
+                priority = time - timestamps[v];
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        // Dead end: the cache holds nothing useful, so a new cluster starts
+        if (next < 0)
+        {
+            next = skipDeadEnd();
+            if (next >= 0)
+                clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+        }
+
+        fanning = next;
+    }
+
+    indices.swap(output);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters, const float threshold, const uint32_t cacheSize)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || clusters.empty())
+        return;
+
+    // Split clusters where the ACMR since the last split reaches threshold times the ACMR of the whole cluster
+    std::vector<uint32_t> timestamps(vertices.size(), 0);
+    uint32_t time = cacheSize + 1;
+    std::vector<uint32_t> splits;
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        const size_t start = clusters[c];
+        const size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+
+        time += cacheSize + 1;
+        size_t clusterMisses = 0;
+        for (size_t t = start; t < end; t++)
+            clusterMisses += TouchTriangle(indices, t, timestamps, time, cacheSize);
+        const float targetAcmr = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+        time += cacheSize + 1;
+        splits.push_back(static_cast<uint32_t>(start));
+        size_t runningMisses = 0, runningTriangles = 0;
+        for (size_t t = start; t < end; t++)
+        {
+            runningMisses += TouchTriangle(indices, t, timestamps, time, cacheSize);
+            runningTriangles++;
+
+            if (t + 1 < end && static_cast<float>(runningMisses) <= targetAcmr * static_cast<float>(runningTriangles))
+            {
+                splits.push_back(static_cast<uint32_t>(t + 1));
+                time += cacheSize + 1;
+                runningMisses = 0;
+                runningTriangles = 0;
+            }
+        }
+    }
+
+    // Area weighted centroid and normal of each cluster, and of the mesh
+    std::vector<glm::vec3> centroids(splits.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(splits.size(), glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < splits.size(); c++)
+    {
+        const size_t end = (c + 1 < splits.size()) ? splits[c + 1] : triangleCount;
+        float clusterArea = 0.0f;
+        for (size_t t = splits[c]; t < end; t++)
+        {
+            const glm::vec3& p0 = vertices[indices[3 * t]].pos;
+            const glm::vec3& p1 = vertices[indices[3 * t + 1]].pos;
+            const glm::vec3& p2 = vertices[indices[3 * t + 2]].pos;
+
+            const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            const float area = glm::length(normal);
+            centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+            normals[c] += normal;
+            clusterArea += area;
+        }
+
+        meshCentroid += centroids[c];
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f)
+            centroids[c] /= clusterArea;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Clusters facing away from the centre are drawn first. Ties keep the cache order
+    std::vector<float> facing(splits.size(), 0.0f);
+    for (size_t c = 0; c < splits.size(); c++)
+    {
+        const float length = glm::length(normals[c]);
+        if (length > 0.0f)
+            facing[c] = glm::dot(centroids[c] - meshCentroid, normals[c] / length);
+    }
+
+    std::vector<uint32_t> order(splits.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&facing](const uint32_t a, const uint32_t b) { return facing[a] > facing[b]; });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (const uint32_t c : order)
+    {
+        const size_t end = (c + 1 < splits.size()) ? splits[c + 1] : triangleCount;
+        output.insert(output.end(), indices.begin() + 3 * splits[c], indices.begin() + 3 * end);
+    }
+
+    indices.swap(output);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    const uint32_t unmapped = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(vertices.size(), unmapped);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == unmapped)
+        {
+            remap[index] = static_cast<uint32_t>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    for (size_t v = 0; v < vertices.size(); v++)
+    {
+        if (remap[v] == unmapped)
+            reordered.push_back(vertices[v]);
+    }
+
+    vertices.swap(reordered);
+}
+
+MeshOptimizationStats OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    MeshOptimizationStats stats;
+    stats.before = AnalyzeVertexCache(indices, vertices.size());
+
+    std::vector<uint32_t> clusters;
+    OptimizeVertexCache(indices, vertices.size(), clusters);
+    OptimizeOverdraw(indices, vertices, clusters);
+    OptimizeVertexFetch(vertices, indices);
+
+    stats.after = AnalyzeVertexCache(indices, vertices.size());
+
+    return stats;
+}
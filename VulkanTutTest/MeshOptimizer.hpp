@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Vertex.hpp>
+
+#include <vector>
+#include <cstdint>
+
+const uint32_t MESH_OPTIMIZER_VERSION = 1;              // Bump whenever the output of OptimizeMesh changes, so cached meshes are rebuilt
+const uint32_t VERTEX_CACHE_SIZE = 16;                  // Entries of the simulated post-transform FIFO cache
+const float OVERDRAW_THRESHOLD = 1.05f;                 // ACMR the overdraw pass may give up, relative to the vertex cache order
+
+/// <summary>
+/// Post-transform vertex cache efficiency of an index buffer, for a FIFO cache of VERTEX_CACHE_SIZE entries
+/// </summary>
+struct VertexCacheStats {
+    float acmr = 0.0f;                                  // Average cache miss ratio: transformed vertices per triangle, 0.5 at best, 3 at worst
+    float atvr = 0.0f;                                  // Average transform to vertex ratio: transformed vertices per referenced vertex, 1 at best
+};
+
+/// <summary>
+/// Cache efficiency of a mesh before and after OptimizeMesh
+/// </summary>
+struct MeshOptimizationStats {
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+/// <summary>
+/// Simulates the post-transform vertex cache over an index buffer
+/// </summary>
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+/// <summary>
+/// Reorders triangles for the post-transform vertex cache with Tipsify (Sander et al. 2007).
+/// Also returns the first triangle of each cluster that starts with a cold cache, for OptimizeOverdraw
+/// </summary>
+/// <param name="indices">: triangle list, reordered in place</param>
+/// <param name="vertexCount">: vertices the indices refer to</param>
+/// <param name="clusters">: output, first triangle of each cluster in ascending order</param>
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+/// <summary>
+/// Reorders the clusters of a cache optimized triangle list so outward facing ones are drawn first, and occlude the rest.
+/// Clusters are first split where their ACMR reaches threshold times the ACMR of the whole cluster, so the cache order is mostly kept
+/// </summary>
+/// <param name="indices">: triangle list, reordered in place</param>
+/// <param name="vertices">: vertices the indices refer to</param>
+/// <param name="clusters">: clusters from OptimizeVertexCache</param>
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters,
+    float threshold = OVERDRAW_THRESHOLD, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+/// <summary>
+/// Reorders vertices in the order the index buffer first references them, so vertex fetches walk memory forward.
+/// Unreferenced vertices keep their relative order at the end
+/// </summary>
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+/// <summary>
+/// Runs the vertex cache, overdraw and vertex fetch passes on a mesh. The result only depends on the input, so it can be cached
+/// </summary>
+/// <returns>Vertex cache statistics before and after</returns>
+MeshOptimizationStats OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
@@ -0,0 +1,182 @@
+#include <Meshlet.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    const uint32_t NO_TRIANGLE = std::numeric_limits<uint32_t>::max();
+
+    /// <summary>
+    /// Fits the bounding sphere and normal cone of a meshlet
+    /// </summary>
+    /// <param name="meshletVertices">: vertices the meshlet references</param>
+    /// <param name="meshletTriangles">: triangles of the meshlet</param>
+    /// <param name="normals">: unit normal of every triangle of the mesh, 0 if degenerate</param>
+    void ComputeMeshletBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& meshletVertices, const std::vector<uint32_t>& meshletTriangles,
+        const std::vector<glm::vec3>& normals, Meshlet& meshlet)
+    {
+        glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(std::numeric_limits<float>::lowest());
+        for (const uint32_t v : meshletVertices)
+        {
+            minimum = glm::min(minimum, vertices[v].pos);
+            maximum = glm::max(maximum, vertices[v].pos);
+        }
+
+        meshlet.center = (minimum + maximum) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (const uint32_t v : meshletVertices)
+            meshlet.radius = std::max(meshlet.radius, glm::length(vertices[v].pos - meshlet.center));
+
+        glm::vec3 normalSum(0.0f);
+        for (const uint32_t t : meshletTriangles)
+            normalSum += normals[t];
+
+        // Facing both ways on average, or only degenerate triangles
+        const float axisLength = glm::length(normalSum);
+        if (axisLength < 1.0e-6f)
+        {
+            meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+            meshlet.coneCutoff = 1.0f;
+            return;
+        }
+
+        meshlet.coneAxis = normalSum / axisLength;
+        float minimumDot = 1.0f;
+        for (const uint32_t t : meshletTriangles)
+        {
+            if (normals[t] != glm::vec3(0.0f))
+                minimumDot = std::min(minimumDot, glm::dot(normals[t], meshlet.coneAxis));
+        }
+
+        meshlet.coneCutoff = (minimumDot <= MESHLET_MIN_CONE_DOT) ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+    }
+}
+
+void BuildMeshlets(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets)
+{
+    meshlets.clear();
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if (triangleCount == 0)
+        return;
+
+    // Triangles around each vertex
+    std::vector<uint32_t> adjacencyOffsets(vertices.size() + 1, 0);
+    for (size_t i = 0; i < 3 * static_cast<size_t>(triangleCount); i++)
+        adjacencyOffsets[indices[i] + 1]++;
+    for (size_t v = 0; v < vertices.size(); v++)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+    std::vector<uint32_t> adjacency(3 * static_cast<size_t>(triangleCount));
+    std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t t = 0; t < triangleCount; t++)
+        for (uint32_t k = 0; k < 3; k++)
+            adjacency[adjacencyFill[indices[3 * t + k]]++] = t;
+
+    std::vector<glm::vec3> normals(triangleCount);
+    for (uint32_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& a = vertices[indices[3 * t]].pos;
+        const glm::vec3 normal = glm::cross(vertices[indices[3 * t + 1]].pos - a, vertices[indices[3 * t + 2]].pos - a);
+        const float area = glm::length(normal);
+        normals[t] = (area > 0.0f) ? normal / area : glm::vec3(0.0f);
+    }
+
+    std::vector<bool> assigned(triangleCount, false);
+    std::vector<uint32_t> vertexMeshlet(vertices.size(), NO_TRIANGLE);        // Last meshlet that referenced each vertex
+    std::vector<uint32_t> meshletVertices, meshletTriangles, candidates;
+    std::vector<uint32_t> ordered;
+    ordered.reserve(3 * static_cast<size_t>(triangleCount));
+
+    uint32_t seed = 0;
+    while (true)
+    {
+        while (seed < triangleCount && assigned[seed])
+            seed++;
+        if (seed == triangleCount)
+            break;
+
+        const uint32_t meshletIndex = static_cast<uint32_t>(meshlets.size());
+        meshletVertices.clear();
+        meshletTriangles.clear();
+        candidates.clear();
+        glm::vec3 normalSum(0.0f);
+
+        uint32_t next = seed;
+        while (next != NO_TRIANGLE)
+        {
+            assigned[next] = true;
+            meshletTriangles.push_back(next);
+            normalSum += normals[next];
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                const uint32_t v = indices[3 * next + k];
+                if (vertexMeshlet[v] == meshletIndex)
+                    continue;
+
+                vertexMeshlet[v] = meshletIndex;
+                meshletVertices.push_back(v);
+                for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+                {
+                    if (!assigned[adjacency[a]])
+                        candidates.push_back(adjacency[a]);
+                }
+            }
+
+            if (meshletTriangles.size() == MESHLET_MAX_TRIANGLES)
+                break;
+
+            // Fewest new vertices first, then the triangle facing closest to the meshlet
+            const float axisLength = glm::length(normalSum);
+            const glm::vec3 axis = (axisLength > 0.0f) ? normalSum / axisLength : glm::vec3(0.0f);
+            next = NO_TRIANGLE;
+            uint32_t bestNewVertices = 4;
+            float bestFacing = std::numeric_limits<float>::max();
+            size_t kept = 0;
+            for (size_t c = 0; c < candidates.size(); c++)
+            {
+                const uint32_t t = candidates[c];
+                if (assigned[t])
+                    continue;
+                candidates[kept++] = t;
+
+                uint32_t newVertices = 0;
+                for (uint32_t k = 0; k < 3; k++)
+                    newVertices += (vertexMeshlet[indices[3 * t + k]] != meshletIndex) ? 1 : 0;
+                if (meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES)
+                    continue;
+
+                const float facing = 1.0f - glm::dot(normals[t], axis);
+                if (newVertices < bestNewVertices || (newVertices == bestNewVertices && facing < bestFacing))
+                {
+                    next = t;
+                    bestNewVertices = newVertices;
+                    bestFacing = facing;
+                }
+            }
+            candidates.resize(kept);
+
+            // No neighbour left, e.g. at the end of a separate strand. Continue with the next triangle in the optimized order, which is usually close by
+            if (next == NO_TRIANGLE && meshletVertices.size() + 3 <= MESHLET_MAX_VERTICES)
+            {
+                while (seed < triangleCount && assigned[seed])
+                    seed++;
+                if (seed < triangleCount)
+                    next = seed;
+            }
+        }
+
+        Meshlet meshlet;
+        meshlet.firstIndex = static_cast<uint32_t>(ordered.size());
+        meshlet.triangleCount = static_cast<uint32_t>(meshletTriangles.size());
+        meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+        for (const uint32_t t : meshletTriangles)
+            ordered.insert(ordered.end(), indices.begin() + 3 * t, indices.begin() + 3 * t + 3);
+
+        ComputeMeshletBounds(vertices, meshletVertices, meshletTriangles, normals, meshlet);
+        meshlets.push_back(meshlet);
+    }
+
+    indices.swap(ordered);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <Vertex.hpp>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+const uint32_t MESHLET_VERSION = 1;                     // Bump whenever the output of BuildMeshlets changes, so cached meshes are rebuilt
+const uint32_t MESHLET_MAX_VERTICES = 64;               // Distinct vertices a meshlet may reference
+const uint32_t MESHLET_MAX_TRIANGLES = 124;             // Triangles of a meshlet
+const float MESHLET_MIN_CONE_DOT = 0.1f;                // Meshlets whose normals spread further from the cone axis are never backface culled
+const uint32_t CLUSTER_CULL_FRUSTUM = 1;                // Tests of the cluster culling pass, as in cluster_cull.comp
+const uint32_t CLUSTER_CULL_BACKFACE = 2;
+
+/// <summary>
+/// A cluster of triangles of the full mesh, with the bounds the culling pass tests. Laid out as in cluster_cull.comp
+/// </summary>
+struct Meshlet {
+    glm::vec3 center = glm::vec3(0.0f);                 // Bounding sphere of its vertices, in model space
+    float radius = 0.0f;
+    glm::vec3 coneAxis = glm::vec3(0.0f);               // Average facing of its triangles
+    float coneCutoff = 1.0f;                            // Sine of the largest angle between a triangle normal and the axis. 1 if the cone can't cull
+    uint32_t firstIndex = 0;                            // Into the index list of the mesh
+    uint32_t triangleCount = 0;
+    uint32_t vertexCount = 0;
+    uint32_t padding = 0;
+};
+
+static_assert(sizeof(Meshlet) == 48, "cluster_cull.comp must match the Meshlet layout!");
+
+/// <summary>
+/// Push constants of the cluster culling pass, one dispatch per mesh. Fills the 128 bytes every device supports
+/// </summary>
+struct ClusterCullConstants {
+    glm::vec4 frustumPlanes[6];                         // In model space, scaled so they give world space distances
+    glm::vec4 cameraPosition;                           // In model space in xyz, world units per model unit in w
+    uint32_t firstMeshlet;                              // Of the mesh in the meshlet buffer of its geometry block
+    uint32_t firstIndex;                                // Of the mesh in the index buffer of its geometry block
+    uint32_t drawIndex;                                 // Indirect draw the triangles of visible meshlets are appended to
+    uint32_t flags;                                     // CLUSTER_CULL_ tests to run
+};
+
+static_assert(sizeof(ClusterCullConstants) == 128, "cluster_cull.comp must match the ClusterCullConstants layout!");
+
+/// <summary>
+/// Partitions a triangle list into meshlets of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles, and reorders
+/// it so every meshlet is a contiguous index range. Meshlets grow over neighbouring triangles that add the fewest vertices and face
+/// the way the meshlet does, so their spheres stay tight and their normal cones narrow. Seeds follow the existing triangle order,
+/// which keeps the vertex cache and overdraw order of OptimizeMesh at the meshlet level
+/// </summary>
+/// <param name="vertices">: vertices of the mesh, unchanged</param>
+/// <param name="indices">: full triangle list, reordered in place</param>
+/// <param name="meshlets">: output, in index order</param>
+void BuildMeshlets(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Meshlet>& meshlets);
+
+/// <summary>
+/// Planes of the view frustum, pointing inwards, from a view projection matrix with depth from 0 to 1 (Gribb and Hartmann 2001).
+/// Planes are normalized, so their dot product with a point is its signed distance
+/// </summary>
+/// <param name="viewProjection"></param>
+/// <param name="planes">: output, left, right, bottom, top, near and far</param>
+inline void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+    const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+    const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+    const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row2;
+    planes[5] = row3 - row2;
+
+    for (int i = 0; i < 6; i++)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
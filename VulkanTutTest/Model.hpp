@@ -11,26 +11,86 @@
 #include <assimp/postprocess.h>     // Post processing flags
 
 #include <Vertex.hpp>
+#include <GeometryArena.hpp>
+#include <MeshLOD.hpp>
+#include <Meshlet.hpp>
 #include <AnimationClip.hpp>
 #include <CubicInterpolation.hpp>
+#include <KeyframeSampler.hpp>
+#include <Skeleton.hpp>
+#include <PoseKernels.hpp>
+
+#include <limits>
+#include <algorithm>
+
+/// <summary>
+/// Layout of the final bone transforms in a palette. Every encoding fits in the space of one mat4 per bone
+/// </summary>
+enum class PaletteEncoding {
+    Mat4,                                       // 4 columns per bone
+    Affine3x4,                                  // First 3 rows per bone, the last row of an affine matrix is implied
+    DualQuat                                    // Real and dual quaternion per bone. Scale is dropped, so bone transforms must be rigid
+};
+
+/// <summary>
+/// Number of vec4 written per bone for an encoding
+/// </summary>
+inline size_t PaletteVec4sPerBone(const PaletteEncoding encoding)
+{
+    switch (encoding)
+    {
+    case PaletteEncoding::Affine3x4:
+        return 3;
+    case PaletteEncoding::DualQuat:
+        return 2;
+    default:
+        return 4;
+    }
+}
 
-inline glm::mat4 ConvertMatrixToGLMFormat(const aiMatrix4x4& from)
+inline const char* PaletteEncodingName(const PaletteEncoding encoding)
 {
-    return glm::transpose(glm::make_mat4(&from.a1));
+    switch (encoding)
+    {
+    case PaletteEncoding::Affine3x4:
+        return "3x4 affine";
+    case PaletteEncoding::DualQuat:
+        return "dual quaternion";
+    default:
+        return "mat4";
+    }
 }
 
+/// <summary>
+/// Output range for final bone transforms, e.g. the bone array of a persistently mapped uniform buffer
+/// </summary>
+struct BonePaletteSpan {
+    glm::mat4* data = nullptr;
+    size_t count = 0;                           // Capacity in bones
+    PaletteEncoding encoding = PaletteEncoding::Mat4;
+};
+
 struct Mesh {
-	const char* name;
+	std::string name;
 	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
+	std::vector<uint32_t> indices;				// Full mesh, followed by the index ranges of its coarser levels of detail
+    std::vector<MeshLod> lods;                  // Index ranges of each level of detail, the full mesh first
+    std::vector<Meshlet> meshlets;              // Clusters of the full mesh, each a contiguous range of its indices. Empty if not clustered
 	std::map<std::string, int> boneMap;			// Map connects node - bone names to indices in m_bones vector
 	std::vector<BoneInfo> bones;				// Is indexed by the indices in bone_map
 	std::vector<AnimationClip> animations;		// Animations associated with this mesh
+	Skeleton skeleton;							// Flattened node hierarchy, with bones and tracks resolved per joint
+	std::vector<glm::mat4> globalTransforms;	// Model space transform of each skeleton joint. Scratch buffer for animation
+	std::vector<glm::mat4> localTransforms;		// Last local transform of each skeleton joint, held for joints culled by animation LOD
+	PoseBatch poseBatch;						// Keyframes and local transforms of animated joints. Scratch buffer for the pose kernel
 	std::string dir;							// Mesh directory
-	const aiScene* scene;						        // Points to scene of the mesh. Needed to preserve node tree for bone transformation calculations
+	const aiScene* scene = nullptr;				// Points to scene of the mesh. Its node tree is flattened into the skeleton at import. nullptr if loaded from the mesh cache
 	int boneCounter = 0;						// Number of bones in mesh rig
 	glm::mat4 inverseTransform;					// Inverse transform matrix for mesh to scene. Possibly only useful if more submeshes are used
-    uint32_t vertexBufferIndex = 0;             // Index of vertex buffer for mesh
+    GeometryAllocation geometry;                // Vertex and index ranges of the mesh in the geometry arena
+    int skinnedBufferIndex = -1;                // Index of post-skin vertex buffers for mesh, if skinned by the compute pass
+    int clusterDrawIndex = -1;                  // Indirect draw of the mesh in this frame's cluster culling pass, -1 if drawn whole
+    uint64_t rigHash = 0;                       // Hash of the skeleton and bones, equal for meshes sharing a rig. 0 if not computed
 
 	//Mesh(const char* name, const aiScene* scene) : name(name), scene(scene) {}
 	Mesh(const aiScene* sceneP)
@@ -39,244 +99,454 @@ struct Mesh {
         inverseTransform = glm::inverse(ConvertMatrixToGLMFormat(scene->mRootNode->mTransformation));
 	}
     Mesh() {};
+
+    /// <summary>
+    /// Index range of a level of detail, or of the coarsest level if the mesh has fewer
+    /// </summary>
+    inline const MeshLod& Lod(const uint32_t level) const
+    {
+        return lods[std::min(static_cast<size_t>(level), lods.size() - 1)];
+    }
+
+    /// <summary>
+    /// Hashes everything that maps a pose to bone transforms: joints, bind pose, bones and their offsets.
+    /// Call once the skeleton is built
+    /// </summary>
+    void ComputeRigHash()
+    {
+        uint64_t hash = HashValue(skeleton.JointCount(), HASH_SEED);
+        for (size_t joint = 0; joint < skeleton.JointCount(); joint++)
+        {
+            hash = HashString(skeleton.jointNames[joint], hash);
+            hash = HashValue(skeleton.parents[joint], hash);
+            hash = HashValue(skeleton.localBindTransforms[joint], hash);
+            hash = HashValue(skeleton.boneIndices[joint], hash);
+        }
+
+        hash = HashValue(boneCounter, hash);
+        for (const BoneInfo& bone : bones)
+            hash = HashValue(bone.offsetMatrix, hash);
+        hash = HashValue(inverseTransform, hash);
+
+        // 0 marks a missing hash
+        rigHash = hash ? hash : 1;
+    }
 };
 
 struct Model {
     //Assimp::Importer importer;					// Assimp Importer for the scene (MUST LIVE!!!)
-	const char* name;
+	std::string name;
 	std::vector<Mesh> meshes;
 	bool enabled = true;
+    bool resident = false;                      // GPU resources are uploaded and alive. False while a streamed model uploads and after it is removed
 	uint32_t pipelineIndex = 0;
     uint32_t wireframeIndex = 0;
+    uint32_t normalIndex = 0;                   // Normals pipeline, shared by models with the same descriptor layout
+    uint32_t depthIndex = 0;                    // Depth-only pipeline of the depth pre-pass, shared like normalIndex
+    uint32_t lodLevel = 0;                      // Level of detail its meshes are drawn at, clamped to the levels of each mesh
     int currentAnim = 0;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);  // Bounding sphere of the bind pose vertices, in model space
+    float boundsRadius = 0.0f;
+    glm::vec3 boundsMin = glm::vec3(0.0f);     // Bounding box of the bind pose vertices, in model space. Compact vertices are quantized within it
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    /// <summary>
+    /// Fits the bounding box and sphere around the vertices of all meshes
+    /// </summary>
+    void ComputeBounds()
+    {
+        glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(std::numeric_limits<float>::lowest());
+        for (const Mesh& mesh : meshes)
+        {
+            for (const Vertex& vertex : mesh.vertices)
+            {
+                minimum = glm::min(minimum, vertex.pos);
+                maximum = glm::max(maximum, vertex.pos);
+            }
+        }
 
-    // Linear interpolation
-	std::vector<glm::mat4> AnimateLI(double currentTime, std::vector<glm::vec3>* boneVertices)
-	{
-		// TODO: Handle multi-mesh models
-		Mesh& mesh = meshes[0];
-
-		std::vector<glm::mat4> bone_transforms(mesh.boneCounter);                     // Vector to be passed to vertex shader, containing all bone transforms
-
-		glm::mat4 initial_matrix = glm::mat4(1.0f);
-
-		// Traverse nodes from root node
-		TraverseNodeLI(currentTime, mesh.scene->mRootNode, initial_matrix, boneVertices);
-
-		//bone_transforms.resize(mesh.boneCounter);
+        if (minimum.x > maximum.x)
+            return;
 
-		// Traverse updated bones
-		for (int i = 0; i < mesh.boneCounter; i++)
-			bone_transforms[i] = mesh.bones[i].bone_transform;
+        boundsMin = minimum;
+        boundsMax = maximum;
+        boundsCenter = (minimum + maximum) * 0.5f;
+        boundsRadius = 0.0f;
+        for (const Mesh& mesh : meshes)
+            for (const Vertex& vertex : mesh.vertices)
+                boundsRadius = std::max(boundsRadius, glm::length(vertex.pos - boundsCenter));
+    }
 
-		// Write bone transforms to vertex shader
-        return bone_transforms;
+    // Linear interpolation
+	void AnimateLI(double currentTime, BonePaletteSpan palette, KeyframeSampler& sampler, std::vector<glm::vec3>* boneVertices = nullptr,
+        const JointLOD& lod = JointLOD())
+	{
+        AnimateBatch(currentTime, palette, sampler, false, boneVertices, DetectPoseKernelISA(), lod);
 	}
 
-    void TraverseNodeLI(const double currentTime, const aiNode* node, const glm::mat4& parent_transform, std::vector<glm::vec3>* boneVertices)
+    /// <summary>
+    /// Blends any number of clips, each sampled at its own time, in one pass over the joints.
+    /// Scale and translation are weighted sums, rotations are summed in the hemisphere of the first sampled layer and normalized.
+    /// A layer that doesn't animate a joint contributes the bind pose, so weights are normalized over all active layers.
+    /// Layers with zero weight are skipped, and each active layer costs one keyframe lookup per animated joint
+    /// </summary>
+    /// <param name="layers">: clips, times and weights</param>
+    /// <param name="layerCount">: number of layers</param>
+    /// <param name="palette">: output for the final bone matrices</param>
+    /// <param name="boneVertices">: optional output for skeleton debug lines</param>
+    /// <param name="lod">: joints to evaluate</param>
+    void AnimateBlend(const BlendLayer* layers, const size_t layerCount, BonePaletteSpan palette, KeyframeSampler& sampler,
+        std::vector<glm::vec3>* boneVertices = nullptr, const JointLOD& lod = JointLOD())
     {
         // TODO: Handle multi-mesh models
         Mesh& mesh = meshes[0];
+        const Skeleton& skeleton = mesh.skeleton;
+        EnsureJointBuffers(mesh);
 
-        std::string node_name(std::string(node->mName.data));
-        glm::mat4 node_transform = ConvertMatrixToGLMFormat(node->mTransformation);
+        float totalWeight = 0.0f;
+        for (size_t l = 0; l < layerCount; l++)
+            totalWeight += std::max(0.0f, layers[l].weight);
 
-        // Get SQT
-        SQT sqt;
-        /*auto sqt_it = mesh.animations.back().poseSamples.find(node_name);
-        if (sqt_it != mesh.animations.back().poseSamples.end())*/
-        auto sqt_it = mesh.animations[currentAnim].poseSamples.find(node_name);
-        if (sqt_it != mesh.animations[currentAnim].poseSamples.end())
+        // Update hierarchy, parents are always evaluated before their children
+        for (size_t joint = 0; joint < skeleton.JointCount(); joint++)
         {
-            const std::vector<SQT>& bonePoses = sqt_it->second.bonePoses;
-            const int numFrames = static_cast<int>(bonePoses.size());
-
-            // Check if keyframes exist
-            if (numFrames > 0)
+            if (skeleton.IsCulled(joint, lod))
             {
-                // Look for first keyframe
-                int frame_index = 0;
-                for (int i = 0; i < bonePoses.size() - 1; i++)
-                {
-
-                    if (bonePoses[i].time <= currentTime && currentTime < bonePoses[i + 1].time)
-                        frame_index = i;
-                }
+                UpdateJoint(mesh, joint, mesh.localTransforms[joint], boneVertices);
+                continue;
+            }
 
-                // Find frames
-                int nextFrameIndex = frame_index + 1;
+            const SQT& bindPose = skeleton.localBindPoses[joint];
+            glm::vec3 scale(0.0f), translation(0.0f);
+            glm::quat rotation(0.0f, 0.0f, 0.0f, 0.0f);
+            glm::quat reference;
+            bool sampled = false, animated = false;
 
-                const SQT& currentFrameSQT = bonePoses[frame_index];
-                const SQT& nextFrameSQT = bonePoses[nextFrameIndex];
+            for (size_t l = 0; l < layerCount && totalWeight > 0.0f; l++)
+            {
+                const BlendLayer& layer = layers[l];
+                if (layer.weight <= 0.0f)
+                    continue;
 
-                // Calculate the interpolation factor
-                float t = (currentTime - currentFrameSQT.time) / (nextFrameSQT.time - currentFrameSQT.time);
+                const float weight = layer.weight / totalWeight;
+                const int32_t track = skeleton.clipTracks[layer.clip][joint];
 
-                // Interpolate scale, rotation and translation
-                glm::vec3 scale = currentFrameSQT.scale + t * (nextFrameSQT.scale - currentFrameSQT.scale);
-                glm::quat rotation = glm::normalize(glm::slerp(currentFrameSQT.rotation, nextFrameSQT.rotation, t));                    // SLERP IS THE WAY!
-                glm::vec3 translation = currentFrameSQT.translation + t * (nextFrameSQT.translation - currentFrameSQT.translation);
+                glm::vec3 layerScale = bindPose.scale, layerTranslation = bindPose.translation;
+                glm::quat layerRotation = bindPose.rotation;
+                if (track >= 0)
+                {
+                    SampleTrackLI(mesh.animations[layer.clip].tracks[track], layer.clip, layer.time, sampler, layerScale, layerRotation, layerTranslation);
+                    animated = true;
+                }
 
-                // Add them to the matrices
-                glm::mat4 scale_matrix = glm::scale(glm::mat4(1.0f), scale);
-                glm::mat4 rotation_matrix = glm::toMat4(rotation);
-                glm::mat4 translation_matrix = glm::translate(glm::mat4(1.0f), translation);
+                // q and -q are the same rotation, so keep every layer on the side of the first one
+                if (!sampled)
+                    reference = layerRotation;
+                else if (glm::dot(reference, layerRotation) < 0.0f)
+                    layerRotation = -layerRotation;
 
-                node_transform = translation_matrix * rotation_matrix * scale_matrix;
+                scale += layerScale * weight;
+                rotation = rotation + layerRotation * weight;
+                translation += layerTranslation * weight;
+                sampled = true;
             }
-        }
 
-        // Combine with parent
-        glm::mat4 global_transformation = parent_transform * node_transform;
+            const glm::mat4 node_transform = animated ? ComposeTRS(scale, glm::normalize(rotation), translation) : skeleton.localBindTransforms[joint];
 
-        // Get Bone
-        auto bone_it = mesh.boneMap.find(node_name);
-        if (bone_it != mesh.boneMap.end())
-        {
-            mesh.bones[bone_it->second].bone_transform = mesh.inverseTransform * global_transformation * mesh.bones[bone_it->second].offsetMatrix;
-
-            if (node->mParent) {
-                // If node has a parent, add a visible connection from the parent to the node by placing bone vertices at the joint locations.
-                glm::vec4 bonePositionParent = parent_transform * glm::vec4(0, 0, 0, 1);
-                glm::vec4 bonePosition = global_transformation * glm::vec4(0, 0, 0, 1);
-
-                boneVertices->push_back(glm::vec3(bonePositionParent.x, bonePositionParent.y, bonePositionParent.z));
-                boneVertices->push_back(glm::vec3(bonePosition.x, bonePosition.y, bonePosition.z));
-            }
+            UpdateJoint(mesh, joint, FadeJoint(mesh, joint, node_transform, lod), boneVertices);
         }
 
-        // Recursion to traverse all nodes
-        for (uint32_t i = 0; i < node->mNumChildren; i++)
-            TraverseNodeLI(currentTime, node->mChildren[i], global_transformation, boneVertices);
+        // Write bone transforms to vertex shader
+        WriteBoneTransforms(mesh, palette);
     }
 
-    // Linear interpolation between two animations
-    std::vector<glm::mat4> AnimateLI2(double currentTime, std::vector<glm::vec3>* boneVertices, const float interpolationValue)
+    // Cubic interpolation
+    void AnimateCI(double currentTime, BonePaletteSpan palette, KeyframeSampler& sampler, std::vector<glm::vec3>* boneVertices = nullptr,
+        const JointLOD& lod = JointLOD())
+    {
+        AnimateBatch(currentTime, palette, sampler, true, boneVertices, DetectPoseKernelISA(), lod);
+    }
+
+    /// <summary>
+    /// Animates the current clip with the pose kernel: keyframes of all animated joints are gathered into a batch,
+    /// interpolated and composed together, then the hierarchy is updated
+    /// </summary>
+    /// <param name="palette">: output for the final bone matrices</param>
+    /// <param name="cubic">: cubic Hermite interpolation for scale and translation, squad for rotation</param>
+    /// <param name="boneVertices">: optional output for skeleton debug lines</param>
+    /// <param name="isa">: instruction set of the pose kernel</param>
+    /// <param name="lod">: joints to evaluate</param>
+    void AnimateBatch(double currentTime, BonePaletteSpan palette, KeyframeSampler& sampler, const bool cubic,
+        std::vector<glm::vec3>* boneVertices = nullptr, const PoseKernelISA isa = DetectPoseKernelISA(), const JointLOD& lod = JointLOD())
     {
         // TODO: Handle multi-mesh models
         Mesh& mesh = meshes[0];
+        const Skeleton& skeleton = mesh.skeleton;
+        EnsureJointBuffers(mesh);
 
-        std::vector<glm::mat4> bone_transforms(mesh.boneCounter);                     // Vector to be passed to vertex shader, containing all bone transforms
+        const AnimationClip& clip = mesh.animations[currentAnim];
+        const std::vector<int32_t>& clipTracks = mesh.skeleton.clipTracks[currentAnim];
 
-        glm::mat4 initial_matrix = glm::mat4(1.0f);
+        // Gather keyframes of animated joints, except those culled by the LOD
+        size_t trackCount = 0;
+        for (size_t joint = 0; joint < skeleton.JointCount(); joint++)
+            trackCount += (clipTracks[joint] >= 0 && !skeleton.IsCulled(joint, lod));
 
-        // Traverse nodes from root node
-        TraverseNodeLI2(currentTime, mesh.scene->mRootNode, initial_matrix, boneVertices, interpolationValue);
+        mesh.poseBatch.Resize(trackCount);
 
-        //bone_transforms.resize(mesh.boneCounter);
+        size_t index = 0;
+        for (size_t joint = 0; joint < skeleton.JointCount(); joint++)
+        {
+            if (clipTracks[joint] >= 0 && !skeleton.IsCulled(joint, lod))
+                GatherTrack(clip.tracks[clipTracks[joint]], currentAnim, currentTime, sampler, cubic, index++, mesh.poseBatch);
+        }
 
-        // Traverse updated bones
-        for (int i = 0; i < mesh.boneCounter; i++)
-            bone_transforms[i] = mesh.bones[i].bone_transform;
+        // Interpolate and compose local transforms
+        mesh.poseBatch.Evaluate(isa);
+
+        // Update hierarchy, parents are always evaluated before their children
+        index = 0;
+        for (size_t joint = 0; joint < skeleton.JointCount(); joint++)
+        {
+            if (skeleton.IsCulled(joint, lod))
+            {
+                UpdateJoint(mesh, joint, mesh.localTransforms[joint], boneVertices);
+                continue;
+            }
+
+            const glm::mat4 node_transform = (clipTracks[joint] >= 0) ? mesh.poseBatch.GetMatrix(index++) : skeleton.localBindTransforms[joint];
+
+            UpdateJoint(mesh, joint, FadeJoint(mesh, joint, node_transform, lod), boneVertices);
+        }
 
         // Write bone transforms to vertex shader
-        return bone_transforms;
+        WriteBoneTransforms(mesh, palette);
     }
 
-    void TraverseNodeLI2(const double currentTime, const aiNode* node, const glm::mat4& parent_transform, std::vector<glm::vec3>* boneVertices, const float interpolationValue)
+    /// <summary>
+    /// Animates the current clip one joint at a time with glm. Reference for the pose kernel
+    /// </summary>
+    /// <param name="palette">: output for the final bone matrices</param>
+    /// <param name="cubic">: cubic Hermite interpolation for scale and translation, squad for rotation</param>
+    /// <param name="boneVertices">: optional output for skeleton debug lines</param>
+    void AnimateReference(double currentTime, BonePaletteSpan palette, KeyframeSampler& sampler, const bool cubic, std::vector<glm::vec3>* boneVertices = nullptr)
     {
         // TODO: Handle multi-mesh models
         Mesh& mesh = meshes[0];
 
-        std::string node_name(std::string(node->mName.data));
-        glm::mat4 node_transform = ConvertMatrixToGLMFormat(node->mTransformation);
+        const AnimationClip& clip = mesh.animations[currentAnim];
+        const std::vector<int32_t>& clipTracks = mesh.skeleton.clipTracks[currentAnim];
+        EnsureJointBuffers(mesh);
 
-        glm::vec3 translationFirst(0.0f), scaleFirst(1.0f), translationSecond(0.0f), scaleSecond(1.0f);
-        glm::quat rotationFirst(1.0f, 0.0f, 0.0f, 0.0f), rotationSecond(1.0f, 0.0f, 0.0f, 0.0f);
-
-        // Get SQT of first animation
-        SQT sqt;
-        auto sqt_it = mesh.animations[currentAnim].poseSamples.find(node_name);
-        if (sqt_it != mesh.animations[currentAnim].poseSamples.end())
+        // Update hierarchy, parents are always evaluated before their children
+        for (size_t joint = 0; joint < mesh.skeleton.JointCount(); joint++)
         {
-            const std::vector<SQT>& bonePoses = sqt_it->second.bonePoses;
-            const int numFrames = static_cast<int>(bonePoses.size());
+            glm::mat4 node_transform = mesh.skeleton.localBindTransforms[joint];
 
-            // Check if keyframes exist
-            if (numFrames > 0)
+            const int32_t track = clipTracks[joint];
+            if (track >= 0)
             {
-                // Look for first keyframe
-                int frame_index = 0;
-                for (int i = 0; i < bonePoses.size() - 1; i++)
-                {
+                glm::vec3 scale, translation;
+                glm::quat rotation;
+                if (cubic)
+                    SampleTrackCI(clip.tracks[track], currentAnim, currentTime, sampler, scale, rotation, translation);
+                else
+                    SampleTrackLI(clip.tracks[track], currentAnim, currentTime, sampler, scale, rotation, translation);
+
+                node_transform = ComposeTRS(scale, rotation, translation);
+            }
 
-                    if (bonePoses[i].time <= currentTime && currentTime < bonePoses[i + 1].time)
-                        frame_index = i;
-                }
+            UpdateJoint(mesh, joint, node_transform, boneVertices);
+        }
+
+        // Write bone transforms to vertex shader
+        WriteBoneTransforms(mesh, palette);
+    }
 
-                // Find frames
-                int nextFrameIndex = frame_index + 1;
+    /// <summary>
+    /// Writes the keyframe pairs of a track to the pose batch, each channel with its own segment and factor.
+    /// For cubic interpolation, scale and translation are evaluated on their Hermite curves here and passed as constant pairs.
+    /// Rotation is squad: the two inner interpolations are done here and the pose kernel blends them by SquadFactor
+    /// </summary>
+    void GatherTrack(const AnimationPose& pose, const uint32_t clipIndex, const double currentTime, KeyframeSampler& sampler, const bool cubic,
+        const size_t index, PoseBatch& batch)
+    {
+        // Look for the keyframe pair of each channel
+        const KeyframeSegment scaleSegment = sampler.FindSegment(clipIndex, pose, TrackChannel::Scale, currentTime);
+        const KeyframeSegment rotationSegment = sampler.FindSegment(clipIndex, pose, TrackChannel::Rotation, currentTime);
+        const KeyframeSegment translationSegment = sampler.FindSegment(clipIndex, pose, TrackChannel::Translation, currentTime);
 
-                const SQT& currentFrameSQT = bonePoses[frame_index];
-                const SQT& nextFrameSQT = bonePoses[nextFrameIndex];
+        const glm::vec3 scale0 = pose.GetScale(scaleSegment.frame), scale1 = pose.GetScale(scaleSegment.next);
+        const glm::quat rotation0 = pose.GetRotation(rotationSegment.frame);
+        glm::quat rotation1 = pose.GetRotation(rotationSegment.next);
+        const glm::vec3 translation0 = pose.GetTranslation(translationSegment.frame), translation1 = pose.GetTranslation(translationSegment.next);
 
-                // Calculate the interpolation factor
-                float t = (currentTime - currentFrameSQT.time) / (nextFrameSQT.time - currentFrameSQT.time);
+        if (!cubic || pose.cubic.Empty())
+        {
+            batch.SetSample(index, scale0, scale1, rotation0, rotation1, translation0, translation1,
+                scaleSegment.factor, rotationSegment.factor, translationSegment.factor);
 
-                // Interpolate scale, rotation and translation
-                scaleFirst = currentFrameSQT.scale + t * (nextFrameSQT.scale - currentFrameSQT.scale);
-                rotationFirst = glm::normalize(glm::slerp(currentFrameSQT.rotation, nextFrameSQT.rotation, t));                    // SLERP IS THE WAY!
-                translationFirst = currentFrameSQT.translation + t * (nextFrameSQT.translation - currentFrameSQT.translation);
-            }
+            return;
         }
 
-        // Get SQT of second animation
-        sqt_it = mesh.animations[9].poseSamples.find(node_name);
-        if (sqt_it != mesh.animations[9].poseSamples.end())
-        {
-            const std::vector<SQT>& bonePoses = sqt_it->second.bonePoses;
-            const int numFrames = static_cast<int>(bonePoses.size());
+        const CubicTrack& tangents = pose.cubic;
+        const glm::vec3 scale = HermiteChannel(scale0, scale1, tangents.scaleTangents, scaleSegment);
+        const glm::vec3 translation = HermiteChannel(translation0, translation1, tangents.translationTangents, translationSegment);
 
-            // Check if keyframes exist
-            if (numFrames > 0)
-            {
-                // Look for first keyframe
-                int frame_index = 0;
-                for (int i = 0; i < bonePoses.size() - 1; i++)
-                {
+        // Control points follow their key to the shortest path. An empty rotation channel has no control points
+        const float t = rotationSegment.factor;
+        glm::quat control0 = rotation0, control1 = rotation1;
+        if (!tangents.rotationControls.empty())
+        {
+            control0 = tangents.rotationControls[rotationSegment.frame];
+            control1 = tangents.rotationControls[rotationSegment.next];
+        }
+        if (glm::dot(rotation0, rotation1) < 0.0f)
+        {
+            rotation1 = -rotation1;
+            control1 = -control1;
+        }
 
-                    if (bonePoses[i].time <= currentTime && currentTime < bonePoses[i + 1].time)
-                        frame_index = i;
-                }
+        const glm::quat outer = InterpolateRotation(rotation0, rotation1, t);
+        const glm::quat inner = InterpolateRotation(control0, control1, t);
 
-                // Find frames
-                int nextFrameIndex = frame_index + 1;
+        batch.SetSample(index, scale, scale, outer, inner, translation, translation, 0.0f, SquadFactor(t), 0.0f);
+    }
 
-                const SQT& currentFrameSQT = bonePoses[frame_index];
-                const SQT& nextFrameSQT = bonePoses[nextFrameIndex];
+    /// <summary>
+    /// Samples a track with linear interpolation for scale and translation, and slerp for rotation
+    /// </summary>
+    void SampleTrackLI(const AnimationPose& pose, const uint32_t clipIndex, const double currentTime, KeyframeSampler& sampler,
+        glm::vec3& scale, glm::quat& rotation, glm::vec3& translation)
+    {
+        // Look for the keyframe pair of each channel
+        const KeyframeSegment scaleSegment = sampler.FindSegment(clipIndex, pose, TrackChannel::Scale, currentTime);
+        const KeyframeSegment rotationSegment = sampler.FindSegment(clipIndex, pose, TrackChannel::Rotation, currentTime);
+        const KeyframeSegment translationSegment = sampler.FindSegment(clipIndex, pose, TrackChannel::Translation, currentTime);
+
+        const glm::vec3 scale0 = pose.GetScale(scaleSegment.frame);
+        const glm::vec3 translation0 = pose.GetTranslation(translationSegment.frame);
+
+        // Interpolate scale, rotation and translation
+        scale = scale0 + scaleSegment.factor * (pose.GetScale(scaleSegment.next) - scale0);
+        rotation = glm::normalize(glm::slerp(pose.GetRotation(rotationSegment.frame), pose.GetRotation(rotationSegment.next),
+            rotationSegment.factor));                    // SLERP IS THE WAY!
+        translation = translation0 + translationSegment.factor * (pose.GetTranslation(translationSegment.next) - translation0);
+    }
 
-                // Calculate the interpolation factor
-                float t = (currentTime - currentFrameSQT.time) / (nextFrameSQT.time - currentFrameSQT.time);
+    /// <summary>
+    /// Samples a track with cubic Hermite interpolation for scale and translation, and squad for rotation.
+    /// Falls back to linear interpolation if the track has no cubic tangents
+    /// </summary>
+    void SampleTrackCI(const AnimationPose& pose, const uint32_t clipIndex, const double currentTime, KeyframeSampler& sampler,
+        glm::vec3& scale, glm::quat& rotation, glm::vec3& translation)
+    {
+        if (pose.cubic.Empty())
+        {
+            SampleTrackLI(pose, clipIndex, currentTime, sampler, scale, rotation, translation);
+            return;
+        }
 
-                // Interpolate scale, rotation and translation
-                scaleSecond = currentFrameSQT.scale + t * (nextFrameSQT.scale - currentFrameSQT.scale);
-                rotationSecond = glm::normalize(glm::slerp(currentFrameSQT.rotation, nextFrameSQT.rotation, t));                    // SLERP IS THE WAY!
-                translationSecond = currentFrameSQT.translation + t * (nextFrameSQT.translation - currentFrameSQT.translation);
-            }
+        // Look for the keyframe pair of each channel
+        const KeyframeSegment scaleSegment = sampler.FindSegment(clipIndex, pose, TrackChannel::Scale, currentTime);
+        const KeyframeSegment rotationSegment = sampler.FindSegment(clipIndex, pose, TrackChannel::Rotation, currentTime);
+        const KeyframeSegment translationSegment = sampler.FindSegment(clipIndex, pose, TrackChannel::Translation, currentTime);
+        const CubicTrack& tangents = pose.cubic;
+
+        scale = HermiteChannel(pose.GetScale(scaleSegment.frame), pose.GetScale(scaleSegment.next), tangents.scaleTangents, scaleSegment);
+        translation = HermiteChannel(pose.GetTranslation(translationSegment.frame), pose.GetTranslation(translationSegment.next),
+            tangents.translationTangents, translationSegment);
+
+        // Squad, with the control points following their key to the shortest path
+        const float t = rotationSegment.factor;
+        const glm::quat rotation0 = pose.GetRotation(rotationSegment.frame);
+        glm::quat rotation1 = pose.GetRotation(rotationSegment.next);
+        glm::quat control0 = rotation0, control1 = rotation1;
+        if (!tangents.rotationControls.empty())
+        {
+            control0 = tangents.rotationControls[rotationSegment.frame];
+            control1 = tangents.rotationControls[rotationSegment.next];
         }
+        if (glm::dot(rotation0, rotation1) < 0.0f)
+        {
+            rotation1 = -rotation1;
+            control1 = -control1;
+        }
+
+        rotation = glm::normalize(glm::slerp(glm::slerp(rotation0, rotation1, t), glm::slerp(control0, control1, t), SquadFactor(t)));
+    }
 
-        // Interpolate between animations
-        const glm::vec3 scale = scaleFirst + (scaleSecond - scaleFirst) * interpolationValue;
-        const glm::quat rotation = glm::normalize(glm::slerp(rotationFirst, rotationSecond, interpolationValue));
-        const glm::vec3 translation = translationFirst + (translationSecond - translationFirst) * interpolationValue;
+    /// <summary>
+    /// Evaluates a scale or translation channel on its Hermite curve, or linearly if it has no tangents
+    /// </summary>
+    static glm::vec3 HermiteChannel(const glm::vec3& value0, const glm::vec3& value1, const std::vector<glm::vec3>& tangents,
+        const KeyframeSegment& segment)
+    {
+        if (tangents.empty())
+            return value0 + segment.factor * (value1 - value0);
 
+        return HermiteInterpolate(value0, tangents[segment.frame], value1, tangents[segment.next], segment.span, segment.factor);
+    }
+
+    /// <summary>
+    /// Builds a local transform from scale, rotation and translation
+    /// </summary>
+    static glm::mat4 ComposeTRS(const glm::vec3& scale, const glm::quat& rotation, const glm::vec3& translation)
+    {
         // Add them to the matrices
         glm::mat4 scale_matrix = glm::scale(glm::mat4(1.0f), scale);
         glm::mat4 rotation_matrix = glm::toMat4(rotation);
         glm::mat4 translation_matrix = glm::translate(glm::mat4(1.0f), translation);
 
-        node_transform = translation_matrix * rotation_matrix * scale_matrix;
+        return translation_matrix * rotation_matrix * scale_matrix;
+    }
+
+    /// <summary>
+    /// Sizes the joint scratch buffers of a mesh. Held local transforms start at the bind pose
+    /// </summary>
+    static void EnsureJointBuffers(Mesh& mesh)
+    {
+        const Skeleton& skeleton = mesh.skeleton;
+        if (mesh.globalTransforms.size() != skeleton.JointCount())
+            mesh.globalTransforms.resize(skeleton.JointCount());
+        if (mesh.localTransforms.size() != skeleton.JointCount())
+            mesh.localTransforms = skeleton.localBindTransforms;
+    }
+
+    /// <summary>
+    /// Moves the held transform of a joint that fades back in after LOD culling towards its evaluated transform
+    /// </summary>
+    static glm::mat4 FadeJoint(const Mesh& mesh, const size_t joint, const glm::mat4& node_transform, const JointLOD& lod)
+    {
+        if (!mesh.skeleton.IsFading(joint, lod))
+            return node_transform;
+
+        const glm::mat4& held = mesh.localTransforms[joint];
+        return held + (node_transform - held) * lod.fade;
+    }
+
+    /// <summary>
+    /// Combines the local transform of a joint with its parent and updates its bone, if any. The local transform is held for animation LOD
+    /// </summary>
+    static void UpdateJoint(Mesh& mesh, const size_t joint, const glm::mat4& node_transform, std::vector<glm::vec3>* boneVertices)
+    {
+        const Skeleton& skeleton = mesh.skeleton;
+        EnsureJointBuffers(mesh);
+        mesh.localTransforms[joint] = node_transform;
 
         // Combine with parent
-        glm::mat4 global_transformation = parent_transform * node_transform;
+        const int32_t parent = skeleton.parents[joint];
+        const glm::mat4 parent_transform = (parent >= 0) ? mesh.globalTransforms[parent] : glm::mat4(1.0f);
+        const glm::mat4 global_transformation = parent_transform * node_transform;
+        mesh.globalTransforms[joint] = global_transformation;
 
         // Get Bone
-        auto bone_it = mesh.boneMap.find(node_name);
-        if (bone_it != mesh.boneMap.end())
+        const int32_t bone = skeleton.boneIndices[joint];
+        if (bone >= 0)
         {
-            mesh.bones[bone_it->second].bone_transform = mesh.inverseTransform * global_transformation * mesh.bones[bone_it->second].offsetMatrix;
+            mesh.bones[bone].bone_transform = mesh.inverseTransform * global_transformation * mesh.bones[bone].offsetMatrix;
 
-            if (node->mParent) {
+            if (boneVertices && parent >= 0) {
                 // If node has a parent, add a visible connection from the parent to the node by placing bone vertices at the joint locations.
                 glm::vec4 bonePositionParent = parent_transform * glm::vec4(0, 0, 0, 1);
                 glm::vec4 bonePosition = global_transformation * glm::vec4(0, 0, 0, 1);
@@ -285,141 +555,53 @@ struct Model {
                 boneVertices->push_back(glm::vec3(bonePosition.x, bonePosition.y, bonePosition.z));
             }
         }
-
-        // Recursion to traverse all nodes
-        for (uint32_t i = 0; i < node->mNumChildren; i++)
-            TraverseNodeLI2(currentTime, node->mChildren[i], global_transformation, boneVertices, interpolationValue);
     }
 
-    // Cubic interpolation
-    std::vector<glm::mat4> AnimateCI(double currentTime, std::vector<glm::vec3>* boneVertices)
+    /// <summary>
+    /// Converts a bone transform to a dual quaternion. Column c holds component c (x, y, z, w) of the real part in row 0 and of the dual part in row 1.
+    /// Scale is removed from the rotation, and otherwise lost
+    /// </summary>
+    static glm::mat4x2 EncodeDualQuat(const glm::mat4& transform)
     {
-        // TODO: Handle multi-mesh models
-        Mesh& mesh = meshes[0];
+        const glm::mat3 rotation_matrix(glm::normalize(glm::vec3(transform[0])), glm::normalize(glm::vec3(transform[1])), glm::normalize(glm::vec3(transform[2])));
+        const glm::quat real = glm::normalize(glm::quat_cast(rotation_matrix));
+        const glm::quat dual = glm::quat(0.0f, transform[3].x, transform[3].y, transform[3].z) * real * 0.5f;
 
-        std::vector<glm::mat4> bone_transforms(mesh.boneCounter);                     // Vector to be passed to vertex shader, containing all bone transforms
-
-        glm::mat4 initial_matrix = glm::mat4(1.0f);
-
-        // Traverse nodes from root node
-        TraverseNodeCI(currentTime, mesh.scene->mRootNode, initial_matrix, boneVertices);
-
-        //bone_transforms.resize(mesh.boneCounter);
-
-        // Traverse updated bones
-        for (int i = 0; i < mesh.boneCounter; i++)
-            bone_transforms[i] = mesh.bones[i].bone_transform;
-
-        // Write bone transforms to vertex shader
-        return bone_transforms;
+        return glm::mat4x2(real.x, dual.x, real.y, dual.y, real.z, dual.z, real.w, dual.w);
     }
 
-    void TraverseNodeCI(const double currentTime, const aiNode* node, const glm::mat4& parent_transform, std::vector<glm::vec3>* boneVertices)
+    /// <summary>
+    /// Writes the final bone transforms of a mesh to the palette in its encoding, in bone order.
+    /// Sequential writes suit write-combined mapped memory
+    /// </summary>
+    static void WriteBoneTransforms(Mesh& mesh, BonePaletteSpan palette)
     {
-        // TODO: Handle multi-mesh models
-        Mesh& mesh = meshes[0];
-
-        std::string node_name(std::string(node->mName.data));
-        glm::mat4 node_transform = ConvertMatrixToGLMFormat(node->mTransformation);
+        const size_t count = std::min(static_cast<size_t>(mesh.boneCounter), palette.count);
+        glm::vec4* out = reinterpret_cast<glm::vec4*>(palette.data);
 
-        // Get SQT
-        SQT sqt;
-        /*auto sqt_it = mesh.animations.back().poseSamples.find(node_name);
-        if (sqt_it != mesh.animations.back().poseSamples.end())*/
-        auto sqt_it = mesh.animations[currentAnim].poseSamples.find(node_name);
-        if (sqt_it != mesh.animations[currentAnim].poseSamples.end())
+        // Traverse updated bones
+        switch (palette.encoding)
         {
-            const std::vector<SQT>& bonePoses = sqt_it->second.bonePoses;
-            const int numFrames = static_cast<int>(bonePoses.size());
-
-            // Check if keyframes exist
-            if (numFrames > 0)
+        case PaletteEncoding::Affine3x4:
+            for (size_t i = 0; i < count; i++)
             {
-                // Look for first keyframe
-                int frame_index = 0;
-                for (int i = 0; i < bonePoses.size() - 1; i++)
-                {
-                    if (bonePoses[i].time <= currentTime && currentTime < bonePoses[i + 1].time)
-                        frame_index = i;
-                }
-
-                // Find frames
-                int prevFrameIndex = std::max(frame_index - 1, 0);
-                int nextFrameIndex = frame_index + 1;
-                int nextNextFrameIndex = std::min(frame_index + 2, numFrames - 1);
-                int nextNextNextFrameIndex = std::min(frame_index + 3, numFrames - 1);
-
-                const SQT& prevFrameSQT = bonePoses[prevFrameIndex];
-                const SQT& currentFrameSQT = bonePoses[frame_index];
-                const SQT& nextFrameSQT = bonePoses[nextFrameIndex];
-                const SQT& nextNextFrameSQT = bonePoses[nextNextFrameIndex];
-                const SQT& nextNextNextFrameSQT = bonePoses[nextNextNextFrameIndex];
-
-                // Calculate the interpolation factor
-                float t = static_cast<float>((currentTime - currentFrameSQT.time) / (nextFrameSQT.time - currentFrameSQT.time));
-
-                // Perform cubic interpolation for scale, rotation, and translation
-                glm::vec3 scale = CubicInterpolate(
-                    currentFrameSQT.scale,
-                    nextFrameSQT.scale,
-                    nextNextFrameSQT.scale,
-                    nextNextNextFrameSQT.scale,
-                    t
-                );
-
-                /*glm::quat rotation = glm::normalize(CubicInterpolate(
-                    currentFrameSQT.rotation,
-                    nextFrameSQT.rotation,
-                    nextNextFrameSQT.rotation,
-                    nextNextNextFrameSQT.rotation,
-                    t
-                ));*/
-                glm::quat rotation = glm::normalize(slerp(
-                    currentFrameSQT.rotation,
-                    nextFrameSQT.rotation,
-                    t
-                ));
-
-                glm::vec3 translation = CubicInterpolate(
-                    currentFrameSQT.translation,
-                    nextFrameSQT.translation,
-                    nextNextFrameSQT.translation,
-                    nextNextNextFrameSQT.translation,
-                    t
-                );
-
-                // Add them to the matrices
-                glm::mat4 scale_matrix = glm::scale(glm::mat4(1.0f), scale);
-                glm::mat4 rotation_matrix = glm::toMat4(rotation);
-                glm::mat4 translation_matrix = glm::translate(glm::mat4(1.0f), translation);
-
-                node_transform = translation_matrix * rotation_matrix * scale_matrix;
+                const glm::mat4& transform = mesh.bones[i].bone_transform;
+                for (int row = 0; row < 3; row++)
+                    out[3 * i + row] = glm::vec4(transform[0][row], transform[1][row], transform[2][row], transform[3][row]);
             }
-        }
-
-        // Combine with parent
-        glm::mat4 global_transformation = parent_transform * node_transform;
-
-        // Get Bone
-        auto bone_it = mesh.boneMap.find(node_name);
-        if (bone_it != mesh.boneMap.end())
-        {
-            mesh.bones[bone_it->second].bone_transform = mesh.inverseTransform * global_transformation * mesh.bones[bone_it->second].offsetMatrix;
-
-            if (node->mParent) {
-                // If node has a parent, add a visible connection from the parent to the node by placing bone vertices at the joint locations.
-                glm::vec4 bonePositionParent = parent_transform * glm::vec4(0, 0, 0, 1);
-                glm::vec4 bonePosition = global_transformation * glm::vec4(0, 0, 0, 1);
-
-                boneVertices->push_back(glm::vec3(bonePositionParent.x, bonePositionParent.y, bonePositionParent.z));
-                boneVertices->push_back(glm::vec3(bonePosition.x, bonePosition.y, bonePosition.z));
+            break;
+        case PaletteEncoding::DualQuat:
+            for (size_t i = 0; i < count; i++)
+            {
+                const glm::mat4x2& dual_quat = mesh.bones[i].dual_quat = EncodeDualQuat(mesh.bones[i].bone_transform);
+                out[2 * i] = glm::vec4(dual_quat[0][0], dual_quat[1][0], dual_quat[2][0], dual_quat[3][0]);
+                out[2 * i + 1] = glm::vec4(dual_quat[0][1], dual_quat[1][1], dual_quat[2][1], dual_quat[3][1]);
             }
-        }
-
-        // Recursion to traverse all nodes
-        for (unsigned int i = 0; i < node->mNumChildren; i++)
-        {
-            TraverseNodeCI(currentTime, node->mChildren[i], global_transformation, boneVertices);
+            break;
+        default:
+            for (size_t i = 0; i < count; i++)
+                palette.data[i] = mesh.bones[i].bone_transform;
+            break;
         }
     }
 };
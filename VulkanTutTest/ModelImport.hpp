@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stb_image.h>
+
+#include <Model.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <stdexcept>
+#include <cstdint>
+
+/// <summary>
+/// A model to load, with its textures and pipeline. Arguments of Renderer::AddModel
+/// </summary>
+struct ModelRequest {
+    uint32_t pipelineIndex = 0;
+    bool passLightingData = false;
+    std::string modelFile;
+    std::string diffuseTextureFile;
+    std::string normalTextureFile;
+};
+
+/// <summary>
+/// RGBA8 pixels of a decoded texture, freed with stbi_image_free
+/// </summary>
+struct DecodedImage {
+    std::unique_ptr<stbi_uc, void (*)(void*)> pixels = { nullptr, stbi_image_free };
+    int width = 0;
+    int height = 0;
+
+    inline size_t Size() const
+    {
+        return static_cast<size_t>(width) * height * 4;
+    }
+};
+
+/// <summary>
+/// Decodes an image file to RGBA8. Safe to call from several threads at once
+/// </summary>
+inline DecodedImage DecodeImage(const std::string& file)
+{
+    DecodedImage image;
+    int channels;
+    image.pixels.reset(stbi_load(file.c_str(), &image.width, &image.height, &channels, STBI_rgb_alpha));
+
+    if (!image.pixels)
+        throw std::runtime_error("failed to load texture image " + file + "!");
+
+    return image;
+}
+
+/// <summary>
+/// Result of the CPU stages of a model import, waiting for its GPU upload
+/// </summary>
+struct ImportedModel {
+    Model model;
+    DecodedImage diffuse;
+    DecodedImage normal;
+    std::unique_ptr<Assimp::Importer> importer = std::make_unique<Assimp::Importer>();  // Owns the scene the meshes point to, holds none if cached
+    bool cached = false;                        // Whether the model came from the mesh cache rather than Assimp
+
+    // Time of each stage, in ms
+    double modelMs = 0.0;                       // Parse and convert, or cache load
+    double diffuseMs = 0.0;
+    double normalMs = 0.0;
+    double uploadMs = 0.0;
+};
+
+/// <summary>
+/// A model requested at runtime, whose CPU stages are running in the background
+/// </summary>
+struct PendingModel {
+    ModelRequest request;
+    bool pickPipeline = false;                  // Pick the pipeline once it is known whether the model is animated
+    std::future<ImportedModel> result;
+};
+
+/// <summary>
+/// Upload of a streamed model in flight on the graphics queue. The model becomes resident once the fence signals,
+/// and the staging buffers the commands read from are freed then
+/// </summary>
+struct ModelUpload {
+    uint32_t modelIndex = 0;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    std::vector<VkBuffer> stagingBuffers;
+    std::vector<VkDeviceMemory> stagingMemories;
+};
+
+/// <summary>
+/// A removed model, whose GPU resources are destroyed once no frame in flight can reference them
+/// </summary>
+struct RetiredModel {
+    uint32_t modelIndex = 0;
+    uint64_t frame = 0;                         // Frame counter when the model was removed
+};
@@ -0,0 +1,334 @@
+#include <PoseKernels.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define POSE_KERNEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows AVX2 intrinsics in any function, GCC and Clang need them enabled per function
+#if defined(POSE_KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+#define POSE_KERNEL_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define POSE_KERNEL_AVX2_TARGET
+#endif
+
+PoseKernelISA DetectPoseKernelISA()
+{
+    static const PoseKernelISA isa = []()
+    {
+#if defined(POSE_KERNEL_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        const bool sse2 = (info[3] & (1 << 26)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+
+        // AVX state must also be enabled by the OS
+        bool avx2 = false;
+        if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+
+        if (avx2)
+            return PoseKernelISA::AVX2;
+        if (sse2)
+            return PoseKernelISA::SSE;
+#elif defined(POSE_KERNEL_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return PoseKernelISA::AVX2;
+        if (__builtin_cpu_supports("sse2"))
+            return PoseKernelISA::SSE;
+#endif
+        return PoseKernelISA::Scalar;
+    }();
+
+    return isa;
+}
+
+const char* PoseKernelISAName(PoseKernelISA isa)
+{
+    switch (isa)
+    {
+    case PoseKernelISA::AVX2:
+        return "AVX2";
+    case PoseKernelISA::SSE:
+        return "SSE";
+    default:
+        return "Scalar";
+    }
+}
+
+/// <summary>
+/// Writes translation * rotation * scale of a lane, without building the separate matrices
+/// </summary>
+static void ComposeLane(PoseMatrixBlock& out, const size_t lane, const glm::vec3& scale, const glm::quat& q, const glm::vec3& translation)
+{
+    const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    out.m[0][lane] = (1.0f - 2.0f * (yy + zz)) * scale.x;
+    out.m[1][lane] = 2.0f * (xy + wz) * scale.x;
+    out.m[2][lane] = 2.0f * (xz - wy) * scale.x;
+
+    out.m[3][lane] = 2.0f * (xy - wz) * scale.y;
+    out.m[4][lane] = (1.0f - 2.0f * (xx + zz)) * scale.y;
+    out.m[5][lane] = 2.0f * (yz + wx) * scale.y;
+
+    out.m[6][lane] = 2.0f * (xz + wy) * scale.z;
+    out.m[7][lane] = 2.0f * (yz - wx) * scale.z;
+    out.m[8][lane] = (1.0f - 2.0f * (xx + yy)) * scale.z;
+
+    out.m[9][lane] = translation.x;
+    out.m[10][lane] = translation.y;
+    out.m[11][lane] = translation.z;
+}
+
+static void EvaluateBlockScalar(const PoseSampleBlock& in, PoseMatrixBlock& out)
+{
+    for (size_t lane = 0; lane < POSE_BLOCK_LANES; lane++)
+    {
+        const float fs = in.scaleFactor[lane];
+        const float ft = in.translationFactor[lane];
+
+        glm::vec3 scale, translation;
+        for (int c = 0; c < 3; c++)
+        {
+            scale[c] = in.scale0[c][lane] + fs * (in.scale1[c][lane] - in.scale0[c][lane]);
+            translation[c] = in.translation0[c][lane] + ft * (in.translation1[c][lane] - in.translation0[c][lane]);
+        }
+
+        const glm::quat rotation0(in.rotation0[3][lane], in.rotation0[0][lane], in.rotation0[1][lane], in.rotation0[2][lane]);
+        const glm::quat rotation1(in.rotation1[3][lane], in.rotation1[0][lane], in.rotation1[1][lane], in.rotation1[2][lane]);
+
+        ComposeLane(out, lane, scale, InterpolateRotation(rotation0, rotation1, in.rotationFactor[lane]), translation);
+    }
+}
+
+#ifdef POSE_KERNEL_X86
+static void EvaluateBlockSSE(const PoseSampleBlock& in, PoseMatrixBlock& out)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 threshold = _mm_set1_ps(NLERP_DOT_THRESHOLD);
+
+    for (size_t base = 0; base < POSE_BLOCK_LANES; base += 4)
+    {
+        const __m128 fs = _mm_load_ps(&in.scaleFactor[base]);
+        const __m128 fr = _mm_load_ps(&in.rotationFactor[base]);
+        const __m128 ft = _mm_load_ps(&in.translationFactor[base]);
+
+        // Scale and translation
+        __m128 s[3], t[3];
+        for (int c = 0; c < 3; c++)
+        {
+            const __m128 s0 = _mm_load_ps(&in.scale0[c][base]);
+            const __m128 t0 = _mm_load_ps(&in.translation0[c][base]);
+            s[c] = _mm_add_ps(s0, _mm_mul_ps(fs, _mm_sub_ps(_mm_load_ps(&in.scale1[c][base]), s0)));
+            t[c] = _mm_add_ps(t0, _mm_mul_ps(ft, _mm_sub_ps(_mm_load_ps(&in.translation1[c][base]), t0)));
+        }
+
+        // Rotation, flipped to the shortest path
+        __m128 q0[4], q1[4];
+        for (int c = 0; c < 4; c++)
+        {
+            q0[c] = _mm_load_ps(&in.rotation0[c][base]);
+            q1[c] = _mm_load_ps(&in.rotation1[c][base]);
+        }
+
+        __m128 cosTheta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(q0[0], q1[0]), _mm_mul_ps(q0[1], q1[1])),
+            _mm_add_ps(_mm_mul_ps(q0[2], q1[2]), _mm_mul_ps(q0[3], q1[3])));
+        const __m128 sign = _mm_and_ps(cosTheta, signMask);
+        cosTheta = _mm_xor_ps(cosTheta, sign);
+
+        __m128 q[4];
+        for (int c = 0; c < 4; c++)
+        {
+            q1[c] = _mm_xor_ps(q1[c], sign);
+            q[c] = _mm_add_ps(q0[c], _mm_mul_ps(fr, _mm_sub_ps(q1[c], q0[c])));
+        }
+
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(q[0], q[0]), _mm_mul_ps(q[1], q[1])),
+            _mm_add_ps(_mm_mul_ps(q[2], q[2]), _mm_mul_ps(q[3], q[3]))));
+        for (int c = 0; c < 4; c++)
+            q[c] = _mm_div_ps(q[c], length);
+
+        // Slerp fallback for distant keyframes
+        const int fallbackMask = _mm_movemask_ps(_mm_cmplt_ps(cosTheta, threshold));
+        if (fallbackMask)
+        {
+            alignas(16) float qs[4][4];
+            for (int c = 0; c < 4; c++)
+                _mm_store_ps(qs[c], q[c]);
+
+            for (int lane = 0; lane < 4; lane++)
+            {
+                if (!(fallbackMask & (1 << lane)))
+                    continue;
+
+                const size_t l = base + lane;
+                const glm::quat rotation0(in.rotation0[3][l], in.rotation0[0][l], in.rotation0[1][l], in.rotation0[2][l]);
+                const glm::quat rotation1(in.rotation1[3][l], in.rotation1[0][l], in.rotation1[1][l], in.rotation1[2][l]);
+                const glm::quat rotation = InterpolateRotation(rotation0, rotation1, in.rotationFactor[l]);
+                qs[0][lane] = rotation.x;
+                qs[1][lane] = rotation.y;
+                qs[2][lane] = rotation.z;
+                qs[3][lane] = rotation.w;
+            }
+
+            for (int c = 0; c < 4; c++)
+                q[c] = _mm_load_ps(qs[c]);
+        }
+
+        // Compose translation * rotation * scale
+        const __m128 xx = _mm_mul_ps(q[0], q[0]), yy = _mm_mul_ps(q[1], q[1]), zz = _mm_mul_ps(q[2], q[2]);
+        const __m128 xy = _mm_mul_ps(q[0], q[1]), xz = _mm_mul_ps(q[0], q[2]), yz = _mm_mul_ps(q[1], q[2]);
+        const __m128 wx = _mm_mul_ps(q[3], q[0]), wy = _mm_mul_ps(q[3], q[1]), wz = _mm_mul_ps(q[3], q[2]);
+
+        _mm_store_ps(&out.m[0][base], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), s[0]));
+        _mm_store_ps(&out.m[1][base], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), s[0]));
+        _mm_store_ps(&out.m[2][base], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), s[0]));
+
+        _mm_store_ps(&out.m[3][base], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), s[1]));
+        _mm_store_ps(&out.m[4][base], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), s[1]));
+        _mm_store_ps(&out.m[5][base], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), s[1]));
+
+        _mm_store_ps(&out.m[6][base], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), s[2]));
+        _mm_store_ps(&out.m[7][base], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), s[2]));
+        _mm_store_ps(&out.m[8][base], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), s[2]));
+
+        _mm_store_ps(&out.m[9][base], t[0]);
+        _mm_store_ps(&out.m[10][base], t[1]);
+        _mm_store_ps(&out.m[11][base], t[2]);
+    }
+}
+
+POSE_KERNEL_AVX2_TARGET
+static void EvaluateBlockAVX2(const PoseSampleBlock& in, PoseMatrixBlock& out)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 threshold = _mm256_set1_ps(NLERP_DOT_THRESHOLD);
+
+    const __m256 fs = _mm256_load_ps(in.scaleFactor);
+    const __m256 fr = _mm256_load_ps(in.rotationFactor);
+    const __m256 ft = _mm256_load_ps(in.translationFactor);
+
+    // Scale and translation
+    __m256 s[3], t[3];
+    for (int c = 0; c < 3; c++)
+    {
+        const __m256 s0 = _mm256_load_ps(in.scale0[c]);
+        const __m256 t0 = _mm256_load_ps(in.translation0[c]);
+        s[c] = _mm256_add_ps(s0, _mm256_mul_ps(fs, _mm256_sub_ps(_mm256_load_ps(in.scale1[c]), s0)));
+        t[c] = _mm256_add_ps(t0, _mm256_mul_ps(ft, _mm256_sub_ps(_mm256_load_ps(in.translation1[c]), t0)));
+    }
+
+    // Rotation, flipped to the shortest path
+    __m256 q0[4], q1[4];
+    for (int c = 0; c < 4; c++)
+    {
+        q0[c] = _mm256_load_ps(in.rotation0[c]);
+        q1[c] = _mm256_load_ps(in.rotation1[c]);
+    }
+
+    __m256 cosTheta = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(q0[0], q1[0]), _mm256_mul_ps(q0[1], q1[1])),
+        _mm256_add_ps(_mm256_mul_ps(q0[2], q1[2]), _mm256_mul_ps(q0[3], q1[3])));
+    const __m256 sign = _mm256_and_ps(cosTheta, signMask);
+    cosTheta = _mm256_xor_ps(cosTheta, sign);
+
+    __m256 q[4];
+    for (int c = 0; c < 4; c++)
+    {
+        q1[c] = _mm256_xor_ps(q1[c], sign);
+        q[c] = _mm256_add_ps(q0[c], _mm256_mul_ps(fr, _mm256_sub_ps(q1[c], q0[c])));
+    }
+
+    const __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(q[0], q[0]), _mm256_mul_ps(q[1], q[1])),
+        _mm256_add_ps(_mm256_mul_ps(q[2], q[2]), _mm256_mul_ps(q[3], q[3]))));
+    for (int c = 0; c < 4; c++)
+        q[c] = _mm256_div_ps(q[c], length);
+
+    // Slerp fallback for distant keyframes
+    const int fallbackMask = _mm256_movemask_ps(_mm256_cmp_ps(cosTheta, threshold, _CMP_LT_OQ));
+    if (fallbackMask)
+    {
+        alignas(32) float qs[4][POSE_BLOCK_LANES];
+        for (int c = 0; c < 4; c++)
+            _mm256_store_ps(qs[c], q[c]);
+
+        for (size_t lane = 0; lane < POSE_BLOCK_LANES; lane++)
+        {
+            if (!(fallbackMask & (1 << lane)))
+                continue;
+
+            const glm::quat rotation0(in.rotation0[3][lane], in.rotation0[0][lane], in.rotation0[1][lane], in.rotation0[2][lane]);
+            const glm::quat rotation1(in.rotation1[3][lane], in.rotation1[0][lane], in.rotation1[1][lane], in.rotation1[2][lane]);
+            const glm::quat rotation = InterpolateRotation(rotation0, rotation1, in.rotationFactor[lane]);
+            qs[0][lane] = rotation.x;
+            qs[1][lane] = rotation.y;
+            qs[2][lane] = rotation.z;
+            qs[3][lane] = rotation.w;
+        }
+
+        for (int c = 0; c < 4; c++)
+            q[c] = _mm256_load_ps(qs[c]);
+    }
+
+    // Compose translation * rotation * scale
+    const __m256 xx = _mm256_mul_ps(q[0], q[0]), yy = _mm256_mul_ps(q[1], q[1]), zz = _mm256_mul_ps(q[2], q[2]);
+    const __m256 xy = _mm256_mul_ps(q[0], q[1]), xz = _mm256_mul_ps(q[0], q[2]), yz = _mm256_mul_ps(q[1], q[2]);
+    const __m256 wx = _mm256_mul_ps(q[3], q[0]), wy = _mm256_mul_ps(q[3], q[1]), wz = _mm256_mul_ps(q[3], q[2]);
+
+    _mm256_store_ps(out.m[0], _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), s[0]));
+    _mm256_store_ps(out.m[1], _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), s[0]));
+    _mm256_store_ps(out.m[2], _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), s[0]));
+
+    _mm256_store_ps(out.m[3], _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), s[1]));
+    _mm256_store_ps(out.m[4], _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), s[1]));
+    _mm256_store_ps(out.m[5], _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), s[1]));
+
+    _mm256_store_ps(out.m[6], _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), s[2]));
+    _mm256_store_ps(out.m[7], _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), s[2]));
+    _mm256_store_ps(out.m[8], _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), s[2]));
+
+    _mm256_store_ps(out.m[9], t[0]);
+    _mm256_store_ps(out.m[10], t[1]);
+    _mm256_store_ps(out.m[11], t[2]);
+}
+#endif // POSE_KERNEL_X86
+
+void EvaluatePoseBlocks(const PoseSampleBlock* samples, PoseMatrixBlock* matrices, size_t blockCount, PoseKernelISA isa)
+{
+#ifdef POSE_KERNEL_X86
+    if (isa == PoseKernelISA::AVX2)
+    {
+        for (size_t i = 0; i < blockCount; i++)
+            EvaluateBlockAVX2(samples[i], matrices[i]);
+
+        return;
+    }
+
+    if (isa == PoseKernelISA::SSE)
+    {
+        for (size_t i = 0; i < blockCount; i++)
+            EvaluateBlockSSE(samples[i], matrices[i]);
+
+        return;
+    }
+#endif // POSE_KERNEL_X86
+
+    for (size_t i = 0; i < blockCount; i++)
+        EvaluateBlockScalar(samples[i], matrices[i]);
+}
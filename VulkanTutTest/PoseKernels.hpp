@@ -0,0 +1,164 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+#include <cstdint>
+
+const uint32_t POSE_BLOCK_LANES = 8;				// Tracks per block, matches one AVX2 register
+const float NLERP_DOT_THRESHOLD = 0.9995f;			// Below this (about 3.6 degrees between keyframes) nlerp drifts from slerp, which is used instead
+
+/// <summary>
+/// Shortest path rotation interpolation. Nlerp for close rotations, slerp otherwise
+/// </summary>
+inline glm::quat InterpolateRotation(const glm::quat& rotation0, glm::quat rotation1, const float factor)
+{
+	float cosTheta = glm::dot(rotation0, rotation1);
+	if (cosTheta < 0.0f)
+	{
+		rotation1 = -rotation1;
+		cosTheta = -cosTheta;
+	}
+
+	if (cosTheta < NLERP_DOT_THRESHOLD)
+		return glm::normalize(glm::slerp(rotation0, rotation1, factor));
+
+	return glm::normalize(rotation0 + (rotation1 - rotation0) * factor);
+}
+
+/// <summary>
+/// Keyframe pairs of POSE_BLOCK_LANES tracks in SoA layout. Rotations are stored as x, y, z, w.
+/// Channels have their own keyframe times, so each is interpolated by its own factor
+/// </summary>
+struct alignas(32) PoseSampleBlock {
+	float scale0[3][POSE_BLOCK_LANES];
+	float scale1[3][POSE_BLOCK_LANES];
+	float rotation0[4][POSE_BLOCK_LANES];
+	float rotation1[4][POSE_BLOCK_LANES];
+	float translation0[3][POSE_BLOCK_LANES];
+	float translation1[3][POSE_BLOCK_LANES];
+	float scaleFactor[POSE_BLOCK_LANES];			// Interpolation factor between the scale keyframes
+	float rotationFactor[POSE_BLOCK_LANES];			// Interpolation factor between the rotation keyframes
+	float translationFactor[POSE_BLOCK_LANES];		// Interpolation factor between the translation keyframes
+};
+
+/// <summary>
+/// Affine local transforms of POSE_BLOCK_LANES tracks in SoA layout.
+/// Stored as the upper 3x4 part of a column-major matrix: m[0..2] is column 0, ..., m[9..11] is the translation
+/// </summary>
+struct alignas(32) PoseMatrixBlock {
+	float m[12][POSE_BLOCK_LANES];
+};
+
+/// <summary>
+/// Instruction set used by the pose kernel
+/// </summary>
+enum class PoseKernelISA {
+	Scalar,
+	SSE,
+	AVX2
+};
+
+/// <summary>
+/// Detects the best supported pose kernel instruction set. Checked once, on first call
+/// </summary>
+/// <returns></returns>
+PoseKernelISA DetectPoseKernelISA();
+
+/// <summary>
+/// Name of a pose kernel instruction set, for logging
+/// </summary>
+/// <param name="isa"></param>
+/// <returns></returns>
+const char* PoseKernelISAName(PoseKernelISA isa);
+
+/// <summary>
+/// Interpolates scale, rotation and translation of every track in the blocks and composes them to affine transforms.
+/// Scale and translation are interpolated linearly, rotation uses nlerp, falling back to slerp for distant keyframes
+/// </summary>
+/// <param name="samples">: input keyframe blocks</param>
+/// <param name="matrices">: output transform blocks</param>
+/// <param name="blockCount">: number of blocks</param>
+/// <param name="isa">: instruction set to use, must be supported by the CPU</param>
+void EvaluatePoseBlocks(const PoseSampleBlock* samples, PoseMatrixBlock* matrices, size_t blockCount, PoseKernelISA isa);
+
+/// <summary>
+/// Batch of tracks evaluated together by the pose kernel
+/// </summary>
+struct PoseBatch {
+	std::vector<PoseSampleBlock> samples;
+	std::vector<PoseMatrixBlock> matrices;
+	size_t count = 0;								// Number of tracks in the batch
+
+	/// <summary>
+	/// Resizes the batch. Unused lanes of the last block are set to identity
+	/// </summary>
+	/// <param name="trackCount"></param>
+	void Resize(const size_t trackCount)
+	{
+		count = trackCount;
+		const size_t blockCount = (trackCount + POSE_BLOCK_LANES - 1) / POSE_BLOCK_LANES;
+		samples.resize(blockCount);
+		matrices.resize(blockCount);
+
+		for (size_t lane = trackCount; lane < blockCount * POSE_BLOCK_LANES; lane++)
+			SetSample(lane, glm::vec3(1.0f), glm::vec3(1.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+				glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, 0.0f, 0.0f);
+	}
+
+	/// <summary>
+	/// Writes the keyframe pairs of a track
+	/// </summary>
+	void SetSample(const size_t index, const glm::vec3& scale0, const glm::vec3& scale1, const glm::quat& rotation0, const glm::quat& rotation1,
+		const glm::vec3& translation0, const glm::vec3& translation1, const float scaleFactor, const float rotationFactor, const float translationFactor)
+	{
+		PoseSampleBlock& block = samples[index / POSE_BLOCK_LANES];
+		const size_t lane = index % POSE_BLOCK_LANES;
+
+		for (int c = 0; c < 3; c++)
+		{
+			block.scale0[c][lane] = scale0[c];
+			block.scale1[c][lane] = scale1[c];
+			block.translation0[c][lane] = translation0[c];
+			block.translation1[c][lane] = translation1[c];
+		}
+
+		block.rotation0[0][lane] = rotation0.x;
+		block.rotation0[1][lane] = rotation0.y;
+		block.rotation0[2][lane] = rotation0.z;
+		block.rotation0[3][lane] = rotation0.w;
+		block.rotation1[0][lane] = rotation1.x;
+		block.rotation1[1][lane] = rotation1.y;
+		block.rotation1[2][lane] = rotation1.z;
+		block.rotation1[3][lane] = rotation1.w;
+
+		block.scaleFactor[lane] = scaleFactor;
+		block.rotationFactor[lane] = rotationFactor;
+		block.translationFactor[lane] = translationFactor;
+	}
+
+	/// <summary>
+	/// Runs the pose kernel on all tracks of the batch
+	/// </summary>
+	/// <param name="isa"></param>
+	inline void Evaluate(const PoseKernelISA isa = DetectPoseKernelISA())
+	{
+		EvaluatePoseBlocks(samples.data(), matrices.data(), samples.size(), isa);
+	}
+
+	/// <summary>
+	/// Returns the local transform of a track after Evaluate
+	/// </summary>
+	glm::mat4 GetMatrix(const size_t index) const
+	{
+		const PoseMatrixBlock& block = matrices[index / POSE_BLOCK_LANES];
+		const size_t lane = index % POSE_BLOCK_LANES;
+
+		glm::mat4 matrix(1.0f);
+		for (int col = 0; col < 4; col++)
+			for (int row = 0; row < 3; row++)
+				matrix[col][row] = block.m[col * 3 + row][lane];
+
+		return matrix;
+	}
+};
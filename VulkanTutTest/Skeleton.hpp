@@ -0,0 +1,166 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <assimp/scene.h>           // Output data structure
+
+#include <AnimationClip.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+
+inline glm::mat4 ConvertMatrixToGLMFormat(const aiMatrix4x4& from)
+{
+    return glm::transpose(glm::make_mat4(&from.a1));
+}
+
+/// <summary>
+/// Splits an affine transform without shear into scale, rotation and translation
+/// </summary>
+inline SQT DecomposeTRS(const glm::mat4& transform)
+{
+	SQT pose;
+	pose.time = 0.0;
+	pose.translation = glm::vec3(transform[3]);
+	pose.scale = glm::vec3(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])));
+
+	const glm::mat3 rotation_matrix(glm::vec3(transform[0]) / pose.scale.x, glm::vec3(transform[1]) / pose.scale.y, glm::vec3(transform[2]) / pose.scale.z);
+	pose.rotation = glm::normalize(glm::quat_cast(rotation_matrix));
+
+	return pose;
+}
+
+/// <summary>
+/// Joints evaluated by an animation LOD level
+/// </summary>
+struct JointLOD {
+	float minReach = 0.0f;							// Joints with a smaller Skeleton::jointReach keep their last local transform. 0 evaluates all
+	float fadeReach = 0.0f;							// minReach of the previous level. Joints between the two fade back in
+	float fade = 1.0f;								// Weight of the evaluated transform of fading joints
+};
+
+/// <summary>
+/// Flattened node hierarchy of a mesh, built once at import.
+///
+/// Joints are stored in depth-first order, so a parent always comes before its children and
+/// the hierarchy can be updated in a single forward loop. Names, bones and tracks are resolved
+/// to indices here, so no strings or maps are touched while animating
+/// </summary>
+struct Skeleton {
+	std::vector<std::string> jointNames;			// Node names. Only used at import and for debugging
+	std::vector<int32_t> parents;					// Parent joint index, -1 for the root
+	std::vector<glm::mat4> localBindTransforms;		// Node transform relative to its parent, used when a joint has no track
+	std::vector<SQT> localBindPoses;				// localBindTransforms split into scale, rotation and translation, for blending
+	std::vector<int32_t> boneIndices;				// Index into Mesh::bones, -1 if the joint doesn't deform the mesh
+	std::vector<std::vector<int32_t>> clipTracks;	// Track index for each [clip][joint], -1 if the clip doesn't animate the joint
+	std::vector<float> jointReach;					// Bind pose distance from each joint to its furthest descendant, relative to the whole skeleton
+
+	inline size_t JointCount() const
+	{
+		return parents.size();
+	}
+
+	/// <summary>
+	/// Flattens the node tree under root and resolves the bone of each joint
+	/// </summary>
+	/// <param name="root">: root node of the scene</param>
+	/// <param name="boneMap">: map from bone name to index in Mesh::bones</param>
+	void Build(const aiNode* root, const std::map<std::string, int>& boneMap)
+	{
+		jointNames.clear();
+		parents.clear();
+		localBindTransforms.clear();
+		localBindPoses.clear();
+		boneIndices.clear();
+		clipTracks.clear();
+		jointReach.clear();
+
+		// Iterative depth-first traversal, children are pushed in reverse to keep the scene order
+		std::vector<std::pair<const aiNode*, int32_t>> stack = { { root, -1 } };
+		while (!stack.empty())
+		{
+			const aiNode* node = stack.back().first;
+			const int32_t parent = stack.back().second;
+			stack.pop_back();
+
+			const int32_t joint = static_cast<int32_t>(parents.size());
+			const std::string node_name(node->mName.data);
+
+			jointNames.push_back(node_name);
+			parents.push_back(parent);
+			localBindTransforms.push_back(ConvertMatrixToGLMFormat(node->mTransformation));
+			localBindPoses.push_back(DecomposeTRS(localBindTransforms.back()));
+
+			auto bone_it = boneMap.find(node_name);
+			boneIndices.push_back(bone_it != boneMap.end() ? bone_it->second : -1);
+
+			for (uint32_t i = node->mNumChildren; i > 0; i--)
+				stack.push_back({ node->mChildren[i - 1], joint });
+		}
+
+		ComputeJointReach();
+	}
+
+	/// <summary>
+	/// Whether a joint is skipped by a joint LOD, keeping its last local transform
+	/// </summary>
+	inline bool IsCulled(const size_t joint, const JointLOD& lod) const
+	{
+		return jointReach[joint] < lod.minReach;
+	}
+
+	/// <summary>
+	/// Whether a joint was skipped by the previous joint LOD and fades back in
+	/// </summary>
+	inline bool IsFading(const size_t joint, const JointLOD& lod) const
+	{
+		return lod.fade < 1.0f && jointReach[joint] < lod.fadeReach;
+	}
+
+	/// <summary>
+	/// Resolves the track of each joint for a clip. Clips must be resolved in the order of Mesh::animations
+	/// </summary>
+	/// <param name="clip">: clip to resolve</param>
+	void ResolveClip(const AnimationClip& clip)
+	{
+		std::vector<int32_t> tracks(JointCount(), -1);
+		for (size_t joint = 0; joint < JointCount(); joint++)
+		{
+			auto track_it = clip.trackMap.find(jointNames[joint]);
+			if (track_it != clip.trackMap.end() && !clip.tracks[track_it->second].Empty())
+				tracks[joint] = static_cast<int32_t>(track_it->second);
+		}
+
+		clipTracks.push_back(tracks);
+	}
+
+private:
+	/// <summary>
+	/// Measures how far each subtree extends in bind pose. Small subtrees, e.g. fingers and face, are the first culled by animation LOD
+	/// </summary>
+	void ComputeJointReach()
+	{
+		std::vector<glm::vec3> positions(JointCount());
+		std::vector<glm::mat4> globalBindTransforms(JointCount());
+		for (size_t joint = 0; joint < JointCount(); joint++)
+		{
+			globalBindTransforms[joint] = (parents[joint] >= 0) ? globalBindTransforms[parents[joint]] * localBindTransforms[joint] : localBindTransforms[joint];
+			positions[joint] = glm::vec3(globalBindTransforms[joint][3]);
+		}
+
+		// Every joint extends the reach of all its ancestors
+		jointReach.assign(JointCount(), 0.0f);
+		for (size_t joint = 0; joint < JointCount(); joint++)
+		{
+			for (int32_t ancestor = parents[joint]; ancestor >= 0; ancestor = parents[ancestor])
+				jointReach[ancestor] = std::max(jointReach[ancestor], glm::length(positions[joint] - positions[ancestor]));
+		}
+
+		const float extent = jointReach.empty() ? 0.0f : jointReach[0];
+		for (float& reach : jointReach)
+			reach = (extent > 0.0f) ? reach / extent : 1.0f;
+	}
+};
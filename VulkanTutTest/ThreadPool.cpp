@@ -0,0 +1,107 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	m_workers.reserve(threadCount);
+	for (uint32_t i = 0; i < threadCount; i++)
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+uint32_t ThreadPool::DefaultThreadCount()
+{
+	const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+
+	return (hardwareThreads > 1) ? hardwareThreads - 1 : 0;
+}
+
+void ThreadPool::Dispatch(size_t count, JobFunction job, const void* context)
+{
+	// Nothing to share
+	if (count <= 1 || m_workers.empty())
+	{
+		for (size_t i = 0; i < count; i++)
+			job(context, i);
+
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = job;
+		m_jobContext = context;
+		m_count = count;
+		m_nextIndex = 0;
+		m_activeWorkers = static_cast<uint32_t>(m_workers.size());
+		m_exception = nullptr;
+		m_generation++;
+	}
+	m_wakeCondition.notify_all();
+
+	RunIndices();
+
+	// Wait for workers to finish their last index
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return m_activeWorkers == 0; });
+	m_job = nullptr;
+	m_jobContext = nullptr;
+
+	if (m_exception)
+		std::rethrow_exception(m_exception);
+}
+
+void ThreadPool::WorkerLoop()
+{
+	uint64_t seenGeneration = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [this, seenGeneration]() { return m_stop || m_generation != seenGeneration; });
+
+			if (m_stop)
+				return;
+
+			seenGeneration = m_generation;
+		}
+
+		RunIndices();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_activeWorkers--;
+		}
+		m_doneCondition.notify_one();
+	}
+}
+
+void ThreadPool::RunIndices()
+{
+	for (size_t i = m_nextIndex.fetch_add(1); i < m_count; i = m_nextIndex.fetch_add(1))
+	{
+		try
+		{
+			m_job(m_jobContext, i);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_exception)
+				m_exception = std::current_exception();
+		}
+	}
+}
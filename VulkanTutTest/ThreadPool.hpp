@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <cstdint>
+
+/// <summary>
+/// Fixed pool of worker threads running data-parallel loops.
+///
+/// The calling thread takes part in every loop, so a pool with N workers runs on N + 1 threads
+/// </summary>
+class ThreadPool
+{
+public:
+	/// <summary>
+	/// Starts the workers. By default one less than the hardware threads, leaving one for the calling thread
+	/// </summary>
+	/// <param name="threadCount">: number of worker threads</param>
+	ThreadPool(uint32_t threadCount = DefaultThreadCount());
+
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/// <summary>
+	/// Calls func for every index in [0, count) across the pool and blocks until all calls are done.
+	/// The first exception thrown by func is rethrown here. Does not allocate
+	/// </summary>
+	/// <param name="count">: number of indices</param>
+	/// <param name="func">: called once per index, possibly concurrently</param>
+	template<typename Func>
+	void ParallelFor(size_t count, const Func& func)
+	{
+		Dispatch(count, [](const void* context, size_t index) { (*static_cast<const Func*>(context))(index); }, &func);
+	}
+
+	/// <summary>
+	/// Returns the number of worker threads, not counting the calling thread
+	/// </summary>
+	inline uint32_t GetThreadCount() const
+	{
+		return static_cast<uint32_t>(m_workers.size());
+	}
+
+	static uint32_t DefaultThreadCount();
+
+private:
+	using JobFunction = void (*)(const void* context, size_t index);
+
+	void Dispatch(size_t count, JobFunction job, const void* context);
+	void WorkerLoop();
+	void RunIndices();
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+
+	// Current loop, guarded by m_mutex apart from m_nextIndex
+	JobFunction m_job = nullptr;
+	const void* m_jobContext = nullptr;
+	size_t m_count = 0;
+	std::atomic<size_t> m_nextIndex{ 0 };
+	uint32_t m_activeWorkers = 0;
+	uint64_t m_generation = 0;
+	std::exception_ptr m_exception;
+	bool m_stop = false;
+};
@@ -46,6 +46,11 @@
 #include <array>
 #include <chrono>
 #include <unordered_map>
+#include <filesystem>
+#include <deque>
+#include <future>
+#include <numeric>
+#include <iomanip>
 
 // Local Libraries
 #include <Camera.hpp>
@@ -55,13 +60,23 @@
 #include <GUI.hpp>
 #include <AnimationClip.hpp>
 #include <AnimationPlayer.hpp>
+#include <AnimationLOD.hpp>
 #include <Skybox.hpp>
+#include <ThreadPool.hpp>
+#include <BakedAnimation.hpp>
+#include <MeshCache.hpp>
+#include <ModelImport.hpp>
+#include <MeshOptimizer.hpp>
+#include <MeshLOD.hpp>
+#include <CompactVertex.hpp>
+#include <GeometryArena.hpp>
 
 // Wrappers
 #include <RenderPass.hpp>
 #include <Image.hpp>
 #include <Swapchain.hpp>
 #include <GraphicsPipeline.hpp>
+#include <ComputePipeline.hpp>
 
 // Macros
 #define REQUIRE_GEOM_SHADERS
@@ -73,6 +88,24 @@
 #define MODEL_IMPORT_DEBUG
 #define USE_ASSIMP                  // DO NOT DISABLE!
 //#define DISABLE_SKYBOX_ON_WIREFRAME
+//#define ANIMATION_BENCHMARK       // Run animation microbenchmarks after loading models
+//#define COMPRESS_ANIMATIONS       // Store animation tracks compressed (lossy keyframe reduction and quantization). Off: all clips in models/ take ~1.3 MiB lossless, it saves ~0.7 MiB at ~0.05 deg per bone
+#define USE_MESH_CACHE              // Load imported models from binary cache files in MESH_CACHE_FOLDER, importing with Assimp only if the cache is stale
+#define OPTIMIZE_MESHES             // Reorder the triangles and vertices of imported meshes for the post-transform cache, overdraw and vertex fetch
+//#define MESH_CACHE_BENCHMARK      // Report cold (Assimp) and warm (cache) load times of every model in the models folder after loading models
+//#define BAKED_CROWD               // Draw an instanced crowd of the first animated model from baked bone palettes (shaders/baked_skinning_vert.spv and its _compact variant are built by shaders/compile.bat before each build)
+//#define GPU_ANIMATION             // Evaluate the crowd's animations from compressed clips in a compute pass instead of baking them (needs BAKED_CROWD. shaders/animation_eval_comp.spv is built by shaders/compile.bat before each build)
+//#define COMPUTE_SKINNING          // Skin animated meshes once per frame in a compute pass, and draw them as static meshes (shaders/skinning_comp.spv and its _affine and _dq variants are built by shaders/compile.bat before each build)
+//#define PALETTE_AFFINE            // Upload bone palettes as 3x4 affine matrices (needs the _affine skinning shader variants)
+//#define PALETTE_DUAL_QUAT         // Upload bone palettes as dual quaternions and skin with DQS (needs the _dq skinning shader variants)
+//#define COMPACT_VERTICES          // Upload meshes as quantized CompactVertex data, with bone influences in a stream of their own for skinned meshes (needs the _compact vertex shader variants)
+//#define DEPTH_PREPASS             // Upload position-only streams and lay down model depth with them before shading, so lit fragments are shaded about once (the depth_only and depth_skinning vertex shader variants are built by shaders/compile.bat before each build)
+#define MESH_LODS                   // Simplify imported meshes into levels of detail, and draw each model at the coarsest level whose projected error is small enough
+//#define CLUSTER_CULLING           // Split imported meshes into meshlets, and draw static models at full detail from the meshlets a compute pass finds in the frustum and front facing (shaders/cluster_cull_comp.spv is built by shaders/compile.bat before each build)
+
+#ifdef ANIMATION_BENCHMARK
+#include <AnimationBenchmark.hpp>
+#endif // ANIMATION_BENCHMARK
 
 // Constants
 #ifdef HIGH_RES
@@ -89,10 +122,84 @@ const std::string NORMAL_PATH = "textures/viking_room_normal.png";
 const std::string SKYBOX_PATH = "textures/skybox/";
 const std::string MODELS_FOLDER = "models/";
 const std::string TEXTURES_FOLDER = "textures/";
+const std::string MESH_CACHE_FOLDER = "cache/";
+
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType;
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 const size_t MAX_BONES = 120;
-const uint32_t MAX_MODELS = 10;
+const uint32_t MAX_MODELS = 10;                     // Skinned models alive at once with COMPUTE_SKINNING. Other models are only limited by memory
+const uint32_t MAX_MODEL_UPLOADS_PER_FRAME = 1;     // Streamed models whose upload is recorded in one frame, to keep frame times even
+const uint32_t CROWD_SIZE = 1024;                   // Instances of the baked crowd
+const float CROWD_SPACING = 150.0f;                 // Distance between crowd instances in model units
+const uint32_t SKINNING_GROUP_SIZE = 64;            // Vertices per skinning compute workgroup, as in skinning.comp
+const uint32_t MAX_CLUSTER_CULL_BLOCKS = 16;        // Geometry blocks the cluster culling pass has descriptor sets for. Meshes in later blocks are drawn whole
+const uint32_t MAX_CLUSTER_CULL_MESHLETS = 65535;   // Meshlets of a mesh the cluster culling pass dispatches at once, the least maxComputeWorkGroupCount. Larger meshes are drawn whole
+
+#if defined(PALETTE_DUAL_QUAT)
+const PaletteEncoding BONE_PALETTE_ENCODING = PaletteEncoding::DualQuat;
+const std::string PALETTE_SHADER_SUFFIX = "_dq";
+#elif defined(PALETTE_AFFINE)
+const PaletteEncoding BONE_PALETTE_ENCODING = PaletteEncoding::Affine3x4;
+const std::string PALETTE_SHADER_SUFFIX = "_affine";
+#else
+const PaletteEncoding BONE_PALETTE_ENCODING = PaletteEncoding::Mat4;
+const std::string PALETTE_SHADER_SUFFIX = "";
+#endif // PALETTE_DUAL_QUAT
+
+#ifdef COMPACT_VERTICES
+const std::string VERTEX_SHADER_SUFFIX = "_compact";
+const VkDeviceSize GEOMETRY_VERTEX_STRIDE = sizeof(CompactVertex);     // Bytes per vertex in the vertex buffers of the geometry arena
+typedef CompactPositionVertex DepthPositionVertex;
+typedef SkinningVertex DepthSkinningVertex;
+#else
+const std::string VERTEX_SHADER_SUFFIX = "";
+const VkDeviceSize GEOMETRY_VERTEX_STRIDE = sizeof(Vertex);
+typedef PositionVertex DepthPositionVertex;
+typedef FloatSkinningVertex DepthSkinningVertex;     // Full precision, so skinned depth matches the shading pass exactly
+#endif // COMPACT_VERTICES
+
+#ifdef DEPTH_PREPASS
+const VkCompareOp MODEL_DEPTH_COMPARE_OP = VK_COMPARE_OP_LESS_OR_EQUAL;     // Shade fragments the pre-pass left in front
+#else
+const VkCompareOp MODEL_DEPTH_COMPARE_OP = VK_COMPARE_OP_LESS;
+#endif // DEPTH_PREPASS
+
+/// <summary>
+/// Returns the variant of a model vertex shader that reads the uploaded vertex layout, e.g. shaders/blinn_phong_compact_vert.spv
+/// </summary>
+/// <param name="name">: shader name</param>
+/// <returns></returns>
+inline std::string ModelShaderFile(const std::string& name)
+{
+    return "shaders/" + name + VERTEX_SHADER_SUFFIX + "_vert.spv";
+}
+
+/// <summary>
+/// Returns the variant of a skinning shader that decodes BONE_PALETTE_ENCODING, e.g. shaders/linear_skinning_dq_vert.spv.
+/// Vertex shaders also read the uploaded vertex layout, as in ModelShaderFile
+/// </summary>
+/// <param name="name">: shader name</param>
+/// <param name="stage">: shader stage suffix</param>
+/// <returns></returns>
+inline std::string PaletteShaderFile(const std::string& name, const std::string& stage)
+{
+    const std::string layoutSuffix = (stage == "vert") ? VERTEX_SHADER_SUFFIX : "";
+    return "shaders/" + name + PALETTE_SHADER_SUFFIX + layoutSuffix + "_" + stage + ".spv";
+}
+
+#if defined(GPU_ANIMATION) && !defined(BAKED_CROWD)
+#error "GPU_ANIMATION evaluates the animations of the BAKED_CROWD crowd!"
+#endif // GPU_ANIMATION && !BAKED_CROWD
+
+#if defined(COMPACT_VERTICES) && defined(COMPUTE_SKINNING)
+#error "COMPUTE_SKINNING reads and writes the float Vertex layout, so it can't skin COMPACT_VERTICES meshes!"
+#endif // COMPACT_VERTICES && COMPUTE_SKINNING
+
+#ifdef COMPUTE_SKINNING
+// skinning.comp reads and writes Vertex as an array of floats
+static_assert(sizeof(Vertex) == 26 * sizeof(float), "skinning.comp must match the Vertex layout!");
+#endif // COMPUTE_SKINNING
 
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
@@ -125,10 +232,20 @@ namespace std
     {
         size_t operator()(Vertex const& vertex) const
         {
-            return (((hash<glm::vec3>()(vertex.pos) ^
-                (hash<glm::vec3>()(vertex.color) << 1)) >> 1 ^
-                (hash<glm::vec3>()(vertex.norm) << 1)) >> 1) ^
-                (hash<glm::vec2>()(vertex.texCoord) << 1);
+            // FNV-1a over the attributes operator== compares. XOR of the per attribute hashes collides on symmetric meshes.
+            // -0 and +0 compare equal, so they must hash the same or signed zeros in normals and UVs won't weld
+            const auto canonical = [](auto value) {
+                for (int i = 0; i < value.length(); i++)
+                    value[i] = (value[i] == 0.0f) ? 0.0f : value[i];
+                return value;
+            };
+
+            uint64_t hash = HashValue(canonical(vertex.pos), HASH_SEED);
+            hash = HashValue(canonical(vertex.color), hash);
+            hash = HashValue(canonical(vertex.texCoord), hash);
+            hash = HashValue(canonical(vertex.norm), hash);
+
+            return static_cast<size_t>(hash);
         }
     };
 }
@@ -137,9 +254,11 @@ struct UniformBufferObject {
     glm::mat4 model;
     glm::mat4 view;
     glm::mat4 proj;
-    glm::mat4 boneTransforms[MAX_BONES];
+    glm::mat4 boneTransforms[MAX_BONES];           // Bone palette, encoded as BONE_PALETTE_ENCODING
     float time;
     bool explode;
+    alignas(16) glm::vec4 positionMin;             // Compact vertex positions decode to positionMin + pos * positionExtent
+    glm::vec4 positionExtent;
 };
 
 struct LightDataUBO {
@@ -214,13 +333,40 @@ inline glm::quat Assimp2GLMQUAT(aiQuaternion& src)
     return glm::quat(src.w, src.x, src.y, src.z);
 }
 
+/// <summary>
+/// Converts scaling or position keys of an Assimp channel, with times in seconds
+/// </summary>
+inline KeyChannel<glm::vec3> ParseVectorKeys(aiVectorKey* keys, const unsigned int keyCount, const double ticksPerSecond)
+{
+    KeyChannel<glm::vec3> channel;
+    channel.times.reserve(keyCount);
+    channel.values.reserve(keyCount);
+    for (unsigned int k = 0; k < keyCount; k++)
+        channel.Add(static_cast<float>(keys[k].mTime / ticksPerSecond), Assimp2GLMVEC3(keys[k].mValue));
+
+    return channel;
+}
+
+/// <summary>
+/// Converts rotation keys of an Assimp channel, with times in seconds
+/// </summary>
+inline KeyChannel<glm::quat> ParseRotationKeys(aiQuatKey* keys, const unsigned int keyCount, const double ticksPerSecond)
+{
+    KeyChannel<glm::quat> channel;
+    channel.times.reserve(keyCount);
+    channel.values.reserve(keyCount);
+    for (unsigned int k = 0; k < keyCount; k++)
+        channel.Add(static_cast<float>(keys[k].mTime / ticksPerSecond), Assimp2GLMQUAT(keys[k].mValue));
+
+    return channel;
+}
+
 // Global objects and stuff
 Camera cam = Camera(glm::vec3(0.0f, 0.0f, 3.0f));
 Timer timer;
 GUI gui = GUI(&cam, &timer);
 //AnimationPlayer animPlayer = AnimationPlayer(0, nullptr, 0);
 std::vector<AnimationPlayer> animPlayers;
-std::vector<Assimp::Importer> importers = std::vector<Assimp::Importer>(MAX_MODELS);
 
 // Callbacks
 void MouseMovementCallback(GLFWwindow* window, double x_pos, double y_pos);
@@ -279,6 +425,8 @@ private:
     std::vector<VkPipeline> normalGraphicsPipelines;
     VkPipelineLayout animatedNormalPipelineLayout;
     VkPipeline animatedNormalGraphicsPipeline;
+    std::vector<VkPipelineLayout> depthPipelineLayouts;
+    std::vector<VkPipeline> depthGraphicsPipelines;
     VkPipelineLayout uiPipelineLayout;
     VkPipeline uiPipeline;
     
@@ -305,10 +453,10 @@ private:
     uint32_t currentFrame = 0;
     bool framebufferResized = false;
     // Vertex and index buffers
-    std::vector<VkBuffer> vertexBuffers;
-    std::vector<VkDeviceMemory> vertexBufferMemories;
-    std::vector<VkBuffer> indexBuffers;
-    std::vector<VkDeviceMemory> indexBufferMemories;
+    std::vector<GeometryBlock> geometryBlocks;          // Geometry arena every mesh is suballocated from. Destroyed blocks stay as null slots
+    std::vector<RetiredBuffer> retiredGeometryBuffers;  // Block buffers replaced by compaction, until frames in flight complete
+    std::vector<GeometryCompaction> geometryCompactions;    // Compaction copies still running on the graphics queue
+    uint32_t geometryVertexAlignment = 1;               // Vertex alignment of mesh ranges, so the skinning pass can bind them as storage buffers
     VkBuffer skyboxVertexBuffer;
     VkDeviceMemory skyboxVertexBufferMemory;
     VkBuffer gridVertexBuffer;
@@ -322,6 +470,7 @@ private:
     std::vector<std::vector<VkBuffer>> uniformBuffers;
     std::vector<std::vector<VkDeviceMemory>> uniformBuffersMemory;
     std::vector<std::vector<void*>> uniformBuffersMapped;
+    std::vector<std::vector<uint64_t>> paletteVersions;                 // Pose version held by the bone palette of each [model][frame], 0 if none
     std::vector<std::vector<VkBuffer>> lightingUniformBuffers;
     std::vector<std::vector<VkDeviceMemory>> lightingUniformBuffersMemory;
     std::vector<std::vector<void*>> lightingUniformBuffersMapped;
@@ -365,9 +514,93 @@ private:
     // PLACEHOLDERS
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
-    // Models
-    std::vector<Model> models = std::vector<Model>(MAX_MODELS);
+    // Models. A deque, so animation players and the GUI can point at models while more are added
+    std::deque<Model> models;
     uint32_t emptyModelIndex = 0;
+    std::vector<uint32_t> freeModelSlots;                               // Slots of destroyed models, reused before models grows
+    std::vector<std::unique_ptr<Assimp::Importer>> importers;          // Importer that owns the scene of each model, null once removed
+    // Model streaming
+    std::vector<PendingModel> pendingModels;                            // Requested models still importing
+    std::vector<ModelUpload> modelUploads;                              // Streamed models uploading on the graphics queue
+    std::vector<RetiredModel> retiredModels;                            // Removed models waiting for their last frames to complete
+    ModelUpload* recordingUpload = nullptr;                             // While set, single time commands are recorded into this upload instead of submitted
+    uint64_t frameCount = 0;                                            // Frames drawn
+    int32_t wireframePipelineIndices[2] = { -1, -1 };                   // Shared wireframe pipeline without and with lighting data, -1 until created
+    int32_t normalPipelineIndices[2] = { -1, -1 };                      // Shared normals pipeline without and with lighting data, -1 until created
+    int32_t depthPipelineIndices[2][2] = { { -1, -1 }, { -1, -1 } };    // Shared depth-only pipeline [without, with lighting data][static, skinned], -1 until created
+    // Animation
+    ThreadPool animationPool;
+    AnimationCompressionSettings animationCompression;
+    std::vector<SharedPoseKey> sharedPoseKeys;                          // Shared pose key of each animation player, rebuilt every frame
+    std::vector<int32_t> poseLeaders;                                   // Player whose pose each animation player takes, -1 if it evaluates its own
+#ifdef BAKED_CROWD
+    // Baked animation crowd
+    BakedAnimation crowdAnimation;
+    Crowd crowd;
+    uint32_t crowdModelIndex = 0;
+    VkBuffer crowdPaletteBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory crowdPaletteBufferMemory = VK_NULL_HANDLE;
+    std::vector<VkBuffer> crowdInstanceBuffers;
+    std::vector<VkDeviceMemory> crowdInstanceBuffersMemory;
+    std::vector<void*> crowdInstanceBuffersMapped;
+    VkDescriptorSetLayout crowdDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool crowdDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> crowdDescriptorSets;
+    VkPipelineLayout crowdPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline crowdGraphicsPipeline = VK_NULL_HANDLE;
+#endif // BAKED_CROWD
+#ifdef GPU_ANIMATION
+    // Compute evaluation of the crowd's animations, writing per-instance palettes to crowdPaletteBuffer
+    GpuAnimationData gpuAnimation;
+    VkBuffer gpuAnimationBuffer = VK_NULL_HANDLE;                          // Packed skeleton and clips, static after upload
+    VkDeviceMemory gpuAnimationBufferMemory = VK_NULL_HANDLE;
+    VkBuffer gpuJointBuffer = VK_NULL_HANDLE;                              // Local, then global joint transforms of every instance
+    VkDeviceMemory gpuJointBufferMemory = VK_NULL_HANDLE;
+    std::vector<VkBuffer> gpuAnimationInstanceBuffers;                     // Clip and time of every instance, per frame in flight
+    std::vector<VkDeviceMemory> gpuAnimationInstanceBuffersMemory;
+    std::vector<void*> gpuAnimationInstanceBuffersMapped;
+    VkDescriptorSetLayout gpuAnimationDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool gpuAnimationDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> gpuAnimationDescriptorSets;
+    VkPipelineLayout gpuAnimationPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline gpuAnimationPipeline = VK_NULL_HANDLE;
+#endif // GPU_ANIMATION
+#ifdef ANIMATION_BENCHMARK
+    // GPU timestamps around the model draws, two per frame in flight
+    VkQueryPool timestampQueryPool;
+    float timestampPeriod = 1.0f;                                           // Nanoseconds per timestamp tick
+    std::vector<bool> timestampsWritten = std::vector<bool>(MAX_FRAMES_IN_FLIGHT, false);
+#endif // ANIMATION_BENCHMARK
+#ifdef COMPUTE_SKINNING
+    // Compute skinning
+    VkDescriptorSetLayout skinningDescriptorSetLayout;
+    VkPipelineLayout skinningPipelineLayout;
+    VkPipeline skinningPipeline;
+    VkDescriptorPool skinningDescriptorPool;
+    uint32_t skinnedPipelineIndex = 0;                                      // Static mesh pipeline that draws post-skin vertex buffers
+    std::vector<std::vector<VkBuffer>> skinnedVertexBuffers;               // Post-skin vertex buffers, per skinned mesh and frame in flight
+    std::vector<std::vector<VkDeviceMemory>> skinnedVertexBufferMemories;
+    std::vector<std::vector<VkDescriptorSet>> skinningDescriptorSets;
+    std::vector<int> freeSkinnedBufferSlots;                                // Slots of destroyed skinned meshes, reused like model slots
+    bool skinningInputsStale[MAX_FRAMES_IN_FLIGHT] = {};                    // Compaction moved bind pose vertices since the sets of this frame slot were written
+#endif // COMPUTE_SKINNING
+#ifdef CLUSTER_CULLING
+    // Cluster culling
+    VkDescriptorSetLayout clusterCullDescriptorSetLayout;
+    VkPipelineLayout clusterCullPipelineLayout;
+    VkPipeline clusterCullPipeline;
+    VkDescriptorPool clusterCullDescriptorPool;
+    std::vector<std::vector<VkDescriptorSet>> clusterCullDescriptorSets;    // Per geometry block and frame in flight, rewritten every frame they are used
+    std::vector<VkBuffer> clusterIndexBuffers = std::vector<VkBuffer>(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);       // Indices of the visible meshlets, per frame in flight
+    std::vector<VkDeviceMemory> clusterIndexBufferMemories = std::vector<VkDeviceMemory>(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    std::vector<uint32_t> clusterIndexCapacities = std::vector<uint32_t>(MAX_FRAMES_IN_FLIGHT, 0);
+    std::vector<VkBuffer> clusterDrawBuffers = std::vector<VkBuffer>(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);        // One indirect draw per culled mesh, per frame in flight. Host visible
+    std::vector<VkDeviceMemory> clusterDrawBufferMemories = std::vector<VkDeviceMemory>(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    std::vector<void*> clusterDrawBuffersMapped = std::vector<void*>(MAX_FRAMES_IN_FLIGHT, nullptr);
+    std::vector<uint32_t> clusterDrawCapacities = std::vector<uint32_t>(MAX_FRAMES_IN_FLIGHT, 0);
+    std::vector<uint32_t> clusterDrawCounts = std::vector<uint32_t>(MAX_FRAMES_IN_FLIGHT, 0);              // Draws recorded in each frame, read back once it completes
+    std::vector<uint32_t> clusterTestedTriangles = std::vector<uint32_t>(MAX_FRAMES_IN_FLIGHT, 0);         // Triangles of those draws before culling
+#endif // CLUSTER_CULLING
     // Multisampling
     VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_8_BIT;
     VkImage colorImage;
@@ -399,28 +632,111 @@ private:
 
     void InitImporter(Assimp::Importer& importer, const char* file = MODEL_PATH.c_str())
     {
-        const aiScene* scene = importer.ReadFile(file,
-            aiProcess_CalcTangentSpace |
-            aiProcess_Triangulate |
-            aiProcess_JoinIdenticalVertices |
-            aiProcess_SortByPType);
+        const aiScene* scene = importer.ReadFile(file, MODEL_IMPORT_FLAGS);
 
         // If the import failed, report it
         if (nullptr == scene)
             throw std::runtime_error("model importing failed!");
     }
 
-    void ImportModel(const uint32_t pipelineIndex, const char* file = MODEL_PATH.c_str())
+    /// <summary>
+    /// Hashes everything besides the source file that changes what ParseScene produces. Part of the mesh cache key
+    /// </summary>
+    uint64_t MeshCacheOptionsHash() const
+    {
+        uint64_t hash = HashValue(MODEL_IMPORT_FLAGS, HASH_SEED);
+        hash = HashValue(sizeof(Vertex), hash);
+        hash = HashValue(MAXIMUM_BONES, hash);
+#ifdef COMPRESS_ANIMATIONS
+        hash = HashValue(animationCompression.positionError, hash);
+        hash = HashValue(animationCompression.angularError, hash);
+        hash = HashValue(animationCompression.scaleError, hash);
+#else
+        hash = HashValue(CONSTANT_CHANNEL_TOLERANCE, hash);
+#endif // COMPRESS_ANIMATIONS
+#ifdef OPTIMIZE_MESHES
+        hash = HashValue(MESH_OPTIMIZER_VERSION, hash);
+#endif // OPTIMIZE_MESHES
+#ifdef MESH_LODS
+        hash = HashValue(MESH_LOD_VERSION, hash);
+#endif // MESH_LODS
+#ifdef CLUSTER_CULLING
+        hash = HashValue(MESHLET_VERSION, hash);
+        hash = HashValue(MESHLET_MAX_VERTICES, hash);
+        hash = HashValue(MESHLET_MAX_TRIANGLES, hash);
+#endif // CLUSTER_CULLING
+
+        return hash;
+    }
+
+    /// <summary>
+    /// Loads a model from its mesh cache if it is up to date, otherwise imports it with Assimp and rewrites the cache
+    /// </summary>
+    /// <param name="file">: source model file</param>
+    /// <param name="model">: output model</param>
+    /// <param name="importer">: importer that keeps the scene alive, only used on a cache miss</param>
+    /// <returns>Whether the model came from the cache</returns>
+    bool LoadModelData(const char* file, Model& model, Assimp::Importer& importer)
     {
-        Model model;
+#ifdef USE_MESH_CACHE
+        const MeshCacheKey cacheKey = { HashFile(file), MeshCacheOptionsHash() };
+        const std::string cachePath = MeshCachePath(MESH_CACHE_FOLDER, file);
+        if (cacheKey.sourceHash != 0 && LoadMeshCache(cachePath, cacheKey, model))
+            return true;
+#endif // USE_MESH_CACHE
 
-        Assimp::Importer& importer = importers[emptyModelIndex];
         InitImporter(importer, file);
+        ParseScene(importer.GetScene(), model);
 
-        const aiScene* scene = importer.GetScene();
+#ifdef USE_MESH_CACHE
+        if (!WriteMeshCache(cachePath, cacheKey, model))
+            std::cerr << "failed to write mesh cache " << cachePath << "!" << std::endl;
+#endif // USE_MESH_CACHE
 
-        std::cout << "---------------------" << std::endl;
+        return false;
+    }
+
+    /// <summary>
+    /// Stores a loaded model in the slot of a destroyed model, or at emptyModelIndex, the end of models, and maps it to an animation player if it is animated.
+    /// Slots are reused, so models and the per-model arrays don't grow over a long streaming session
+    /// </summary>
+    /// <returns>Index of the model</returns>
+    uint32_t RegisterModel(Model& model, const uint32_t pipelineIndex)
+    {
+        model.pipelineIndex = pipelineIndex;
 
+        uint32_t modelIndex = emptyModelIndex;
+        if (!freeModelSlots.empty())
+        {
+            modelIndex = freeModelSlots.back();
+            freeModelSlots.pop_back();
+            models[modelIndex] = std::move(model);
+            gui.ResetModel(modelIndex);
+        }
+        else
+        {
+            models.push_back(std::move(model));
+            emptyModelIndex++;
+        }
+
+        // Map to Animation Player
+        if (!models[modelIndex].meshes[0].animations.empty())
+        {
+            animPlayers.resize(animPlayers.size() + 1);
+            //animPlayers.back().SetValues(0, &models.back(), models.size() - 1);
+            animPlayers.back().SetValues(0, &models[modelIndex], modelIndex);
+            sharedPoseKeys.resize(animPlayers.size());
+            poseLeaders.resize(animPlayers.size(), -1);
+        }
+
+        return modelIndex;
+    }
+
+    /// <summary>
+    /// Converts an imported scene to a model: vertices, indices and bones of each mesh, animations, skeleton and bounds
+    /// </summary>
+    void ParseScene(const aiScene* scene, Model& model)
+    {
         // Logging
 #ifdef MODEL_IMPORT_DEBUG
         std::cout << "Loading scene " << scene->mName.C_Str() << std::endl;
@@ -440,7 +756,6 @@ private:
 
         model.name = scene->mName.C_Str();
         model.meshes.resize(scene->mNumMeshes);
-        model.pipelineIndex = pipelineIndex;
 
         // Parse model
         for (size_t i = 0; i < scene->mNumMeshes; i++)
@@ -489,22 +804,60 @@ private:
             // Parse bones!
             ExtractBoneWeightForVertices(model.meshes[i].vertices, mesh, scene, model);
 
+#ifdef OPTIMIZE_MESHES
+            // After the bone weights, which are looked up by Assimp vertex id
+            if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+            {
+                const MeshOptimizationStats stats = OptimizeMesh(model.meshes[i].vertices, model.meshes[i].indices);
+#ifdef MODEL_IMPORT_DEBUG
+                std::cout << "Optimized mesh " << mesh->mName.C_Str() << ": ACMR " << stats.before.acmr << " -> " << stats.after.acmr
+                    << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << std::endl;
+#endif // MODEL_IMPORT_DEBUG
+            }
+#endif // OPTIMIZE_MESHES
+
             std::cout << "Loaded mesh " << mesh->mName.C_Str() << " Successfully with " << model.meshes[i].vertices.size() << " vertices, and " << model.meshes[i].indices.size() << " triangles!" << std::endl;
+
+#ifdef CLUSTER_CULLING
+            // Reorders the full mesh, so before its levels of detail are appended
+            if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+            {
+                BuildMeshlets(model.meshes[i].vertices, model.meshes[i].indices, model.meshes[i].meshlets);
+#ifdef MODEL_IMPORT_DEBUG
+                std::cout << "Clustered mesh " << mesh->mName.C_Str() << " into " << model.meshes[i].meshlets.size() << " meshlets" << std::endl;
+#endif // MODEL_IMPORT_DEBUG
+            }
+#endif // CLUSTER_CULLING
+
+#ifdef MESH_LODS
+            // After the optimization of the full mesh, whose vertex order the levels share
+            if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+            {
+                BuildMeshLods(model.meshes[i].vertices, model.meshes[i].indices, mesh->HasBones(), model.meshes[i].lods);
+#ifdef MODEL_IMPORT_DEBUG
+                std::cout << "Simplified mesh " << mesh->mName.C_Str() << " into " << model.meshes[i].lods.size() << " LODs:";
+                for (const MeshLod& lod : model.meshes[i].lods)
+                    std::cout << " " << lod.indexCount / 3 << " triangles (error " << lod.error << ")";
+                std::cout << std::endl;
+#endif // MODEL_IMPORT_DEBUG
+            }
+#endif // MESH_LODS
         }
 
         // Parse animations
         ParseAnimations(scene, model);
 
-        //models.push_back(model);
-        models[emptyModelIndex] = model;
-
-        // Map to Animation Player
-        if (!model.meshes[0].animations.empty())
+        // Flatten node hierarchy and resolve bones and tracks
+        Skeleton& skeleton = model.meshes[0].skeleton;
+        skeleton.Build(scene->mRootNode, model.meshes[0].boneMap);
+        for (AnimationClip& clip : model.meshes[0].animations)
         {
-            animPlayers.resize(animPlayers.size() + 1);
-            //animPlayers.back().SetValues(0, &models.back(), models.size() - 1);
-            animPlayers.back().SetValues(0, &models[emptyModelIndex], emptyModelIndex);
+            skeleton.ResolveClip(clip);
+            clip.BuildCubicTracks();
+            clip.ComputeContentHash();
         }
+        model.meshes[0].ComputeRigHash();
+        model.ComputeBounds();
     }
 
     void ExtractBoneWeightForVertices(std::vector<Vertex>& vertices, const aiMesh* mesh, const aiScene* scene, Model& model)
@@ -575,10 +928,12 @@ private:
             {
                 aiAnimation* current_animation = scene->mAnimations[i];
 
-                // TODO: Currently considers same size of all channels (realistic?)
                 // Parse channels
                 int max_frames = 0;
-                std::map<std::string, AnimationPose> poses;
+                std::vector<AnimationPose> poses;
+#ifdef COMPRESS_ANIMATIONS
+                CompressionStats clipStats;
+#endif // COMPRESS_ANIMATIONS
                 for (unsigned int j = 0; j < current_animation->mNumChannels; j++)
                 {
                     aiNodeAnim* current_channel = current_animation->mChannels[j];
@@ -593,36 +948,119 @@ private:
                     if (current_channel->mNumScalingKeys > max_frames)
                         max_frames = current_channel->mNumScalingKeys;
 
-                    // Parse SQTs of channel
-                    std::vector<SQT> sqts;
-                    for (unsigned int k = 0; k < current_channel->mNumPositionKeys; k++)
-                    {
-                        SQT new_sqt;
-                        new_sqt.time = current_channel->mScalingKeys[k].mTime / current_animation->mTicksPerSecond;
-                        new_sqt.scale = Assimp2GLMVEC3(current_channel->mScalingKeys[k].mValue);
-                        new_sqt.translation = Assimp2GLMVEC3(current_channel->mPositionKeys[k].mValue);
-                        new_sqt.rotation = Assimp2GLMQUAT(current_channel->mRotationKeys[k].mValue);
-
-                        sqts.push_back(new_sqt);
-                    }
-
+                    // Parse keys of channel. Scale, rotation and translation each have their own keyframe times
                     AnimationPose new_pose;
                     new_pose.bone_name = channel_bone_name;
-                    new_pose.bonePoses = sqts;
+                    new_pose.scales = ParseVectorKeys(current_channel->mScalingKeys, current_channel->mNumScalingKeys, current_animation->mTicksPerSecond);
+                    new_pose.rotations = ParseRotationKeys(current_channel->mRotationKeys, current_channel->mNumRotationKeys, current_animation->mTicksPerSecond);
+                    new_pose.translations = ParseVectorKeys(current_channel->mPositionKeys, current_channel->mNumPositionKeys, current_animation->mTicksPerSecond);
+#ifdef COMPRESS_ANIMATIONS
+                    new_pose.compressed = CompressTrack(new_pose, animationCompression, &clipStats);
+                    new_pose.scales = KeyChannel<glm::vec3>();
+                    new_pose.rotations = KeyChannel<glm::quat>();
+                    new_pose.translations = KeyChannel<glm::vec3>();
+#else
+                    new_pose.CollapseConstantChannels();
+#endif // COMPRESS_ANIMATIONS
+                    new_pose.trackIndex = j;
 
-                    // Add AnimationPose to map
-                    poses.insert({ channel_bone_name, new_pose });
+                    // Add AnimationPose to clip tracks
+                    poses.push_back(new_pose);
                 }
 
                 AnimationClip new_animation_clip = AnimationClip(std::string(current_animation->mName.data), model.meshes[0].bones.size(),
                     max_frames, current_animation->mDuration / current_animation->mTicksPerSecond, current_animation->mTicksPerSecond, poses);
                 model.meshes[0].animations.push_back(new_animation_clip);
+
+#ifdef COMPRESS_ANIMATIONS
+                std::cout << "Compressed animation " << current_animation->mName.data << ": "
+                    << clipStats.keptKeys << "/" << clipStats.rawKeys << " keys, "
+                    << clipStats.rawBytes / 1024.0 << " KiB -> " << clipStats.compressedBytes / 1024.0 << " KiB ("
+                    << (clipStats.compressedBytes ? static_cast<double>(clipStats.rawBytes) / clipStats.compressedBytes : 0.0) << "x), max error "
+                    << clipStats.maxPositionError << " units, " << glm::degrees(clipStats.maxAngularError) << " deg, "
+                    << clipStats.maxScaleError << " scale" << std::endl;
+#endif // COMPRESS_ANIMATIONS
             }
         }
         else
             std::cout << "No animations found!" << std::endl;
     }
 
+#if defined(ANIMATION_BENCHMARK) && defined(COMPRESS_ANIMATIONS)
+    /// <summary>
+    /// Compresses the animations of every FBX file in the models folder, reporting memory and error per clip
+    /// </summary>
+    void ReportAnimationCompression()
+    {
+        for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(MODELS_FOLDER))
+        {
+            if (entry.path().extension() != ".fbx")
+                continue;
+
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(entry.path().string(), 0);
+            if (nullptr == scene || !scene->HasAnimations())
+                continue;
+
+            std::cout << "Animation compression for " << entry.path().filename().string() << ":" << std::endl;
+
+            // Only the clips are parsed
+            Model model;
+            model.meshes.resize(1);
+            ParseAnimations(scene, model);
+        }
+    }
+#endif // ANIMATION_BENCHMARK && COMPRESS_ANIMATIONS
+
+#if defined(MESH_CACHE_BENCHMARK) && defined(USE_MESH_CACHE)
+    /// <summary>
+    /// Loads every FBX and OBJ file in the models folder cold, with Assimp, and warm, from a freshly written mesh cache, reporting both times
+    /// </summary>
+    void ReportMeshCacheLoadTimes()
+    {
+        std::cout << "Mesh cache load times:" << std::endl;
+        for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(MODELS_FOLDER))
+        {
+            if (entry.path().extension() != ".fbx" && entry.path().extension() != ".obj")
+                continue;
+
+            const std::string file = entry.path().string();
+
+            // Cold: what a first launch does, without writing the cache
+            Model coldModel;
+            auto start = std::chrono::high_resolution_clock::now();
+            {
+                Assimp::Importer importer;
+                const aiScene* scene = importer.ReadFile(file, MODEL_IMPORT_FLAGS);
+                if (nullptr == scene || !scene->HasMeshes())
+                    continue;
+
+                ParseScene(scene, coldModel);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            const double coldMs = std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+
+            const MeshCacheKey cacheKey = { HashFile(file), MeshCacheOptionsHash() };
+            const std::string cachePath = MeshCachePath(MESH_CACHE_FOLDER, file);
+            if (!WriteMeshCache(cachePath, cacheKey, coldModel))
+                continue;
+
+            // Warm: hashing the source and loading the cache
+            Model warmModel;
+            start = std::chrono::high_resolution_clock::now();
+            const bool loaded = LoadMeshCache(cachePath, { HashFile(file), MeshCacheOptionsHash() }, warmModel);
+            end = std::chrono::high_resolution_clock::now();
+            const double warmMs = std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+
+            std::cout << "  " << entry.path().filename().string() << ": cold " << coldMs << " ms, warm "
+                << (loaded ? std::to_string(warmMs) + " ms" : std::string("failed"))
+                << " (" << (loaded && warmMs > 0.0 ? coldMs / warmMs : 0.0) << "x, "
+                << std::filesystem::file_size(entry.path()) / (1024.0 * 1024.0) << " MiB source, "
+                << std::filesystem::file_size(cachePath) / (1024.0 * 1024.0) << " MiB cache)" << std::endl;
+        }
+    }
+#endif // MESH_CACHE_BENCHMARK && USE_MESH_CACHE
+
     void InitGUI()
     {
         // Setup Dear ImGui context
@@ -704,2303 +1142,4857 @@ private:
         app->framebufferResized = true;
     }
 
-    void LoadTexture(const uint32_t modelIndex, const char* file = TEXTURE_PATH.c_str(), bool isNormal = false)
+    void LoadTexture(const uint32_t modelIndex, const DecodedImage& image, bool isNormal = false)
     {
-        CreateTextureImage(modelIndex, file, isNormal);
+        CreateTextureImage(modelIndex, image, isNormal);
         CreateTextureImageView(modelIndex, isNormal);
         CreateTextureSampler(modelIndex, isNormal);
     }
 
     void AddModel(const uint32_t pipelineIndex = 0, bool passLightingData = false, const char* modelFile = MODEL_PATH.c_str(), const char* diffuseTextureFile = TEXTURE_PATH.c_str(), const char* normalTextureFile = NORMAL_PATH.c_str())
     {
-        if (emptyModelIndex == models.size() - 1)
-            throw std::runtime_error("Too many models! Increase vector size!");
+        AddModels({ { pipelineIndex, passLightingData, modelFile, diffuseTextureFile, normalTextureFile } });
+    }
+
+    /// <summary>
+    /// Runs one CPU stage of a model import: 0 loads the model, 1 decodes the diffuse texture and 2 the normal texture.
+    /// Safe to call from several threads at once, for different stages or models
+    /// </summary>
+    void RunImportStage(const ModelRequest& request, ImportedModel& imported, const size_t stage)
+    {
+        auto stageStart = std::chrono::high_resolution_clock::now();
+        double* stageMs = nullptr;
+        switch (stage)
+        {
+        case 0:
+            imported.cached = LoadModelData(request.modelFile.c_str(), imported.model, *imported.importer);
+            stageMs = &imported.modelMs;
+            break;
+        case 1:
+            imported.diffuse = DecodeImage(request.diffuseTextureFile);
+            stageMs = &imported.diffuseMs;
+            break;
+        default:
+            imported.normal = DecodeImage(request.normalTextureFile);
+            stageMs = &imported.normalMs;
+            break;
+        }
+        auto stageEnd = std::chrono::high_resolution_clock::now();
+        *stageMs = std::chrono::duration<double, std::chrono::milliseconds::period>(stageEnd - stageStart).count();
+    }
+
+    /// <summary>
+    /// Loads several models at once. The CPU stages, i.e. loading each model and decoding each texture, run concurrently on the worker pool,
+    /// so they take about as long as the slowest asset. The results are then uploaded in request order, so model indices follow the requests
+    /// </summary>
+    void AddModels(const std::vector<ModelRequest>& requests)
+    {
+        std::vector<ImportedModel> imports(requests.size());
+
+        // One job per model and per texture. Model jobs come first, as they usually take longest.
+        // The animation pool has no other work while models are added
+        auto start = std::chrono::high_resolution_clock::now();
+        animationPool.ParallelFor(3 * requests.size(), [&](const size_t job)
+            {
+                const size_t i = job % requests.size();
+                RunImportStage(requests[i], imports[i], job / requests.size());
+            });
+        auto end = std::chrono::high_resolution_clock::now();
+        const double cpuMs = std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+
+        // GPU upload
+        start = end;
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            auto uploadStart = std::chrono::high_resolution_clock::now();
+            UploadModel(requests[i], imports[i]);
+            auto uploadEnd = std::chrono::high_resolution_clock::now();
+            imports[i].uploadMs = std::chrono::duration<double, std::chrono::milliseconds::period>(uploadEnd - uploadStart).count();
+        }
+        end = std::chrono::high_resolution_clock::now();
+        const double uploadMs = std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+
+        std::cout << "---------------------" << std::endl;
+        std::cout << "Added " << requests.size() << " model(s) on " << animationPool.GetThreadCount() + 1 << " threads:" << std::endl;
+        double serialMs = 0.0;
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            const ImportedModel& imported = imports[i];
+            serialMs += imported.modelMs + imported.diffuseMs + imported.normalMs;
+
+            std::cout << "  " << requests[i].modelFile << ": " << (imported.cached ? "cache " : "Assimp ") << imported.modelMs << " ms, diffuse "
+                << imported.diffuseMs << " ms, normal " << imported.normalMs << " ms, upload " << imported.uploadMs << " ms" << std::endl;
+        }
+        std::cout << "CPU stages " << cpuMs << " ms (" << serialMs << " ms of work), GPU upload " << uploadMs << " ms" << std::endl;
+    }
+
+    /// <summary>
+    /// Uploads an imported model and its textures, and creates its buffers and descriptors in the slot RegisterModel picks.
+    /// The model is resident right away, unless its commands are recorded into a streamed upload
+    /// </summary>
+    /// <returns>Index of the model</returns>
+    uint32_t UploadModel(const ModelRequest& request, ImportedModel& imported)
+    {
+        const bool passLightingData = request.passLightingData;
 
-        ImportModel(pipelineIndex, modelFile);
-        LoadTexture(emptyModelIndex, diffuseTextureFile);
-        LoadTexture(emptyModelIndex, normalTextureFile, true);
-        CreateVertexBuffer(emptyModelIndex);
-        CreateIndexBuffer(emptyModelIndex);
-        CreateUniformBuffers(emptyModelIndex);
+        const uint32_t modelIndex = RegisterModel(imported.model, request.pipelineIndex);
+        if (modelIndex < importers.size())
+            importers[modelIndex] = std::move(imported.importer);
+        else
+            importers.push_back(std::move(imported.importer));
+        LoadTexture(modelIndex, imported.diffuse);
+        LoadTexture(modelIndex, imported.normal, true);
+        CreateVertexBuffer(modelIndex);
+        CreateIndexBuffer(modelIndex);
+        CreateUniformBuffers(modelIndex);
+#ifdef COMPUTE_SKINNING
+        if (!models[modelIndex].meshes[0].animations.empty())
+            CreateSkinnedVertexBuffers(modelIndex);
+#endif // COMPUTE_SKINNING
         if (passLightingData)
         {
             if (lightingUniformBuffers.empty())
-                CreateLightingUniformBuffers(emptyModelIndex);
-            CreateLightingDataDescriptorPool(emptyModelIndex);
+                CreateLightingUniformBuffers(modelIndex);
+            CreateLightingDataDescriptorPool(modelIndex);
         }
         else
-            CreateDescriptorPool(emptyModelIndex);
+            CreateDescriptorPool(modelIndex);
 
-        if (models[emptyModelIndex].meshes[0].animations.empty())
-            CreateWireframeGraphicsPipeline("shaders/vert.spv", "shaders/frag.spv", passLightingData);
+        if (models[modelIndex].meshes[0].animations.empty())
+            models[modelIndex].wireframeIndex = GetWireframePipeline(passLightingData);
 
-        CreateDescriptorSets(emptyModelIndex, passLightingData);
-        CreateNormalsGraphicsPipeline(passLightingData);
+        CreateDescriptorSets(modelIndex, passLightingData);
+        models[modelIndex].normalIndex = GetNormalsPipeline(passLightingData);
+#ifdef DEPTH_PREPASS
+        models[modelIndex].depthIndex = GetDepthPipeline(passLightingData, !models[modelIndex].meshes[0].animations.empty());
+#endif // DEPTH_PREPASS
+        models[modelIndex].resident = (recordingUpload == nullptr);
 
-        emptyModelIndex++;
-    }
+        SyncGUI();
 
-    void AddSkybox(const char* folder = SKYBOX_PATH.c_str())
-    {
-        LoadCubemap(folder);
-        CreateSkyboxVertexBuffer();
-        CreateSkyboxUniformBuffer();
-        CreateSkyboxDescriptorPool();
-        CreateSkyboxDescriptorSet();
+        return modelIndex;
     }
 
-    void AddGrid()
+    /// <summary>
+    /// Requests a model while rendering continues. It is imported on a background thread, its upload is recorded once the import is done,
+    /// and it is drawn once the upload completes. Import failures are reported and drop the request
+    /// </summary>
+    /// <param name="request">: model to load</param>
+    /// <param name="pickPipeline">: choose the lit static or skinned pipeline once it is known whether the model is animated, ignoring request.pipelineIndex</param>
+    void RequestModel(const ModelRequest& request, bool pickPipeline = false)
     {
-        CreateGridVertexBuffer();
-        CreateGridIndexBuffer();
-        CreateGridUniformBuffer();
-        CreateGridDescriptorPool();
-        CreateGridDescriptorSet();
-    }
+        PendingModel pending;
+        pending.request = request;
+        pending.pickPipeline = pickPipeline;
+        pending.result = std::async(std::launch::async, [this, request]()
+            {
+                ImportedModel imported;
+                for (size_t stage = 0; stage < 3; stage++)
+                    RunImportStage(request, imported, stage);
 
-    void InitVulkan()
-    {
-        CreateInstance();
-        SetupDebugMessenger();
-        CreateSurface();
-        PickPhysicalDevice();
-        CreateLogicalDevice();
-        CreateSwapChain();
-        CreateImageViews();
-        CreateRenderPass();
-        CreateImGuiRenderPass();
-        CreateDescriptorSetLayout();
-        CreateLightingDataDescriptorSetLayout();
-        CreateGridDescriptorSetLayout();
-        CreateGraphicsPipeline();
-        CreateGraphicsPipeline("shaders/linear_skinning_vert.spv", "shaders/linear_skinning_frag.spv", true);
-        CreateGraphicsPipeline("shaders/blinn_phong_vert.spv", "shaders/blinn_phong_frag.spv", true);
-        CreateSkyboxGraphicsPipeline("shaders/skybox_vert.spv", "shaders/skybox_frag.spv");
-        CreateSkyboxWireframeGraphicsPipeline();
-        CreateGridGraphicsPipeline();
-        CreateCommandPools();
-        CreateColorResources();
-        CreateDepthResources();
-        CreateFramebuffers();
-#ifdef USE_ASSIMP
-        CreateTestImage();
-        AddModel(2, true);
-        AddModel(2, true, "models/suzanne.obj", "textures/marble.png", "textures/marble_normal.png");
-        AddModel(2, true, "models/wicker_basket_02_2k.fbx", "models/textures/wicker_basket_02_diff_2k.jpg", "models/textures/wicker_basket_02_nor_dx_2k.png");
-        //AddModel(1, true, "models/flair_edited.fbx", "textures/body_diffuse.png", "textures/body_normal.png");
-        AddModel(1, true, "models/Capoeira_working.fbx", "textures/brick.png", "textures/brick_normal.png");
-        AddModel(1, true, "models/Dancing Twerk_working.fbx", "textures/brick.png", "textures/brick_normal.png");
-        AddModel(1, true, "models/Hokey Pokey_working.fbx", "textures/brick.png", "textures/brick_normal.png");
+                return imported;
+            });
 
-        //AddModel(1, true, "models/ymca.fbx", "textures/parasiteZombie_body_diffuse.png", "textures/parasiteZombie_body_normal.bmp");
-        //AddModel(1, true, "models/wiggly.fbx", "textures/plaster.jpg", "textures/plaster_normal.png");
-        // AddModel(1, false, "models/boy_animated.fbx", "textures/plaster.jpg", "textures/plaster_normal.png");
-        //AddModel(1, "models/bob_lamp.fbx", "textures/plaster.jpg");
-        //AddModel(1, "models/deer.fbx", "textures/plaster.jpg");
-        //AddModel(1, "models/female_doctor.fbx", "textures/plaster.jpg");
-#else
-        LoadModel();
-        CreateTextureImage();
-        CreateTextureImageView();
-        CreateTextureSampler();
-        CreateVertexBuffer();
-        CreateIndexBuffer();
-        CreateUniformBuffers();
-        CreateDescriptorPool();
-        CreateDescriptorSets();
-#endif // USE_ASSIMP
-        CreateAnimatedWireframeGraphicsPipeline("shaders/linear_skinning_vert.spv", "shaders/linear_skinning_frag.spv", true);
-        CreateAnimatedNormalGraphicsPipeline();
-        gui.nModels = emptyModelIndex;
-        gui.models = models.data();
-        gui.animationPlayers = animPlayers.data();
-        gui.nAnimationPlayers = animPlayers.size();
-        gui.Setup();
-        //AddSkybox();
-        AddSkybox("textures/Yokohama3/");
-        AddGrid();
-        CreateNormalDescriptorPool();
-        CreateNormalDescriptorSet();
-        CreateCommandBuffers();
-        CreateSyncObjects();
+        pendingModels.push_back(std::move(pending));
     }
 
-    void MainLoop()
+    /// <summary>
+    /// Removes a model. It stops being drawn and animated right away, and its resources are destroyed once no frame in flight references them
+    /// </summary>
+    void RemoveModel(const uint32_t modelIndex)
     {
-        while (!glfwWindowShouldClose(window))
-        {
-            timer.Tick();
-
-            glfwPollEvents();
+        if (modelIndex >= emptyModelIndex || !models[modelIndex].resident)
+            return;
 
-            gui.Render();
+#ifdef BAKED_CROWD
+        if (modelIndex == crowdModelIndex && crowd.Size() > 0)
+        {
+            std::cerr << "can't remove model " << modelIndex << ", the crowd is drawn from it!" << std::endl;
+            return;
+        }
+#endif // BAKED_CROWD
 
-            cam.UpdateVelocity(timer.GetData().DeltaTime);
-            cam.MoveCamera(timer.GetData().DeltaTime);
+        models[modelIndex].resident = false;
 
-            DrawFrame();
-        }
+        animPlayers.erase(std::remove_if(animPlayers.begin(), animPlayers.end(),
+            [modelIndex](const AnimationPlayer& animPlayer) { return animPlayer.modelIndex == modelIndex; }), animPlayers.end());
+        sharedPoseKeys.resize(animPlayers.size());
+        poseLeaders.resize(animPlayers.size(), -1);
+        SyncGUI();
 
-        // Wait for device to finish operations before exiting
-        vkDeviceWaitIdle(device);
+        retiredModels.push_back({ modelIndex, frameCount });
     }
 
-    void DrawFrame()
+    /// <summary>
+    /// Advances streamed models: records the uploads of finished imports, makes models whose upload completed resident,
+    /// and destroys removed models that no frame in flight can reference anymore. Must run after the frame's fence has been waited on.
+    /// Never waits on the GPU
+    /// </summary>
+    void UpdateModelStreaming()
     {
-        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-
-        uint32_t imageIndex;
-        VkResult image_result = vkAcquireNextImageKHR(device, sc.swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        if (gui.load_model_flag)
+        {
+            gui.load_model_flag = false;
+            RequestModel({ 2, true, gui.stream_model_file, gui.stream_diffuse_file, gui.stream_normal_file }, true);
+        }
 
-        // Check whether swap chain recreation is required
-        if (image_result == VK_ERROR_OUT_OF_DATE_KHR || image_result == VK_SUBOPTIMAL_KHR || framebufferResized)
+        if (gui.remove_model_index >= 0)
         {
-            framebufferResized = false;
-            RecreateSwapChain();
-            return;
+            RemoveModel(static_cast<uint32_t>(gui.remove_model_index));
+            gui.remove_model_index = -1;
         }
-        else if (image_result != VK_SUCCESS)
-            throw std::runtime_error("failed to present swap chain image!");
 
-        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+        // Finished imports
+        uint32_t uploadsStarted = 0;
+        for (auto it = pendingModels.begin(); it != pendingModels.end() && uploadsStarted < MAX_MODEL_UPLOADS_PER_FRAME;)
+        {
+            if (it->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                ++it;
+                continue;
+            }
 
-        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
-        RecordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+            ImportedModel imported;
+            bool importFailed = false;
+            try
+            {
+                imported = it->result.get();
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "failed to stream model " << it->request.modelFile << ": " << e.what() << std::endl;
+                importFailed = true;
+            }
 
-        // Update model uniform buffers
-        //for (size_t i = 0; i < models.size(); i++)
-        for (size_t i = 0; i < emptyModelIndex; i++)
-        {
-            UpdateUniformBuffer(i, currentFrame);
+            if (!importFailed)
+            {
+                ModelRequest request = it->request;
+                if (it->pickPipeline)
+                    request.pipelineIndex = imported.model.meshes[0].animations.empty() ? 2 : 1;
 
-            // Update lighting data UBO
-            if (models[i].pipelineIndex == 2)
-                UpdateLightingDataUniformBuffer(i, currentFrame);
+                StartModelUpload(request, imported);
+                uploadsStarted++;
+            }
+
+            it = pendingModels.erase(it);
         }
 
-        // Update skybox uniform buffer
-        UpdateSkyboxUniformBuffer(currentFrame);
+        // Completed uploads
+        for (auto it = modelUploads.begin(); it != modelUploads.end();)
+        {
+            if (vkGetFenceStatus(device, it->fence) != VK_SUCCESS)
+            {
+                ++it;
+                continue;
+            }
 
-        // Update grid uniform buffer
-        UpdateGridUniformBuffer(currentFrame);
+            FinishModelUpload(*it);
+            it = modelUploads.erase(it);
+        }
 
-        // Submit command buffer
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        // The last frame that drew a removed model was recorded before it was removed. Frames up to frameCount - MAX_FRAMES_IN_FLIGHT have completed
+        for (auto it = retiredModels.begin(); it != retiredModels.end();)
+        {
+            if (frameCount < it->frame + MAX_FRAMES_IN_FLIGHT)
+            {
+                ++it;
+                continue;
+            }
 
-        VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame]};
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
-        VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
-
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
-            throw std::runtime_error("failed to submit draw command buffer!");
-
-        // UI render command buffer
-        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-        vkResetFences(device, 1, &inFlightFences[currentFrame]);
-        VkSemaphore uiWaitSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-        submitInfo.pWaitSemaphores = uiWaitSemaphores;
-        VkSemaphore uiSignalSemaphores[] = { uiRenderFinishedSemaphores[currentFrame] };
-        submitInfo.pSignalSemaphores = uiSignalSemaphores;
+            DestroyModelResources(it->modelIndex);
+            it = retiredModels.erase(it);
+        }
 
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = 0; // Optional
-        beginInfo.pInheritanceInfo = nullptr; // Optional
+        // Compaction copies that completed
+        for (auto it = geometryCompactions.begin(); it != geometryCompactions.end();)
+        {
+            if (vkGetFenceStatus(device, it->fence) != VK_SUCCESS)
+            {
+                ++it;
+                continue;
+            }
 
-        if (vkBeginCommandBuffer(commandBuffers[currentFrame], &beginInfo) != VK_SUCCESS)
-            throw std::runtime_error("failed to begin recording command buffer!");
+            vkFreeCommandBuffers(device, commandPool, 1, &it->commandBuffer);
+            vkDestroyFence(device, it->fence, nullptr);
+            it = geometryCompactions.erase(it);
+        }
 
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = imguiRenderPass;
-        //renderPassInfo.renderPass = renderPass;
-        //renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
-        renderPassInfo.framebuffer = imguiFramebuffers[imageIndex];
-        renderPassInfo.renderArea.offset = { 0, 0 };
-        renderPassInfo.renderArea.extent = sc.extent;
+        // Block buffers replaced by compaction, the same way as removed models. The copies reading them were submitted before those frames
+        for (auto it = retiredGeometryBuffers.begin(); it != retiredGeometryBuffers.end();)
+        {
+            if (frameCount < it->frame + MAX_FRAMES_IN_FLIGHT)
+            {
+                ++it;
+                continue;
+            }
 
-        // Testing
-        /*VkImageBlit region{};
+            vkDestroyBuffer(device, it->buffer, nullptr);
+            vkFreeMemory(device, it->memory, nullptr);
+            it = retiredGeometryBuffers.erase(it);
+        }
 
-        region.srcOffsets[0].x = 0;
-        region.srcOffsets[0].y = 0;
-        region.srcOffsets[0].z = 0;
-        region.dstOffsets[0].x = 0;
-        region.dstOffsets[0].y = 0;
-        region.dstOffsets[0].z = 0;
-        region.srcOffsets[1].x = sc.extent.width;
-        region.srcOffsets[1].y = sc.extent.height;
-        region.srcOffsets[1].z = 1;
-        region.dstOffsets[1].x = sc.extent.width;
-        region.dstOffsets[1].y = sc.extent.height;
-        region.dstOffsets[1].z = 1;
-        region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.srcSubresource.mipLevel = 0;
-        region.dstSubresource.mipLevel = 0;
-        region.srcSubresource.baseArrayLayer = 0;
-        region.dstSubresource.baseArrayLayer = 0;
-        region.srcSubresource.layerCount = 1;
-        region.dstSubresource.layerCount = 1;
+        if (gui.compact_geometry_flag && recordingUpload == nullptr && modelUploads.empty())
+        {
+            CompactGeometry();
+            gui.compact_geometry_flag = false;
+        }
+        UpdateGeometryStats();
 
-        TransitionImageLayoutCmd(sc.images[currentFrame], 1, sc.format, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            VK_IMAGE_ASPECT_COLOR_BIT, commandBuffers[currentFrame], 1);
+        gui.streaming_models = static_cast<uint32_t>(pendingModels.size() + modelUploads.size());
+    }
 
-        TransitionImageLayoutCmd(textureImages[1], 1, sc.format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            VK_IMAGE_ASPECT_COLOR_BIT, commandBuffers[currentFrame], 1);
+    /// <summary>
+    /// Records the upload of an imported model into its own command buffer and submits it with a fence, without waiting for it
+    /// </summary>
+    void StartModelUpload(const ModelRequest& request, ImportedModel& imported)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
 
-        vkCmdBlitImage(commandBuffers[currentFrame], sc.images[currentFrame], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-            textureImages[1], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+        ModelUpload upload;
 
-        TransitionImageLayoutCmd(sc.images[currentFrame], 1, sc.format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-            VK_IMAGE_ASPECT_COLOR_BIT, commandBuffers[currentFrame], 1);
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
 
-        TransitionImageLayoutCmd(textureImages[1], 1, sc.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            VK_IMAGE_ASPECT_COLOR_BIT, commandBuffers[currentFrame], 1);*/
+        if (vkAllocateCommandBuffers(device, &allocInfo, &upload.commandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate model upload command buffer!");
 
-        // Begin UI render pass
-        vkCmdBeginRenderPass(commandBuffers[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(upload.commandBuffer, &beginInfo);
 
-        VkBuffer vertexBuffersRend[] = { gridVertexBuffer };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffers[currentFrame], 0, 1, vertexBuffersRend, offsets);
-        vkCmdBindIndexBuffer(commandBuffers[currentFrame], gridIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+        recordingUpload = &upload;
+        upload.modelIndex = UploadModel(request, imported);
+        recordingUpload = nullptr;
 
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(sc.extent.width);
-        viewport.height = static_cast<float>(sc.extent.height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffers[currentFrame], 0, 1, &viewport);
+        // Copies must land before the frames that draw the model read them
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
 
-        VkRect2D scissor{};
-        scissor.offset = { 0, 0 };
-        scissor.extent = sc.extent;
-        vkCmdSetScissor(commandBuffers[currentFrame], 0, 1, &scissor);
+        vkCmdPipelineBarrier(upload.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
 
-        vkCmdBindPipeline(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, uiPipeline);
-        vkCmdBindDescriptorSets(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, uiPipelineLayout, 0, 1, imguiDescriptorSet.data(), 0, nullptr);
+        vkEndCommandBuffer(upload.commandBuffer);
 
-        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffers[currentFrame]);
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device, &fenceInfo, nullptr, &upload.fence) != VK_SUCCESS)
+            throw std::runtime_error("failed to create model upload fence!");
 
-        vkCmdEndRenderPass(commandBuffers[currentFrame]);
-        if (vkEndCommandBuffer(commandBuffers[currentFrame]) != VK_SUCCESS)
-            throw std::runtime_error("failed to render ui!");
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &upload.commandBuffer;
 
-        vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]);
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, upload.fence) != VK_SUCCESS)
+            throw std::runtime_error("failed to submit model upload!");
 
-        // Presentation
-        VkPresentInfoKHR presentInfo{};
-        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Streaming " << request.modelFile << " as model " << upload.modelIndex << ": " << (imported.cached ? "cache " : "Assimp ")
+            << imported.modelMs << " ms, diffuse " << imported.diffuseMs << " ms, normal " << imported.normalMs << " ms, upload recorded in "
+            << std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count() << " ms" << std::endl;
 
-        presentInfo.waitSemaphoreCount = 1;
-        //presentInfo.pWaitSemaphores = signalSemaphores;
-        presentInfo.pWaitSemaphores = uiSignalSemaphores;
-        VkSwapchainKHR swapChains[] = { sc.swapChain };
-        presentInfo.swapchainCount = 1;
-        presentInfo.pSwapchains = swapChains;
-        presentInfo.pImageIndices = &imageIndex;
-        presentInfo.pResults = nullptr; // Optional
+        modelUploads.push_back(std::move(upload));
+    }
 
-        // Check whether swap chain recreation is required
-        if (image_result == VK_ERROR_OUT_OF_DATE_KHR || image_result == VK_SUBOPTIMAL_KHR || framebufferResized)
+    /// <summary>
+    /// Frees what a completed upload used and makes its model resident
+    /// </summary>
+    void FinishModelUpload(ModelUpload& upload)
+    {
+        for (size_t i = 0; i < upload.stagingBuffers.size(); i++)
         {
-            framebufferResized = false;
-            RecreateSwapChain();
-            return;
+            vkDestroyBuffer(device, upload.stagingBuffers[i], nullptr);
+            vkFreeMemory(device, upload.stagingMemories[i], nullptr);
         }
-        else if (image_result != VK_SUCCESS)
-            throw std::runtime_error("failed to present swap chain image!");
 
-        vkQueuePresentKHR(presentQueue, &presentInfo);
+        vkFreeCommandBuffers(device, commandPool, 1, &upload.commandBuffer);
+        vkDestroyFence(device, upload.fence, nullptr);
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        models[upload.modelIndex].resident = true;
     }
 
-    void Cleanup()
+    /// <summary>
+    /// Destroys the buffers, images and descriptors of a removed model and frees its CPU data. The slot stays empty until a new model reuses it, so other model indices don't change.
+    /// Handles are reset, so Cleanup can destroy every slot alike
+    /// </summary>
+    void DestroyModelResources(const uint32_t modelIndex)
     {
-        // Clean up GUI
-        ImGui_ImplVulkan_Shutdown();
-        ImGui_ImplGlfw_Shutdown();
-        ImGui::DestroyContext();
-
-        if (enableValidationLayers)
-            DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
-
-        vkDestroyCommandPool(device, commandPool, nullptr);
-        vkDestroyCommandPool(device, transCommandPool, nullptr);
-        vkDestroyCommandPool(device, imguiCommandPool, nullptr);
-
-        for (size_t i = 0; i < graphicsPipelines.size(); i++)
-            vkDestroyPipeline(device, graphicsPipelines[i], nullptr);
-
-        for (size_t i = 0; i < pipelineLayouts.size(); i++)
-            vkDestroyPipelineLayout(device, pipelineLayouts[i], nullptr);
-
-        for (size_t i = 0; i < wireframeGraphicsPipelines.size(); i++)
-            vkDestroyPipeline(device, wireframeGraphicsPipelines[i], nullptr);
-        for (size_t i = 0; i < wireframePipelineLayouts.size(); i++)
-            vkDestroyPipelineLayout(device, wireframePipelineLayouts[i], nullptr);
-
-        vkDestroyPipeline(device, skyboxGraphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(device, skyboxPipelineLayout, nullptr);
-        vkDestroyPipeline(device, skyboxWireframeGraphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(device, skyboxWireframePipelineLayout, nullptr);
-        vkDestroyPipeline(device, animatedWireframeGraphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(device, animatedWireframePipelineLayout, nullptr);
-        vkDestroyPipeline(device, gridGraphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(device, gridPipelineLayout, nullptr);
-        vkDestroyPipeline(device, animatedNormalGraphicsPipeline, nullptr);
-        vkDestroyPipelineLayout(device, animatedNormalPipelineLayout, nullptr);
-        vkDestroyPipelineLayout(device, uiPipelineLayout, nullptr);
-        vkDestroyPipeline(device, uiPipeline, nullptr);
+        for (Mesh& mesh : models[modelIndex].meshes)
+        {
+            FreeGeometry(mesh.geometry);
+            mesh.geometry = GeometryAllocation();
 
-        for (size_t i = 0; i < normalGraphicsPipelines.size(); i++)
-            vkDestroyPipeline(device, normalGraphicsPipelines[i], nullptr);
+#ifdef COMPUTE_SKINNING
+            if (mesh.skinnedBufferIndex >= 0)
+            {
+                for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+                {
+                    vkDestroyBuffer(device, skinnedVertexBuffers[mesh.skinnedBufferIndex][i], nullptr);
+                    vkFreeMemory(device, skinnedVertexBufferMemories[mesh.skinnedBufferIndex][i], nullptr);
+                    skinnedVertexBuffers[mesh.skinnedBufferIndex][i] = VK_NULL_HANDLE;
+                    skinnedVertexBufferMemories[mesh.skinnedBufferIndex][i] = VK_NULL_HANDLE;
+                }
 
-        for (size_t i = 0; i < normalPipelineLayouts.size(); i++)
-            vkDestroyPipelineLayout(device, normalPipelineLayouts[i], nullptr);
+                vkFreeDescriptorSets(device, skinningDescriptorPool, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT), skinningDescriptorSets[mesh.skinnedBufferIndex].data());
+                skinningDescriptorSets[mesh.skinnedBufferIndex].clear();
+                freeSkinnedBufferSlots.push_back(mesh.skinnedBufferIndex);
+            }
+#endif // COMPUTE_SKINNING
+        }
 
-        vkDestroyRenderPass(device, renderPass, nullptr);
-        vkDestroyRenderPass(device, imguiRenderPass, nullptr);
+        vkDestroyImageView(device, textureImageViews[modelIndex], nullptr);
+        vkDestroySampler(device, textureSamplers[modelIndex], nullptr);
+        vkDestroyImage(device, textureImages[modelIndex], nullptr);
+        vkFreeMemory(device, textureImageMemories[modelIndex], nullptr);
+        textureImageViews[modelIndex] = VK_NULL_HANDLE;
+        textureSamplers[modelIndex] = VK_NULL_HANDLE;
+        textureImages[modelIndex] = VK_NULL_HANDLE;
+        textureImageMemories[modelIndex] = VK_NULL_HANDLE;
+
+        vkDestroyImageView(device, normalImageViews[modelIndex], nullptr);
+        vkDestroySampler(device, normalSamplers[modelIndex], nullptr);
+        vkDestroyImage(device, normalImages[modelIndex], nullptr);
+        vkFreeMemory(device, normalImageMemories[modelIndex], nullptr);
+        normalImageViews[modelIndex] = VK_NULL_HANDLE;
+        normalSamplers[modelIndex] = VK_NULL_HANDLE;
+        normalImages[modelIndex] = VK_NULL_HANDLE;
+        normalImageMemories[modelIndex] = VK_NULL_HANDLE;
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
-            vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-            vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-            vkDestroySemaphore(device, uiRenderFinishedSemaphores[i], nullptr);
-            vkDestroyFence(device, inFlightFences[i], nullptr);
+            vkDestroyBuffer(device, uniformBuffers[modelIndex][i], nullptr);
+            vkFreeMemory(device, uniformBuffersMemory[modelIndex][i], nullptr);
+            uniformBuffers[modelIndex][i] = VK_NULL_HANDLE;
+            uniformBuffersMemory[modelIndex][i] = VK_NULL_HANDLE;
+            uniformBuffersMapped[modelIndex][i] = nullptr;
         }
 
-        CleanupSwapChain();
+        // Frees the descriptor sets as well
+        vkDestroyDescriptorPool(device, descriptorPools[modelIndex], nullptr);
+        descriptorPools[modelIndex] = VK_NULL_HANDLE;
+        descriptorSets[modelIndex].clear();
 
-        for (size_t i = 0; i < uniformBuffers.size(); i++)
-        {
-            for (size_t j = 0; j < MAX_FRAMES_IN_FLIGHT; j++)
-            {
-                vkDestroyBuffer(device, uniformBuffers[i][j], nullptr);
-                vkFreeMemory(device, uniformBuffersMemory[i][j], nullptr);
-            }
-        }
+        importers[modelIndex].reset();
+        models[modelIndex] = Model();
+        freeModelSlots.push_back(modelIndex);
+    }
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-        {
-            vkDestroyBuffer(device, skyboxUniformBuffers[i], nullptr);
-            vkFreeMemory(device, skyboxUniformBuffersMemory[i], nullptr);
-        }
+    /// <summary>
+    /// Points the GUI at the models and animation players. Called whenever either changes
+    /// </summary>
+    void SyncGUI()
+    {
+        gui.nModels = emptyModelIndex;
+        gui.models = &models;
+        gui.animationPlayers = animPlayers.data();
+        gui.nAnimationPlayers = static_cast<uint32_t>(animPlayers.size());
+        gui.Setup();
+    }
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    /// <summary>
+    /// Index of the wireframe pipeline for a descriptor layout, created the first time a model needs it.
+    /// Models share it, so streamed models don't build pipelines while frames are in flight
+    /// </summary>
+    uint32_t GetWireframePipeline(const bool passLightingData)
+    {
+        int32_t& index = wireframePipelineIndices[passLightingData ? 1 : 0];
+        if (index < 0)
         {
-            vkDestroyBuffer(device, gridUniformBuffers[i], nullptr);
-            vkFreeMemory(device, gridUniformBuffersMemory[i], nullptr);
+            CreateWireframeGraphicsPipeline(ModelShaderFile("simple_tri"), "shaders/frag.spv", passLightingData);
+            index = static_cast<int32_t>(wireframeGraphicsPipelines.size() - 1);
         }
 
-        for (size_t i = 0; i < lightingUniformBuffers.size(); i++)
-        {
-            for (size_t j = 0; j < MAX_FRAMES_IN_FLIGHT; j++)
-            {
-                vkDestroyBuffer(device, lightingUniformBuffers[i][j], nullptr);
-                vkFreeMemory(device, lightingUniformBuffersMemory[i][j], nullptr);
-            }
-        }
+        return static_cast<uint32_t>(index);
+    }
 
-        for (size_t i = 0; i < textureImages.size(); i++)
+    /// <summary>
+    /// Index of the normals pipeline for a descriptor layout, created the first time a model needs it. Shared like the wireframe pipelines
+    /// </summary>
+    uint32_t GetNormalsPipeline(const bool passLightingData)
+    {
+        int32_t& index = normalPipelineIndices[passLightingData ? 1 : 0];
+        if (index < 0)
         {
-            vkDestroyImageView(device, textureImageViews[i], nullptr);
-            vkDestroySampler(device, textureSamplers[i], nullptr);
-            vkDestroyImage(device, textureImages[i], nullptr);
-            vkFreeMemory(device, textureImageMemories[i], nullptr);
+            CreateNormalsGraphicsPipeline(passLightingData);
+            index = static_cast<int32_t>(normalGraphicsPipelines.size() - 1);
         }
 
-        for (size_t i = 0; i < normalImages.size(); i++)
+        return static_cast<uint32_t>(index);
+    }
+
+#ifdef DEPTH_PREPASS
+    /// <summary>
+    /// Index of the depth-only pipeline for a descriptor layout and vertex streams, created the first time a model needs it. Shared like the wireframe pipelines
+    /// </summary>
+    uint32_t GetDepthPipeline(const bool passLightingData, const bool skinned)
+    {
+        int32_t& index = depthPipelineIndices[passLightingData ? 1 : 0][skinned ? 1 : 0];
+        if (index < 0)
         {
-            vkDestroyImageView(device, normalImageViews[i], nullptr);
-            vkDestroySampler(device, normalSamplers[i], nullptr);
-            vkDestroyImage(device, normalImages[i], nullptr);
-            vkFreeMemory(device, normalImageMemories[i], nullptr);
+            CreateDepthGraphicsPipeline(passLightingData, skinned);
+            index = static_cast<int32_t>(depthGraphicsPipelines.size() - 1);
         }
 
-        vkDestroyImageView(device, skyboxImageView, nullptr);
-        vkDestroySampler(device, skyboxSampler, nullptr);
-        vkDestroyImage(device, skyboxImage, nullptr);
-        vkFreeMemory(device, skyboxImageMemory, nullptr);
-
-        // Test images
-        vkDestroyImageView(device, testImageView, nullptr);
-        vkDestroyImage(device, testImage, nullptr);
-        vkFreeMemory(device, testMemory, nullptr);
-
-        for (size_t i = 0; i < descriptorPools.size(); i++)
-            vkDestroyDescriptorPool(device, descriptorPools[i], nullptr);
+        return static_cast<uint32_t>(index);
+    }
+#endif // DEPTH_PREPASS
 
-        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-        vkDestroyDescriptorSetLayout(device, lightingDataDescriptorSetLayout, nullptr);
-        vkDestroyDescriptorSetLayout(device, gridDescriptorSetLayout, nullptr);
-        vkDestroyDescriptorSetLayout(device, imguiDescriptorSetLayout, nullptr);
-
-        vkDestroyDescriptorPool(device, skyboxDescriptorPool, nullptr);
-        vkDestroyDescriptorPool(device, gridDescriptorPool, nullptr);
-        vkDestroyDescriptorPool(device, lightingDescriptorPool, nullptr);
-        vkDestroyDescriptorPool(device, normalDescriptorPool, nullptr);
-        vkDestroyDescriptorPool(device, imguiDescriptorPool, nullptr);
-        
-        // Clear all vertex and index buffers and memories
-        for (size_t i = 0; i < vertexBuffers.size(); i++)
-        {
-            vkDestroyBuffer(device, vertexBuffers[i], nullptr);
-            vkFreeMemory(device, vertexBufferMemories[i], nullptr);
-            vkDestroyBuffer(device, indexBuffers[i], nullptr);
-            vkFreeMemory(device, indexBufferMemories[i], nullptr);
-        }
-
-        vkDestroyBuffer(device, skyboxVertexBuffer, nullptr);
-        vkFreeMemory(device, skyboxVertexBufferMemory, nullptr);
-        vkDestroyBuffer(device, gridVertexBuffer, nullptr);
-        vkFreeMemory(device, gridVertexBufferMemory, nullptr);
-        vkDestroyBuffer(device, gridIndexBuffer, nullptr);
-        vkFreeMemory(device, gridIndexBufferMemory, nullptr);
-
-        vkDestroyDevice(device, nullptr);
-
-        vkDestroySurfaceKHR(instance, surface, nullptr);
-
-        vkDestroyInstance(instance, nullptr);
-
-        glfwDestroyWindow(window);
-
-        glfwTerminate();
+    void AddSkybox(const char* folder = SKYBOX_PATH.c_str())
+    {
+        LoadCubemap(folder);
+        CreateSkyboxVertexBuffer();
+        CreateSkyboxUniformBuffer();
+        CreateSkyboxDescriptorPool();
+        CreateSkyboxDescriptorSet();
     }
 
-    void CleanupSwapChain()
+    void AddGrid()
     {
-        // Clean up color resources
-        vkDestroyImageView(device, colorImageView, nullptr);
-        vkDestroyImage(device, colorImage, nullptr);
-        vkFreeMemory(device, colorImageMemory, nullptr);
-
-        // Clean up depth resources
-        vkDestroyImageView(device, depthImageView, nullptr);
-        vkDestroyImage(device, depthImage, nullptr);
-        vkFreeMemory(device, depthMemory, nullptr);
-
-        vkDestroySwapchainKHR(device, sc.swapChain, nullptr);
-
-        for (auto framebuffer : swapChainFramebuffers)
-            vkDestroyFramebuffer(device, framebuffer, nullptr);
-
-        for (auto imageView : sc.imageViews)
-            vkDestroyImageView(device, imageView, nullptr);
-
-        for (auto frameBuffer : imguiFramebuffers)
-            vkDestroyFramebuffer(device, frameBuffer, nullptr);
+        CreateGridVertexBuffer();
+        CreateGridIndexBuffer();
+        CreateGridUniformBuffer();
+        CreateGridDescriptorPool();
+        CreateGridDescriptorSet();
     }
 
-    void RecreateSwapChain()
+#ifdef BAKED_CROWD
+    /// <summary>
+    /// Bakes the animations of a model and sets up an instanced crowd of it.
+    /// With GPU_ANIMATION, the clips are packed for the animation compute pass instead
+    /// </summary>
+    /// <param name="modelIndex">: animated model, which must pass lighting data</param>
+    void AddCrowd(const uint32_t modelIndex)
     {
-        // Check whether window is minimized
-        int width = 0, height = 0;
-        glfwGetFramebufferSize(window, &width, &height);
-        while (width == 0 || height == 0)
+        crowdModelIndex = modelIndex;
+
+#ifdef GPU_ANIMATION
+        // Only the clip durations are needed
+        crowdAnimation = BakeAnimations(models[modelIndex], BAKE_SAMPLE_RATE, false);
+        gpuAnimation = PackGpuAnimation(models[modelIndex]);
+        std::cout << "Packed " << crowdAnimation.clips.size() << " animations of " << models[modelIndex].name << " for GPU evaluation ("
+            << gpuAnimation.MemorySize() / (1024.0 * 1024.0) << " MiB, " << gpuAnimation.LevelCount() << " hierarchy levels)" << std::endl;
+
+        crowd.Populate(crowdAnimation, CROWD_SIZE, CROWD_SPACING);
+
+        CreateGpuAnimationBuffers();
+        CreateCrowdBuffers();
+        CreateGpuAnimationDescriptorSetLayout();
+        CreateGpuAnimationComputePipeline();
+        CreateGpuAnimationDescriptorPool();
+        CreateGpuAnimationDescriptorSets();
+#else
+        auto start = std::chrono::high_resolution_clock::now();
+        crowdAnimation = BakeAnimations(models[modelIndex]);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        // Baking overwrote the bones of the model
+        for (AnimationPlayer& animPlayer : animPlayers)
         {
-            //glfwGetFramebufferSize(window, &width, &height);
-            glfwWaitEvents();
+            if (animPlayer.modelIndex == modelIndex)
+                animPlayer.InvalidatePose();
         }
+        std::cout << "Baked " << crowdAnimation.clips.size() << " animations of " << models[modelIndex].name << " in "
+            << std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count() << " ms ("
+            << crowdAnimation.MemorySize() / (1024.0 * 1024.0) << " MiB)" << std::endl;
+
+        crowd.Populate(crowdAnimation, CROWD_SIZE, CROWD_SPACING);
+
+        CreateCrowdBuffers();
+#endif // GPU_ANIMATION
+        CreateCrowdDescriptorSetLayout();
+        CreateCrowdGraphicsPipeline();
+        CreateCrowdDescriptorPool();
+        CreateCrowdDescriptorSets();
+
+#ifdef GPU_ANIMATION
+        // Also catches regressions of the compute pass on software implementations such as lavapipe or SwiftShader
+        if (!RunGpuAnimationValidation())
+            throw std::runtime_error("GPU animation does not match the pose kernel for " + models[modelIndex].name + "!");
+#endif // GPU_ANIMATION
+    }
 
-        vkDeviceWaitIdle(device);
+    /// <summary>
+    /// Input of the animation compute pass for a frame in flight, nullptr if the crowd plays baked palettes
+    /// </summary>
+    GpuAnimationInstance* CrowdGpuInstances(const size_t frame)
+    {
+#ifdef GPU_ANIMATION
+        return static_cast<GpuAnimationInstance*>(gpuAnimationInstanceBuffersMapped[frame]);
+#else
+        return nullptr;
+#endif // GPU_ANIMATION
+    }
+#endif // BAKED_CROWD
 
+    void InitVulkan()
+    {
+        CreateInstance();
+        SetupDebugMessenger();
+        CreateSurface();
+        PickPhysicalDevice();
+        CreateLogicalDevice();
         CreateSwapChain();
         CreateImageViews();
+        CreateRenderPass();
+        CreateImGuiRenderPass();
+        CreateDescriptorSetLayout();
+        CreateLightingDataDescriptorSetLayout();
+        CreateGridDescriptorSetLayout();
+        CreateGraphicsPipeline();
+        CreateGraphicsPipeline(PaletteShaderFile("linear_skinning", "vert"), "shaders/linear_skinning_frag.spv", true, "shaders/geom.spv", true);
+        CreateGraphicsPipeline(ModelShaderFile("blinn_phong"), "shaders/blinn_phong_frag.spv", true);
+#ifdef COMPUTE_SKINNING
+        CreateSkinningDescriptorSetLayout();
+        CreateSkinningComputePipeline();
+        CreateSkinningDescriptorPool();
+        CreateGraphicsPipeline(ModelShaderFile("blinn_phong"), "shaders/linear_skinning_frag.spv", true);
+        skinnedPipelineIndex = static_cast<uint32_t>(graphicsPipelines.size() - 1);
+#endif // COMPUTE_SKINNING
+#ifdef CLUSTER_CULLING
+        CreateClusterCullDescriptorSetLayout();
+        CreateClusterCullComputePipeline();
+        CreateClusterCullDescriptorPool();
+        CreateClusterCullDescriptorSets();
+#endif // CLUSTER_CULLING
+        CreateSkyboxGraphicsPipeline("shaders/skybox_vert.spv", "shaders/skybox_frag.spv");
+        CreateSkyboxWireframeGraphicsPipeline();
+        CreateGridGraphicsPipeline();
+        CreateCommandPools();
         CreateColorResources();
         CreateDepthResources();
         CreateFramebuffers();
+#ifdef USE_ASSIMP
+        CreateTestImage();
+        AddModels({
+            { 2, true, MODEL_PATH, TEXTURE_PATH, NORMAL_PATH },
+            { 2, true, "models/suzanne.obj", "textures/marble.png", "textures/marble_normal.png" },
+            { 2, true, "models/wicker_basket_02_2k.fbx", "models/textures/wicker_basket_02_diff_2k.jpg", "models/textures/wicker_basket_02_nor_dx_2k.png" },
+            //{ 1, true, "models/flair_edited.fbx", "textures/body_diffuse.png", "textures/body_normal.png" },
+            { 1, true, "models/Capoeira_working.fbx", "textures/brick.png", "textures/brick_normal.png" },
+            { 1, true, "models/Dancing Twerk_working.fbx", "textures/brick.png", "textures/brick_normal.png" },
+            { 1, true, "models/Hokey Pokey_working.fbx", "textures/brick.png", "textures/brick_normal.png" }
+            });
+
+#if defined(MESH_CACHE_BENCHMARK) && defined(USE_MESH_CACHE)
+        ReportMeshCacheLoadTimes();
+#endif // MESH_CACHE_BENCHMARK && USE_MESH_CACHE
+
+#ifdef ANIMATION_BENCHMARK
+        for (uint32_t i = 0; i < emptyModelIndex; i++)
+        {
+            if (models[i].meshes[0].animations.empty())
+                continue;
 
-        // We also need to take care of the UI
-        ImGui_ImplVulkan_SetMinImageCount(MAX_FRAMES_IN_FLIGHT);
-        /*CreateImGuiRenderPass();
-        CreateImGuiFramebuffers();
-        CreateImGuiCommandBuffers();*/
-    }
-
-    void CreateInstance()
-    {
-        // Check validation layers
-        if (enableValidationLayers && !CheckValidationLayerSupport())
-            throw std::runtime_error("validation layers requested, but not available!");
+            RunKeyframeBenchmark(models[i]);
+            if (!RunPoseKernelValidation(models[i]))
+                std::cerr << "Pose kernel does not match reference for " << models[i].name << "!" << std::endl;
+            if (!RunPaletteEncodingValidation(models[i]))
+                std::cerr << "Palette encoding does not match mat4 palette for " << models[i].name << "!" << std::endl;
+        }
 
-        // Application information
-        VkApplicationInfo appInfo{};
-        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-        appInfo.pApplicationName = "Hello Triangle";
-        appInfo.applicationVersion = VK_MAKE_API_VERSION(0, 1, 0, 0);
-        appInfo.pEngineName = "No Engine";
-        appInfo.engineVersion = VK_MAKE_API_VERSION(0, 1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+#ifdef COMPRESS_ANIMATIONS
+        ReportAnimationCompression();
+#endif // COMPRESS_ANIMATIONS
 
-        // Global extensions and validation layers
-        VkInstanceCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-        createInfo.pApplicationInfo = &appInfo;
+        // Animation updates must not allocate once the samplers and pose batches are warmed up
+        const uint32_t allocationCheckFrames = 120;
+        UpdateAnimations(0);
+        const uint64_t animationAllocations = CountHeapAllocations([this]()
+            {
+                for (uint32_t f = 0; f < allocationCheckFrames; f++)
+                {
+                    // Otherwise unchanged poses would be served from the pose cache without evaluating anything
+                    for (AnimationPlayer& animPlayer : animPlayers)
+                        animPlayer.InvalidatePose();
 
-        std::vector<const char*> glfwExtensions = GetRequiredExtensions();  // Get extensions from GLFW
+                    UpdateAnimations(f % MAX_FRAMES_IN_FLIGHT);
+                }
+            });
+        std::cout << "Heap allocations in " << allocationCheckFrames << " animation updates: " << animationAllocations << std::endl;
+        if (animationAllocations > 0)
+            throw std::runtime_error("animation updates allocated on the heap after warm-up!");
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(glfwExtensions.size());
-        createInfo.ppEnabledExtensionNames = glfwExtensions.data();
-        createInfo.enabledLayerCount = (enableValidationLayers) ? static_cast<uint32_t>(validationLayers.size()) : 0;
-        createInfo.ppEnabledLayerNames = (enableValidationLayers) ? validationLayers.data() : nullptr;
+        for (AnimationPlayer& animPlayer : animPlayers)
+        {
+            animPlayer.ResetTime();
+            animPlayer.InvalidatePose();
+        }
+#endif // ANIMATION_BENCHMARK
 
-        VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
-        if (enableValidationLayers)
+        //AddModel(1, true, "models/ymca.fbx", "textures/parasiteZombie_body_diffuse.png", "textures/parasiteZombie_body_normal.bmp");
+        //AddModel(1, true, "models/wiggly.fbx", "textures/plaster.jpg", "textures/plaster_normal.png");
+        // AddModel(1, false, "models/boy_animated.fbx", "textures/plaster.jpg", "textures/plaster_normal.png");
+        //AddModel(1, "models/bob_lamp.fbx", "textures/plaster.jpg");
+        //AddModel(1, "models/deer.fbx", "textures/plaster.jpg");
+        //AddModel(1, "models/female_doctor.fbx", "textures/plaster.jpg");
+#else
+        LoadModel();
+        CreateTextureImage();
+        CreateTextureImageView();
+        CreateTextureSampler();
+        CreateVertexBuffer();
+        CreateIndexBuffer();
+        CreateUniformBuffers();
+        CreateDescriptorPool();
+        CreateDescriptorSets();
+#endif // USE_ASSIMP
+#ifdef COMPUTE_SKINNING
+        // Animated meshes are already skinned when drawn
+        CreateAnimatedWireframeGraphicsPipeline(ModelShaderFile("blinn_phong"), "shaders/linear_skinning_frag.spv", true, false);
+#else
+        CreateAnimatedWireframeGraphicsPipeline(PaletteShaderFile("linear_skinning", "vert"), "shaders/linear_skinning_frag.spv", true);
+#endif // COMPUTE_SKINNING
+        CreateAnimatedNormalGraphicsPipeline();
+        SyncGUI();
+        //AddSkybox();
+        AddSkybox("textures/Yokohama3/");
+        AddGrid();
+#ifdef BAKED_CROWD
+        for (uint32_t i = 0; i < emptyModelIndex; i++)
         {
-            PopulateDebugMessengerCreateInfo(debugCreateInfo);
-            createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
+            if (!models[i].meshes[0].animations.empty())
+            {
+                AddCrowd(i);
+                break;
+            }
         }
-        else
-            createInfo.pNext = nullptr;
+#endif // BAKED_CROWD
+        CreateNormalDescriptorPool();
+        CreateNormalDescriptorSet();
+        CreateCommandBuffers();
+        CreateSyncObjects();
+#ifdef ANIMATION_BENCHMARK
+        CreateTimestampQueryPool();
+#endif // ANIMATION_BENCHMARK
+    }
 
-        // Create instance
-        if (vkCreateInstance(&createInfo, allocationCallback, &instance) != VK_SUCCESS)
-            throw std::runtime_error("failed to create instance!");
+    void MainLoop()
+    {
+        while (!glfwWindowShouldClose(window))
+        {
+            timer.Tick();
 
-        uint32_t extensionCount = 0;
-        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+            glfwPollEvents();
 
-        std::vector<VkExtensionProperties> extensions(extensionCount);
+            gui.Render();
 
-        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+            cam.UpdateVelocity(timer.GetData().DeltaTime);
+            cam.MoveCamera(timer.GetData().DeltaTime);
 
-        std::cout << "Available extensions:\n";
-        for (const auto& extension : extensions)
-            std::cout << '\t' << extension.extensionName << '\n';
+            DrawFrame();
+        }
 
-        bool missing_extensions = false;
-        std::cout << "Required extensions:\n";
-        for (int i = 0; i < static_cast<uint32_t>(glfwExtensions.size()); i++)
-        {
-            std::cout << '\t' << glfwExtensions[i] << '\n';
-            missing_extensions = true;
-            for (const auto& extension : extensions)
-            {
-                if (std::strcmp(extension.extensionName, glfwExtensions[i]))
-                {
-                    missing_extensions = false;
-                    break;
-                }
-            }
+        // Imports still running use the renderer
+        for (PendingModel& pending : pendingModels)
+            pending.result.wait();
 
-            if (missing_extensions)
-                std::cerr << "Missing extension: " << glfwExtensions[i] << std::endl;
-        }
+        // Wait for device to finish operations before exiting
+        vkDeviceWaitIdle(device);
     }
 
-    bool CheckValidationLayerSupport()
+    void DrawFrame()
     {
-        uint32_t layerCount;
-        vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
-        std::vector<VkLayerProperties> availableLayers(layerCount);
-        vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+        uint32_t imageIndex;
+        VkResult image_result = vkAcquireNextImageKHR(device, sc.swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
 
-        for (const char* layerName : validationLayers)
+        // Check whether swap chain recreation is required
+        if (image_result == VK_ERROR_OUT_OF_DATE_KHR || image_result == VK_SUBOPTIMAL_KHR || framebufferResized)
         {
-            bool layerFound = false;
-            for (const auto& layerProperties : availableLayers) {
-                if (!strcmp(layerName, layerProperties.layerName))
+            framebufferResized = false;
+            RecreateSwapChain();
+            return;
+        }
+        else if (image_result != VK_SUCCESS)
+            throw std::runtime_error("failed to present swap chain image!");
+
+        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+
+        // Add and remove streamed models, now that the GPU is done with this frame's resources
+        UpdateModelStreaming();
+#ifdef COMPUTE_SKINNING
+        // Sets of the other frame slots may still be in use, they are rewritten when their slot comes round
+        if (skinningInputsStale[currentFrame])
+        {
+            for (uint32_t i = 0; i < emptyModelIndex; i++)
+            {
+                for (const Mesh& mesh : models[i].meshes)
                 {
-                    layerFound = true;
-                    break;
+                    if (mesh.skinnedBufferIndex >= 0)
+                        WriteSkinningInputDescriptors(mesh, currentFrame);
                 }
             }
-
-            if (!layerFound)
-                return false;
+            skinningInputsStale[currentFrame] = false;
         }
+#endif // COMPUTE_SKINNING
+
+        // Evaluate animations of all players, now that the GPU is done with this frame's uniform buffers
+        UpdateAnimations(currentFrame);
+#ifdef ANIMATION_BENCHMARK
+        ReadTimestamps(currentFrame);
+#endif // ANIMATION_BENCHMARK
+#ifdef CLUSTER_CULLING
+        ReadClusterCullStats(currentFrame);
+#endif // CLUSTER_CULLING
+#ifdef BAKED_CROWD
+        if (crowd.Size() > 0)
+            crowd.Update(timer.GetData().DeltaTime, gui.animation_speed, gui.play_animation_flag,
+                static_cast<CrowdInstanceData*>(crowdInstanceBuffersMapped[currentFrame]), CrowdGpuInstances(currentFrame));
+#endif // BAKED_CROWD
+
+#ifdef MESH_LODS
+        SelectModelLods();
+#endif // MESH_LODS
 
-    }
-    
-    std::vector<const char*> GetRequiredExtensions()
-    {
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+        RecordCommandBuffer(commandBuffers[currentFrame], imageIndex);
 
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        // Update model uniform buffers
+        //for (size_t i = 0; i < models.size(); i++)
+        for (size_t i = 0; i < emptyModelIndex; i++)
+        {
+            if (!models[i].resident)
+                continue;
 
-        // Conditionally add Debug Utils extension
-        if (enableValidationLayers)
-            extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+            UpdateUniformBuffer(i, currentFrame);
 
-        return extensions;
-    }
+            // Update lighting data UBO
+            if (models[i].pipelineIndex == 2)
+                UpdateLightingDataUniformBuffer(i, currentFrame);
+        }
 
-    static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
-        VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-        VkDebugUtilsMessageTypeFlagsEXT messageType,
-        const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
-        void* pUserData)
-    {
-        std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+        // Update skybox uniform buffer
+        UpdateSkyboxUniformBuffer(currentFrame);
 
-        return VK_FALSE;
-    }
+        // Update grid uniform buffer
+        UpdateGridUniformBuffer(currentFrame);
 
-    void SetupDebugMessenger()
-    {
-        if (!enableValidationLayers)
-            return;
+        // Submit command buffer
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkDebugUtilsMessengerCreateInfoEXT createInfo;
-        PopulateDebugMessengerCreateInfo(createInfo);
+        VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame]};
+        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = waitSemaphores;
+        submitInfo.pWaitDstStageMask = waitStages;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+        VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = signalSemaphores;
 
-        if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS)
-            throw std::runtime_error("failed to set up debug messenger!");
-    }
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+            throw std::runtime_error("failed to submit draw command buffer!");
 
-    void PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
-    {
-        createInfo = {};
-        createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-        createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-        createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-        createInfo.pfnUserCallback = DebugCallback;
-        createInfo.pUserData = nullptr; // Optional
-    }
+        // UI render command buffer
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+        VkSemaphore uiWaitSemaphores[] = { renderFinishedSemaphores[currentFrame] };
+        submitInfo.pWaitSemaphores = uiWaitSemaphores;
+        VkSemaphore uiSignalSemaphores[] = { uiRenderFinishedSemaphores[currentFrame] };
+        submitInfo.pSignalSemaphores = uiSignalSemaphores;
 
-    void PickPhysicalDevice()
-    {
-        uint32_t deviceCount = 0;
-        vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = 0; // Optional
+        beginInfo.pInheritanceInfo = nullptr; // Optional
 
-        if (deviceCount == 0)
-            throw std::runtime_error("failed to find GPUs with Vulkan support!");
+        if (vkBeginCommandBuffer(commandBuffers[currentFrame], &beginInfo) != VK_SUCCESS)
+            throw std::runtime_error("failed to begin recording command buffer!");
 
-        std::vector<VkPhysicalDevice> devices(deviceCount);
-        vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = imguiRenderPass;
+        //renderPassInfo.renderPass = renderPass;
+        //renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        renderPassInfo.framebuffer = imguiFramebuffers[imageIndex];
+        renderPassInfo.renderArea.offset = { 0, 0 };
+        renderPassInfo.renderArea.extent = sc.extent;
 
-#ifdef RANK_PHYSICAL_DEVICES
-        std::multimap<int, PhysicalDeviceContainer> candidates;     // Ordered map
+        // Testing
+        /*VkImageBlit region{};
 
-        for (const auto& device : devices)
-        {
-            PhysicalDeviceContainer deviceContainer(device);
-            vkGetPhysicalDeviceProperties(device, &deviceContainer.properties);
-            vkGetPhysicalDeviceFeatures(device, &deviceContainer.features);
+        region.srcOffsets[0].x = 0;
+        region.srcOffsets[0].y = 0;
+        region.srcOffsets[0].z = 0;
+        region.dstOffsets[0].x = 0;
+        region.dstOffsets[0].y = 0;
+        region.dstOffsets[0].z = 0;
+        region.srcOffsets[1].x = sc.extent.width;
+        region.srcOffsets[1].y = sc.extent.height;
+        region.srcOffsets[1].z = 1;
+        region.dstOffsets[1].x = sc.extent.width;
+        region.dstOffsets[1].y = sc.extent.height;
+        region.dstOffsets[1].z = 1;
+        region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.srcSubresource.mipLevel = 0;
+        region.dstSubresource.mipLevel = 0;
+        region.srcSubresource.baseArrayLayer = 0;
+        region.dstSubresource.baseArrayLayer = 0;
+        region.srcSubresource.layerCount = 1;
+        region.dstSubresource.layerCount = 1;
 
-            int deviceScore = RateDeviceSuitability(deviceContainer);
-            candidates.insert(std::make_pair(deviceScore, deviceContainer));
-        }
+        TransitionImageLayoutCmd(sc.images[currentFrame], 1, sc.format, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_IMAGE_ASPECT_COLOR_BIT, commandBuffers[currentFrame], 1);
 
-        if (candidates.rbegin()->first > 0)
-            physicalDevice = candidates.rbegin()->second.device;
-        else
-            throw std::runtime_error("failed to find a suitable GPU!");
-#else
-        // Check for suitable physical device
-        for (const auto& device : devices)
-        {
-            if (IsDeviceSuitable(device))
-            {
-                physicalDevice = device;
-                break;
-            }
-        }
-#endif // RANK_PHYSICAL_DEVICES
+        TransitionImageLayoutCmd(textureImages[1], 1, sc.format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_ASPECT_COLOR_BIT, commandBuffers[currentFrame], 1);
 
-        // If no suitable physical device found
-        if (physicalDevice == VK_NULL_HANDLE)
-            throw std::runtime_error("failed to find a suitable GPU!");
-    }
+        vkCmdBlitImage(commandBuffers[currentFrame], sc.images[currentFrame], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            textureImages[1], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
 
-    bool IsDeviceSuitable(VkPhysicalDevice device)
-    {
-        VkPhysicalDeviceProperties deviceProperties;
-        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+        TransitionImageLayoutCmd(sc.images[currentFrame], 1, sc.format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_ASPECT_COLOR_BIT, commandBuffers[currentFrame], 1);
 
-        VkPhysicalDeviceFeatures deviceFeatures;
-        vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+        TransitionImageLayoutCmd(textureImages[1], 1, sc.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_IMAGE_ASPECT_COLOR_BIT, commandBuffers[currentFrame], 1);*/
 
-        QueueFamilyIndices queueIndices = FindQueueFamilies(device);
+        // Begin UI render pass
+        vkCmdBeginRenderPass(commandBuffers[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-        bool extensionsSupported = CheckDeviceExtensionSupport(device);
+        VkBuffer vertexBuffersRend[] = { gridVertexBuffer };
+        VkDeviceSize offsets[] = { 0 };
+        vkCmdBindVertexBuffers(commandBuffers[currentFrame], 0, 1, vertexBuffersRend, offsets);
+        vkCmdBindIndexBuffer(commandBuffers[currentFrame], gridIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported)
-        {
-            SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(device);
-            swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
-        }
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(sc.extent.width);
+        viewport.height = static_cast<float>(sc.extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffers[currentFrame], 0, 1, &viewport);
 
-#ifdef REQUIRE_GEOM_SHADERS
-        return deviceFeatures.geometryShader && deviceFeatures.samplerAnisotropy && (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) && queueIndices.IsComplete() && extensionsSupported && swapChainAdequate;
-#else
-        return (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) && queueIndices.IsComplete() && extensionsSupported && swapChainAdequate;
-#endif // REQUIRE_GEOM_SHADERS
-    }
+        VkRect2D scissor{};
+        scissor.offset = { 0, 0 };
+        scissor.extent = sc.extent;
+        vkCmdSetScissor(commandBuffers[currentFrame], 0, 1, &scissor);
 
-    int RateDeviceSuitability(PhysicalDeviceContainer device)
-    {
-        int score = 0;
+        vkCmdBindPipeline(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, uiPipeline);
+        vkCmdBindDescriptorSets(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, uiPipelineLayout, 0, 1, imguiDescriptorSet.data(), 0, nullptr);
 
-        if (device.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
-            score += 1000;
+        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffers[currentFrame]);
 
-        score += device.properties.limits.maxImageDimension2D;
+        vkCmdEndRenderPass(commandBuffers[currentFrame]);
+        if (vkEndCommandBuffer(commandBuffers[currentFrame]) != VK_SUCCESS)
+            throw std::runtime_error("failed to render ui!");
 
-#ifdef REQUIRE_GEOM_SHADERS
-        if (!device.features.geometryShader)
-            return 0;
-#endif // REQUIRE_GEOM_SHADERS
-        if (!device.features.samplerAnisotropy)
-            return 0;
+        vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]);
 
-#ifndef NO_MSAA
-        VkSampleCountFlagBits msaaSamplesNew = GetMaxUsableSampleCount(device);
-        score += msaaSamples;
+        // Presentation
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
-        if (msaaSamplesNew > msaaSamples)
+        presentInfo.waitSemaphoreCount = 1;
+        //presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.pWaitSemaphores = uiSignalSemaphores;
+        VkSwapchainKHR swapChains[] = { sc.swapChain };
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = swapChains;
+        presentInfo.pImageIndices = &imageIndex;
+        presentInfo.pResults = nullptr; // Optional
+
+        // Check whether swap chain recreation is required
+        if (image_result == VK_ERROR_OUT_OF_DATE_KHR || image_result == VK_SUBOPTIMAL_KHR || framebufferResized)
         {
-            msaaSamples = msaaSamplesNew;
-            std::cout << "MSAA " << msaaSamples << "X" << std::endl;
+            framebufferResized = false;
+            RecreateSwapChain();
+            return;
         }
-#endif // NO_MSAA
+        else if (image_result != VK_SUCCESS)
+            throw std::runtime_error("failed to present swap chain image!");
 
-        return score;
+        vkQueuePresentKHR(presentQueue, &presentInfo);
+
+        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        frameCount++;
     }
 
-    bool CheckDeviceExtensionSupport(VkPhysicalDevice device)
+    void Cleanup()
     {
-        uint32_t extensionCount;
-        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+        // Clean up GUI
+        ImGui_ImplVulkan_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
 
-        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+        // Streamed models still uploading or waiting to be destroyed. The device is idle
+        for (ModelUpload& upload : modelUploads)
+            FinishModelUpload(upload);
+        for (const RetiredModel& retired : retiredModels)
+            DestroyModelResources(retired.modelIndex);
+        for (GeometryCompaction& compaction : geometryCompactions)
+        {
+            vkFreeCommandBuffers(device, commandPool, 1, &compaction.commandBuffer);
+            vkDestroyFence(device, compaction.fence, nullptr);
+        }
 
-        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+        if (enableValidationLayers)
+            DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 
-        for (const auto& extension : availableExtensions)
-            requiredExtensions.erase(extension.extensionName);
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        vkDestroyCommandPool(device, transCommandPool, nullptr);
+        vkDestroyCommandPool(device, imguiCommandPool, nullptr);
 
-        return requiredExtensions.empty();
-    }
+        for (size_t i = 0; i < graphicsPipelines.size(); i++)
+            vkDestroyPipeline(device, graphicsPipelines[i], nullptr);
 
-    QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device)
-    {
-        QueueFamilyIndices indices;
-        
-        uint32_t queueFamilyCount;
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-
-        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+        for (size_t i = 0; i < pipelineLayouts.size(); i++)
+            vkDestroyPipelineLayout(device, pipelineLayouts[i], nullptr);
 
-        int i = 0;
-        for (const auto& queueFamily : queueFamilies)
-        {
-            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-                indices.graphicsFamily = i;
+        for (size_t i = 0; i < wireframeGraphicsPipelines.size(); i++)
+            vkDestroyPipeline(device, wireframeGraphicsPipelines[i], nullptr);
+        for (size_t i = 0; i < wireframePipelineLayouts.size(); i++)
+            vkDestroyPipelineLayout(device, wireframePipelineLayouts[i], nullptr);
 
-            if (!(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT)
-                indices.transferFamily = i;
+        vkDestroyPipeline(device, skyboxGraphicsPipeline, nullptr);
+        vkDestroyPipelineLayout(device, skyboxPipelineLayout, nullptr);
+        vkDestroyPipeline(device, skyboxWireframeGraphicsPipeline, nullptr);
+        vkDestroyPipelineLayout(device, skyboxWireframePipelineLayout, nullptr);
+        vkDestroyPipeline(device, animatedWireframeGraphicsPipeline, nullptr);
+        vkDestroyPipelineLayout(device, animatedWireframePipelineLayout, nullptr);
+        vkDestroyPipeline(device, gridGraphicsPipeline, nullptr);
+        vkDestroyPipelineLayout(device, gridPipelineLayout, nullptr);
+        vkDestroyPipeline(device, animatedNormalGraphicsPipeline, nullptr);
+        vkDestroyPipelineLayout(device, animatedNormalPipelineLayout, nullptr);
+        vkDestroyPipelineLayout(device, uiPipelineLayout, nullptr);
+        vkDestroyPipeline(device, uiPipeline, nullptr);
 
-            VkBool32 presentSupport;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-            if (presentSupport)
-                indices.presentFamily = i;
+        for (size_t i = 0; i < normalGraphicsPipelines.size(); i++)
+            vkDestroyPipeline(device, normalGraphicsPipelines[i], nullptr);
 
-            if (indices.IsComplete())
-                break;
+        for (size_t i = 0; i < normalPipelineLayouts.size(); i++)
+            vkDestroyPipelineLayout(device, normalPipelineLayouts[i], nullptr);
 
-            i++;
-        }
+        for (size_t i = 0; i < depthGraphicsPipelines.size(); i++)
+            vkDestroyPipeline(device, depthGraphicsPipelines[i], nullptr);
+        for (size_t i = 0; i < depthPipelineLayouts.size(); i++)
+            vkDestroyPipelineLayout(device, depthPipelineLayouts[i], nullptr);
 
-        return indices;
-    }
+        vkDestroyRenderPass(device, renderPass, nullptr);
+        vkDestroyRenderPass(device, imguiRenderPass, nullptr);
 
-    void CreateLogicalDevice()
-    {
-        QueueFamilyIndices indices = FindQueueFamilies(physicalDevice);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+            vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+            vkDestroySemaphore(device, uiRenderFinishedSemaphores[i], nullptr);
+            vkDestroyFence(device, inFlightFences[i], nullptr);
+        }
 
-        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
+        CleanupSwapChain();
 
-        float queuePriority = 1.0f;
-        for (uint32_t queueFamily : uniqueQueueFamilies)
+        for (size_t i = 0; i < uniformBuffers.size(); i++)
         {
-            VkDeviceQueueCreateInfo queueCreateInfo{};
-            queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-            queueCreateInfo.queueFamilyIndex = queueFamily;
-            queueCreateInfo.queueCount = 1;
-            queueCreateInfo.pQueuePriorities = &queuePriority;
-
-            queueCreateInfos.push_back(queueCreateInfo);
+            for (size_t j = 0; j < MAX_FRAMES_IN_FLIGHT; j++)
+            {
+                vkDestroyBuffer(device, uniformBuffers[i][j], nullptr);
+                vkFreeMemory(device, uniformBuffersMemory[i][j], nullptr);
+            }
         }
 
-        // Get Device features
-        VkPhysicalDeviceFeatures deviceFeatures{};
-        deviceFeatures.samplerAnisotropy = VK_TRUE;
-        deviceFeatures.sampleRateShading = VK_TRUE;
-        deviceFeatures.fillModeNonSolid = VK_TRUE;
-#ifdef REQUIRE_GEOM_SHADERS
-        deviceFeatures.geometryShader = VK_TRUE;
-#endif // REQUIRE_GEOM_SHADERS
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            vkDestroyBuffer(device, skyboxUniformBuffers[i], nullptr);
+            vkFreeMemory(device, skyboxUniformBuffersMemory[i], nullptr);
+        }
 
-        VkDeviceCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        createInfo.pQueueCreateInfos = queueCreateInfos.data();
-        createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-        createInfo.pEnabledFeatures = &deviceFeatures;
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            vkDestroyBuffer(device, gridUniformBuffers[i], nullptr);
+            vkFreeMemory(device, gridUniformBuffersMemory[i], nullptr);
+        }
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
-        if (enableValidationLayers)
+        for (size_t i = 0; i < lightingUniformBuffers.size(); i++)
         {
-            createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-            createInfo.ppEnabledLayerNames = validationLayers.data();
+            for (size_t j = 0; j < MAX_FRAMES_IN_FLIGHT; j++)
+            {
+                vkDestroyBuffer(device, lightingUniformBuffers[i][j], nullptr);
+                vkFreeMemory(device, lightingUniformBuffersMemory[i][j], nullptr);
+            }
         }
-        else
-            createInfo.enabledLayerCount = 0;
 
-        // Instantiate device
-        if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
-            throw std::runtime_error("failed to create logical device!");
+        for (size_t i = 0; i < textureImages.size(); i++)
+        {
+            vkDestroyImageView(device, textureImageViews[i], nullptr);
+            vkDestroySampler(device, textureSamplers[i], nullptr);
+            vkDestroyImage(device, textureImages[i], nullptr);
+            vkFreeMemory(device, textureImageMemories[i], nullptr);
+        }
 
-        // Retrieve queue handles
-        vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
-        vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
-        vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
-    }
+        for (size_t i = 0; i < normalImages.size(); i++)
+        {
+            vkDestroyImageView(device, normalImageViews[i], nullptr);
+            vkDestroySampler(device, normalSamplers[i], nullptr);
+            vkDestroyImage(device, normalImages[i], nullptr);
+            vkFreeMemory(device, normalImageMemories[i], nullptr);
+        }
 
-    void CreateSurface()
-    {
-        if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
-            throw std::runtime_error("failed to create window surface!");
-    }
+        vkDestroyImageView(device, skyboxImageView, nullptr);
+        vkDestroySampler(device, skyboxSampler, nullptr);
+        vkDestroyImage(device, skyboxImage, nullptr);
+        vkFreeMemory(device, skyboxImageMemory, nullptr);
 
-    SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device)
-    {
-        SwapChainSupportDetails details;
+        // Test images
+        vkDestroyImageView(device, testImageView, nullptr);
+        vkDestroyImage(device, testImage, nullptr);
+        vkFreeMemory(device, testMemory, nullptr);
 
-        // Capabilities
-        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
+        for (size_t i = 0; i < descriptorPools.size(); i++)
+            vkDestroyDescriptorPool(device, descriptorPools[i], nullptr);
 
-        // Formats
-        uint32_t formatCount;
-        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, lightingDataDescriptorSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, gridDescriptorSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, imguiDescriptorSetLayout, nullptr);
 
-        if (formatCount != 0)
+        vkDestroyDescriptorPool(device, skyboxDescriptorPool, nullptr);
+        vkDestroyDescriptorPool(device, gridDescriptorPool, nullptr);
+        vkDestroyDescriptorPool(device, lightingDescriptorPool, nullptr);
+        vkDestroyDescriptorPool(device, normalDescriptorPool, nullptr);
+        vkDestroyDescriptorPool(device, imguiDescriptorPool, nullptr);
+        
+        // Clear the geometry arena
+        for (GeometryBlock& block : geometryBlocks)
+            DestroyGeometryBlock(block);
+        for (const RetiredBuffer& retired : retiredGeometryBuffers)
         {
-            details.formats.resize(formatCount);
-            vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
+            vkDestroyBuffer(device, retired.buffer, nullptr);
+            vkFreeMemory(device, retired.memory, nullptr);
         }
 
-        // Present modes
-        uint32_t presentModeCount;
-        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+        vkDestroyBuffer(device, skyboxVertexBuffer, nullptr);
+        vkFreeMemory(device, skyboxVertexBufferMemory, nullptr);
+        vkDestroyBuffer(device, gridVertexBuffer, nullptr);
+        vkFreeMemory(device, gridVertexBufferMemory, nullptr);
+        vkDestroyBuffer(device, gridIndexBuffer, nullptr);
+        vkFreeMemory(device, gridIndexBufferMemory, nullptr);
 
-        if (presentModeCount != 0)
+#ifdef ANIMATION_BENCHMARK
+        vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+#endif // ANIMATION_BENCHMARK
+
+#ifdef COMPUTE_SKINNING
+        vkDestroyPipeline(device, skinningPipeline, nullptr);
+        vkDestroyPipelineLayout(device, skinningPipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, skinningDescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, skinningDescriptorSetLayout, nullptr);
+        for (size_t i = 0; i < skinnedVertexBuffers.size(); i++)
         {
-            details.presentModes.resize(presentModeCount);
-            vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
+            for (size_t j = 0; j < MAX_FRAMES_IN_FLIGHT; j++)
+            {
+                vkDestroyBuffer(device, skinnedVertexBuffers[i][j], nullptr);
+                vkFreeMemory(device, skinnedVertexBufferMemories[i][j], nullptr);
+            }
         }
+#endif // COMPUTE_SKINNING
 
-        return details;
-    }
-
-    VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
-    {
-        for (const auto& availableFormat : availableFormats)
+#ifdef CLUSTER_CULLING
+        vkDestroyPipeline(device, clusterCullPipeline, nullptr);
+        vkDestroyPipelineLayout(device, clusterCullPipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, clusterCullDescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, clusterCullDescriptorSetLayout, nullptr);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
-            if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
-                return availableFormat;
+            vkDestroyBuffer(device, clusterIndexBuffers[i], nullptr);
+            vkFreeMemory(device, clusterIndexBufferMemories[i], nullptr);
+            vkDestroyBuffer(device, clusterDrawBuffers[i], nullptr);
+            vkFreeMemory(device, clusterDrawBufferMemories[i], nullptr);
         }
-
-        // TODO: Consider ranking rather than returning the first format available!
-        return availableFormats[0];
-    }
-
-    VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
-    {
-        for (const auto& availablePresentMode : availablePresentModes)
+#endif // CLUSTER_CULLING
+
+#ifdef BAKED_CROWD
+        vkDestroyPipeline(device, crowdGraphicsPipeline, nullptr);
+        vkDestroyPipelineLayout(device, crowdPipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, crowdDescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, crowdDescriptorSetLayout, nullptr);
+        vkDestroyBuffer(device, crowdPaletteBuffer, nullptr);
+        vkFreeMemory(device, crowdPaletteBufferMemory, nullptr);
+        for (size_t i = 0; i < crowdInstanceBuffers.size(); i++)
         {
-            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-                return availablePresentMode;
+            vkDestroyBuffer(device, crowdInstanceBuffers[i], nullptr);
+            vkFreeMemory(device, crowdInstanceBuffersMemory[i], nullptr);
+        }
+#endif // BAKED_CROWD
+
+#ifdef GPU_ANIMATION
+        vkDestroyPipeline(device, gpuAnimationPipeline, nullptr);
+        vkDestroyPipelineLayout(device, gpuAnimationPipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, gpuAnimationDescriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, gpuAnimationDescriptorSetLayout, nullptr);
+        vkDestroyBuffer(device, gpuAnimationBuffer, nullptr);
+        vkFreeMemory(device, gpuAnimationBufferMemory, nullptr);
+        vkDestroyBuffer(device, gpuJointBuffer, nullptr);
+        vkFreeMemory(device, gpuJointBufferMemory, nullptr);
+        for (size_t i = 0; i < gpuAnimationInstanceBuffers.size(); i++)
+        {
+            vkDestroyBuffer(device, gpuAnimationInstanceBuffers[i], nullptr);
+            vkFreeMemory(device, gpuAnimationInstanceBuffersMemory[i], nullptr);
         }
+#endif // GPU_ANIMATION
 
-        return VK_PRESENT_MODE_FIFO_KHR;
-    }
+        vkDestroyDevice(device, nullptr);
 
-    VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
-    {
-        if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
-            return capabilities.currentExtent;
-        else
-        {
-            int width, height;
-            glfwGetFramebufferSize(window, &width, &height);
+        vkDestroySurfaceKHR(instance, surface, nullptr);
 
-            VkExtent2D actualExtent = {
-                static_cast<uint32_t>(width),
-                static_cast<uint32_t>(height)
-            };
+        vkDestroyInstance(instance, nullptr);
 
-            actualExtent.width = std::clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
-            actualExtent.height = std::clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+        glfwDestroyWindow(window);
 
-            return actualExtent;
-        }
+        glfwTerminate();
     }
 
-    void CreateSwapChain()
+    void CleanupSwapChain()
     {
-        sc = Swapchain(device, physicalDevice, surface, window);
-    }
+        // Clean up color resources
+        vkDestroyImageView(device, colorImageView, nullptr);
+        vkDestroyImage(device, colorImage, nullptr);
+        vkFreeMemory(device, colorImageMemory, nullptr);
 
-    void CreateImageViews()
-    {
-        sc.imageViews.resize(sc.images.size());
+        // Clean up depth resources
+        vkDestroyImageView(device, depthImageView, nullptr);
+        vkDestroyImage(device, depthImage, nullptr);
+        vkFreeMemory(device, depthMemory, nullptr);
 
-        for (size_t i = 0; i < sc.images.size(); i++)
-        {
-            sc.imageViews[i] = CreateImageView(sc.images[i], 1, sc.format, VK_IMAGE_ASPECT_COLOR_BIT);
-        }
-    }
+        vkDestroySwapchainKHR(device, sc.swapChain, nullptr);
 
-    void CreateGraphicsPipeline(const char* vertShaderFile = "shaders/vert.spv", const char* fragShaderFile = "shaders/frag.spv", bool passLightingData = false, const char* geomShaderFile = "shaders/geom.spv")
-    {
-        pipelineLayouts.resize(pipelineLayouts.size() + 1);
-        graphicsPipelines.resize(graphicsPipelines.size() + 1);
+        for (auto framebuffer : swapChainFramebuffers)
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
 
-        auto bindingDescription = Vertex::GetBindingDescription();
-        auto attributeDescriptions = Vertex::GetAttributeDescriptions();
+        for (auto imageView : sc.imageViews)
+            vkDestroyImageView(device, imageView, nullptr);
 
-        VkDescriptorSetLayout& descriptorLayout = (passLightingData) ? lightingDataDescriptorSetLayout : descriptorSetLayout;
-        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE,
-            bindingDescription, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
-            pipelineLayouts.back(), descriptorLayout, renderPass,
-            vertShaderFile, fragShaderFile, geomShaderFile, std::to_string(graphicsPipelines.size() - 1),
-            graphicsPipelines.back());
+        for (auto frameBuffer : imguiFramebuffers)
+            vkDestroyFramebuffer(device, frameBuffer, nullptr);
     }
 
-    void CreateWireframeGraphicsPipeline(const char* vertShaderFile = "shaders/vert.spv", const char* fragShaderFile = "shaders/frag.spv", bool passLightingData = false)
+    void RecreateSwapChain()
     {
-        wireframePipelineLayouts.resize(wireframePipelineLayouts.size() + 1);
-        wireframeGraphicsPipelines.resize(wireframeGraphicsPipelines.size() + 1);
+        // Check whether window is minimized
+        int width = 0, height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        while (width == 0 || height == 0)
+        {
+            //glfwGetFramebufferSize(window, &width, &height);
+            glfwWaitEvents();
+        }
 
-        auto bindingDescription = Vertex::GetBindingDescription();
-        auto attributeDescriptions = Vertex::GetAttributeDescriptions();
-        
-        VkDescriptorSetLayout& descriptorLayout = (passLightingData) ? lightingDataDescriptorSetLayout : descriptorSetLayout;
-        const std::string name = std::string("wireframe ") + std::to_string(wireframeGraphicsPipelines.size() - 1);
-        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_LINE, VK_TRUE, VK_TRUE,
-            bindingDescription, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
-            wireframePipelineLayouts.back(), descriptorLayout, renderPass,
-            vertShaderFile, fragShaderFile, name,
-            wireframeGraphicsPipelines.back());
+        vkDeviceWaitIdle(device);
+
+        CreateSwapChain();
+        CreateImageViews();
+        CreateColorResources();
+        CreateDepthResources();
+        CreateFramebuffers();
 
-        models[models.size() - 1].wireframeIndex = wireframeGraphicsPipelines.size() - 1;
+        // We also need to take care of the UI
+        ImGui_ImplVulkan_SetMinImageCount(MAX_FRAMES_IN_FLIGHT);
+        /*CreateImGuiRenderPass();
+        CreateImGuiFramebuffers();
+        CreateImGuiCommandBuffers();*/
     }
 
-    void CreateSkyboxGraphicsPipeline(const char* vertShaderFile = "shaders/skybox_vert.spv", const char* fragShaderFile = "shaders/skybox_frag.spv")
+    void CreateInstance()
     {
-        auto bindingDescription = Skybox::GetBindingDescription();
-        auto attributeDescriptions = Skybox::GetAttributeDescriptions();
+        // Check validation layers
+        if (enableValidationLayers && !CheckValidationLayerSupport())
+            throw std::runtime_error("validation layers requested, but not available!");
 
-        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_FILL, VK_FALSE, VK_FALSE,
-            bindingDescription, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
-            skyboxPipelineLayout, descriptorSetLayout, renderPass,
-            vertShaderFile, fragShaderFile, "skybox",
-            skyboxGraphicsPipeline);
-    }
+        // Application information
+        VkApplicationInfo appInfo{};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = "Hello Triangle";
+        appInfo.applicationVersion = VK_MAKE_API_VERSION(0, 1, 0, 0);
+        appInfo.pEngineName = "No Engine";
+        appInfo.engineVersion = VK_MAKE_API_VERSION(0, 1, 0, 0);
+        appInfo.apiVersion = VK_API_VERSION_1_0;
 
-    void CreateSkyboxWireframeGraphicsPipeline(const char* vertShaderFile = "shaders/skybox_vert.spv", const char* fragShaderFile = "shaders/skybox_frag.spv")
-    {  
-        auto bindingDescription = Skybox::GetBindingDescription();
-        auto attributeDescriptions = Skybox::GetAttributeDescriptions();
+        // Global extensions and validation layers
+        VkInstanceCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        createInfo.pApplicationInfo = &appInfo;
 
-        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_LINE, VK_FALSE, VK_FALSE,
-            bindingDescription, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
-            skyboxWireframePipelineLayout, descriptorSetLayout, renderPass,
-            vertShaderFile, fragShaderFile, "skybox wireframe",
-            skyboxWireframeGraphicsPipeline);
-    }
+        std::vector<const char*> glfwExtensions = GetRequiredExtensions();  // Get extensions from GLFW
 
-    void CreateAnimatedWireframeGraphicsPipeline(const char* vertShaderFile = "shaders/linear_skinning_vert.spv", const char* fragShaderFile = "shaders/linear_skinning_frag.spv", bool passLightingData = false)
-    {
-        auto bindingDescription = Vertex::GetBindingDescription();
-        auto attributeDescriptions = Vertex::GetAttributeDescriptions();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(glfwExtensions.size());
+        createInfo.ppEnabledExtensionNames = glfwExtensions.data();
+        createInfo.enabledLayerCount = (enableValidationLayers) ? static_cast<uint32_t>(validationLayers.size()) : 0;
+        createInfo.ppEnabledLayerNames = (enableValidationLayers) ? validationLayers.data() : nullptr;
 
-        VkDescriptorSetLayout& descriptorLayout = (passLightingData) ? lightingDataDescriptorSetLayout : descriptorSetLayout;
-        const std::string name = std::string("animated wireframe ") + std::to_string(graphicsPipelines.size() - 1);
-        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_LINE, VK_TRUE, VK_TRUE,
-            bindingDescription, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
-            animatedWireframePipelineLayout, descriptorLayout, renderPass,
-            vertShaderFile, fragShaderFile, name,
-            animatedWireframeGraphicsPipeline);
-    }
+        VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
+        if (enableValidationLayers)
+        {
+            PopulateDebugMessengerCreateInfo(debugCreateInfo);
+            createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
+        }
+        else
+            createInfo.pNext = nullptr;
 
-    void CreateGridGraphicsPipeline(const char* vertShaderFile = "shaders/grid_vert.spv", const char* fragShaderFile = "shaders/grid_frag.spv")
-    {
-        auto bindingDescription = Vertex::GetBindingDescription();
-        auto attributeDescriptions = Vertex::GetAttributeDescriptions();
+        // Create instance
+        if (vkCreateInstance(&createInfo, allocationCallback, &instance) != VK_SUCCESS)
+            throw std::runtime_error("failed to create instance!");
 
-        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_FILL, VK_FALSE, VK_FALSE,
-            bindingDescription, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
-            gridPipelineLayout, gridDescriptorSetLayout, renderPass, vertShaderFile, fragShaderFile, "grid", gridGraphicsPipeline);
-    }
+        uint32_t extensionCount = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
 
-    void CreateNormalsGraphicsPipeline(bool passLightingData = false)
-    {
-        normalPipelineLayouts.resize(normalPipelineLayouts.size() + 1);
-        normalGraphicsPipelines.resize(normalGraphicsPipelines.size() + 1);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
 
-        const char* vertShaderFile = "shaders/normDisplay_vert.spv";
-        const char* fragShaderFile = "shaders/normDisplay_frag.spv";
-        const char* geomShaderFile = "shaders/normDisplay_geom.spv";
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
 
-        auto bindingDescription = Vertex::GetBindingDescription();
-        auto attributeDescriptions = Vertex::GetAttributeDescriptions();
+        std::cout << "Available extensions:\n";
+        for (const auto& extension : extensions)
+            std::cout << '\t' << extension.extensionName << '\n';
 
-        VkDescriptorSetLayout& descriptorLayout = (passLightingData) ? lightingDataDescriptorSetLayout : descriptorSetLayout;
-        const std::string name = "normal " + std::to_string(normalGraphicsPipelines.size() - 1);
-        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE,
-            bindingDescription, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
-            normalPipelineLayouts.back(), descriptorLayout, renderPass,
-            vertShaderFile, fragShaderFile, geomShaderFile, name,
-            normalGraphicsPipelines.back());
+        bool missing_extensions = false;
+        std::cout << "Required extensions:\n";
+        for (int i = 0; i < static_cast<uint32_t>(glfwExtensions.size()); i++)
+        {
+            std::cout << '\t' << glfwExtensions[i] << '\n';
+            missing_extensions = true;
+            for (const auto& extension : extensions)
+            {
+                if (std::strcmp(extension.extensionName, glfwExtensions[i]))
+                {
+                    missing_extensions = false;
+                    break;
+                }
+            }
+
+            if (missing_extensions)
+                std::cerr << "Missing extension: " << glfwExtensions[i] << std::endl;
+        }
     }
 
-    void CreateAnimatedNormalGraphicsPipeline()
+    bool CheckValidationLayerSupport()
     {
-        const char* vertShaderFile = "shaders/linear_skinning_norm_vert.spv";
-        const char* fragShaderFile = "shaders/normDisplay_frag.spv";
-        const char* geomShaderFile = "shaders/normDisplay_geom.spv";
+        uint32_t layerCount;
+        vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
 
-        auto bindingDescription = Vertex::GetBindingDescription();
-        auto attributeDescriptions = Vertex::GetAttributeDescriptions();
+        std::vector<VkLayerProperties> availableLayers(layerCount);
+        vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
 
-        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE,
-            bindingDescription, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
-            animatedNormalPipelineLayout, lightingDataDescriptorSetLayout,
-            renderPass, vertShaderFile, fragShaderFile, geomShaderFile, "animated normal", animatedNormalGraphicsPipeline);
-    }
+        for (const char* layerName : validationLayers)
+        {
+            bool layerFound = false;
+            for (const auto& layerProperties : availableLayers) {
+                if (!strcmp(layerName, layerProperties.layerName))
+                {
+                    layerFound = true;
+                    break;
+                }
+            }
 
-    void CreateUIGraphicsPipeline()
+            if (!layerFound)
+                return false;
+        }
+
+    }
+    
+    std::vector<const char*> GetRequiredExtensions()
     {
-        const char* vertShaderFile = "shaders/grid_vert.spv";
-        const char* fragShaderFile = "shaders/grid_frag.spv";
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-        auto bindingDescription = Vertex::GetBindingDescription();
-        auto attributeDescriptions = Vertex::GetAttributeDescriptions();
+        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
 
-        GraphicsPipeline tmpGraphPipeline(device, sc, VK_SAMPLE_COUNT_1_BIT, VK_FALSE, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE,
-            bindingDescription, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
-            uiPipelineLayout, imguiDescriptorSetLayout, imguiRenderPass, vertShaderFile, fragShaderFile, "imgui", uiPipeline);
-    }
+        // Conditionally add Debug Utils extension
+        if (enableValidationLayers)
+            extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
-    void CreateRenderPass()
-    {
-        const std::vector<VkFormat> formats = { sc.format, FindDepthFormat(), sc.format };
-        const std::vector<VkSampleCountFlagBits> samples = { msaaSamples, msaaSamples, VK_SAMPLE_COUNT_1_BIT };
-        const std::vector<VkAttachmentLoadOp> loadOps = { VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_DONT_CARE };
-        const std::vector<VkAttachmentStoreOp> storeOps = { VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE };
-        const std::vector<VkImageLayout> initialLayouts = { VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED };
-        //const std::vector<VkImageLayout> finalLayouts = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
-        const std::vector<VkImageLayout> finalLayouts = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
-        tmpRenderPassObj = RenderPass(device, VK_PIPELINE_BIND_POINT_GRAPHICS, formats, samples, loadOps, storeOps, initialLayouts, finalLayouts,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-            0,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-            "Main render pass", renderPass);
+        return extensions;
     }
 
-    void CreateImGuiRenderPass()
+    static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
+        VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+        VkDebugUtilsMessageTypeFlagsEXT messageType,
+        const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+        void* pUserData)
     {
-        const std::vector<VkFormat> formats = { sc.format };
-        const std::vector<VkSampleCountFlagBits> samples = { VK_SAMPLE_COUNT_1_BIT };
-        const std::vector<VkAttachmentLoadOp> loadOps = { VK_ATTACHMENT_LOAD_OP_LOAD };
-        const std::vector<VkAttachmentStoreOp> storeOps = { VK_ATTACHMENT_STORE_OP_STORE };
-        const std::vector<VkImageLayout> initialLayouts = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
-        const std::vector<VkImageLayout> finalLayouts = { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
-        RenderPass tmpImGuiRenderPass = RenderPass(device, VK_PIPELINE_BIND_POINT_GRAPHICS, formats, samples, loadOps, storeOps, initialLayouts, finalLayouts,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-            "ImGui render pass", imguiRenderPass);
+        std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+
+        return VK_FALSE;
     }
 
-    void CreateFramebuffers()
+    void SetupDebugMessenger()
     {
-        swapChainFramebuffers.resize(sc.images.size());
-
-        // Framebuffer for each image view
-        for (size_t i = 0; i < sc.imageViews.size(); i++)
-        {
-            std::array<VkImageView, 3> attachments = {
-                colorImageView,
-                depthImageView,
-                sc.imageViews[i]
-            };
+        if (!enableValidationLayers)
+            return;
 
-            VkFramebufferCreateInfo framebufferInfo{};
-            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            framebufferInfo.renderPass = renderPass;
-            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-            framebufferInfo.pAttachments = attachments.data();
-            framebufferInfo.width = sc.extent.width;
-            framebufferInfo.height = sc.extent.height;
-            framebufferInfo.layers = 1;
+        VkDebugUtilsMessengerCreateInfoEXT createInfo;
+        PopulateDebugMessengerCreateInfo(createInfo);
 
-            if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS)
-                throw std::runtime_error("failed to create framebuffer!");
-        }
+        if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS)
+            throw std::runtime_error("failed to set up debug messenger!");
     }
 
-    void CreateImGuiFramebuffers()
+    void PopulateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo)
     {
-        imguiFramebuffers.resize(sc.imageViews.size());
-
-        VkImageView attachment[1];
-        VkFramebufferCreateInfo info = {};
-        info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        info.renderPass = imguiRenderPass;
-        info.attachmentCount = 1;
-        info.pAttachments = attachment;
-        info.width = sc.extent.width;
-        info.height = sc.extent.height;
-        info.layers = 1;
-        for (uint32_t i = 0; i < sc.imageViews.size(); i++)
-        {
-            attachment[0] = sc.imageViews[i];
-            if (vkCreateFramebuffer(device, &info, nullptr, &imguiFramebuffers[i]) != VK_SUCCESS)
-                throw std::runtime_error("failed to create framebuffer!");
-        }
+        createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+        createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+        createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+        createInfo.pfnUserCallback = DebugCallback;
+        createInfo.pUserData = nullptr; // Optional
     }
 
-    void CreateCommandPools()
+    void PickPhysicalDevice()
     {
-        QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(physicalDevice);
+        uint32_t deviceCount = 0;
+        vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
 
-        // Graphics command pool
-        VkCommandPoolCreateInfo poolInfo{};
-        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+        if (deviceCount == 0)
+            throw std::runtime_error("failed to find GPUs with Vulkan support!");
 
-        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
-            throw std::runtime_error("failed to create graphics command pool!");
+        std::vector<VkPhysicalDevice> devices(deviceCount);
+        vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
-        // Transfer command pool
-        poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
-        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+#ifdef RANK_PHYSICAL_DEVICES
+        std::multimap<int, PhysicalDeviceContainer> candidates;     // Ordered map
 
-        if (vkCreateCommandPool(device, &poolInfo, nullptr, &transCommandPool) != VK_SUCCESS)
-            throw std::runtime_error("failed to create transfer command pool");
-    }
+        for (const auto& device : devices)
+        {
+            PhysicalDeviceContainer deviceContainer(device);
+            vkGetPhysicalDeviceProperties(device, &deviceContainer.properties);
+            vkGetPhysicalDeviceFeatures(device, &deviceContainer.features);
 
-    void CreateImguiCommandPool()
-    {
-        QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(physicalDevice);
+            int deviceScore = RateDeviceSuitability(deviceContainer);
+            candidates.insert(std::make_pair(deviceScore, deviceContainer));
+        }
 
-        // IMGUI command pool
-        VkCommandPoolCreateInfo poolInfo{};
-        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+        if (candidates.rbegin()->first > 0)
+            physicalDevice = candidates.rbegin()->second.device;
+        else
+            throw std::runtime_error("failed to find a suitable GPU!");
+#else
+        // Check for suitable physical device
+        for (const auto& device : devices)
+        {
+            if (IsDeviceSuitable(device))
+            {
+                physicalDevice = device;
+                break;
+            }
+        }
+#endif // RANK_PHYSICAL_DEVICES
 
-        if (vkCreateCommandPool(device, &poolInfo, nullptr, &imguiCommandPool) != VK_SUCCESS)
-            throw std::runtime_error("failed to create graphics command pool!");
+        // If no suitable physical device found
+        if (physicalDevice == VK_NULL_HANDLE)
+            throw std::runtime_error("failed to find a suitable GPU!");
+
+#ifdef COMPUTE_SKINNING
+        // Mesh ranges start at offsets the skinning pass can bind as storage buffers
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        const VkDeviceSize storageAlignment = properties.limits.minStorageBufferOffsetAlignment;
+        geometryVertexAlignment = static_cast<uint32_t>(storageAlignment / std::gcd(storageAlignment, GEOMETRY_VERTEX_STRIDE));
+#endif // COMPUTE_SKINNING
     }
 
-    void CreateCommandBuffers()
+    bool IsDeviceSuitable(VkPhysicalDevice device)
     {
-        commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
 
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = commandPool;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+        VkPhysicalDeviceFeatures deviceFeatures;
+        vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
 
-        if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
-            throw std::runtime_error("failed to allocate command buffers!");
-    }
+        QueueFamilyIndices queueIndices = FindQueueFamilies(device);
 
-    void CreateImGuiCommandBuffers()
-    {
-        imguiCommandBuffers.resize(sc.imageViews.size());
+        bool extensionsSupported = CheckDeviceExtensionSupport(device);
 
-        VkCommandBufferAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = imguiCommandPool;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = (uint32_t)imguiCommandBuffers.size();
+        bool swapChainAdequate = false;
+        if (extensionsSupported)
+        {
+            SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(device);
+            swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+        }
 
-        if (vkAllocateCommandBuffers(device, &allocInfo, imguiCommandBuffers.data()) != VK_SUCCESS)
-            throw std::runtime_error("failed to allocate command buffers!");
+#ifdef REQUIRE_GEOM_SHADERS
+        return deviceFeatures.geometryShader && deviceFeatures.samplerAnisotropy && (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) && queueIndices.IsComplete() && extensionsSupported && swapChainAdequate;
+#else
+        return (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) && queueIndices.IsComplete() && extensionsSupported && swapChainAdequate;
+#endif // REQUIRE_GEOM_SHADERS
     }
 
-    void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+    int RateDeviceSuitability(PhysicalDeviceContainer device)
     {
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = 0; // Optional
-        beginInfo.pInheritanceInfo = nullptr; // Optional
+        int score = 0;
 
-        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
-            throw std::runtime_error("failed to begin recording command buffer!");
+        if (device.properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+            score += 1000;
 
-        // Render pass
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
-        renderPassInfo.renderArea.offset = { 0, 0 };
-        renderPassInfo.renderArea.extent = sc.extent;
+        score += device.properties.limits.maxImageDimension2D;
 
-        std::array<VkClearValue, 2> clearValues{};
-        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-        clearValues[1].depthStencil = {1.0f, 0};            // Clear to furthest possible depth
-        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-        renderPassInfo.pClearValues = clearValues.data();
+#ifdef REQUIRE_GEOM_SHADERS
+        if (!device.features.geometryShader)
+            return 0;
+#endif // REQUIRE_GEOM_SHADERS
+        if (!device.features.samplerAnisotropy)
+            return 0;
 
-        // Begin render pass
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+#ifndef NO_MSAA
+        VkSampleCountFlagBits msaaSamplesNew = GetMaxUsableSampleCount(device);
+        score += msaaSamples;
 
-        // Render skybox
-#ifdef DISABLE_SKYBOX_ON_WIREFRAME
-        if (gui.skybox_flag && !gui.wireframe_flag)
-#else
-        if (gui.skybox_flag)
-#endif // DISABLE_SKYBOX_ON_WIREFRAME
+        if (msaaSamplesNew > msaaSamples)
         {
-            // Bind graphics pipeline
-            if (gui.wireframe_flag)
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxWireframeGraphicsPipeline);
-            else
-                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxGraphicsPipeline);
+            msaaSamples = msaaSamplesNew;
+            std::cout << "MSAA " << msaaSamples << "X" << std::endl;
+        }
+#endif // NO_MSAA
 
-            VkBuffer vertexBuffersRend[] = { skyboxVertexBuffer };
-            VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffersRend, offsets);
+        return score;
+    }
 
-            VkViewport viewport{};
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = static_cast<float>(sc.extent.width);
-            viewport.height = static_cast<float>(sc.extent.height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    bool CheckDeviceExtensionSupport(VkPhysicalDevice device)
+    {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
-            VkRect2D scissor{};
-            scissor.offset = { 0, 0 };
-            scissor.extent = sc.extent;
-            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-            if (gui.wireframe_flag)
-                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxWireframePipelineLayout, 0, 1, skyboxDescriptorSet.data(), 0, nullptr);
-            else
-                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxPipelineLayout, 0, 1, skyboxDescriptorSet.data(), 0, nullptr);
+        std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
 
-            vkCmdDraw(commandBuffer, static_cast<uint32_t>(108), 1, 0, 0);
-        }
+        for (const auto& extension : availableExtensions)
+            requiredExtensions.erase(extension.extensionName);
 
-        // Render grid
-        if (gui.grid_flag)
-        {
-            // Bind graphics pipeline
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gridGraphicsPipeline);
+        return requiredExtensions.empty();
+    }
 
-            VkBuffer vertexBuffersRend[] = { gridVertexBuffer };
-            VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffersRend, offsets);
-            vkCmdBindIndexBuffer(commandBuffer, gridIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+    QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device)
+    {
+        QueueFamilyIndices indices;
+        
+        uint32_t queueFamilyCount;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
 
-            VkViewport viewport{};
-            viewport.x = 0.0f;
-            viewport.y = 0.0f;
-            viewport.width = static_cast<float>(sc.extent.width);
-            viewport.height = static_cast<float>(sc.extent.height);
-            viewport.minDepth = 0.0f;
-            viewport.maxDepth = 1.0f;
-            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-            VkRect2D scissor{};
-            scissor.offset = { 0, 0 };
-            scissor.extent = sc.extent;
-            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        int i = 0;
+        for (const auto& queueFamily : queueFamilies)
+        {
+#ifdef COMPUTE_SKINNING
+            // Skinning is dispatched on the graphics queue
+            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT && queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)
+#else
+            if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+#endif // COMPUTE_SKINNING
+                indices.graphicsFamily = i;
 
-            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gridPipelineLayout, 0, 1, gridDescriptorSet.data(), 0, nullptr);
+            if (!(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT)
+                indices.transferFamily = i;
 
-            vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(gridIndices.size()), 1, 0, 0, 0);
+            VkBool32 presentSupport;
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+            if (presentSupport)
+                indices.presentFamily = i;
+
+            if (indices.IsComplete())
+                break;
+
+            i++;
         }
 
-        // Render models
-        //for (size_t i = 0; i < models.size(); i++)
-        for (size_t i = 0; i < emptyModelIndex; i++)
-        {
-            // Only render model if enabled
-            if (!models[i].enabled)
-                continue;
-
-            // Render mesh
-            for (auto& mesh : models[i].meshes)
-            {
-                // Bind graphics pipeline
-                if (gui.wireframe_flag && !mesh.animations.empty())
-                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, animatedWireframeGraphicsPipeline);
-                else if (gui.wireframe_flag && mesh.animations.empty())
-                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, wireframeGraphicsPipelines[models[i].wireframeIndex]);
-                else
-                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[models[i].pipelineIndex]);
-
-                VkBuffer vertexBuffersRend[] = { vertexBuffers[mesh.vertexBufferIndex] };
-                VkDeviceSize offsets[] = { 0 };
-                vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffersRend, offsets);
-                vkCmdBindIndexBuffer(commandBuffer, indexBuffers[mesh.vertexBufferIndex], 0, VK_INDEX_TYPE_UINT32);
+        return indices;
+    }
 
-                VkViewport viewport{};
-                viewport.x = 0.0f;
-                viewport.y = 0.0f;
-                viewport.width = static_cast<float>(sc.extent.width);
-                viewport.height = static_cast<float>(sc.extent.height);
-                viewport.minDepth = 0.0f;
-                viewport.maxDepth = 1.0f;
-                vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    void CreateLogicalDevice()
+    {
+        QueueFamilyIndices indices = FindQueueFamilies(physicalDevice);
 
-                VkRect2D scissor{};
-                scissor.offset = { 0, 0 };
-                scissor.extent = sc.extent;
-                vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+        std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
 
-                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts[models[i].pipelineIndex], 0, 1, &descriptorSets[i][currentFrame], 0, nullptr);
+        float queuePriority = 1.0f;
+        for (uint32_t queueFamily : uniqueQueueFamilies)
+        {
+            VkDeviceQueueCreateInfo queueCreateInfo{};
+            queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queueCreateInfo.queueFamilyIndex = queueFamily;
+            queueCreateInfo.queueCount = 1;
+            queueCreateInfo.pQueuePriorities = &queuePriority;
 
-                vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(mesh.indices.size()), 1, 0, 0, 0);
+            queueCreateInfos.push_back(queueCreateInfo);
+        }
 
-                // Normal drawing
-                if (!gui.normals_flag)
-                    continue;
+        // Get Device features
+        VkPhysicalDeviceFeatures deviceFeatures{};
+        deviceFeatures.samplerAnisotropy = VK_TRUE;
+        deviceFeatures.sampleRateShading = VK_TRUE;
+        deviceFeatures.fillModeNonSolid = VK_TRUE;
+#ifdef REQUIRE_GEOM_SHADERS
+        deviceFeatures.geometryShader = VK_TRUE;
+#endif // REQUIRE_GEOM_SHADERS
 
-                // Bind graphics pipeline for normal drawing
-                if (!mesh.animations.empty())
-                {
-                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, animatedNormalGraphicsPipeline);
-                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, animatedNormalPipelineLayout, 0, 1, &descriptorSets[i][currentFrame], 0, nullptr);
-                }
-                else
-                {
-                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, normalGraphicsPipelines[i]);
-                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, normalPipelineLayouts[i], 0, 1, &descriptorSets[i][currentFrame], 0, nullptr);
-                }
+        VkDeviceCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pQueueCreateInfos = queueCreateInfos.data();
+        createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+        createInfo.pEnabledFeatures = &deviceFeatures;
 
-                vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(mesh.indices.size()), 1, 0, 0, 0);
-            }
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        if (enableValidationLayers)
+        {
+            createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+            createInfo.ppEnabledLayerNames = validationLayers.data();
         }
+        else
+            createInfo.enabledLayerCount = 0;
 
-        // Record dear imgui primitives into command buffer
-        //ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+        // Instantiate device
+        if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS)
+            throw std::runtime_error("failed to create logical device!");
 
-        // End render pass
-        vkCmdEndRenderPass(commandBuffer);
+        // Retrieve queue handles
+        vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
+        vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+        vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+    }
 
-        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
-            throw std::runtime_error("failed to record command buffer!");
+    void CreateSurface()
+    {
+        if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS)
+            throw std::runtime_error("failed to create window surface!");
     }
 
-    void CreateSyncObjects()
+    SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device)
     {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        uiRenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+        SwapChainSupportDetails details;
 
-        VkSemaphoreCreateInfo semaphoreInfo{};
-        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        // Capabilities
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
 
-        VkFenceCreateInfo fenceInfo{};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        // Formats
+        uint32_t formatCount;
+        vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        if (formatCount != 0)
         {
-            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-                vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateSemaphore(device, &semaphoreInfo, nullptr, &uiRenderFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
-                throw std::runtime_error("failed to create sync objects for a frame!");
+            details.formats.resize(formatCount);
+            vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
         }
-    }
 
-    void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
-    {
-        VkBufferCreateInfo bufferInfo{};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = size;
-        bufferInfo.usage = usage;
-        //bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        // Present modes
+        uint32_t presentModeCount;
+        vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
 
-        QueueFamilyIndices indices = FindQueueFamilies(physicalDevice);
-        uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.transferFamily.value() };
-        bufferInfo.queueFamilyIndexCount = 2;
-        bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+        if (presentModeCount != 0)
+        {
+            details.presentModes.resize(presentModeCount);
+            vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
+        }
 
-        if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
-            throw std::runtime_error("failed to create vertex buffer!");
+        return details;
+    }
 
-        // Memory allocation
-        VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+    VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
+    {
+        for (const auto& availableFormat : availableFormats)
+        {
+            if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+                return availableFormat;
+        }
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+        // TODO: Consider ranking rather than returning the first format available!
+        return availableFormats[0];
+    }
 
-        if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-            throw std::runtime_error("failed to allocate vertex buffer memory!");
+    VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
+    {
+        for (const auto& availablePresentMode : availablePresentModes)
+        {
+            if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+                return availablePresentMode;
+        }
 
-        vkBindBufferMemory(device, buffer, bufferMemory, 0);
+        return VK_PRESENT_MODE_FIFO_KHR;
     }
 
-    void CreateVertexBuffer(const size_t modelIndex)
+    VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities)
     {
-        for (size_t i = 0; i < models[modelIndex].meshes.size(); i++)
+        if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
+            return capabilities.currentExtent;
+        else
         {
-#ifdef USE_ASSIMP
-            VkDeviceSize bufferSize = sizeof(models[modelIndex].meshes[i].vertices[0]) * models[modelIndex].meshes[i].vertices.size();
-#else
-            VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-#endif // USE_ASSIMP
-
-            // Staging buffer
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingBufferMemory;
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                stagingBuffer, stagingBufferMemory);
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
 
-            // Map memory
-            void* data;
-            vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-#ifdef USE_ASSIMP
-            memcpy(data, models[modelIndex].meshes[i].vertices.data(), static_cast<size_t>(bufferSize));
-#else
-            memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-#endif // USE_ASSIMP
-            vkUnmapMemory(device, stagingBufferMemory);
+            VkExtent2D actualExtent = {
+                static_cast<uint32_t>(width),
+                static_cast<uint32_t>(height)
+            };
 
-            // Resize buffer and memory vectors
-            vertexBuffers.resize(vertexBuffers.size() + 1);
-            vertexBufferMemories.resize(vertexBufferMemories.size() + 1);
+            actualExtent.width = std::clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+            actualExtent.height = std::clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
 
-            models[modelIndex].meshes[i].vertexBufferIndex = vertexBuffers.size() - 1;
+            return actualExtent;
+        }
+    }
 
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                vertexBuffers[models[modelIndex].meshes[i].vertexBufferIndex], vertexBufferMemories[models[modelIndex].meshes[i].vertexBufferIndex]);
+    void CreateSwapChain()
+    {
+        sc = Swapchain(device, physicalDevice, surface, window);
+    }
 
-            CopyBuffer(stagingBuffer, vertexBuffers[models[modelIndex].meshes[i].vertexBufferIndex], bufferSize);
+    void CreateImageViews()
+    {
+        sc.imageViews.resize(sc.images.size());
 
-            vkDestroyBuffer(device, stagingBuffer, nullptr);
-            vkFreeMemory(device, stagingBufferMemory, nullptr);
+        for (size_t i = 0; i < sc.images.size(); i++)
+        {
+            sc.imageViews[i] = CreateImageView(sc.images[i], 1, sc.format, VK_IMAGE_ASPECT_COLOR_BIT);
         }
     }
 
-    void CreateIndexBuffer(const size_t modelIndex)
+    /// <summary>
+    /// Vertex streams read by model pipelines: Vertex, or with COMPACT_VERTICES CompactVertex, plus SkinningVertex for skinned pipelines
+    /// </summary>
+    /// <param name="skinned">: whether the vertex shader skins</param>
+    /// <param name="bindings">: output bindings</param>
+    /// <param name="attributes">: output attributes</param>
+    void GetModelVertexInput(const bool skinned, std::vector<VkVertexInputBindingDescription>& bindings, std::vector<VkVertexInputAttributeDescription>& attributes) const
     {
-        for (size_t i = 0; i < models[modelIndex].meshes.size(); i++)
+#ifdef COMPACT_VERTICES
+        const auto compactAttributes = CompactVertex::GetAttributeDescriptions();
+        bindings = { CompactVertex::GetBindingDescription() };
+        attributes.assign(compactAttributes.begin(), compactAttributes.end());
+
+        if (skinned)
         {
-#ifdef USE_ASSIMP
-            VkDeviceSize bufferSize = sizeof(models[modelIndex].meshes[i].indices[0]) * models[modelIndex].meshes[i].indices.size();
+            const auto skinningAttributes = SkinningVertex::GetAttributeDescriptions();
+            bindings.push_back(SkinningVertex::GetBindingDescription());
+            attributes.insert(attributes.end(), skinningAttributes.begin(), skinningAttributes.end());
+        }
 #else
-            VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-#endif // USE_ASSIMP
-
-            // Staging buffer
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingBufferMemory;
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                stagingBuffer, stagingBufferMemory);
+        const auto vertexAttributes = Vertex::GetAttributeDescriptions();
+        bindings = { Vertex::GetBindingDescription() };
+        attributes.assign(vertexAttributes.begin(), vertexAttributes.end());
+#endif // COMPACT_VERTICES
+    }
 
-            // Map memory
-            void* data;
-            vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-#ifdef USE_ASSIMP
-            memcpy(data, models[modelIndex].meshes[i].indices.data(), static_cast<size_t>(bufferSize));
-#else
-            memcpy(data, indices.data(), static_cast<size_t>(bufferSize));
-#endif // USE_ASSIMP
-            vkUnmapMemory(device, stagingBufferMemory);
+    void CreateGraphicsPipeline(const std::string& vertShaderFile = ModelShaderFile("simple_tri"), const char* fragShaderFile = "shaders/frag.spv", bool passLightingData = false,
+        const char* geomShaderFile = "shaders/geom.spv", bool skinned = false)
+    {
+        pipelineLayouts.resize(pipelineLayouts.size() + 1);
+        graphicsPipelines.resize(graphicsPipelines.size() + 1);
 
-            // Resize buffer and memory vectors
-            indexBuffers.resize(indexBuffers.size() + 1);
-            indexBufferMemories.resize(indexBufferMemories.size() + 1);
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+        GetModelVertexInput(skinned, bindingDescriptions, attributeDescriptions);
 
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                indexBuffers[models[modelIndex].meshes[i].vertexBufferIndex], indexBufferMemories[models[modelIndex].meshes[i].vertexBufferIndex]);
+        VkDescriptorSetLayout& descriptorLayout = (passLightingData) ? lightingDataDescriptorSetLayout : descriptorSetLayout;
+        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE,
+            bindingDescriptions, attributeDescriptions,
+            pipelineLayouts.back(), descriptorLayout, renderPass,
+            vertShaderFile.c_str(), fragShaderFile, geomShaderFile, std::to_string(graphicsPipelines.size() - 1),
+            graphicsPipelines.back(), MODEL_DEPTH_COMPARE_OP);
+    }
 
-            CopyBuffer(stagingBuffer, indexBuffers[models[modelIndex].meshes[i].vertexBufferIndex], bufferSize);
+    void CreateWireframeGraphicsPipeline(const std::string& vertShaderFile = ModelShaderFile("simple_tri"), const char* fragShaderFile = "shaders/frag.spv", bool passLightingData = false)
+    {
+        wireframePipelineLayouts.resize(wireframePipelineLayouts.size() + 1);
+        wireframeGraphicsPipelines.resize(wireframeGraphicsPipelines.size() + 1);
 
-            vkDestroyBuffer(device, stagingBuffer, nullptr);
-            vkFreeMemory(device, stagingBufferMemory, nullptr);
-        }
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+        GetModelVertexInput(false, bindingDescriptions, attributeDescriptions);
+        
+        VkDescriptorSetLayout& descriptorLayout = (passLightingData) ? lightingDataDescriptorSetLayout : descriptorSetLayout;
+        const std::string name = std::string("wireframe ") + std::to_string(wireframeGraphicsPipelines.size() - 1);
+        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_LINE, VK_TRUE, VK_TRUE,
+            bindingDescriptions, attributeDescriptions,
+            wireframePipelineLayouts.back(), descriptorLayout, renderPass,
+            vertShaderFile.c_str(), fragShaderFile, name,
+            wireframeGraphicsPipelines.back());
     }
 
-    void CreateGridIndexBuffer()
+    void CreateSkyboxGraphicsPipeline(const char* vertShaderFile = "shaders/skybox_vert.spv", const char* fragShaderFile = "shaders/skybox_frag.spv")
     {
-        VkDeviceSize bufferSize = sizeof(gridIndices[0]) * gridIndices.size();
+        auto bindingDescription = Skybox::GetBindingDescription();
+        auto attributeDescriptions = Skybox::GetAttributeDescriptions();
 
-        // Staging buffer
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory);
+        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_FILL, VK_FALSE, VK_FALSE,
+            { bindingDescription }, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
+            skyboxPipelineLayout, descriptorSetLayout, renderPass,
+            vertShaderFile, fragShaderFile, "skybox",
+            skyboxGraphicsPipeline);
+    }
 
-        // Map memory
-        void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, gridIndices.data(), static_cast<size_t>(bufferSize));
-        vkUnmapMemory(device, stagingBufferMemory);
+    void CreateSkyboxWireframeGraphicsPipeline(const char* vertShaderFile = "shaders/skybox_vert.spv", const char* fragShaderFile = "shaders/skybox_frag.spv")
+    {  
+        auto bindingDescription = Skybox::GetBindingDescription();
+        auto attributeDescriptions = Skybox::GetAttributeDescriptions();
 
-        CreateBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            gridIndexBuffer, gridIndexBufferMemory);
+        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_LINE, VK_FALSE, VK_FALSE,
+            { bindingDescription }, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
+            skyboxWireframePipelineLayout, descriptorSetLayout, renderPass,
+            vertShaderFile, fragShaderFile, "skybox wireframe",
+            skyboxWireframeGraphicsPipeline);
+    }
 
-        CopyBuffer(stagingBuffer, gridIndexBuffer, bufferSize);
+    void CreateAnimatedWireframeGraphicsPipeline(const std::string& vertShaderFile = PaletteShaderFile("linear_skinning", "vert"), const char* fragShaderFile = "shaders/linear_skinning_frag.spv",
+        bool passLightingData = false, bool skinned = true)
+    {
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+        GetModelVertexInput(skinned, bindingDescriptions, attributeDescriptions);
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        VkDescriptorSetLayout& descriptorLayout = (passLightingData) ? lightingDataDescriptorSetLayout : descriptorSetLayout;
+        const std::string name = std::string("animated wireframe ") + std::to_string(graphicsPipelines.size() - 1);
+        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_LINE, VK_TRUE, VK_TRUE,
+            bindingDescriptions, attributeDescriptions,
+            animatedWireframePipelineLayout, descriptorLayout, renderPass,
+            vertShaderFile.c_str(), fragShaderFile, name,
+            animatedWireframeGraphicsPipeline);
     }
 
-    void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize bufferSize)
+    void CreateGridGraphicsPipeline(const char* vertShaderFile = "shaders/grid_vert.spv", const char* fragShaderFile = "shaders/grid_frag.spv")
     {
-        VkCommandBuffer commandBuffer = BeginSingleTimeCommands(transCommandPool);
+        auto bindingDescription = Vertex::GetBindingDescription();
+        auto attributeDescriptions = Vertex::GetAttributeDescriptions();
 
-        VkBufferCopy copyRegion{};
-        copyRegion.srcOffset = 0; // Optional
-        copyRegion.dstOffset = 0; // Optional
-        copyRegion.size = bufferSize;
-        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_FILL, VK_FALSE, VK_FALSE,
+            { bindingDescription }, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
+            gridPipelineLayout, gridDescriptorSetLayout, renderPass, vertShaderFile, fragShaderFile, "grid", gridGraphicsPipeline);
+    }
 
-        EndSingleTimeCommands(commandBuffer, transCommandPool, transferQueue);
+    void CreateNormalsGraphicsPipeline(bool passLightingData = false)
+    {
+        normalPipelineLayouts.resize(normalPipelineLayouts.size() + 1);
+        normalGraphicsPipelines.resize(normalGraphicsPipelines.size() + 1);
+
+        const std::string vertShaderFile = ModelShaderFile("normDisplay");
+        const char* fragShaderFile = "shaders/normDisplay_frag.spv";
+        const char* geomShaderFile = "shaders/normDisplay_geom.spv";
+
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+        GetModelVertexInput(false, bindingDescriptions, attributeDescriptions);
+
+        VkDescriptorSetLayout& descriptorLayout = (passLightingData) ? lightingDataDescriptorSetLayout : descriptorSetLayout;
+        const std::string name = "normal " + std::to_string(normalGraphicsPipelines.size() - 1);
+        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE,
+            bindingDescriptions, attributeDescriptions,
+            normalPipelineLayouts.back(), descriptorLayout, renderPass,
+            vertShaderFile.c_str(), fragShaderFile, geomShaderFile, name,
+            normalGraphicsPipelines.back());
     }
 
-    uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+    void CreateAnimatedNormalGraphicsPipeline()
     {
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+        const std::string vertShaderFile = PaletteShaderFile("linear_skinning_norm", "vert");
+        const char* fragShaderFile = "shaders/normDisplay_frag.spv";
+        const char* geomShaderFile = "shaders/normDisplay_geom.spv";
 
-        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+        GetModelVertexInput(true, bindingDescriptions, attributeDescriptions);
+
+        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE,
+            bindingDescriptions, attributeDescriptions,
+            animatedNormalPipelineLayout, lightingDataDescriptorSetLayout,
+            renderPass, vertShaderFile.c_str(), fragShaderFile, geomShaderFile, "animated normal", animatedNormalGraphicsPipeline);
+    }
+
+#ifdef DEPTH_PREPASS
+    /// <summary>
+    /// Creates a depth-only pipeline that reads the position stream of DepthPositionVertex, plus the DepthSkinningVertex stream if it skins
+    /// </summary>
+    void CreateDepthGraphicsPipeline(bool passLightingData = false, bool skinned = false)
+    {
+        depthPipelineLayouts.resize(depthPipelineLayouts.size() + 1);
+        depthGraphicsPipelines.resize(depthGraphicsPipelines.size() + 1);
+
+        const std::string vertShaderFile = (skinned) ? PaletteShaderFile("depth_skinning", "vert") : ModelShaderFile("depth_only");
+
+        const auto positionAttributes = DepthPositionVertex::GetAttributeDescriptions();
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions = { DepthPositionVertex::GetBindingDescription() };
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions(positionAttributes.begin(), positionAttributes.end());
+        if (skinned)
         {
-            if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-                return i;
+            const auto skinningAttributes = DepthSkinningVertex::GetAttributeDescriptions();
+            bindingDescriptions.push_back(DepthSkinningVertex::GetBindingDescription());
+            attributeDescriptions.insert(attributeDescriptions.end(), skinningAttributes.begin(), skinningAttributes.end());
+        }
+
+        VkDescriptorSetLayout& descriptorLayout = (passLightingData) ? lightingDataDescriptorSetLayout : descriptorSetLayout;
+        const std::string name = "depth " + std::to_string(depthGraphicsPipelines.size() - 1);
+        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples,
+            bindingDescriptions, attributeDescriptions,
+            depthPipelineLayouts.back(), descriptorLayout, renderPass,
+            vertShaderFile.c_str(), name,
+            depthGraphicsPipelines.back());
+    }
+#endif // DEPTH_PREPASS
+
+    void CreateUIGraphicsPipeline()
+    {
+        const char* vertShaderFile = "shaders/grid_vert.spv";
+        const char* fragShaderFile = "shaders/grid_frag.spv";
+
+        auto bindingDescription = Vertex::GetBindingDescription();
+        auto attributeDescriptions = Vertex::GetAttributeDescriptions();
+
+        GraphicsPipeline tmpGraphPipeline(device, sc, VK_SAMPLE_COUNT_1_BIT, VK_FALSE, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE,
+            { bindingDescription }, std::vector<VkVertexInputAttributeDescription>(attributeDescriptions.begin(), attributeDescriptions.end()),
+            uiPipelineLayout, imguiDescriptorSetLayout, imguiRenderPass, vertShaderFile, fragShaderFile, "imgui", uiPipeline);
+    }
+
+    void CreateRenderPass()
+    {
+        const std::vector<VkFormat> formats = { sc.format, FindDepthFormat(), sc.format };
+        const std::vector<VkSampleCountFlagBits> samples = { msaaSamples, msaaSamples, VK_SAMPLE_COUNT_1_BIT };
+        const std::vector<VkAttachmentLoadOp> loadOps = { VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_LOAD_OP_DONT_CARE };
+        const std::vector<VkAttachmentStoreOp> storeOps = { VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_STORE };
+        const std::vector<VkImageLayout> initialLayouts = { VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED };
+        //const std::vector<VkImageLayout> finalLayouts = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+        const std::vector<VkImageLayout> finalLayouts = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        tmpRenderPassObj = RenderPass(device, VK_PIPELINE_BIND_POINT_GRAPHICS, formats, samples, loadOps, storeOps, initialLayouts, finalLayouts,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+            0,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            "Main render pass", renderPass);
+    }
+
+    void CreateImGuiRenderPass()
+    {
+        const std::vector<VkFormat> formats = { sc.format };
+        const std::vector<VkSampleCountFlagBits> samples = { VK_SAMPLE_COUNT_1_BIT };
+        const std::vector<VkAttachmentLoadOp> loadOps = { VK_ATTACHMENT_LOAD_OP_LOAD };
+        const std::vector<VkAttachmentStoreOp> storeOps = { VK_ATTACHMENT_STORE_OP_STORE };
+        const std::vector<VkImageLayout> initialLayouts = { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        const std::vector<VkImageLayout> finalLayouts = { VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+        RenderPass tmpImGuiRenderPass = RenderPass(device, VK_PIPELINE_BIND_POINT_GRAPHICS, formats, samples, loadOps, storeOps, initialLayouts, finalLayouts,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            "ImGui render pass", imguiRenderPass);
+    }
+
+    void CreateFramebuffers()
+    {
+        swapChainFramebuffers.resize(sc.images.size());
+
+        // Framebuffer for each image view
+        for (size_t i = 0; i < sc.imageViews.size(); i++)
+        {
+            std::array<VkImageView, 3> attachments = {
+                colorImageView,
+                depthImageView,
+                sc.imageViews[i]
+            };
+
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = sc.extent.width;
+            framebufferInfo.height = sc.extent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS)
+                throw std::runtime_error("failed to create framebuffer!");
+        }
+    }
+
+    void CreateImGuiFramebuffers()
+    {
+        imguiFramebuffers.resize(sc.imageViews.size());
+
+        VkImageView attachment[1];
+        VkFramebufferCreateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        info.renderPass = imguiRenderPass;
+        info.attachmentCount = 1;
+        info.pAttachments = attachment;
+        info.width = sc.extent.width;
+        info.height = sc.extent.height;
+        info.layers = 1;
+        for (uint32_t i = 0; i < sc.imageViews.size(); i++)
+        {
+            attachment[0] = sc.imageViews[i];
+            if (vkCreateFramebuffer(device, &info, nullptr, &imguiFramebuffers[i]) != VK_SUCCESS)
+                throw std::runtime_error("failed to create framebuffer!");
         }
+    }
+
+    void CreateCommandPools()
+    {
+        QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(physicalDevice);
+
+        // Graphics command pool
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create graphics command pool!");
+
+        // Transfer command pool
+        poolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &transCommandPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create transfer command pool");
+    }
+
+    void CreateImguiCommandPool()
+    {
+        QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(physicalDevice);
+
+        // IMGUI command pool
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &imguiCommandPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create graphics command pool!");
+    }
+
+    void CreateCommandBuffers()
+    {
+        commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate command buffers!");
+    }
+
+    void CreateImGuiCommandBuffers()
+    {
+        imguiCommandBuffers.resize(sc.imageViews.size());
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = imguiCommandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = (uint32_t)imguiCommandBuffers.size();
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, imguiCommandBuffers.data()) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate command buffers!");
+    }
+
+    void RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+    {
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = 0; // Optional
+        beginInfo.pInheritanceInfo = nullptr; // Optional
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+            throw std::runtime_error("failed to begin recording command buffer!");
+
+#ifdef ANIMATION_BENCHMARK
+        vkCmdResetQueryPool(commandBuffer, timestampQueryPool, 2 * currentFrame, 2);
+#endif // ANIMATION_BENCHMARK
+
+#ifdef COMPUTE_SKINNING
+        RecordSkinningPass(commandBuffer);
+#endif // COMPUTE_SKINNING
+#ifdef GPU_ANIMATION
+        if (models[crowdModelIndex].enabled && crowd.Size() > 0)
+            RecordAnimationPass(commandBuffer, currentFrame);
+#endif // GPU_ANIMATION
+#ifdef CLUSTER_CULLING
+        RecordClusterCullPass(commandBuffer);
+#endif // CLUSTER_CULLING
+
+        // Render pass
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        renderPassInfo.renderArea.offset = { 0, 0 };
+        renderPassInfo.renderArea.extent = sc.extent;
+
+        std::array<VkClearValue, 2> clearValues{};
+        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        clearValues[1].depthStencil = {1.0f, 0};            // Clear to furthest possible depth
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+
+        // Begin render pass
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        // Render skybox
+#ifdef DISABLE_SKYBOX_ON_WIREFRAME
+        if (gui.skybox_flag && !gui.wireframe_flag)
+#else
+        if (gui.skybox_flag)
+#endif // DISABLE_SKYBOX_ON_WIREFRAME
+        {
+            // Bind graphics pipeline
+            if (gui.wireframe_flag)
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxWireframeGraphicsPipeline);
+            else
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxGraphicsPipeline);
+
+            VkBuffer vertexBuffersRend[] = { skyboxVertexBuffer };
+            VkDeviceSize offsets[] = { 0 };
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffersRend, offsets);
+
+            VkViewport viewport{};
+            viewport.x = 0.0f;
+            viewport.y = 0.0f;
+            viewport.width = static_cast<float>(sc.extent.width);
+            viewport.height = static_cast<float>(sc.extent.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+            VkRect2D scissor{};
+            scissor.offset = { 0, 0 };
+            scissor.extent = sc.extent;
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+            if (gui.wireframe_flag)
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxWireframePipelineLayout, 0, 1, skyboxDescriptorSet.data(), 0, nullptr);
+            else
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, skyboxPipelineLayout, 0, 1, skyboxDescriptorSet.data(), 0, nullptr);
+
+            vkCmdDraw(commandBuffer, static_cast<uint32_t>(108), 1, 0, 0);
+        }
+
+        // Render grid
+        if (gui.grid_flag)
+        {
+            // Bind graphics pipeline
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gridGraphicsPipeline);
+
+            VkBuffer vertexBuffersRend[] = { gridVertexBuffer };
+            VkDeviceSize offsets[] = { 0 };
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffersRend, offsets);
+            vkCmdBindIndexBuffer(commandBuffer, gridIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+
+            VkViewport viewport{};
+            viewport.x = 0.0f;
+            viewport.y = 0.0f;
+            viewport.width = static_cast<float>(sc.extent.width);
+            viewport.height = static_cast<float>(sc.extent.height);
+            viewport.minDepth = 0.0f;
+            viewport.maxDepth = 1.0f;
+            vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+            VkRect2D scissor{};
+            scissor.offset = { 0, 0 };
+            scissor.extent = sc.extent;
+            vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gridPipelineLayout, 0, 1, gridDescriptorSet.data(), 0, nullptr);
+
+            vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(gridIndices.size()), 1, 0, 0, 0);
+        }
+
+        // Render models
+        //for (size_t i = 0; i < models.size(); i++)
+#ifdef ANIMATION_BENCHMARK
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, 2 * currentFrame);
+#endif // ANIMATION_BENCHMARK
+
+#ifdef DEPTH_PREPASS
+        // Wireframes are lines, which the filled depth of the pre-pass would hide
+        if (gui.depth_prepass_flag && !gui.wireframe_flag)
+            RecordDepthPrepass(commandBuffer);
+#endif // DEPTH_PREPASS
+
+        // Geometry blocks are only rebound when a mesh lives in another block than the one before
+        uint32_t boundVertexBlock = std::numeric_limits<uint32_t>::max(), boundIndexBlock = std::numeric_limits<uint32_t>::max();
+        for (size_t i = 0; i < emptyModelIndex; i++)
+        {
+            // Only render model if enabled and uploaded
+            if (!models[i].resident || !models[i].enabled)
+                continue;
+
+            // Render mesh
+            for (auto& mesh : models[i].meshes)
+            {
+                const GeometryBlock& block = geometryBlocks[mesh.geometry.block];
+                const MeshLod& lod = mesh.Lod(models[i].lodLevel);
+                uint32_t pipelineIndex = models[i].pipelineIndex;
+                int32_t vertexOffset = static_cast<int32_t>(mesh.geometry.firstVertex);
+                bool vertexShaderSkinning = !mesh.animations.empty();
+                bool postSkinVertices = false;
+#ifdef COMPUTE_SKINNING
+                // Skinned meshes are drawn from this frame's post-skin vertex buffer, as static meshes
+                if (mesh.skinnedBufferIndex >= 0)
+                {
+                    pipelineIndex = skinnedPipelineIndex;
+                    vertexShaderSkinning = false;
+                    postSkinVertices = true;
+                    vertexOffset = 0;
+
+                    VkBuffer vertexBuffersRend[] = { skinnedVertexBuffers[mesh.skinnedBufferIndex][currentFrame] };
+                    VkDeviceSize offsets[] = { 0 };
+                    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffersRend, offsets);
+                    boundVertexBlock = std::numeric_limits<uint32_t>::max();
+                }
+#endif // COMPUTE_SKINNING
+
+                // Bind graphics pipeline
+                if (gui.wireframe_flag && !mesh.animations.empty())
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, animatedWireframeGraphicsPipeline);
+                else if (gui.wireframe_flag && mesh.animations.empty())
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, wireframeGraphicsPipelines[models[i].wireframeIndex]);
+                else
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[pipelineIndex]);
+
+                if (boundVertexBlock != mesh.geometry.block && !postSkinVertices)
+                {
+                    BindGeometryBlock(commandBuffer, block);
+                    boundVertexBlock = mesh.geometry.block;
+                }
+                BindMeshIndexBuffer(commandBuffer, mesh, boundIndexBlock);
+
+                VkViewport viewport{};
+                viewport.x = 0.0f;
+                viewport.y = 0.0f;
+                viewport.width = static_cast<float>(sc.extent.width);
+                viewport.height = static_cast<float>(sc.extent.height);
+                viewport.minDepth = 0.0f;
+                viewport.maxDepth = 1.0f;
+                vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+                VkRect2D scissor{};
+                scissor.offset = { 0, 0 };
+                scissor.extent = sc.extent;
+                vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts[pipelineIndex], 0, 1, &descriptorSets[i][currentFrame], 0, nullptr);
+
+                DrawMesh(commandBuffer, mesh, lod, vertexOffset);
+
+                // Normal drawing
+                if (!gui.normals_flag)
+                    continue;
+
+                // Bind graphics pipeline for normal drawing
+                if (vertexShaderSkinning)
+                {
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, animatedNormalGraphicsPipeline);
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, animatedNormalPipelineLayout, 0, 1, &descriptorSets[i][currentFrame], 0, nullptr);
+                }
+                else
+                {
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, normalGraphicsPipelines[models[i].normalIndex]);
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, normalPipelineLayouts[models[i].normalIndex], 0, 1, &descriptorSets[i][currentFrame], 0, nullptr);
+                }
+
+                DrawMesh(commandBuffer, mesh, lod, vertexOffset);
+            }
+        }
+
+#ifdef ANIMATION_BENCHMARK
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, 2 * currentFrame + 1);
+        timestampsWritten[currentFrame] = true;
+#endif // ANIMATION_BENCHMARK
+
+#ifdef BAKED_CROWD
+        // Render crowd, all instances in one draw
+        if (models[crowdModelIndex].enabled && crowd.Size() > 0)
+        {
+            const Mesh& mesh = models[crowdModelIndex].meshes[0];
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, crowdGraphicsPipeline);
+
+            BindGeometryBlock(commandBuffer, geometryBlocks[mesh.geometry.block]);
+            vkCmdBindIndexBuffer(commandBuffer, geometryBlocks[mesh.geometry.block].indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, crowdPipelineLayout, 0, 1, &crowdDescriptorSets[currentFrame], 0, nullptr);
+
+            vkCmdDrawIndexed(commandBuffer, mesh.lods[0].indexCount, crowd.Size(), mesh.geometry.firstIndex, static_cast<int32_t>(mesh.geometry.firstVertex), 0);
+        }
+#endif // BAKED_CROWD
+
+        // Record dear imgui primitives into command buffer
+        //ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+
+        // End render pass
+        vkCmdEndRenderPass(commandBuffer);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("failed to record command buffer!");
+    }
+
+#ifdef DEPTH_PREPASS
+    /// <summary>
+    /// Records the depth of the resident models from their position streams, in the render pass before the models are shaded.
+    /// Exploding models are left out, as the geometry shader moves their shaded triangles away from the pre-pass depth
+    /// </summary>
+    void RecordDepthPrepass(VkCommandBuffer commandBuffer)
+    {
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(sc.extent.width);
+        viewport.height = static_cast<float>(sc.extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor{};
+        scissor.offset = { 0, 0 };
+        scissor.extent = sc.extent;
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        uint32_t boundBlock = std::numeric_limits<uint32_t>::max(), boundIndexBlock = std::numeric_limits<uint32_t>::max();
+        for (size_t i = 0; i < emptyModelIndex; i++)
+        {
+            if (!models[i].resident || !models[i].enabled || gui.explode_flags[i])
+                continue;
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthGraphicsPipelines[models[i].depthIndex]);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPipelineLayouts[models[i].depthIndex], 0, 1, &descriptorSets[i][currentFrame], 0, nullptr);
+
+            for (const Mesh& mesh : models[i].meshes)
+            {
+#ifdef COMPUTE_SKINNING
+                // Shaded from the post-skin vertex buffer, which the bind pose position stream doesn't match
+                if (mesh.skinnedBufferIndex >= 0)
+                    continue;
+#endif // COMPUTE_SKINNING
+
+                // Position stream and skin stream of the block, bound once for all of its meshes
+                if (boundBlock != mesh.geometry.block)
+                {
+                    const GeometryBlock& block = geometryBlocks[mesh.geometry.block];
+                    VkBuffer vertexBuffersRend[] = { block.positionBuffer, block.skinningBuffer };
+                    VkDeviceSize offsets[] = { 0, 0 };
+                    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffersRend, offsets);
+                    boundBlock = mesh.geometry.block;
+                }
+                BindMeshIndexBuffer(commandBuffer, mesh, boundIndexBlock);
+
+                // The level and meshlets the model is shaded with, so the depths match
+                DrawMesh(commandBuffer, mesh, mesh.Lod(models[i].lodLevel), static_cast<int32_t>(mesh.geometry.firstVertex));
+            }
+        }
+    }
+#endif // DEPTH_PREPASS
+
+    void CreateSyncObjects()
+    {
+        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+        uiRenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+                vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
+                vkCreateSemaphore(device, &semaphoreInfo, nullptr, &uiRenderFinishedSemaphores[i]) != VK_SUCCESS ||
+                vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+                throw std::runtime_error("failed to create sync objects for a frame!");
+        }
+    }
+
+#ifdef ANIMATION_BENCHMARK
+    void CreateTimestampQueryPool()
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        timestampPeriod = properties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = static_cast<uint32_t>(2 * MAX_FRAMES_IN_FLIGHT);
+
+        if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampQueryPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create query pool!");
+    }
+
+    /// <summary>
+    /// Reads the model draw timestamps of a frame, once its fence has been waited on
+    /// </summary>
+    /// <param name="frame"></param>
+    void ReadTimestamps(uint32_t frame)
+    {
+        if (!timestampsWritten[frame])
+            return;
+
+        uint64_t timestamps[2];
+        if (vkGetQueryPoolResults(device, timestampQueryPool, 2 * frame, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+            gui.model_pass_ms = static_cast<float>((timestamps[1] - timestamps[0]) * timestampPeriod * 1.0e-6);
+    }
+#endif // ANIMATION_BENCHMARK
+
+    void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+    {
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        //bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+
+        QueueFamilyIndices indices = FindQueueFamilies(physicalDevice);
+        uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.transferFamily.value() };
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+
+        if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+            throw std::runtime_error("failed to create vertex buffer!");
+
+        // Memory allocation
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
+
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate vertex buffer memory!");
+
+        vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    }
+
+    /// <summary>
+    /// Suballocates the meshes of a model from the geometry arena and uploads their vertex streams: Vertex or CompactVertex,
+    /// the skin stream of skinned meshes and the position stream of the depth pre-pass
+    /// </summary>
+    void CreateVertexBuffer(const size_t modelIndex)
+    {
+#ifdef MODEL_IMPORT_DEBUG
+        VkDeviceSize uploadedBytes = 0, vertexBytes = 0;
+#endif // MODEL_IMPORT_DEBUG
+
+        // Every mesh is allocated before any is uploaded, as an allocation may compact the block and move the ranges allocated before it
+        for (Mesh& mesh : models[modelIndex].meshes)
+        {
+#ifdef USE_ASSIMP
+            const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+            const uint32_t indexCount = static_cast<uint32_t>(mesh.indices.size());
+#else
+            const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+            const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+#endif // USE_ASSIMP
+            AllocateGeometry(vertexCount, indexCount, static_cast<uint32_t>(mesh.meshlets.size()), mesh.geometry);
+        }
+
+        for (size_t i = 0; i < models[modelIndex].meshes.size(); i++)
+        {
+            Mesh& mesh = models[modelIndex].meshes[i];
+#ifdef USE_ASSIMP
+            const std::vector<Vertex>& meshVertices = mesh.vertices;
+            const size_t indexCount = mesh.indices.size();
+#else
+            const std::vector<Vertex>& meshVertices = vertices;
+            const size_t indexCount = indices.size();
+#endif // USE_ASSIMP
+#ifdef COMPACT_VERTICES
+            std::vector<CompactVertex> compactVertices;
+            PackVertices(meshVertices, models[modelIndex].boundsMin, models[modelIndex].boundsMax, compactVertices);
+            const void* vertexData = compactVertices.data();
+#else
+            const void* vertexData = meshVertices.data();
+#endif // COMPACT_VERTICES
+
+            // Meshes that weren't simplified draw the full mesh at every level
+            if (mesh.lods.empty())
+                mesh.lods.push_back({ 0, static_cast<uint32_t>(indexCount), 0.0f });
+
+            const GeometryBlock& block = geometryBlocks[mesh.geometry.block];
+
+            VkDeviceSize bufferSize = UploadToBuffer(vertexData, GEOMETRY_VERTEX_STRIDE * meshVertices.size(),
+                block.vertexBuffer, GEOMETRY_VERTEX_STRIDE * mesh.geometry.firstVertex);
+
+#if defined(COMPACT_VERTICES) || defined(DEPTH_PREPASS)
+            // Only meshes skinned in the vertex shader read bone influences
+            if (!models[modelIndex].meshes[0].animations.empty())
+                bufferSize += UploadSkinningStream(meshVertices, mesh.geometry, models[modelIndex].name);
+#endif // COMPACT_VERTICES || DEPTH_PREPASS
+
+#ifdef DEPTH_PREPASS
+            // Position-only stream of the depth pre-pass, decoded like the shading pass positions
+            std::vector<DepthPositionVertex> positionVertices;
+#ifdef COMPACT_VERTICES
+            PackPositions(compactVertices, positionVertices);
+#else
+            PackPositions(meshVertices, positionVertices);
+#endif // COMPACT_VERTICES
+            bufferSize += UploadToBuffer(positionVertices.data(), sizeof(DepthPositionVertex) * positionVertices.size(),
+                block.positionBuffer, sizeof(DepthPositionVertex) * mesh.geometry.firstVertex);
+#endif // DEPTH_PREPASS
+
+#ifdef MODEL_IMPORT_DEBUG
+            uploadedBytes += bufferSize;
+            vertexBytes += sizeof(Vertex) * meshVertices.size();
+#endif // MODEL_IMPORT_DEBUG
+        }
+
+#ifdef MODEL_IMPORT_DEBUG
+        std::cout << "Uploaded " << uploadedBytes / 1024 << " KB of vertex data for " << models[modelIndex].name << " (" << vertexBytes / 1024 << " KB as Vertex)" << std::endl;
+#endif // MODEL_IMPORT_DEBUG
+    }
+
+#if defined(COMPACT_VERTICES) || defined(DEPTH_PREPASS)
+    /// <summary>
+    /// Uploads the bone IDs and weights of a mesh as a SkinningVertex stream, or a FloatSkinningVertex stream for depth passes without COMPACT_VERTICES,
+    /// into the skinning buffer of its geometry block
+    /// </summary>
+    /// <returns>Size of the stream in bytes</returns>
+    VkDeviceSize UploadSkinningStream(const std::vector<Vertex>& meshVertices, const GeometryAllocation& geometry, const std::string& modelName)
+    {
+#ifdef COMPACT_VERTICES
+        std::vector<SkinningVertex> skinningVertices;
+        if (!PackSkinning(meshVertices, skinningVertices))
+            throw std::runtime_error("bone IDs of " + modelName + " don't fit in the compact skinning stream!");
+#else
+        std::vector<FloatSkinningVertex> skinningVertices;
+        PackSkinning(meshVertices, skinningVertices);
+#endif // COMPACT_VERTICES
+
+        return UploadToBuffer(skinningVertices.data(), sizeof(DepthSkinningVertex) * skinningVertices.size(),
+            geometryBlocks[geometry.block].skinningBuffer, sizeof(DepthSkinningVertex) * geometry.firstVertex);
+    }
+#endif // COMPACT_VERTICES || DEPTH_PREPASS
+
+    /// <summary>
+    /// Copies data into a device local buffer at an offset, through a staging buffer
+    /// </summary>
+    /// <returns>Size of the data in bytes</returns>
+    VkDeviceSize UploadToBuffer(const void* sourceData, const VkDeviceSize bufferSize, VkBuffer dstBuffer, const VkDeviceSize dstOffset)
+    {
+        if (bufferSize == 0)
+            return 0;
+
+        // Staging buffer
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            stagingBuffer, stagingBufferMemory);
+
+        // Map memory
+        void* data;
+        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        memcpy(data, sourceData, static_cast<size_t>(bufferSize));
+        vkUnmapMemory(device, stagingBufferMemory);
+
+        CopyBuffer(stagingBuffer, dstBuffer, bufferSize, dstOffset);
+
+        ReleaseStagingBuffer(stagingBuffer, stagingBufferMemory);
+
+        return bufferSize;
+    }
+
+    /// <summary>
+    /// Uploads the indices of a model's meshes into the index ranges CreateVertexBuffer allocated, and with CLUSTER_CULLING their meshlets
+    /// </summary>
+    void CreateIndexBuffer(const size_t modelIndex)
+    {
+        for (size_t i = 0; i < models[modelIndex].meshes.size(); i++)
+        {
+            const Mesh& mesh = models[modelIndex].meshes[i];
+#ifdef USE_ASSIMP
+            const std::vector<uint32_t>& meshIndices = mesh.indices;
+#else
+            const std::vector<uint32_t>& meshIndices = indices;
+#endif // USE_ASSIMP
+
+            UploadToBuffer(meshIndices.data(), sizeof(uint32_t) * meshIndices.size(),
+                geometryBlocks[mesh.geometry.block].indexBuffer, sizeof(uint32_t) * mesh.geometry.firstIndex);
+#ifdef CLUSTER_CULLING
+            UploadToBuffer(mesh.meshlets.data(), sizeof(Meshlet) * mesh.meshlets.size(),
+                geometryBlocks[mesh.geometry.block].meshletBuffer, sizeof(Meshlet) * mesh.geometry.firstMeshlet);
+#endif // CLUSTER_CULLING
+        }
+    }
+
+    /// <summary>
+    /// Creates a geometry block with room for at least the given vertices, indices and meshlets, in a destroyed block's slot if there is one
+    /// </summary>
+    /// <returns>Index of the block</returns>
+    uint32_t CreateGeometryBlock(const uint32_t vertexCount, const uint32_t indexCount, const uint32_t meshletCount)
+    {
+        uint32_t blockIndex = 0;
+        while (blockIndex < geometryBlocks.size() && geometryBlocks[blockIndex].vertexBuffer != VK_NULL_HANDLE)
+            blockIndex++;
+        if (blockIndex == geometryBlocks.size())
+            geometryBlocks.emplace_back();
+
+        GeometryBlock& block = geometryBlocks[blockIndex];
+        block.vertices = RangeAllocator(std::max(vertexCount, GEOMETRY_BLOCK_VERTICES));
+        block.indices = RangeAllocator(std::max(indexCount, GEOMETRY_BLOCK_INDICES));
+        block.meshlets = RangeAllocator(std::max(meshletCount, GEOMETRY_BLOCK_MESHLETS));
+        CreateGeometryBlockBuffers(block);
+
+#ifdef MODEL_IMPORT_DEBUG
+        std::cout << "Created geometry block " << blockIndex << " for " << block.vertices.Capacity() << " vertices and " << block.indices.Capacity() << " indices" << std::endl;
+#endif // MODEL_IMPORT_DEBUG
+
+        return blockIndex;
+    }
+
+    /// <summary>
+    /// Creates the buffers of a geometry block for the capacity of its allocators
+    /// </summary>
+    void CreateGeometryBlockBuffers(GeometryBlock& block)
+    {
+        const VkDeviceSize vertexCapacity = block.vertices.Capacity();
+
+        // Copied from by compaction
+        const VkBufferUsageFlags streamUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+#ifdef COMPUTE_SKINNING
+        // Also read by the skinning pass
+        CreateBuffer(GEOMETRY_VERTEX_STRIDE * vertexCapacity, streamUsage | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            block.vertexBuffer, block.vertexBufferMemory);
+#else
+        CreateBuffer(GEOMETRY_VERTEX_STRIDE * vertexCapacity, streamUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            block.vertexBuffer, block.vertexBufferMemory);
+#endif // COMPUTE_SKINNING
+#if defined(COMPACT_VERTICES) || defined(DEPTH_PREPASS)
+        CreateBuffer(sizeof(DepthSkinningVertex) * vertexCapacity, streamUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            block.skinningBuffer, block.skinningBufferMemory);
+#endif // COMPACT_VERTICES || DEPTH_PREPASS
+#ifdef DEPTH_PREPASS
+        CreateBuffer(sizeof(DepthPositionVertex) * vertexCapacity, streamUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            block.positionBuffer, block.positionBufferMemory);
+#endif // DEPTH_PREPASS
+#ifdef CLUSTER_CULLING
+        // Indices are also read by the cluster culling pass, which copies those of visible meshlets
+        CreateBuffer(sizeof(uint32_t) * static_cast<VkDeviceSize>(block.indices.Capacity()),
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, block.indexBuffer, block.indexBufferMemory);
+        CreateBuffer(sizeof(Meshlet) * static_cast<VkDeviceSize>(block.meshlets.Capacity()),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            block.meshletBuffer, block.meshletBufferMemory);
+#else
+        CreateBuffer(sizeof(uint32_t) * static_cast<VkDeviceSize>(block.indices.Capacity()),
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            block.indexBuffer, block.indexBufferMemory);
+#endif // CLUSTER_CULLING
+    }
+
+    /// <summary>
+    /// Destroys the buffers of a geometry block and leaves its slot empty. Frames in flight must not read them anymore
+    /// </summary>
+    void DestroyGeometryBlock(GeometryBlock& block)
+    {
+        vkDestroyBuffer(device, block.vertexBuffer, nullptr);
+        vkFreeMemory(device, block.vertexBufferMemory, nullptr);
+        vkDestroyBuffer(device, block.skinningBuffer, nullptr);
+        vkFreeMemory(device, block.skinningBufferMemory, nullptr);
+        vkDestroyBuffer(device, block.positionBuffer, nullptr);
+        vkFreeMemory(device, block.positionBufferMemory, nullptr);
+        vkDestroyBuffer(device, block.indexBuffer, nullptr);
+        vkFreeMemory(device, block.indexBufferMemory, nullptr);
+        vkDestroyBuffer(device, block.meshletBuffer, nullptr);
+        vkFreeMemory(device, block.meshletBufferMemory, nullptr);
+        block = GeometryBlock();
+    }
+
+    /// <summary>
+    /// Suballocates the vertices, indices and meshlets of a mesh from the first geometry block with room for all of them.
+    /// Fragmented blocks are compacted first if that makes room, otherwise a new block is created
+    /// </summary>
+    void AllocateGeometry(const uint32_t vertexCount, const uint32_t indexCount, const uint32_t meshletCount, GeometryAllocation& geometry)
+    {
+        for (int attempt = 0; attempt < 2; attempt++)
+        {
+            for (uint32_t b = 0; b < geometryBlocks.size(); b++)
+            {
+                if (geometryBlocks[b].vertexBuffer != VK_NULL_HANDLE && TryAllocateGeometry(b, vertexCount, indexCount, meshletCount, geometry))
+                    return;
+            }
+
+            // Compaction moves the ranges of uploads still in flight, so it waits for a quiet moment
+            if (attempt > 0 || recordingUpload != nullptr || !modelUploads.empty())
+                break;
+
+            bool compacted = false;
+            for (uint32_t b = 0; b < geometryBlocks.size(); b++)
+            {
+                const GeometryBlock& block = geometryBlocks[b];
+                if (block.vertexBuffer != VK_NULL_HANDLE
+                    && block.vertices.Capacity() - block.vertices.Used() >= vertexCount + geometryVertexAlignment
+                    && block.indices.Capacity() - block.indices.Used() >= indexCount
+                    && block.meshlets.Capacity() - block.meshlets.Used() >= meshletCount)
+                {
+                    CompactGeometryBlock(b);
+                    compacted = true;
+                }
+            }
+
+            if (!compacted)
+                break;
+        }
+
+        const uint32_t blockIndex = CreateGeometryBlock(vertexCount + geometryVertexAlignment, indexCount, meshletCount);
+        if (!TryAllocateGeometry(blockIndex, vertexCount, indexCount, meshletCount, geometry))
+            throw std::runtime_error("failed to allocate mesh geometry!");
+    }
+
+    /// <summary>
+    /// Allocates all ranges of a mesh in one block, or none
+    /// </summary>
+    bool TryAllocateGeometry(const uint32_t blockIndex, const uint32_t vertexCount, const uint32_t indexCount, const uint32_t meshletCount, GeometryAllocation& geometry)
+    {
+        GeometryBlock& block = geometryBlocks[blockIndex];
+        uint32_t firstVertex, firstIndex, firstMeshlet;
+        if (!block.vertices.Allocate(vertexCount, geometryVertexAlignment, firstVertex))
+            return false;
+
+        if (!block.indices.Allocate(indexCount, 1, firstIndex))
+        {
+            block.vertices.Free(firstVertex, vertexCount);
+            return false;
+        }
+
+        if (!block.meshlets.Allocate(meshletCount, 1, firstMeshlet))
+        {
+            block.vertices.Free(firstVertex, vertexCount);
+            block.indices.Free(firstIndex, indexCount);
+            return false;
+        }
+
+        geometry = { blockIndex, firstVertex, vertexCount, firstIndex, indexCount, firstMeshlet, meshletCount };
+        return true;
+    }
+
+    /// <summary>
+    /// Returns the ranges of a mesh to its block. Blocks other than the first are destroyed once empty
+    /// </summary>
+    void FreeGeometry(const GeometryAllocation& geometry)
+    {
+        if (geometry.block >= geometryBlocks.size() || geometryBlocks[geometry.block].vertexBuffer == VK_NULL_HANDLE)
+            return;
+
+        GeometryBlock& block = geometryBlocks[geometry.block];
+        block.vertices.Free(geometry.firstVertex, geometry.vertexCount);
+        block.indices.Free(geometry.firstIndex, geometry.indexCount);
+        block.meshlets.Free(geometry.firstMeshlet, geometry.meshletCount);
+
+        // No frame draws from an empty block
+        if (geometry.block > 0 && block.vertices.Used() == 0 && block.indices.Used() == 0)
+            DestroyGeometryBlock(block);
+    }
+
+    /// <summary>
+    /// Packs the meshes of a geometry block at the start of new buffers, so its free space is one range again.
+    /// The old buffers are retired until the frames in flight that read them complete
+    /// </summary>
+    void CompactGeometryBlock(const uint32_t blockIndex)
+    {
+        GeometryBlock& block = geometryBlocks[blockIndex];
+
+        // Meshes of the block in allocation order, including removed models that aren't destroyed yet and the model being uploaded
+        std::vector<Mesh*> blockMeshes;
+        std::set<const Mesh*> movedMeshes;              // Only moved, not copied
+        for (size_t i = 0; i < models.size(); i++)
+        {
+            for (Mesh& mesh : models[i].meshes)
+            {
+                if (mesh.geometry.block != blockIndex || (mesh.geometry.vertexCount == 0 && mesh.geometry.indexCount == 0))
+                    continue;
+
+                blockMeshes.push_back(&mesh);
+                if (!models[i].resident)
+                    movedMeshes.insert(&mesh);
+            }
+        }
+        std::sort(blockMeshes.begin(), blockMeshes.end(), [](const Mesh* a, const Mesh* b) { return a->geometry.firstVertex < b->geometry.firstVertex; });
+
+        GeometryBlock compacted;
+        compacted.vertices = RangeAllocator(block.vertices.Capacity());
+        compacted.indices = RangeAllocator(block.indices.Capacity());
+        compacted.meshlets = RangeAllocator(block.meshlets.Capacity());
+        CreateGeometryBlockBuffers(compacted);
+
+        std::vector<VkBufferCopy> vertexRegions, indexRegions, meshletRegions;
+        std::vector<GeometryAllocation> packed;
+        for (const Mesh* mesh : blockMeshes)
+        {
+            // Allocating in order from the empty allocators packs the meshes, and keeps alignment padding free so it merges when they are freed
+            GeometryAllocation geometry = mesh->geometry;
+            uint32_t firstVertex = 0, firstIndex = 0, firstMeshlet = 0;
+            compacted.vertices.Allocate(geometry.vertexCount, geometryVertexAlignment, firstVertex);
+            compacted.indices.Allocate(geometry.indexCount, 1, firstIndex);
+            compacted.meshlets.Allocate(geometry.meshletCount, 1, firstMeshlet);
+
+            // Removed models and the model being uploaded are never drawn from the old buffers, so their ranges only move.
+            // Copying the ranges of an upload could overwrite the data it writes meanwhile, as the copies aren't waited on.
+            // Regions count vertices, indices and meshlets here, and are scaled to bytes per buffer
+            if (movedMeshes.count(mesh) == 0)
+            {
+                vertexRegions.push_back({ geometry.firstVertex, firstVertex, geometry.vertexCount });
+                indexRegions.push_back({ geometry.firstIndex, firstIndex, geometry.indexCount });
+                meshletRegions.push_back({ geometry.firstMeshlet, firstMeshlet, geometry.meshletCount });
+            }
+
+            geometry.firstVertex = firstVertex;
+            geometry.firstIndex = firstIndex;
+            geometry.firstMeshlet = firstMeshlet;
+            packed.push_back(geometry);
+        }
+
+        // Recorded on the graphics queue like model uploads. Frames submitted later wait for the copies through the barrier, so nothing waits here
+        GeometryCompaction compaction;
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, &compaction.commandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate geometry compaction command buffer!");
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(compaction.commandBuffer, &beginInfo);
+
+        CopyRegions(compaction.commandBuffer, block.vertexBuffer, compacted.vertexBuffer, vertexRegions, GEOMETRY_VERTEX_STRIDE);
+#if defined(COMPACT_VERTICES) || defined(DEPTH_PREPASS)
+        CopyRegions(compaction.commandBuffer, block.skinningBuffer, compacted.skinningBuffer, vertexRegions, sizeof(DepthSkinningVertex));
+#endif // COMPACT_VERTICES || DEPTH_PREPASS
+#ifdef DEPTH_PREPASS
+        CopyRegions(compaction.commandBuffer, block.positionBuffer, compacted.positionBuffer, vertexRegions, sizeof(DepthPositionVertex));
+#endif // DEPTH_PREPASS
+        CopyRegions(compaction.commandBuffer, block.indexBuffer, compacted.indexBuffer, indexRegions, sizeof(uint32_t));
+#ifdef CLUSTER_CULLING
+        CopyRegions(compaction.commandBuffer, block.meshletBuffer, compacted.meshletBuffer, meshletRegions, sizeof(Meshlet));
+#endif // CLUSTER_CULLING
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+        // Transfer too, as the next compaction of the block copies from these buffers
+        vkCmdPipelineBarrier(compaction.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+
+        vkEndCommandBuffer(compaction.commandBuffer);
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device, &fenceInfo, nullptr, &compaction.fence) != VK_SUCCESS)
+            throw std::runtime_error("failed to create geometry compaction fence!");
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &compaction.commandBuffer;
+
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, compaction.fence) != VK_SUCCESS)
+            throw std::runtime_error("failed to submit geometry compaction!");
+
+        geometryCompactions.push_back(compaction);
+
+        for (size_t i = 0; i < blockMeshes.size(); i++)
+            blockMeshes[i]->geometry = packed[i];
+
+#ifdef MODEL_IMPORT_DEBUG
+        std::cout << "Compacted geometry block " << blockIndex << ": " << blockMeshes.size() << " meshes, largest free range "
+            << block.vertices.LargestFreeRange() << " -> " << compacted.vertices.LargestFreeRange() << " vertices" << std::endl;
+#endif // MODEL_IMPORT_DEBUG
+
+        // Frames in flight and the copies still read the old buffers
+        retiredGeometryBuffers.push_back({ block.vertexBuffer, block.vertexBufferMemory, frameCount });
+        retiredGeometryBuffers.push_back({ block.skinningBuffer, block.skinningBufferMemory, frameCount });
+        retiredGeometryBuffers.push_back({ block.positionBuffer, block.positionBufferMemory, frameCount });
+        retiredGeometryBuffers.push_back({ block.indexBuffer, block.indexBufferMemory, frameCount });
+        retiredGeometryBuffers.push_back({ block.meshletBuffer, block.meshletBufferMemory, frameCount });
+        block = std::move(compacted);
+
+#ifdef COMPUTE_SKINNING
+        // The skinning descriptor sets of every frame slot point into the old buffers
+        std::fill(std::begin(skinningInputsStale), std::end(skinningInputsStale), true);
+#endif // COMPUTE_SKINNING
+    }
+
+    /// <summary>
+    /// Compacts every geometry block, once no upload is in flight
+    /// </summary>
+    void CompactGeometry()
+    {
+        if (recordingUpload != nullptr || !modelUploads.empty())
+            return;
+
+        for (uint32_t b = 0; b < geometryBlocks.size(); b++)
+        {
+            if (geometryBlocks[b].vertexBuffer != VK_NULL_HANDLE)
+                CompactGeometryBlock(b);
+        }
+    }
+
+    /// <summary>
+    /// Sums the used and total vertices of the geometry arena for the GUI
+    /// </summary>
+    void UpdateGeometryStats()
+    {
+        gui.geometry_blocks = 0;
+        gui.geometry_used_vertices = 0;
+        gui.geometry_capacity_vertices = 0;
+        gui.geometry_largest_free_vertices = 0;
+        for (const GeometryBlock& block : geometryBlocks)
+        {
+            if (block.vertexBuffer == VK_NULL_HANDLE)
+                continue;
+
+            gui.geometry_blocks++;
+            gui.geometry_used_vertices += block.vertices.Used();
+            gui.geometry_capacity_vertices += block.vertices.Capacity();
+            gui.geometry_largest_free_vertices = std::max(gui.geometry_largest_free_vertices, block.vertices.LargestFreeRange());
+        }
+    }
+
+    /// <summary>
+    /// Records copies of element ranges between two buffers
+    /// </summary>
+    /// <param name="regions">: source offset, destination offset and size of each range, in elements</param>
+    /// <param name="stride">: bytes per element</param>
+    void CopyRegions(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, const std::vector<VkBufferCopy>& regions, const VkDeviceSize stride)
+    {
+        std::vector<VkBufferCopy> byteRegions;
+        for (const VkBufferCopy& region : regions)
+        {
+            if (region.size > 0)
+                byteRegions.push_back({ region.srcOffset * stride, region.dstOffset * stride, region.size * stride });
+        }
+
+        if (!byteRegions.empty())
+            vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, static_cast<uint32_t>(byteRegions.size()), byteRegions.data());
+    }
+
+    /// <summary>
+    /// Binds the vertex streams of a geometry block: the vertex buffer, and the skin stream second if the build has one
+    /// </summary>
+    void BindGeometryBlock(VkCommandBuffer commandBuffer, const GeometryBlock& block)
+    {
+        VkBuffer vertexBuffersRend[] = { block.vertexBuffer, block.skinningBuffer };
+        VkDeviceSize offsets[] = { 0, 0 };
+        vkCmdBindVertexBuffers(commandBuffer, 0, (vertexBuffersRend[1] != VK_NULL_HANDLE) ? 2 : 1, vertexBuffersRend, offsets);
+    }
+
+    /// <summary>
+    /// Binds the index buffer a mesh draws from, unless it is already bound: the one of its geometry block, or this frame's
+    /// cluster index buffer if the cluster culling pass compacted the visible meshlets of the mesh
+    /// </summary>
+    /// <param name="boundIndexBlock">: geometry block whose index buffer is bound, updated</param>
+    void BindMeshIndexBuffer(VkCommandBuffer commandBuffer, const Mesh& mesh, uint32_t& boundIndexBlock)
+    {
+        uint32_t indexBlock = mesh.geometry.block;
+        VkBuffer indexBuffer = geometryBlocks[mesh.geometry.block].indexBuffer;
+#ifdef CLUSTER_CULLING
+        if (mesh.clusterDrawIndex >= 0)
+        {
+            // Stands for the cluster index buffer among the blocks
+            indexBlock = std::numeric_limits<uint32_t>::max() - 1;
+            indexBuffer = clusterIndexBuffers[currentFrame];
+        }
+#endif // CLUSTER_CULLING
+
+        if (boundIndexBlock == indexBlock)
+            return;
+
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        boundIndexBlock = indexBlock;
+    }
+
+    /// <summary>
+    /// Draws a mesh at a level of detail, or the indirect draw of its visible meshlets if the cluster culling pass culled it.
+    /// The index buffer must be bound by BindMeshIndexBuffer
+    /// </summary>
+    void DrawMesh(VkCommandBuffer commandBuffer, const Mesh& mesh, const MeshLod& lod, const int32_t vertexOffset)
+    {
+#ifdef CLUSTER_CULLING
+        if (mesh.clusterDrawIndex >= 0)
+        {
+            vkCmdDrawIndexedIndirect(commandBuffer, clusterDrawBuffers[currentFrame], sizeof(VkDrawIndexedIndirectCommand) * mesh.clusterDrawIndex,
+                1, sizeof(VkDrawIndexedIndirectCommand));
+            return;
+        }
+#endif // CLUSTER_CULLING
+
+        vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, mesh.geometry.firstIndex + lod.firstIndex, vertexOffset, 0);
+    }
+
+    void CreateGridIndexBuffer()
+    {
+        VkDeviceSize bufferSize = sizeof(gridIndices[0]) * gridIndices.size();
+
+        // Staging buffer
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            stagingBuffer, stagingBufferMemory);
+
+        // Map memory
+        void* data;
+        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        memcpy(data, gridIndices.data(), static_cast<size_t>(bufferSize));
+        vkUnmapMemory(device, stagingBufferMemory);
+
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            gridIndexBuffer, gridIndexBufferMemory);
+
+        CopyBuffer(stagingBuffer, gridIndexBuffer, bufferSize);
+
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        vkFreeMemory(device, stagingBufferMemory, nullptr);
+    }
+
+    /// <summary>
+    /// Frees a staging buffer once the copies from it are done: right away, as single time commands wait for the queue,
+    /// or when the streamed upload being recorded completes
+    /// </summary>
+    void ReleaseStagingBuffer(VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory)
+    {
+        if (recordingUpload != nullptr)
+        {
+            recordingUpload->stagingBuffers.push_back(stagingBuffer);
+            recordingUpload->stagingMemories.push_back(stagingBufferMemory);
+            return;
+        }
+
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        vkFreeMemory(device, stagingBufferMemory, nullptr);
+    }
+
+    void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize bufferSize, VkDeviceSize dstOffset = 0)
+    {
+        VkCommandBuffer commandBuffer = BeginSingleTimeCommands(transCommandPool);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = 0; // Optional
+        copyRegion.dstOffset = dstOffset;
+        copyRegion.size = bufferSize;
+        vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+
+        EndSingleTimeCommands(commandBuffer, transCommandPool, transferQueue);
+    }
+
+    uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+    {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+        {
+            if (typeFilter & (1 << i) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+                return i;
+        }
+
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    void CreateSkyboxVertexBuffer()
+    {
+        VkDeviceSize bufferSize = sizeof(float) * 108;
+
+        // Staging buffer
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            stagingBuffer, stagingBufferMemory);
+
+        // Map memory
+        void* data;
+        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        memcpy(data, box_vertices, static_cast<size_t>(bufferSize));
+        vkUnmapMemory(device, stagingBufferMemory);
+
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            skyboxVertexBuffer, skyboxVertexBufferMemory);
+
+        CopyBuffer(stagingBuffer, skyboxVertexBuffer, bufferSize);
+
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        vkFreeMemory(device, stagingBufferMemory, nullptr);
+    }
+
+    void CreateGridVertexBuffer()
+    {
+        VkDeviceSize bufferSize = sizeof(Vertex) * gridVertices.size();
+
+        // Staging buffer
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            stagingBuffer, stagingBufferMemory);
+
+        // Map memory
+        void* data;
+        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        memcpy(data, gridVertices.data(), static_cast<size_t>(bufferSize));
+        vkUnmapMemory(device, stagingBufferMemory);
+
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            gridVertexBuffer, gridVertexBufferMemory);
+
+        CopyBuffer(stagingBuffer, gridVertexBuffer, bufferSize);
+
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        vkFreeMemory(device, stagingBufferMemory, nullptr);
+    }
+
+    void CreateDescriptorSetLayout()
+    {
+        // UBO descriptor layout
+        VkDescriptorSetLayoutBinding uboLayoutBinding{};
+        uboLayoutBinding.binding = 0;
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uboLayoutBinding.descriptorCount = 1;
+        //uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT;
+        uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+
+        // Combined image sampler descriptor layout
+        VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+        samplerLayoutBinding.binding = 1;
+        samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        samplerLayoutBinding.descriptorCount = 1;
+        samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        samplerLayoutBinding.pImmutableSamplers = nullptr; // Optional
+
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    void CreateGridDescriptorSetLayout()
+    {
+        // UBO descriptor layout
+        VkDescriptorSetLayoutBinding uboLayoutBinding{};
+        uboLayoutBinding.binding = 0;
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uboLayoutBinding.descriptorCount = 1;
+        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &uboLayoutBinding;
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &gridDescriptorSetLayout) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    void CreateImGuiDescriptorSetLayout()
+    {
+        // UBO descriptor layout
+        VkDescriptorSetLayoutBinding uboLayoutBinding{};
+        uboLayoutBinding.binding = 0;
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uboLayoutBinding.descriptorCount = 1;
+        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &uboLayoutBinding;
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &imguiDescriptorSetLayout) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    void CreateLightingDataDescriptorSetLayout()
+    {
+        // UBO descriptor layout
+        VkDescriptorSetLayoutBinding uboLayoutBinding{};
+        uboLayoutBinding.binding = 0;
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uboLayoutBinding.descriptorCount = 1;
+        //uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT;
+        uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+
+        // Combined image sampler descriptor layout for diffuse
+        VkDescriptorSetLayoutBinding samplerLayoutBinding{};
+        samplerLayoutBinding.binding = 1;
+        samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        samplerLayoutBinding.descriptorCount = 1;
+        samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        samplerLayoutBinding.pImmutableSamplers = nullptr; // Optional
+
+        // Lighting data UBO descriptor layout
+        VkDescriptorSetLayoutBinding lightingUBOLayoutBinding{};
+        lightingUBOLayoutBinding.binding = 2;
+        lightingUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        lightingUBOLayoutBinding.descriptorCount = 1;
+        lightingUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        lightingUBOLayoutBinding.pImmutableSamplers = nullptr; // Optional
+
+        // Combined image sampler descriptor layout for normal
+        VkDescriptorSetLayoutBinding normalSamplerLayoutBinding{};
+        normalSamplerLayoutBinding.binding = 3;
+        normalSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        normalSamplerLayoutBinding.descriptorCount = 1;
+        normalSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        normalSamplerLayoutBinding.pImmutableSamplers = nullptr;
+
+        std::array<VkDescriptorSetLayoutBinding, 4> bindings = { uboLayoutBinding, samplerLayoutBinding, lightingUBOLayoutBinding, normalSamplerLayoutBinding };
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &lightingDataDescriptorSetLayout) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    void CreateUniformBuffers(const size_t modelIndex)
+    {
+        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+        uniformBuffers.resize(std::max<size_t>(uniformBuffers.size(), modelIndex + 1));
+        uniformBuffersMemory.resize(std::max<size_t>(uniformBuffersMemory.size(), modelIndex + 1));
+        uniformBuffersMapped.resize(std::max<size_t>(uniformBuffersMapped.size(), modelIndex + 1));
+        uniformBuffers[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
+        uniformBuffersMemory[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
+        uniformBuffersMapped[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
+        paletteVersions.resize(uniformBuffersMapped.size());
+        paletteVersions[modelIndex].assign(MAX_FRAMES_IN_FLIGHT, 0);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                uniformBuffers[modelIndex][i], uniformBuffersMemory[modelIndex][i]);
+
+            // Persistent mapping
+            vkMapMemory(device, uniformBuffersMemory[modelIndex][i], 0, bufferSize, 0, &uniformBuffersMapped[modelIndex][i]);
+
+            // Bone transforms are only written by the animation players, so clear them for static models
+            memset(uniformBuffersMapped[modelIndex][i], 0, bufferSize);
+        }
+    }
+
+    void CreateSkyboxUniformBuffer()
+    {
+        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+        skyboxUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        skyboxUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        skyboxUniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                skyboxUniformBuffers[i], skyboxUniformBuffersMemory[i]);
+
+            // Persistent mapping
+            vkMapMemory(device, skyboxUniformBuffersMemory[i], 0, bufferSize, 0, &skyboxUniformBuffersMapped[i]);
+        }
+    }
+
+    void CreateGridUniformBuffer()
+    {
+        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+        gridUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        gridUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        gridUniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                gridUniformBuffers[i], gridUniformBuffersMemory[i]);
+
+            // Persistent mapping
+            vkMapMemory(device, gridUniformBuffersMemory[i], 0, bufferSize, 0, &gridUniformBuffersMapped[i]);
+        }
+    }
+
+    void CreateLightingUniformBuffers(const uint32_t modelIndex)
+    {
+        VkDeviceSize bufferSize = sizeof(LightDataUBO);
+        lightingUniformBuffers.resize(std::max<size_t>(lightingUniformBuffers.size(), modelIndex + 1));
+        lightingUniformBuffersMemory.resize(std::max<size_t>(lightingUniformBuffersMemory.size(), modelIndex + 1));
+        lightingUniformBuffersMapped.resize(std::max<size_t>(lightingUniformBuffersMapped.size(), modelIndex + 1));
+        lightingUniformBuffers[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
+        lightingUniformBuffersMemory[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
+        lightingUniformBuffersMapped[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                lightingUniformBuffers[modelIndex][i], lightingUniformBuffersMemory[modelIndex][i]);
+
+            // Persistent mapping
+            vkMapMemory(device, lightingUniformBuffersMemory[modelIndex][i], 0, bufferSize, 0, &lightingUniformBuffersMapped[modelIndex][i]);
+        }
+    }
+
+    /// <summary>
+    /// Evaluates all animation players in parallel, writing each bone palette straight into the mapped uniform buffer of currentFrame.
+    /// Must run after the frame's fence has been waited on. Does not allocate.
+    /// Each player owns its target model during the update, so a model must not be targeted by more than one player
+    /// </summary>
+    /// <param name="currentFrame"></param>
+    void UpdateAnimations(uint32_t currentFrame)
+    {
+        const double deltaTime = timer.GetData().DeltaTime;
+
+        // Advance time and pick the blend layers
+        for (AnimationPlayer& animPlayer : animPlayers)
+        {
+            const size_t clipCount = animPlayer.tgt_model->meshes[0].animations.size();
+            if (clipCount == 0)
+                continue;
+
+            animPlayer.is_playing = gui.play_animation_flag;
+            animPlayer.UpdateTime(deltaTime, gui.animation_speed);
+
+            // Blend the GUI selected clip over the current animation
+            if (clipCount > 1 && gui.animation_interpolation_value > 0.0f)
+                animPlayer.SetBlendLayer(0, std::min(static_cast<uint32_t>(gui.blend_animation), static_cast<uint32_t>(clipCount) - 1), gui.animation_interpolation_value);
+            else
+                animPlayer.ClearBlendLayers();
+
+            // Animation LOD from the projected size of the model. Model transforms live in the GUI, once it is set up
+            uint32_t lodLevel = 0;
+            if (gui.animation_lod_flag && animPlayer.modelIndex < gui.model_translations.size())
+            {
+                const Model& model = *animPlayer.tgt_model;
+                const glm::mat4 modelMatrix = GetModelMatrix(animPlayer.modelIndex);
+                const float scale = std::max({ glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2])) });
+                const glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(model.boundsCenter, 1.0f));
+
+                lodLevel = SelectAnimationLOD(ProjectedSize(center, model.boundsRadius * scale, cam.position, glm::radians(cam.fov)), animPlayer.lod_level);
+            }
+            animPlayer.SetLOD(lodLevel, deltaTime);
+        }
+
+        // Group players with the same rig, clips, quantized times and mode. The first player of a group evaluates it for the rest
+        for (size_t i = 0; i < animPlayers.size(); i++)
+        {
+            poseLeaders[i] = -1;
+            if (!gui.share_poses_flag || animPlayers[i].tgt_model->meshes[0].animations.empty())
+                continue;
+
+            sharedPoseKeys[i] = animPlayers[i].MakeSharedPoseKey(gui.cubic_interpolation_flag, BONE_PALETTE_ENCODING);
+            if (sharedPoseKeys[i].rig == 0)
+                continue;
+
+            for (size_t j = 0; j < i; j++)
+            {
+                if (poseLeaders[j] < 0 && sharedPoseKeys[j].rig != 0 && sharedPoseKeys[j] == sharedPoseKeys[i])
+                {
+                    poseLeaders[i] = static_cast<int32_t>(j);
+                    break;
+                }
+            }
+        }
+
+        // Evaluate group leaders and players with unique poses
+        animationPool.ParallelFor(animPlayers.size(), [&](size_t i)
+            {
+                AnimationPlayer& animPlayer = animPlayers[i];
+                if (animPlayer.tgt_model->meshes[0].animations.empty() || poseLeaders[i] >= 0)
+                    return;
+
+                UniformBufferObject* ubo = static_cast<UniformBufferObject*>(uniformBuffersMapped[animPlayer.modelIndex][currentFrame]);
+                const BonePaletteSpan palette{ ubo->boneTransforms, MAX_BONES, BONE_PALETTE_ENCODING };
+
+                animPlayer.Animate(palette, gui.cubic_interpolation_flag, paletteVersions[animPlayer.modelIndex][currentFrame]);
+            });
+
+        // Fan the palettes of the leaders out to the rest of their groups
+        animationPool.ParallelFor(animPlayers.size(), [&](size_t i)
+            {
+                if (poseLeaders[i] < 0)
+                    return;
+
+                AnimationPlayer& animPlayer = animPlayers[i];
+                const AnimationPlayer& leader = animPlayers[poseLeaders[i]];
+
+                UniformBufferObject* leaderUbo = static_cast<UniformBufferObject*>(uniformBuffersMapped[leader.modelIndex][currentFrame]);
+                UniformBufferObject* ubo = static_cast<UniformBufferObject*>(uniformBuffersMapped[animPlayer.modelIndex][currentFrame]);
+                const BonePaletteSpan source{ leaderUbo->boneTransforms, MAX_BONES, BONE_PALETTE_ENCODING };
+                const BonePaletteSpan palette{ ubo->boneTransforms, MAX_BONES, BONE_PALETTE_ENCODING };
+
+                animPlayer.SharePose(source, paletteVersions[leader.modelIndex][currentFrame], palette, paletteVersions[animPlayer.modelIndex][currentFrame]);
+            });
+
+        // Palette upload and pose cache statistics
+        size_t paletteBytes = 0;
+        uint32_t evaluatedPoses = 0, cachedPoses = 0, sharedPoses = 0;
+        for (const AnimationPlayer& animPlayer : animPlayers)
+        {
+            if (animPlayer.tgt_model->meshes[0].animations.empty())
+                continue;
+
+            if (animPlayer.last_update == PoseUpdate::Evaluated)
+                evaluatedPoses++;
+            else if (animPlayer.last_update == PoseUpdate::Shared)
+                sharedPoses++;
+            else
+                cachedPoses++;
+
+            if (animPlayer.last_update != PoseUpdate::Cached)
+                paletteBytes += std::min(static_cast<size_t>(animPlayer.tgt_model->meshes[0].boneCounter), MAX_BONES)
+                    * PaletteVec4sPerBone(BONE_PALETTE_ENCODING) * sizeof(glm::vec4);
+        }
+        gui.palette_bytes = static_cast<uint32_t>(paletteBytes);
+        gui.evaluated_poses = evaluatedPoses;
+        gui.cached_poses = cachedPoses;
+        gui.shared_poses = sharedPoses;
+
+        std::fill(std::begin(gui.lod_players), std::end(gui.lod_players), 0);
+        for (const AnimationPlayer& animPlayer : animPlayers)
+        {
+            if (!animPlayer.tgt_model->meshes[0].animations.empty())
+                gui.lod_players[animPlayer.lod_level]++;
+        }
+        gui.palette_encoding = PaletteEncodingName(BONE_PALETTE_ENCODING);
+    }
+
+    /// <summary>
+    /// Model matrix of a model, from its GUI translation and scale
+    /// </summary>
+    glm::mat4 GetModelMatrix(const size_t modelIndex)
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        if (modelIndex == 0)
+        {
+            model = glm::rotate(
+                glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
+                glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        }
+
+        if (modelIndex == 1)
+        {
+            static auto startTime = std::chrono::high_resolution_clock::now();
+
+            auto currentTime = std::chrono::high_resolution_clock::now();
+
+            float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+            model = glm::rotate(model, time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        }
+
+        model = glm::translate(model, glm::vec3(gui.model_translations[modelIndex][0], gui.model_translations[modelIndex][1], gui.model_translations[modelIndex][2]));
+        model = glm::scale(model, glm::vec3(gui.model_scales[modelIndex]));
+
+        return model;
+    }
+
+#ifdef MESH_LODS
+    /// <summary>
+    /// Picks the level of detail of every drawn model from the projected error of its levels, and counts the triangles they draw
+    /// </summary>
+    void SelectModelLods()
+    {
+        std::fill(std::begin(gui.lod_models), std::end(gui.lod_models), 0);
+        gui.drawn_triangles = 0;
+        gui.full_triangles = 0;
+
+        for (uint32_t i = 0; i < emptyModelIndex; i++)
+        {
+            Model& model = models[i];
+            if (!model.resident || !model.enabled)
+                continue;
+
+            // A level of the model is as far off as its worst mesh
+            float levelErrors[MESH_LOD_COUNT] = {};
+            uint32_t levelCount = 1;
+            for (const Mesh& mesh : model.meshes)
+            {
+                levelCount = std::max(levelCount, static_cast<uint32_t>(mesh.lods.size()));
+                for (uint32_t level = 0; level < MESH_LOD_COUNT; level++)
+                    levelErrors[level] = std::max(levelErrors[level], mesh.Lod(level).error);
+            }
+
+            // Model transforms live in the GUI, once it is set up
+            uint32_t level = 0;
+            if (gui.mesh_lod_flag && i < gui.model_translations.size())
+            {
+                const glm::mat4 modelMatrix = GetModelMatrix(i);
+                const float scale = std::max({ glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2])) });
+                const glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(model.boundsCenter, 1.0f));
+                const float pixelsPerUnit = PixelsPerUnit(center, model.boundsRadius * scale, cam.position, glm::radians(cam.fov), static_cast<float>(sc.extent.height), Z_NEAR);
+
+                // Errors are in model units
+                level = SelectMeshLOD(levelErrors, levelCount, pixelsPerUnit * scale, gui.lod_pixel_error, model.lodLevel);
+            }
+            model.lodLevel = level;
+
+            gui.lod_models[level]++;
+            for (const Mesh& mesh : model.meshes)
+            {
+                gui.drawn_triangles += mesh.Lod(level).indexCount / 3;
+                gui.full_triangles += mesh.lods[0].indexCount / 3;
+            }
+        }
+    }
+#endif // MESH_LODS
+
+    void UpdateUniformBuffer(const size_t modelIndex, uint32_t currentFrame)
+    {
+        // Bone transforms were already written by UpdateAnimations, so only the rest is filled in
+        UniformBufferObject ubo;
+#ifdef ENABLE_CAMERA_ANIM
+        static auto startTime = std::chrono::high_resolution_clock::now();
+
+        auto currentTime = std::chrono::high_resolution_clock::now();
+
+        float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+
+        ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        ubo.proj = glm::perspective(glm::radians(45.0f), sc.extent.width / (float)sc.extent.height, 0.1f, 10.0f);   // without sc.extent we get wrong aspect ratio if resize happens
+#else
+        ubo.proj = cam.GetCurrentProjectionMatrix(sc.extent.width, sc.extent.height);
+        ubo.view = cam.GetCurrentViewMatrix();
+
+        ubo.model = GetModelMatrix(modelIndex);
+
+#endif // ENABLE_CAMERA_ANIM
+        ubo.proj[1][1] *= -1;   // Flip sign of scaling factor
+
+        //ubo.time = glfwGetTime();
+        ubo.explode = static_cast<bool>(gui.explode_flags[modelIndex]);
+        ubo.time = gui.explosion_rates[modelIndex];
+
+        UniformBufferObject* mapped = static_cast<UniformBufferObject*>(uniformBuffersMapped[modelIndex][currentFrame]);
+        mapped->model = ubo.model;
+        mapped->view = ubo.view;
+        mapped->proj = ubo.proj;
+        mapped->time = ubo.time;
+        mapped->explode = ubo.explode;
+        mapped->positionMin = glm::vec4(models[modelIndex].boundsMin, 0.0f);
+        mapped->positionExtent = glm::vec4(QuantizationExtent(models[modelIndex].boundsMin, models[modelIndex].boundsMax), 0.0f);
+    }
+
+    void UpdateSkyboxUniformBuffer(uint32_t currentFrame)
+    {
+        UniformBufferObject ubo{};
+
+        ubo.model = glm::mat4(1.0f);
+        ubo.proj = cam.GetCurrentProjectionMatrix(sc.extent.width, sc.extent.height);
+        ubo.view = glm::mat4(glm::mat3(cam.GetCurrentViewMatrix()));                        // Remove translation from view matrix
+
+        ubo.proj[1][1] *= -1;   // Flip sign of scaling factor
+
+        memcpy(skyboxUniformBuffersMapped[currentFrame], &ubo, sizeof(ubo));
+    }
+
+    void UpdateLightingDataUniformBuffer(const size_t modelIndex, uint32_t currentFrame)
+    {
+        LightDataUBO lightUBO{};
+
+        lightUBO.blinn = gui.blinn_flag;
+        lightUBO.lightPos = glm::vec3(gui.light_pos[0], gui.light_pos[1], gui.light_pos[2]);
+        lightUBO.camPos = cam.position;
+
+        memcpy(lightingUniformBuffersMapped[0][currentFrame], &lightUBO, sizeof(lightUBO));
+    }
+
+    void UpdateGridUniformBuffer(uint32_t currentFrame)
+    {
+        UniformBufferObject ubo{};
+
+        ubo.model = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        ubo.model = glm::scale(ubo.model, glm::vec3(200.0f));
+        ubo.proj = cam.GetCurrentProjectionMatrix(sc.extent.width, sc.extent.height);
+        ubo.view = cam.GetCurrentViewMatrix();
+
+        ubo.proj[1][1] *= -1;   // Flip sign of scaling factor
+
+        memcpy(gridUniformBuffersMapped[currentFrame], &ubo, sizeof(ubo));
+    }
+
+    void CreateDescriptorPool(const size_t modelIndex)
+    {
+        descriptorPools.resize(std::max<size_t>(descriptorPools.size(), modelIndex + 1));
+
+        std::array<VkDescriptorPoolSize, 2> poolSizes;
+        // UBO
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        // Sampler
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        //poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPools[modelIndex]) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    void CreateImGuiDescriptorPool()
+    {
+        VkDescriptorPoolSize poolSize;
+        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &imguiDescriptorPool));
+    }
+
+    void CreateSkyboxDescriptorPool()
+    {
+        std::array<VkDescriptorPoolSize, 2> poolSizes;
+        // UBO
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        // Sampler
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        //poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &skyboxDescriptorPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    void CreateGridDescriptorPool()
+    {
+        std::array<VkDescriptorPoolSize, 1> poolSizes;
+        // UBO
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        //poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &gridDescriptorPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    void CreateNormalDescriptorPool()
+    {
+        std::array<VkDescriptorPoolSize, 1> poolSizes;
+        // UBO
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &normalDescriptorPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    void CreateLightingDataDescriptorPool(const uint32_t modelIndex)
+    {
+        descriptorPools.resize(std::max<size_t>(descriptorPools.size(), modelIndex + 1));
+
+        std::array<VkDescriptorPoolSize, 4> poolSizes;
+        // UBO
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        // Diffuse Sampler
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        // LightData UBO
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        // Normal Sampler
+        poolSizes[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[3].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        //poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+        /*if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &lightingDescriptorPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor pool!");*/
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPools[modelIndex]) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    void CreateDescriptorSets(const size_t modelIndex, bool passLightingData = false)
+    {
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+        std::vector<VkDescriptorSetLayout> lightingDataLayouts(MAX_FRAMES_IN_FLIGHT, lightingDataDescriptorSetLayout);
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        /*if (passLightingData)
+            allocInfo.descriptorPool = lightingDescriptorPool;
+        else
+            allocInfo.descriptorPool = descriptorPools[modelIndex];*/
+        allocInfo.descriptorPool = descriptorPools[modelIndex];
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        if (passLightingData)
+            allocInfo.pSetLayouts = lightingDataLayouts.data();
+        else
+            allocInfo.pSetLayouts = layouts.data();
+
+        descriptorSets.resize(std::max<size_t>(descriptorSets.size(), modelIndex + 1));
+        descriptorSets[modelIndex].resize(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+
+        if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets[modelIndex].data()) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate descriptor sets!");
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            // UBO
+            VkDescriptorBufferInfo bufferInfo{};
+            bufferInfo.buffer = uniformBuffers[modelIndex][i];
+            bufferInfo.offset = 0;
+            bufferInfo.range = sizeof(UniformBufferObject);
+
+            // Sampler
+            VkDescriptorImageInfo imageInfo{};
+            imageInfo.sampler = textureSamplers[modelIndex];
+            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imageInfo.imageView = textureImageViews[modelIndex];
+
+            VkDescriptorBufferInfo lightingBufferInfo{};
+
+            // Update configurations
+            if (passLightingData)
+            {
+                // Lighting data UBO
+                lightingBufferInfo.buffer = lightingUniformBuffers[0][i];
+                lightingBufferInfo.offset = 0;
+                lightingBufferInfo.range = sizeof(LightDataUBO);
+
+                // Normal map sampler
+                VkDescriptorImageInfo normalImageInfo{};
+                normalImageInfo.sampler = normalSamplers[modelIndex];
+                normalImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                normalImageInfo.imageView = normalImageViews[modelIndex];
+
+                std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+                descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[0].dstSet = descriptorSets[modelIndex][i];
+                descriptorWrites[0].dstBinding = 0;
+                descriptorWrites[0].dstArrayElement = 0;
+                descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                descriptorWrites[0].descriptorCount = 1;
+                descriptorWrites[0].pBufferInfo = &bufferInfo;
+                descriptorWrites[0].pImageInfo = nullptr; // Optional
+                descriptorWrites[0].pTexelBufferView = nullptr; // Optional
+
+                descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[1].dstSet = descriptorSets[modelIndex][i];
+                descriptorWrites[1].dstBinding = 1;
+                descriptorWrites[1].dstArrayElement = 0;
+                descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptorWrites[1].descriptorCount = 1;
+                descriptorWrites[1].pBufferInfo = nullptr;   // Optional
+                descriptorWrites[1].pImageInfo = &imageInfo;
+                descriptorWrites[1].pTexelBufferView = nullptr; // Optional
+
+                descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[2].dstSet = descriptorSets[modelIndex][i];
+                descriptorWrites[2].dstBinding = 2;
+                descriptorWrites[2].dstArrayElement = 0;
+                descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                descriptorWrites[2].descriptorCount = 1;
+                descriptorWrites[2].pBufferInfo = &lightingBufferInfo;
+                descriptorWrites[2].pImageInfo = nullptr;
+                descriptorWrites[2].pTexelBufferView = nullptr;
+
+                descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[3].dstSet = descriptorSets[modelIndex][i];
+                descriptorWrites[3].dstBinding = 3;
+                descriptorWrites[3].dstArrayElement = 0;
+                descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptorWrites[3].descriptorCount = 1;
+                descriptorWrites[3].pBufferInfo = nullptr;
+                descriptorWrites[3].pImageInfo = &normalImageInfo;
+                descriptorWrites[3].pTexelBufferView = nullptr;
+
+                vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+            }
+            else
+            {
+                std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+                descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[0].dstSet = descriptorSets[modelIndex][i];
+                descriptorWrites[0].dstBinding = 0;
+                descriptorWrites[0].dstArrayElement = 0;
+                descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                descriptorWrites[0].descriptorCount = 1;
+                descriptorWrites[0].pBufferInfo = &bufferInfo;
+                descriptorWrites[0].pImageInfo = nullptr; // Optional
+                descriptorWrites[0].pTexelBufferView = nullptr; // Optional
+
+                descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[1].dstSet = descriptorSets[modelIndex][i];
+                descriptorWrites[1].dstBinding = 1;
+                descriptorWrites[1].dstArrayElement = 0;
+                descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptorWrites[1].descriptorCount = 1;
+                descriptorWrites[1].pBufferInfo = nullptr;   // Optional
+                descriptorWrites[1].pImageInfo = &imageInfo;
+                descriptorWrites[1].pTexelBufferView = nullptr; // Optional
 
-        throw std::runtime_error("failed to find suitable memory type!");
+                vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+            }
+        }
     }
 
-    void CreateSkyboxVertexBuffer()
+    void CreateSkyboxDescriptorSet()
     {
-        VkDeviceSize bufferSize = sizeof(float) * 108;
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = skyboxDescriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.pSetLayouts = layouts.data();
 
-        // Staging buffer
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory);
+        skyboxDescriptorSet.resize(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
 
-        // Map memory
-        void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, box_vertices, static_cast<size_t>(bufferSize));
-        vkUnmapMemory(device, stagingBufferMemory);
+        if (vkAllocateDescriptorSets(device, &allocInfo, skyboxDescriptorSet.data()) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate descriptor sets!");
 
-        CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            skyboxVertexBuffer, skyboxVertexBufferMemory);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            // UBO
+            VkDescriptorBufferInfo bufferInfo{};
+            bufferInfo.buffer = skyboxUniformBuffers[i];
+            bufferInfo.offset = 0;
+            bufferInfo.range = sizeof(UniformBufferObject);
 
-        CopyBuffer(stagingBuffer, skyboxVertexBuffer, bufferSize);
+            // Sampler
+            VkDescriptorImageInfo imageInfo{};
+            imageInfo.sampler = skyboxSampler;
+            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imageInfo.imageView = skyboxImageView;
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+            // Update configurations
+            std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[0].dstSet = skyboxDescriptorSet[i];
+            descriptorWrites[0].dstBinding = 0;
+            descriptorWrites[0].dstArrayElement = 0;
+            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptorWrites[0].descriptorCount = 1;
+            descriptorWrites[0].pBufferInfo = &bufferInfo;
+            descriptorWrites[0].pImageInfo = nullptr; // Optional
+            descriptorWrites[0].pTexelBufferView = nullptr; // Optional
+
+            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[1].dstSet = skyboxDescriptorSet[i];
+            descriptorWrites[1].dstBinding = 1;
+            descriptorWrites[1].dstArrayElement = 0;
+            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrites[1].descriptorCount = 1;
+            descriptorWrites[1].pBufferInfo = nullptr;   // Optional
+            descriptorWrites[1].pImageInfo = &imageInfo;
+            descriptorWrites[1].pTexelBufferView = nullptr; // Optional
+
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
     }
 
-    void CreateGridVertexBuffer()
+    void CreateGridDescriptorSet()
     {
-        VkDeviceSize bufferSize = sizeof(Vertex) * gridVertices.size();
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, gridDescriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = gridDescriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.pSetLayouts = layouts.data();
 
-        // Staging buffer
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory);
+        gridDescriptorSet.resize(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
 
-        // Map memory
-        void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, gridVertices.data(), static_cast<size_t>(bufferSize));
-        vkUnmapMemory(device, stagingBufferMemory);
+        if (vkAllocateDescriptorSets(device, &allocInfo, gridDescriptorSet.data()) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate descriptor sets!");
 
-        CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            gridVertexBuffer, gridVertexBufferMemory);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            // UBO
+            VkDescriptorBufferInfo bufferInfo{};
+            bufferInfo.buffer = gridUniformBuffers[i];
+            bufferInfo.offset = 0;
+            bufferInfo.range = sizeof(UniformBufferObject);
 
-        CopyBuffer(stagingBuffer, gridVertexBuffer, bufferSize);
+            // Update configurations
+            std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[0].dstSet = gridDescriptorSet[i];
+            descriptorWrites[0].dstBinding = 0;
+            descriptorWrites[0].dstArrayElement = 0;
+            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptorWrites[0].descriptorCount = 1;
+            descriptorWrites[0].pBufferInfo = &bufferInfo;
+            descriptorWrites[0].pImageInfo = nullptr; // Optional
+            descriptorWrites[0].pTexelBufferView = nullptr; // Optional
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
     }
 
-    void CreateDescriptorSetLayout()
+#ifdef COMPUTE_SKINNING
+    void CreateSkinningDescriptorSetLayout()
     {
-        // UBO descriptor layout
+        // Bone palette UBO
         VkDescriptorSetLayoutBinding uboLayoutBinding{};
         uboLayoutBinding.binding = 0;
         uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
         uboLayoutBinding.descriptorCount = 1;
-        //uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT;
+        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
         uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
 
-        // Combined image sampler descriptor layout
-        VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-        samplerLayoutBinding.binding = 1;
-        samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        samplerLayoutBinding.descriptorCount = 1;
-        samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        samplerLayoutBinding.pImmutableSamplers = nullptr; // Optional
+        // Bind pose vertices
+        VkDescriptorSetLayoutBinding inVerticesLayoutBinding{};
+        inVerticesLayoutBinding.binding = 1;
+        inVerticesLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        inVerticesLayoutBinding.descriptorCount = 1;
+        inVerticesLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        inVerticesLayoutBinding.pImmutableSamplers = nullptr;
 
-        std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+        // Post-skin vertices
+        VkDescriptorSetLayoutBinding outVerticesLayoutBinding{};
+        outVerticesLayoutBinding.binding = 2;
+        outVerticesLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        outVerticesLayoutBinding.descriptorCount = 1;
+        outVerticesLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        outVerticesLayoutBinding.pImmutableSamplers = nullptr;
+
+        std::array<VkDescriptorSetLayoutBinding, 3> bindings = { uboLayoutBinding, inVerticesLayoutBinding, outVerticesLayoutBinding };
 
         VkDescriptorSetLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
         layoutInfo.pBindings = bindings.data();
 
-        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &skinningDescriptorSetLayout) != VK_SUCCESS)
             throw std::runtime_error("failed to create descriptor set layout!");
     }
 
-    void CreateGridDescriptorSetLayout()
+    void CreateSkinningComputePipeline()
     {
-        // UBO descriptor layout
-        VkDescriptorSetLayoutBinding uboLayoutBinding{};
-        uboLayoutBinding.binding = 0;
-        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uboLayoutBinding.descriptorCount = 1;
-        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-        uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+        const std::string compShaderFile = PaletteShaderFile("skinning", "comp");
+        ComputePipeline tmpComputePipeline(device, skinningPipelineLayout, skinningDescriptorSetLayout, compShaderFile.c_str(), "skinning", skinningPipeline);
+    }
 
-        VkDescriptorSetLayoutCreateInfo layoutInfo{};
-        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layoutInfo.bindingCount = 1;
-        layoutInfo.pBindings = &uboLayoutBinding;
+    void CreateSkinningDescriptorPool()
+    {
+        // One set per frame in flight for every model, which is the most that can be skinned at once. Sets of removed models are freed
+        std::array<VkDescriptorPoolSize, 2> poolSizes;
+        // Bone palette UBO
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_MODELS * MAX_FRAMES_IN_FLIGHT);
+        // Bind pose and post-skin vertices
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[1].descriptorCount = static_cast<uint32_t>(2 * MAX_MODELS * MAX_FRAMES_IN_FLIGHT);
 
-        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &gridDescriptorSetLayout) != VK_SUCCESS)
-            throw std::runtime_error("failed to create descriptor set layout!");
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = static_cast<uint32_t>(MAX_MODELS * MAX_FRAMES_IN_FLIGHT);
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &skinningDescriptorPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor pool!");
     }
 
-    void CreateImGuiDescriptorSetLayout()
+    /// <summary>
+    /// Creates the post-skin vertex buffers of an animated model's mesh, one per frame in flight, and the descriptor sets that skin into them
+    /// </summary>
+    /// <param name="modelIndex"></param>
+    void CreateSkinnedVertexBuffers(const size_t modelIndex)
     {
-        // UBO descriptor layout
-        VkDescriptorSetLayoutBinding uboLayoutBinding{};
-        uboLayoutBinding.binding = 0;
-        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uboLayoutBinding.descriptorCount = 1;
-        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-        uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+        Mesh& mesh = models[modelIndex].meshes[0];
+        VkDeviceSize bufferSize = sizeof(mesh.vertices[0]) * mesh.vertices.size();
 
-        VkDescriptorSetLayoutCreateInfo layoutInfo{};
-        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layoutInfo.bindingCount = 1;
-        layoutInfo.pBindings = &uboLayoutBinding;
+        if (!freeSkinnedBufferSlots.empty())
+        {
+            mesh.skinnedBufferIndex = freeSkinnedBufferSlots.back();
+            freeSkinnedBufferSlots.pop_back();
+            skinningDescriptorSets[mesh.skinnedBufferIndex].resize(MAX_FRAMES_IN_FLIGHT);
+        }
+        else
+        {
+            mesh.skinnedBufferIndex = static_cast<int>(skinnedVertexBuffers.size());
+            skinnedVertexBuffers.emplace_back(MAX_FRAMES_IN_FLIGHT);
+            skinnedVertexBufferMemories.emplace_back(MAX_FRAMES_IN_FLIGHT);
+            skinningDescriptorSets.emplace_back(MAX_FRAMES_IN_FLIGHT);
+        }
 
-        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &imguiDescriptorSetLayout) != VK_SUCCESS)
-            throw std::runtime_error("failed to create descriptor set layout!");
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+            CreateBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                skinnedVertexBuffers[mesh.skinnedBufferIndex][i], skinnedVertexBufferMemories[mesh.skinnedBufferIndex][i]);
+
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, skinningDescriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = skinningDescriptorPool;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.pSetLayouts = layouts.data();
+
+        if (vkAllocateDescriptorSets(device, &allocInfo, skinningDescriptorSets[mesh.skinnedBufferIndex].data()) != VK_SUCCESS)
+            throw std::runtime_error("failed to allocate descriptor sets!");
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            // Bone palette UBO
+            VkDescriptorBufferInfo bufferInfo{};
+            bufferInfo.buffer = uniformBuffers[modelIndex][i];
+            bufferInfo.offset = 0;
+            bufferInfo.range = sizeof(UniformBufferObject);
+
+            // Post-skin vertices
+            VkDescriptorBufferInfo outVerticesInfo{};
+            outVerticesInfo.buffer = skinnedVertexBuffers[mesh.skinnedBufferIndex][i];
+            outVerticesInfo.offset = 0;
+            outVerticesInfo.range = bufferSize;
+
+            std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[0].dstSet = skinningDescriptorSets[mesh.skinnedBufferIndex][i];
+            descriptorWrites[0].dstBinding = 0;
+            descriptorWrites[0].dstArrayElement = 0;
+            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptorWrites[0].descriptorCount = 1;
+            descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[1].dstSet = skinningDescriptorSets[mesh.skinnedBufferIndex][i];
+            descriptorWrites[1].dstBinding = 2;
+            descriptorWrites[1].dstArrayElement = 0;
+            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[1].descriptorCount = 1;
+            descriptorWrites[1].pBufferInfo = &outVerticesInfo;
+
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+            WriteSkinningInputDescriptors(mesh, i);
     }
 
-    void CreateLightingDataDescriptorSetLayout()
+    /// <summary>
+    /// Points the bind pose vertices of a mesh's skinning descriptor set of one frame slot at its range of the geometry arena.
+    /// Rewritten when compaction moves the range, once the slot's frame completed
+    /// </summary>
+    void WriteSkinningInputDescriptors(const Mesh& mesh, const uint32_t frame)
     {
-        // UBO descriptor layout
-        VkDescriptorSetLayoutBinding uboLayoutBinding{};
-        uboLayoutBinding.binding = 0;
-        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        uboLayoutBinding.descriptorCount = 1;
-        //uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT;
-        uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+        // Bind pose vertices
+        VkDescriptorBufferInfo inVerticesInfo{};
+        inVerticesInfo.buffer = geometryBlocks[mesh.geometry.block].vertexBuffer;
+        inVerticesInfo.offset = GEOMETRY_VERTEX_STRIDE * mesh.geometry.firstVertex;
+        inVerticesInfo.range = GEOMETRY_VERTEX_STRIDE * mesh.geometry.vertexCount;
+
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = skinningDescriptorSets[mesh.skinnedBufferIndex][frame];
+        descriptorWrite.dstBinding = 1;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &inVerticesInfo;
+
+        vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+    }
 
-        // Combined image sampler descriptor layout for diffuse
-        VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-        samplerLayoutBinding.binding = 1;
-        samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        samplerLayoutBinding.descriptorCount = 1;
-        samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        samplerLayoutBinding.pImmutableSamplers = nullptr; // Optional
+    /// <summary>
+    /// Skins every enabled animated mesh into its post-skin vertex buffer for currentFrame.
+    /// Must be recorded outside the render pass. Later passes of the frame read the result as vertex input
+    /// </summary>
+    /// <param name="commandBuffer"></param>
+    void RecordSkinningPass(VkCommandBuffer commandBuffer)
+    {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinningPipeline);
 
-        // Lighting data UBO descriptor layout
-        VkDescriptorSetLayoutBinding lightingUBOLayoutBinding{};
-        lightingUBOLayoutBinding.binding = 2;
-        lightingUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        lightingUBOLayoutBinding.descriptorCount = 1;
-        lightingUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        lightingUBOLayoutBinding.pImmutableSamplers = nullptr; // Optional
+        for (size_t i = 0; i < emptyModelIndex; i++)
+        {
+            if (!models[i].resident || !models[i].enabled)
+                continue;
 
-        // Combined image sampler descriptor layout for normal
-        VkDescriptorSetLayoutBinding normalSamplerLayoutBinding{};
-        normalSamplerLayoutBinding.binding = 3;
-        normalSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        normalSamplerLayoutBinding.descriptorCount = 1;
-        normalSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-        normalSamplerLayoutBinding.pImmutableSamplers = nullptr;
+            for (const Mesh& mesh : models[i].meshes)
+            {
+                if (mesh.skinnedBufferIndex < 0)
+                    continue;
 
-        std::array<VkDescriptorSetLayoutBinding, 4> bindings = { uboLayoutBinding, samplerLayoutBinding, lightingUBOLayoutBinding, normalSamplerLayoutBinding };
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinningPipelineLayout, 0, 1,
+                    &skinningDescriptorSets[mesh.skinnedBufferIndex][currentFrame], 0, nullptr);
+
+                const uint32_t groupCount = (static_cast<uint32_t>(mesh.vertices.size()) + SKINNING_GROUP_SIZE - 1) / SKINNING_GROUP_SIZE;
+                vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+            }
+        }
+
+        // Post-skin vertices must be written before any pass reads them
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+    }
+#endif // COMPUTE_SKINNING
+
+#ifdef CLUSTER_CULLING
+    void CreateClusterCullDescriptorSetLayout()
+    {
+        // Meshlets, indices of the geometry block, visible indices and indirect draws
+        std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+        for (uint32_t i = 0; i < bindings.size(); i++)
+        {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            bindings[i].pImmutableSamplers = nullptr;
+        }
 
         VkDescriptorSetLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
         layoutInfo.pBindings = bindings.data();
 
-        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &lightingDataDescriptorSetLayout) != VK_SUCCESS)
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &clusterCullDescriptorSetLayout) != VK_SUCCESS)
             throw std::runtime_error("failed to create descriptor set layout!");
     }
 
-    void CreateUniformBuffers(const size_t modelIndex)
+    void CreateClusterCullComputePipeline()
     {
-        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-        uniformBuffers.resize(emptyModelIndex + 1);
-        uniformBuffersMemory.resize(emptyModelIndex + 1);
-        uniformBuffersMapped.resize(emptyModelIndex + 1);
-        uniformBuffers[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMemory[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
-        uniformBuffersMapped[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
+        ComputePipeline tmpComputePipeline(device, clusterCullPipelineLayout, clusterCullDescriptorSetLayout, "shaders/cluster_cull_comp.spv", "cluster culling",
+            clusterCullPipeline, sizeof(ClusterCullConstants));
+    }
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
-        {
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                uniformBuffers[modelIndex][i], uniformBuffersMemory[modelIndex][i]);
+    void CreateClusterCullDescriptorPool()
+    {
+        // One set per frame in flight for every geometry block the pass culls meshes of
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = static_cast<uint32_t>(4 * MAX_CLUSTER_CULL_BLOCKS * MAX_FRAMES_IN_FLIGHT);
 
-            // Persistent mapping
-            vkMapMemory(device, uniformBuffersMemory[modelIndex][i], 0, bufferSize, 0, &uniformBuffersMapped[modelIndex][i]);
-        }
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = static_cast<uint32_t>(MAX_CLUSTER_CULL_BLOCKS * MAX_FRAMES_IN_FLIGHT);
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &clusterCullDescriptorPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor pool!");
     }
 
-    void CreateSkyboxUniformBuffer()
+    void CreateClusterCullDescriptorSets()
     {
-        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-        skyboxUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        skyboxUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-        skyboxUniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
-
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        clusterCullDescriptorSets.resize(MAX_CLUSTER_CULL_BLOCKS, std::vector<VkDescriptorSet>(MAX_FRAMES_IN_FLIGHT));
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, clusterCullDescriptorSetLayout);
+        for (uint32_t b = 0; b < MAX_CLUSTER_CULL_BLOCKS; b++)
         {
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                skyboxUniformBuffers[i], skyboxUniformBuffersMemory[i]);
+            VkDescriptorSetAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorPool = clusterCullDescriptorPool;
+            allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+            allocInfo.pSetLayouts = layouts.data();
 
-            // Persistent mapping
-            vkMapMemory(device, skyboxUniformBuffersMemory[i], 0, bufferSize, 0, &skyboxUniformBuffersMapped[i]);
+            if (vkAllocateDescriptorSets(device, &allocInfo, clusterCullDescriptorSets[b].data()) != VK_SUCCESS)
+                throw std::runtime_error("failed to allocate descriptor sets!");
         }
     }
 
-    void CreateGridUniformBuffer()
+    /// <summary>
+    /// Points the descriptor set of a geometry block and frame at the current buffers of both. Blocks are created, compacted
+    /// and destroyed while models stream, so sets are written each frame they are used, once the frame's fence has been waited on
+    /// </summary>
+    void WriteClusterCullDescriptors(const uint32_t blockIndex, const uint32_t frame)
     {
-        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-        gridUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        gridUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-        gridUniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        const GeometryBlock& block = geometryBlocks[blockIndex];
+        const std::array<VkBuffer, 4> buffers = { block.meshletBuffer, block.indexBuffer, clusterIndexBuffers[frame], clusterDrawBuffers[frame] };
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+        std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+        for (uint32_t i = 0; i < buffers.size(); i++)
         {
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                gridUniformBuffers[i], gridUniformBuffersMemory[i]);
-
-            // Persistent mapping
-            vkMapMemory(device, gridUniformBuffersMemory[i], 0, bufferSize, 0, &gridUniformBuffersMapped[i]);
+            bufferInfos[i].buffer = buffers[i];
+            bufferInfos[i].offset = 0;
+            bufferInfos[i].range = VK_WHOLE_SIZE;
+
+            descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[i].dstSet = clusterCullDescriptorSets[blockIndex][frame];
+            descriptorWrites[i].dstBinding = i;
+            descriptorWrites[i].dstArrayElement = 0;
+            descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[i].descriptorCount = 1;
+            descriptorWrites[i].pBufferInfo = &bufferInfos[i];
         }
+
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
 
-    void CreateLightingUniformBuffers(const uint32_t modelIndex)
+    /// <summary>
+    /// Grows the visible index buffer and the indirect draw buffer of a frame to hold at least the given indices and draws.
+    /// The frame's fence must have been waited on, as replaced buffers are destroyed right away
+    /// </summary>
+    void ReserveClusterCullBuffers(const uint32_t frame, const uint32_t drawCount, const uint32_t indexCount)
     {
-        VkDeviceSize bufferSize = sizeof(LightDataUBO);
-        lightingUniformBuffers.resize(emptyModelIndex + 1);
-        lightingUniformBuffersMemory.resize(emptyModelIndex + 1);
-        lightingUniformBuffersMapped.resize(emptyModelIndex + 1);
-        lightingUniformBuffers[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
-        lightingUniformBuffersMemory[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
-        lightingUniformBuffersMapped[modelIndex].resize(MAX_FRAMES_IN_FLIGHT);
-
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        if (indexCount > clusterIndexCapacities[frame])
         {
-            CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                lightingUniformBuffers[modelIndex][i], lightingUniformBuffersMemory[modelIndex][i]);
+            vkDestroyBuffer(device, clusterIndexBuffers[frame], nullptr);
+            vkFreeMemory(device, clusterIndexBufferMemories[frame], nullptr);
 
-            // Persistent mapping
-            vkMapMemory(device, lightingUniformBuffersMemory[modelIndex][i], 0, bufferSize, 0, &lightingUniformBuffersMapped[modelIndex][i]);
+            clusterIndexCapacities[frame] = std::max(indexCount, 2 * clusterIndexCapacities[frame]);
+            CreateBuffer(sizeof(uint32_t) * static_cast<VkDeviceSize>(clusterIndexCapacities[frame]), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, clusterIndexBuffers[frame], clusterIndexBufferMemories[frame]);
+        }
+
+        if (drawCount > clusterDrawCapacities[frame])
+        {
+            if (clusterDrawBuffersMapped[frame] != nullptr)
+                vkUnmapMemory(device, clusterDrawBufferMemories[frame]);
+            vkDestroyBuffer(device, clusterDrawBuffers[frame], nullptr);
+            vkFreeMemory(device, clusterDrawBufferMemories[frame], nullptr);
+
+            // Host visible, so draws are reset without a transfer, and their visible index counts read back for the GUI
+            clusterDrawCapacities[frame] = std::max(drawCount, 2 * clusterDrawCapacities[frame]);
+            const VkDeviceSize bufferSize = sizeof(VkDrawIndexedIndirectCommand) * static_cast<VkDeviceSize>(clusterDrawCapacities[frame]);
+            CreateBuffer(bufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, clusterDrawBuffers[frame], clusterDrawBufferMemories[frame]);
+            vkMapMemory(device, clusterDrawBufferMemories[frame], 0, bufferSize, 0, &clusterDrawBuffersMapped[frame]);
         }
     }
 
-    void UpdateUniformBuffer(const size_t modelIndex, uint32_t currentFrame)
+    /// <summary>
+    /// Culls the meshlets of every static mesh drawn at full detail against the view frustum and their normal cones, one dispatch
+    /// per mesh, and compacts the indices of the visible ones into an indirect draw per mesh. Marks the culled meshes for
+    /// DrawMesh. Animated meshes are drawn whole, as their meshlet bounds only hold for the bind pose, and so are exploding ones.
+    /// Must be recorded outside the render pass
+    /// </summary>
+    /// <param name="commandBuffer"></param>
+    void RecordClusterCullPass(VkCommandBuffer commandBuffer)
     {
-        UniformBufferObject ubo{};
-#ifdef ENABLE_CAMERA_ANIM
-        static auto startTime = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < emptyModelIndex; i++)
+            for (Mesh& mesh : models[i].meshes)
+                mesh.clusterDrawIndex = -1;
 
-        auto currentTime = std::chrono::high_resolution_clock::now();
+        clusterDrawCounts[currentFrame] = 0;
+        clusterTestedTriangles[currentFrame] = 0;
+        if (!gui.cluster_culling_flag)
+            return;
 
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+        std::vector<Mesh*> culledMeshes;
+        std::vector<size_t> culledModels;
+        uint32_t indexCount = 0;
+        for (size_t i = 0; i < emptyModelIndex && i < gui.explode_flags.size(); i++)
+        {
+            Model& model = models[i];
+            if (!model.resident || !model.enabled || gui.explode_flags[i] || !model.meshes[0].animations.empty())
+                continue;
 
-        ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.proj = glm::perspective(glm::radians(45.0f), sc.extent.width / (float)sc.extent.height, 0.1f, 10.0f);   // without sc.extent we get wrong aspect ratio if resize happens
-#else
-        ubo.proj = cam.GetCurrentProjectionMatrix(sc.extent.width, sc.extent.height);
-        ubo.view = cam.GetCurrentViewMatrix();
+            for (Mesh& mesh : model.meshes)
+            {
+                if (mesh.geometry.meshletCount == 0 || mesh.geometry.meshletCount > MAX_CLUSTER_CULL_MESHLETS
+                    || mesh.geometry.block >= MAX_CLUSTER_CULL_BLOCKS || mesh.Lod(model.lodLevel).firstIndex != 0)
+                    continue;
 
-        ubo.model = glm::mat4(1.0f);
-        if (modelIndex == 0)
-        {
-            ubo.model = glm::rotate(
-                glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-                glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+                mesh.clusterDrawIndex = static_cast<int>(culledMeshes.size());
+                culledMeshes.push_back(&mesh);
+                culledModels.push_back(i);
+                indexCount += mesh.lods[0].indexCount;
+            }
         }
 
-        if (modelIndex == 1)
-        {
-            static auto startTime = std::chrono::high_resolution_clock::now();
+        if (culledMeshes.empty())
+            return;
 
-            auto currentTime = std::chrono::high_resolution_clock::now();
+        const uint32_t drawCount = static_cast<uint32_t>(culledMeshes.size());
+        ReserveClusterCullBuffers(currentFrame, drawCount, indexCount);
 
-            float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-            ubo.model = glm::rotate(ubo.model, time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        // Every mesh gets the range of its full index count in the visible index buffer, and starts with no visible triangles
+        VkDrawIndexedIndirectCommand* draws = static_cast<VkDrawIndexedIndirectCommand*>(clusterDrawBuffersMapped[currentFrame]);
+        uint32_t firstIndex = 0;
+        for (uint32_t d = 0; d < drawCount; d++)
+        {
+            draws[d] = { 0, 1, firstIndex, static_cast<int32_t>(culledMeshes[d]->geometry.firstVertex), 0 };
+            firstIndex += culledMeshes[d]->lods[0].indexCount;
         }
 
-        ubo.model = glm::translate(ubo.model, glm::vec3(gui.model_translations[modelIndex][0], gui.model_translations[modelIndex][1], gui.model_translations[modelIndex][2]));
-        ubo.model = glm::scale(ubo.model, glm::vec3(gui.model_scales[modelIndex]));
+        glm::mat4 projection = cam.GetCurrentProjectionMatrix(static_cast<float>(sc.extent.width), static_cast<float>(sc.extent.height));
+        projection[1][1] *= -1;
+        glm::vec4 worldPlanes[6];
+        ExtractFrustumPlanes(projection * cam.GetCurrentViewMatrix(), worldPlanes);
 
-#endif // ENABLE_CAMERA_ANIM
-        ubo.proj[1][1] *= -1;   // Flip sign of scaling factor
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusterCullPipeline);
 
-        // Animate model
-        bool reset_animations = false;
-        for (auto& animPlayer : animPlayers)
+        ClusterCullConstants constants{};
+        constants.flags = CLUSTER_CULL_FRUSTUM | (gui.cluster_backface_flag ? CLUSTER_CULL_BACKFACE : 0);
+        std::vector<bool> blockWritten(MAX_CLUSTER_CULL_BLOCKS, false);
+        uint32_t boundBlock = std::numeric_limits<uint32_t>::max();
+        size_t constantsModel = std::numeric_limits<size_t>::max();
+        for (uint32_t d = 0; d < drawCount; d++)
         {
-            if (modelIndex == animPlayer.modelIndex && !animPlayer.tgt_model->meshes[0].animations.empty())
-            {
-                animPlayer.is_playing = gui.play_animation_flag;
+            const Mesh& mesh = *culledMeshes[d];
 
-                std::vector<glm::vec3> skeletonBones;                   // TODO: NOT USED NOW!
-                animPlayer.UpdateTime(timer.GetData().DeltaTime, gui.animation_speed);
-
-                // Checks for animation reset
-                /*if (gui.reset_animation_flag)
-                {
-                    animPlayer.ResetTime();
-                    reset_animations = true;
-                }*/
-
-                std::vector<glm::mat4> boneTranforms;
-                if (animPlayer.tgt_model->meshes[0].animations.size() > 1)
-                    boneTranforms = animPlayer.tgt_model->AnimateLI2(animPlayer.animation_time, &skeletonBones, gui.animation_interpolation_value);
-                else if (gui.cubic_interpolation_flag)
-                    boneTranforms = animPlayer.tgt_model->AnimateCI(animPlayer.animation_time, &skeletonBones);
-                else
-                    boneTranforms = animPlayer.tgt_model->AnimateLI(animPlayer.animation_time, &skeletonBones);
-                memcpy(ubo.boneTransforms, boneTranforms.data(), boneTranforms.size() * sizeof(glm::mat4));
+            // Meshlet bounds stay in model space. The transpose of the model matrix takes world planes there, still giving world distances,
+            // and normal cones hold in model space as long as the model scale is uniform
+            if (constantsModel != culledModels[d])
+            {
+                const glm::mat4 modelMatrix = GetModelMatrix(culledModels[d]);
+                const glm::mat4 planeTransform = glm::transpose(modelMatrix);
+                for (int p = 0; p < 6; p++)
+                    constants.frustumPlanes[p] = planeTransform * worldPlanes[p];
+
+                const float scale = std::max({ glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2])) });
+                constants.cameraPosition = glm::vec4(glm::vec3(glm::inverse(modelMatrix) * glm::vec4(cam.position, 1.0f)), scale);
+                constantsModel = culledModels[d];
             }
-        }
-
-        //ubo.time = glfwGetTime();
-        ubo.explode = static_cast<bool>(gui.explode_flags[modelIndex]);
-        ubo.time = gui.explosion_rates[modelIndex];
-
-        memcpy(uniformBuffersMapped[modelIndex][currentFrame], &ubo, sizeof(ubo));
-    }
-
-    void UpdateSkyboxUniformBuffer(uint32_t currentFrame)
-    {
-        UniformBufferObject ubo{};
 
-        ubo.model = glm::mat4(1.0f);
-        ubo.proj = cam.GetCurrentProjectionMatrix(sc.extent.width, sc.extent.height);
-        ubo.view = glm::mat4(glm::mat3(cam.GetCurrentViewMatrix()));                        // Remove translation from view matrix
+            if (!blockWritten[mesh.geometry.block])
+            {
+                WriteClusterCullDescriptors(mesh.geometry.block, currentFrame);
+                blockWritten[mesh.geometry.block] = true;
+            }
+            if (boundBlock != mesh.geometry.block)
+            {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, clusterCullPipelineLayout, 0, 1,
+                    &clusterCullDescriptorSets[mesh.geometry.block][currentFrame], 0, nullptr);
+                boundBlock = mesh.geometry.block;
+            }
 
-        ubo.proj[1][1] *= -1;   // Flip sign of scaling factor
+            constants.firstMeshlet = mesh.geometry.firstMeshlet;
+            constants.firstIndex = mesh.geometry.firstIndex;
+            constants.drawIndex = d;
+            vkCmdPushConstants(commandBuffer, clusterCullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
 
-        memcpy(skyboxUniformBuffersMapped[currentFrame], &ubo, sizeof(ubo));
-    }
+            // One workgroup per meshlet
+            vkCmdDispatch(commandBuffer, mesh.geometry.meshletCount, 1, 1);
+        }
 
-    void UpdateLightingDataUniformBuffer(const size_t modelIndex, uint32_t currentFrame)
-    {
-        LightDataUBO lightUBO{};
+        // Visible indices and index counts must be written before the draws read them, and the counts are read back for the GUI
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_HOST_READ_BIT;
 
-        lightUBO.blinn = gui.blinn_flag;
-        lightUBO.lightPos = glm::vec3(gui.light_pos[0], gui.light_pos[1], gui.light_pos[2]);
-        lightUBO.camPos = cam.position;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
 
-        memcpy(lightingUniformBuffersMapped[0][currentFrame], &lightUBO, sizeof(lightUBO));
+        clusterDrawCounts[currentFrame] = drawCount;
+        clusterTestedTriangles[currentFrame] = indexCount / 3;
     }
 
-    void UpdateGridUniformBuffer(uint32_t currentFrame)
+    /// <summary>
+    /// Sums the triangles the cluster culling pass of a frame kept, once its fence has been waited on
+    /// </summary>
+    /// <param name="frame"></param>
+    void ReadClusterCullStats(const uint32_t frame)
     {
-        UniformBufferObject ubo{};
-
-        ubo.model = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-        ubo.model = glm::scale(ubo.model, glm::vec3(200.0f));
-        ubo.proj = cam.GetCurrentProjectionMatrix(sc.extent.width, sc.extent.height);
-        ubo.view = cam.GetCurrentViewMatrix();
+        uint32_t visibleIndices = 0;
+        const VkDrawIndexedIndirectCommand* draws = static_cast<const VkDrawIndexedIndirectCommand*>(clusterDrawBuffersMapped[frame]);
+        for (uint32_t d = 0; d < clusterDrawCounts[frame]; d++)
+            visibleIndices += draws[d].indexCount;
 
-        ubo.proj[1][1] *= -1;   // Flip sign of scaling factor
-
-        memcpy(gridUniformBuffersMapped[currentFrame], &ubo, sizeof(ubo));
+        gui.cluster_visible_triangles = visibleIndices / 3;
+        gui.cluster_tested_triangles = clusterTestedTriangles[frame];
     }
+#endif // CLUSTER_CULLING
 
-    void CreateDescriptorPool(const size_t modelIndex)
+#ifdef BAKED_CROWD
+    void CreateCrowdBuffers()
     {
-        descriptorPools.resize(descriptorPools.size() + 1);
-
-        std::array<VkDescriptorPoolSize, 2> poolSizes;
-        // UBO
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        // Sampler
-        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+#ifdef GPU_ANIMATION
+        // One palette per instance, written by the animation compute pass. Also read back by its validation
+        CreateBuffer(sizeof(glm::mat4) * gpuAnimation.boneCount * crowd.Size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, crowdPaletteBuffer, crowdPaletteBufferMemory);
+#else
+        // Baked palettes, static after upload
+        VkDeviceSize bufferSize = crowdAnimation.MemorySize();
 
-        VkDescriptorPoolCreateInfo poolInfo{};
-        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-        poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        //poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            stagingBuffer, stagingBufferMemory);
 
-        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPools[modelIndex]) != VK_SUCCESS)
-            throw std::runtime_error("failed to create descriptor pool!");
-    }
+        void* data;
+        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        memcpy(data, crowdAnimation.palettes.data(), static_cast<size_t>(bufferSize));
+        vkUnmapMemory(device, stagingBufferMemory);
 
-    void CreateImGuiDescriptorPool()
-    {
-        VkDescriptorPoolSize poolSize;
-        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSize.descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            crowdPaletteBuffer, crowdPaletteBufferMemory);
 
-        VkDescriptorPoolCreateInfo poolInfo{};
-        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);;
-        poolInfo.poolSizeCount = 1;
-        poolInfo.pPoolSizes = &poolSize;
+        CopyBuffer(stagingBuffer, crowdPaletteBuffer, bufferSize);
 
-        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &imguiDescriptorPool));
-    }
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        vkFreeMemory(device, stagingBufferMemory, nullptr);
+#endif // GPU_ANIMATION
 
-    void CreateSkyboxDescriptorPool()
-    {
-        std::array<VkDescriptorPoolSize, 2> poolSizes;
-        // UBO
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        // Sampler
-        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        // Instance data, rewritten every frame
+        VkDeviceSize instanceBufferSize = sizeof(CrowdInstanceData) * crowd.Size();
+        crowdInstanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        crowdInstanceBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        crowdInstanceBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
-        VkDescriptorPoolCreateInfo poolInfo{};
-        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-        poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        //poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            CreateBuffer(instanceBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                crowdInstanceBuffers[i], crowdInstanceBuffersMemory[i]);
 
-        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &skyboxDescriptorPool) != VK_SUCCESS)
-            throw std::runtime_error("failed to create descriptor pool!");
+            // Persistent mapping
+            vkMapMemory(device, crowdInstanceBuffersMemory[i], 0, instanceBufferSize, 0, &crowdInstanceBuffersMapped[i]);
+            crowd.Update(0.0, 0.0f, false, static_cast<CrowdInstanceData*>(crowdInstanceBuffersMapped[i]), CrowdGpuInstances(i));
+        }
     }
 
-    void CreateGridDescriptorPool()
+    void CreateCrowdDescriptorSetLayout()
     {
-        std::array<VkDescriptorPoolSize, 1> poolSizes;
-        // UBO
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        // Same as the lighting data layout, plus the baked palettes and instance data
+        std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+        const VkDescriptorType types[6] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+        const VkShaderStageFlags stages[6] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT, VK_SHADER_STAGE_FRAGMENT_BIT,
+            VK_SHADER_STAGE_FRAGMENT_BIT, VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_VERTEX_BIT };
+
+        for (uint32_t i = 0; i < bindings.size(); i++)
+        {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = types[i];
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = stages[i];
+            bindings[i].pImmutableSamplers = nullptr;
+        }
 
-        VkDescriptorPoolCreateInfo poolInfo{};
-        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-        poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        //poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
 
-        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &gridDescriptorPool) != VK_SUCCESS)
-            throw std::runtime_error("failed to create descriptor pool!");
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &crowdDescriptorSetLayout) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor set layout!");
     }
 
-    void CreateNormalDescriptorPool()
+    void CreateCrowdGraphicsPipeline(const std::string& vertShaderFile = ModelShaderFile("baked_skinning"), const char* fragShaderFile = "shaders/linear_skinning_frag.spv")
     {
-        std::array<VkDescriptorPoolSize, 1> poolSizes;
-        // UBO
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-
-        VkDescriptorPoolCreateInfo poolInfo{};
-        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-        poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+        GetModelVertexInput(true, bindingDescriptions, attributeDescriptions);
 
-        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &normalDescriptorPool) != VK_SUCCESS)
-            throw std::runtime_error("failed to create descriptor pool!");
+        GraphicsPipeline tmpGraphPipeline(device, sc, msaaSamples, VK_TRUE, VK_POLYGON_MODE_FILL, VK_TRUE, VK_TRUE,
+            bindingDescriptions, attributeDescriptions,
+            crowdPipelineLayout, crowdDescriptorSetLayout, renderPass, vertShaderFile.c_str(), fragShaderFile, "crowd", crowdGraphicsPipeline);
     }
 
-    void CreateLightingDataDescriptorPool(const uint32_t modelIndex)
+    void CreateCrowdDescriptorPool()
     {
-        descriptorPools.resize(descriptorPools.size() + 1);
-
-        std::array<VkDescriptorPoolSize, 4> poolSizes;
-        // UBO
+        std::array<VkDescriptorPoolSize, 3> poolSizes;
+        // UBO and LightData UBO
         poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        // Diffuse Sampler
+        poolSizes[0].descriptorCount = static_cast<uint32_t>(2 * MAX_FRAMES_IN_FLIGHT);
+        // Diffuse and Normal Samplers
         poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        // LightData UBO
-        poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        // Normal Sampler
-        poolSizes[3].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[3].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolSizes[1].descriptorCount = static_cast<uint32_t>(2 * MAX_FRAMES_IN_FLIGHT);
+        // Palettes and instance data
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[2].descriptorCount = static_cast<uint32_t>(2 * MAX_FRAMES_IN_FLIGHT);
 
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
         poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        //poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-
-        /*if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &lightingDescriptorPool) != VK_SUCCESS)
-            throw std::runtime_error("failed to create descriptor pool!");*/
 
-        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPools[modelIndex]) != VK_SUCCESS)
-            throw std::runtime_error("failed to create descriptor pool!");
-    }
-
-    void CreateDescriptorSets(const size_t modelIndex, bool passLightingData = false)
-    {
-        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
-        std::vector<VkDescriptorSetLayout> lightingDataLayouts(MAX_FRAMES_IN_FLIGHT, lightingDataDescriptorSetLayout);
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &crowdDescriptorPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor pool!");
+    }
 
+    void CreateCrowdDescriptorSets()
+    {
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, crowdDescriptorSetLayout);
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        /*if (passLightingData)
-            allocInfo.descriptorPool = lightingDescriptorPool;
-        else
-            allocInfo.descriptorPool = descriptorPools[modelIndex];*/
-        allocInfo.descriptorPool = descriptorPools[modelIndex];
+        allocInfo.descriptorPool = crowdDescriptorPool;
         allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        if (passLightingData)
-            allocInfo.pSetLayouts = lightingDataLayouts.data();
-        else
-            allocInfo.pSetLayouts = layouts.data();
+        allocInfo.pSetLayouts = layouts.data();
 
-        descriptorSets.resize(descriptorSets.size() + 1);
-        descriptorSets[modelIndex].resize(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+        crowdDescriptorSets.resize(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
 
-        if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets[modelIndex].data()) != VK_SUCCESS)
+        if (vkAllocateDescriptorSets(device, &allocInfo, crowdDescriptorSets.data()) != VK_SUCCESS)
             throw std::runtime_error("failed to allocate descriptor sets!");
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
-            // UBO
+            // Shares the UBO and textures of the baked model
             VkDescriptorBufferInfo bufferInfo{};
-            bufferInfo.buffer = uniformBuffers[modelIndex][i];
+            bufferInfo.buffer = uniformBuffers[crowdModelIndex][i];
             bufferInfo.offset = 0;
             bufferInfo.range = sizeof(UniformBufferObject);
 
-            // Sampler
             VkDescriptorImageInfo imageInfo{};
-            imageInfo.sampler = textureSamplers[modelIndex];
+            imageInfo.sampler = textureSamplers[crowdModelIndex];
             imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageInfo.imageView = textureImageViews[modelIndex];
+            imageInfo.imageView = textureImageViews[crowdModelIndex];
 
             VkDescriptorBufferInfo lightingBufferInfo{};
-
-            // Update configurations
-            if (passLightingData)
+            lightingBufferInfo.buffer = lightingUniformBuffers[0][i];
+            lightingBufferInfo.offset = 0;
+            lightingBufferInfo.range = sizeof(LightDataUBO);
+
+            VkDescriptorImageInfo normalImageInfo{};
+            normalImageInfo.sampler = normalSamplers[crowdModelIndex];
+            normalImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            normalImageInfo.imageView = normalImageViews[crowdModelIndex];
+
+            VkDescriptorBufferInfo paletteBufferInfo{};
+            paletteBufferInfo.buffer = crowdPaletteBuffer;
+            paletteBufferInfo.offset = 0;
+            paletteBufferInfo.range = VK_WHOLE_SIZE;
+
+            VkDescriptorBufferInfo instanceBufferInfo{};
+            instanceBufferInfo.buffer = crowdInstanceBuffers[i];
+            instanceBufferInfo.offset = 0;
+            instanceBufferInfo.range = VK_WHOLE_SIZE;
+
+            std::array<VkWriteDescriptorSet, 6> descriptorWrites{};
+            for (uint32_t b = 0; b < descriptorWrites.size(); b++)
             {
-                // Lighting data UBO
-                lightingBufferInfo.buffer = lightingUniformBuffers[0][i];
-                lightingBufferInfo.offset = 0;
-                lightingBufferInfo.range = sizeof(LightDataUBO);
+                descriptorWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[b].dstSet = crowdDescriptorSets[i];
+                descriptorWrites[b].dstBinding = b;
+                descriptorWrites[b].dstArrayElement = 0;
+                descriptorWrites[b].descriptorCount = 1;
+            }
 
-                // Normal map sampler
-                VkDescriptorImageInfo normalImageInfo{};
-                normalImageInfo.sampler = normalSamplers[modelIndex];
-                normalImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                normalImageInfo.imageView = normalImageViews[modelIndex];
+            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptorWrites[0].pBufferInfo = &bufferInfo;
+            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrites[1].pImageInfo = &imageInfo;
+            descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            descriptorWrites[2].pBufferInfo = &lightingBufferInfo;
+            descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            descriptorWrites[3].pImageInfo = &normalImageInfo;
+            descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[4].pBufferInfo = &paletteBufferInfo;
+            descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[5].pBufferInfo = &instanceBufferInfo;
 
-                std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
-                descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites[0].dstSet = descriptorSets[modelIndex][i];
-                descriptorWrites[0].dstBinding = 0;
-                descriptorWrites[0].dstArrayElement = 0;
-                descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                descriptorWrites[0].descriptorCount = 1;
-                descriptorWrites[0].pBufferInfo = &bufferInfo;
-                descriptorWrites[0].pImageInfo = nullptr; // Optional
-                descriptorWrites[0].pTexelBufferView = nullptr; // Optional
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+    }
+#endif // BAKED_CROWD
 
-                descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites[1].dstSet = descriptorSets[modelIndex][i];
-                descriptorWrites[1].dstBinding = 1;
-                descriptorWrites[1].dstArrayElement = 0;
-                descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                descriptorWrites[1].descriptorCount = 1;
-                descriptorWrites[1].pBufferInfo = nullptr;   // Optional
-                descriptorWrites[1].pImageInfo = &imageInfo;
-                descriptorWrites[1].pTexelBufferView = nullptr; // Optional
+#ifdef GPU_ANIMATION
+    void CreateGpuAnimationBuffers()
+    {
+        // Packed skeleton and clips, static after upload
+        VkDeviceSize bufferSize = gpuAnimation.MemorySize();
 
-                descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites[2].dstSet = descriptorSets[modelIndex][i];
-                descriptorWrites[2].dstBinding = 2;
-                descriptorWrites[2].dstArrayElement = 0;
-                descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                descriptorWrites[2].descriptorCount = 1;
-                descriptorWrites[2].pBufferInfo = &lightingBufferInfo;
-                descriptorWrites[2].pImageInfo = nullptr;
-                descriptorWrites[2].pTexelBufferView = nullptr;
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            stagingBuffer, stagingBufferMemory);
 
-                descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites[3].dstSet = descriptorSets[modelIndex][i];
-                descriptorWrites[3].dstBinding = 3;
-                descriptorWrites[3].dstArrayElement = 0;
-                descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                descriptorWrites[3].descriptorCount = 1;
-                descriptorWrites[3].pBufferInfo = nullptr;
-                descriptorWrites[3].pImageInfo = &normalImageInfo;
-                descriptorWrites[3].pTexelBufferView = nullptr;
+        void* data;
+        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        memcpy(data, gpuAnimation.words.data(), static_cast<size_t>(bufferSize));
+        vkUnmapMemory(device, stagingBufferMemory);
 
-                vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-            }
-            else
-            {
-                std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-                descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites[0].dstSet = descriptorSets[modelIndex][i];
-                descriptorWrites[0].dstBinding = 0;
-                descriptorWrites[0].dstArrayElement = 0;
-                descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                descriptorWrites[0].descriptorCount = 1;
-                descriptorWrites[0].pBufferInfo = &bufferInfo;
-                descriptorWrites[0].pImageInfo = nullptr; // Optional
-                descriptorWrites[0].pTexelBufferView = nullptr; // Optional
+        CreateBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            gpuAnimationBuffer, gpuAnimationBufferMemory);
 
-                descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrites[1].dstSet = descriptorSets[modelIndex][i];
-                descriptorWrites[1].dstBinding = 1;
-                descriptorWrites[1].dstArrayElement = 0;
-                descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-                descriptorWrites[1].descriptorCount = 1;
-                descriptorWrites[1].pBufferInfo = nullptr;   // Optional
-                descriptorWrites[1].pImageInfo = &imageInfo;
-                descriptorWrites[1].pTexelBufferView = nullptr; // Optional
+        CopyBuffer(stagingBuffer, gpuAnimationBuffer, bufferSize);
 
-                vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-            }
+        vkDestroyBuffer(device, stagingBuffer, nullptr);
+        vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+        // Joint transforms, only used between the passes
+        CreateBuffer(sizeof(glm::mat4) * gpuAnimation.jointCount * crowd.Size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            gpuJointBuffer, gpuJointBufferMemory);
+
+        // Instance clips and times, rewritten every frame
+        VkDeviceSize instanceBufferSize = sizeof(GpuAnimationInstance) * crowd.Size();
+        gpuAnimationInstanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        gpuAnimationInstanceBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        gpuAnimationInstanceBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        {
+            CreateBuffer(instanceBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                gpuAnimationInstanceBuffers[i], gpuAnimationInstanceBuffersMemory[i]);
+
+            // Persistent mapping
+            vkMapMemory(device, gpuAnimationInstanceBuffersMemory[i], 0, instanceBufferSize, 0, &gpuAnimationInstanceBuffersMapped[i]);
         }
     }
 
-    void CreateSkyboxDescriptorSet()
+    void CreateGpuAnimationDescriptorSetLayout()
     {
-        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+        // Packed data, instances, joint transforms and palettes. Four storage buffers, the minimum every implementation supports
+        std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+        for (uint32_t i = 0; i < bindings.size(); i++)
+        {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            bindings[i].pImmutableSamplers = nullptr;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+        layoutInfo.pBindings = bindings.data();
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &gpuAnimationDescriptorSetLayout) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    void CreateGpuAnimationComputePipeline(const char* compShaderFile = "shaders/animation_eval_comp.spv")
+    {
+        ComputePipeline tmpComputePipeline(device, gpuAnimationPipelineLayout, gpuAnimationDescriptorSetLayout, compShaderFile, "animation evaluation",
+            gpuAnimationPipeline, sizeof(GpuAnimationPass));
+    }
+
+    void CreateGpuAnimationDescriptorPool()
+    {
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = static_cast<uint32_t>(4 * MAX_FRAMES_IN_FLIGHT);
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &gpuAnimationDescriptorPool) != VK_SUCCESS)
+            throw std::runtime_error("failed to create descriptor pool!");
+    }
+
+    void CreateGpuAnimationDescriptorSets()
+    {
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, gpuAnimationDescriptorSetLayout);
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        allocInfo.descriptorPool = skyboxDescriptorPool;
+        allocInfo.descriptorPool = gpuAnimationDescriptorPool;
         allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
         allocInfo.pSetLayouts = layouts.data();
 
-        skyboxDescriptorSet.resize(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+        gpuAnimationDescriptorSets.resize(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
 
-        if (vkAllocateDescriptorSets(device, &allocInfo, skyboxDescriptorSet.data()) != VK_SUCCESS)
+        if (vkAllocateDescriptorSets(device, &allocInfo, gpuAnimationDescriptorSets.data()) != VK_SUCCESS)
             throw std::runtime_error("failed to allocate descriptor sets!");
 
         for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         {
-            // UBO
-            VkDescriptorBufferInfo bufferInfo{};
-            bufferInfo.buffer = skyboxUniformBuffers[i];
-            bufferInfo.offset = 0;
-            bufferInfo.range = sizeof(UniformBufferObject);
+            // Only the instance input differs between frames in flight
+            const std::array<VkBuffer, 4> buffers = { gpuAnimationBuffer, gpuAnimationInstanceBuffers[i], gpuJointBuffer, crowdPaletteBuffer };
 
-            // Sampler
-            VkDescriptorImageInfo imageInfo{};
-            imageInfo.sampler = skyboxSampler;
-            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageInfo.imageView = skyboxImageView;
+            std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
+            std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+            for (uint32_t b = 0; b < descriptorWrites.size(); b++)
+            {
+                bufferInfos[b].buffer = buffers[b];
+                bufferInfos[b].offset = 0;
+                bufferInfos[b].range = VK_WHOLE_SIZE;
+
+                descriptorWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrites[b].dstSet = gpuAnimationDescriptorSets[i];
+                descriptorWrites[b].dstBinding = b;
+                descriptorWrites[b].dstArrayElement = 0;
+                descriptorWrites[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                descriptorWrites[b].descriptorCount = 1;
+                descriptorWrites[b].pBufferInfo = &bufferInfos[b];
+            }
 
-            // Update configurations
-            std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[0].dstSet = skyboxDescriptorSet[i];
-            descriptorWrites[0].dstBinding = 0;
-            descriptorWrites[0].dstArrayElement = 0;
-            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptorWrites[0].descriptorCount = 1;
-            descriptorWrites[0].pBufferInfo = &bufferInfo;
-            descriptorWrites[0].pImageInfo = nullptr; // Optional
-            descriptorWrites[0].pTexelBufferView = nullptr; // Optional
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+    }
 
-            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[1].dstSet = skyboxDescriptorSet[i];
-            descriptorWrites[1].dstBinding = 1;
-            descriptorWrites[1].dstArrayElement = 0;
-            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptorWrites[1].descriptorCount = 1;
-            descriptorWrites[1].pBufferInfo = nullptr;   // Optional
-            descriptorWrites[1].pImageInfo = &imageInfo;
-            descriptorWrites[1].pTexelBufferView = nullptr; // Optional
+    /// <summary>
+    /// Evaluates the animations of every crowd instance into crowdPaletteBuffer: one dispatch samples the local transforms
+    /// of all instances and joints, then one dispatch per depth level of the skeleton combines them with their parents.
+    /// Must be recorded outside the render pass. Later passes of the frame read the palettes in vertex shaders
+    /// </summary>
+    /// <param name="commandBuffer"></param>
+    /// <param name="frame">: frame in flight, selects the instance input</param>
+    void RecordAnimationPass(VkCommandBuffer commandBuffer, const uint32_t frame)
+    {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        // The previous frame may still be reading the palettes and joint transforms
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpuAnimationPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpuAnimationPipelineLayout, 0, 1, &gpuAnimationDescriptorSets[frame], 0, nullptr);
+
+        // Local transforms
+        GpuAnimationPass pass{ GPU_ANIMATION_PASS_SAMPLE, 0, 0, crowd.Size() };
+        vkCmdPushConstants(commandBuffer, gpuAnimationPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pass), &pass);
+        vkCmdDispatch(commandBuffer, GpuAnimationGroupCount(static_cast<size_t>(crowd.Size()) * gpuAnimation.jointCount), 1, 1);
+
+        // Hierarchy, each level reads the global transforms of the previous one
+        for (uint32_t level = 0; level < gpuAnimation.LevelCount(); level++)
+        {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                1, &barrier, 0, nullptr, 0, nullptr);
+
+            pass = { GPU_ANIMATION_PASS_HIERARCHY, gpuAnimation.levelOffsets[level], gpuAnimation.levelCounts[level], crowd.Size() };
+            vkCmdPushConstants(commandBuffer, gpuAnimationPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pass), &pass);
+            vkCmdDispatch(commandBuffer, GpuAnimationGroupCount(static_cast<size_t>(crowd.Size()) * gpuAnimation.levelCounts[level]), 1, 1);
         }
+
+        // Palettes must be written before the crowd is drawn
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
     }
 
-    void CreateGridDescriptorSet()
+    /// <summary>
+    /// Evaluates the crowd's animations on the GPU once, with every clip at spread out times, reads the palettes back and
+    /// compares them with the pose kernel. Only needs core compute and storage buffers, so it also runs on software implementations
+    /// </summary>
+    /// <param name="tolerance">: maximum allowed error, relative to the magnitude of the pose kernel matrix elements</param>
+    /// <returns>Whether all palettes are within tolerance</returns>
+    bool RunGpuAnimationValidation(const float tolerance = 1.0e-3f)
     {
-        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, gridDescriptorSetLayout);
-        VkDescriptorSetAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        allocInfo.descriptorPool = gridDescriptorPool;
-        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        allocInfo.pSetLayouts = layouts.data();
+        Model& model = models[crowdModelIndex];
+        const uint32_t instanceCount = crowd.Size();
+        const uint32_t boneCount = gpuAnimation.boneCount;
+        const uint32_t clipCount = static_cast<uint32_t>(crowdAnimation.clips.size());
 
-        gridDescriptorSet.resize(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+        std::cout << "GPU animation validation for " << model.name << ":" << std::endl;
 
-        if (vkAllocateDescriptorSets(device, &allocInfo, gridDescriptorSet.data()) != VK_SUCCESS)
-            throw std::runtime_error("failed to allocate descriptor sets!");
+        // Spread every clip over the instances
+        std::vector<GpuAnimationInstance> instances(instanceCount);
+        for (uint32_t i = 0; i < instanceCount; i++)
+        {
+            instances[i].clip = i % clipCount;
+            instances[i].time = crowdAnimation.clips[instances[i].clip].duration * ((i / clipCount) % 97) / 97.0f;
+        }
+        memcpy(gpuAnimationInstanceBuffersMapped[0], instances.data(), sizeof(GpuAnimationInstance) * instanceCount);
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        VkDeviceSize paletteSize = sizeof(glm::mat4) * boneCount * instanceCount;
+        VkBuffer readbackBuffer;
+        VkDeviceMemory readbackBufferMemory;
+        CreateBuffer(paletteSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            readbackBuffer, readbackBufferMemory);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        VkCommandBuffer commandBuffer = BeginSingleTimeCommands(commandPool);
+        RecordAnimationPass(commandBuffer, 0);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.size = paletteSize;
+        vkCmdCopyBuffer(commandBuffer, crowdPaletteBuffer, readbackBuffer, 1, &copyRegion);
+        EndSingleTimeCommands(commandBuffer, commandPool, graphicsQueue);
+        auto end = std::chrono::high_resolution_clock::now();
+        const double gpuMs = std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+
+        void* data;
+        vkMapMemory(device, readbackBufferMemory, 0, paletteSize, 0, &data);
+        const glm::mat4* gpuPalettes = static_cast<const glm::mat4*>(data);
+
+        const int previousAnim = model.currentAnim;
+        std::vector<glm::mat4> reference(boneCount);
+        const BonePaletteSpan referencePalette{ reference.data(), reference.size() };
+        float maxError = 0.0f;
+        double cpuMs = 0.0;
+        for (uint32_t i = 0; i < instanceCount; i++)
         {
-            // UBO
-            VkDescriptorBufferInfo bufferInfo{};
-            bufferInfo.buffer = gridUniformBuffers[i];
-            bufferInfo.offset = 0;
-            bufferInfo.range = sizeof(UniformBufferObject);
+            model.currentAnim = static_cast<int>(instances[i].clip);
+            KeyframeSampler sampler;
 
-            // Update configurations
-            std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
-            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[0].dstSet = gridDescriptorSet[i];
-            descriptorWrites[0].dstBinding = 0;
-            descriptorWrites[0].dstArrayElement = 0;
-            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptorWrites[0].descriptorCount = 1;
-            descriptorWrites[0].pBufferInfo = &bufferInfo;
-            descriptorWrites[0].pImageInfo = nullptr; // Optional
-            descriptorWrites[0].pTexelBufferView = nullptr; // Optional
+            start = std::chrono::high_resolution_clock::now();
+            model.AnimateBatch(instances[i].time, referencePalette, sampler, false);
+            end = std::chrono::high_resolution_clock::now();
+            cpuMs += std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
 
-            vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+            for (uint32_t bone = 0; bone < boneCount; bone++)
+            {
+                for (int col = 0; col < 4; col++)
+                {
+                    for (int row = 0; row < 4; row++)
+                    {
+                        const float expected = reference[bone][col][row];
+                        maxError = std::max(maxError, std::abs(gpuPalettes[static_cast<size_t>(i) * boneCount + bone][col][row] - expected) / std::max(1.0f, std::abs(expected)));
+                    }
+                }
+            }
+        }
+
+        vkUnmapMemory(device, readbackBufferMemory);
+        vkDestroyBuffer(device, readbackBuffer, nullptr);
+        vkFreeMemory(device, readbackBufferMemory, nullptr);
+
+        // Restore the instance input and the bones of the model
+        crowd.Update(0.0, 0.0f, false, static_cast<CrowdInstanceData*>(crowdInstanceBuffersMapped[0]), CrowdGpuInstances(0));
+        model.currentAnim = previousAnim;
+        for (AnimationPlayer& animPlayer : animPlayers)
+        {
+            if (animPlayer.modelIndex == crowdModelIndex)
+                animPlayer.InvalidatePose();
         }
+
+        const bool passed = maxError <= tolerance;
+        std::cout << std::scientific << std::setprecision(2)
+            << "  " << instanceCount << " instances, " << gpuAnimation.jointCount << " joints, " << gpuAnimation.LevelCount() << " levels"
+            << ": max error " << maxError << (passed ? " OK" : " FAILED")
+            << std::fixed << " | GPU " << gpuMs << " ms (submit and wait)"
+            << " | CPU " << cpuMs << " ms" << std::endl;
+
+        return passed;
     }
+#endif // GPU_ANIMATION
 
     void CreateImGuiDescriptorSet()
     {
@@ -3080,16 +6072,21 @@ private:
 
     void CreateTextureImage(const size_t modelIndex, const char* file = TEXTURE_PATH.c_str(), bool isNormal = false)
     {
-        int texWidth, texHeight, texChannels;
-        stbi_uc* pixels = stbi_load(file, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
+        CreateTextureImage(modelIndex, DecodeImage(file), isNormal);
+    }
+
+    /// <summary>
+    /// Uploads a decoded texture of a model and generates its mipmaps
+    /// </summary>
+    void CreateTextureImage(const size_t modelIndex, const DecodedImage& image, bool isNormal = false)
+    {
+        const int texWidth = image.width, texHeight = image.height;
+        const stbi_uc* pixels = image.pixels.get();
+        VkDeviceSize imageSize = image.Size();
 
         // TODO: Handle for multiple textures!
         mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight))) + 1);
 
-        if (!pixels)
-            throw std::runtime_error("failed to load texture image!");
-
         // Staging buffer
         VkBuffer stagingBuffer;
         VkDeviceMemory stagingBufferMemory;
@@ -3101,12 +6098,10 @@ private:
         memcpy(data, pixels, static_cast<uint32_t>(imageSize));
         vkUnmapMemory(device, stagingBufferMemory);
 
-        stbi_image_free(pixels);
-
         if (isNormal)
         {
-            normalImages.resize(normalImages.size() + 1);
-            normalImageMemories.resize(normalImageMemories.size() + 1);
+            normalImages.resize(std::max<size_t>(normalImages.size(), modelIndex + 1));
+            normalImageMemories.resize(std::max<size_t>(normalImageMemories.size(), modelIndex + 1));
 
             CreateImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
@@ -3122,8 +6117,8 @@ private:
         }
         else
         {
-            textureImages.resize(textureImages.size() + 1);
-            textureImageMemories.resize(textureImageMemories.size() + 1);
+            textureImages.resize(std::max<size_t>(textureImages.size(), modelIndex + 1));
+            textureImageMemories.resize(std::max<size_t>(textureImageMemories.size(), modelIndex + 1));
 
             CreateImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
@@ -3138,8 +6133,7 @@ private:
             GenerateMipmaps(textureImages[modelIndex], VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
         }
 
-        vkDestroyBuffer(device, stagingBuffer, nullptr);
-        vkFreeMemory(device, stagingBufferMemory, nullptr);
+        ReleaseStagingBuffer(stagingBuffer, stagingBufferMemory);
     }
 
     void CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
@@ -3410,6 +6404,9 @@ private:
 
     VkCommandBuffer BeginSingleTimeCommands(VkCommandPool commandPool)
     {
+        if (recordingUpload != nullptr)
+            return recordingUpload->commandBuffer;
+
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -3430,6 +6427,10 @@ private:
 
     void EndSingleTimeCommands(VkCommandBuffer commandBuffer, VkCommandPool commandPool, VkQueue queue)
     {
+        // Submitted with the rest of the upload
+        if (recordingUpload != nullptr)
+            return;
+
         vkEndCommandBuffer(commandBuffer);
 
         VkSubmitInfo submitInfo{};
@@ -3568,12 +6569,12 @@ private:
     {
         if (isNormal)
         {
-            normalImageViews.resize(normalImageViews.size() + 1);
+            normalImageViews.resize(std::max<size_t>(normalImageViews.size(), modelIndex + 1));
             normalImageViews[modelIndex] = CreateImageView(normalImages[modelIndex], mipLevels, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
         }
         else
         {
-            textureImageViews.resize(textureImageViews.size() + 1);
+            textureImageViews.resize(std::max<size_t>(textureImageViews.size(), modelIndex + 1));
             textureImageViews[modelIndex] = CreateImageView(textureImages[modelIndex], mipLevels, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
         }
     }
@@ -3630,14 +6631,14 @@ private:
 
         if (isNormal)
         {
-            normalSamplers.resize(normalSamplers.size() + 1);
+            normalSamplers.resize(std::max<size_t>(normalSamplers.size(), modelIndex + 1));
 
             if (vkCreateSampler(device, &samplerInfo, nullptr, &normalSamplers[modelIndex]) != VK_SUCCESS)
                 throw std::runtime_error("failed to create sampler!");
         }
         else
         {
-            textureSamplers.resize(textureSamplers.size() + 1);
+            textureSamplers.resize(std::max<size_t>(textureSamplers.size(), modelIndex + 1));
 
             if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSamplers[modelIndex]) != VK_SUCCESS)
                 throw std::runtime_error("failed to create sampler!");
@@ -3761,6 +6762,12 @@ private:
             std::cout << "Loaded " << shape.name << "!" << std::endl;
         }
 
+#ifdef OPTIMIZE_MESHES
+        const MeshOptimizationStats stats = OptimizeMesh(vertices, indices);
+        std::cout << "Optimized model: ACMR " << stats.before.acmr << " -> " << stats.after.acmr
+            << ", ATVR " << stats.before.atvr << " -> " << stats.after.atvr << std::endl;
+#endif // OPTIMIZE_MESHES
+
         std::cout << "Load Successful with " << vertices.size() << " vertices, and " << indices.size() << " triangles!" << std::endl;
     }
 
@@ -0,0 +1,89 @@
+#version 450
+// *****************************************************
+// Shader that implements Linear Skinning with baked
+// bone palettes, for instanced crowds
+// *****************************************************
+
+#extension GL_GOOGLE_include_directive : require
+
+const int MAX_BONES = 120;                      // We need a maximum number, and 120 should be safe for the vast majority of rigs
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    mat4 inBoneTransforms[MAX_BONES];           // Unused, the palettes are baked
+    float time;
+    bool explode;
+    vec4 positionMin;                           // Decodes compact vertex positions
+    vec4 positionExtent;
+} ubo;
+
+struct CrowdInstance {
+    vec4 offset;                                // Model space offset of the instance in xyz
+    uint firstFrame;                            // First baked frame of the clip
+    uint frameCount;                            // Number of baked frames of the clip
+    float frame;                                // Current baked frame, fractional part interpolates to the next one
+                                                // The last frame of a clip is baked at its duration, so frames never wrap
+    uint boneCount;                             // Bones per baked palette
+};
+
+layout(std430, binding = 4) readonly buffer BakedPalettes {
+    mat4 palettes[];
+};
+
+layout(std430, binding = 5) readonly buffer CrowdInstances {
+    CrowdInstance instances[];
+};
+
+#define SKINNED_VERTICES
+#include "vertex_input.glsl"
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragNorm;
+layout(location = 3) out vec3 fragPos;
+
+// Bone transform interpolated between two baked frames
+mat4 GetBoneTransform(uint firstPalette, uint secondPalette, float t, int boneID)
+{
+    mat4 first = palettes[firstPalette + boneID];
+    mat4 second = palettes[secondPalette + boneID];
+
+    return first + (second - first) * t;
+}
+
+void main()
+{
+    CrowdInstance instance = instances[gl_InstanceIndex];
+
+    // Palettes of the current and next frame, clamped to the last interval of the clip
+    uint frame = min(uint(instance.frame), max(instance.frameCount, 2u) - 2u);
+    uint nextFrame = min(frame + 1u, instance.frameCount - 1u);
+    float t = clamp(instance.frame - float(frame), 0.0f, 1.0f);
+
+    uint firstPalette = (instance.firstFrame + frame) * instance.boneCount;
+    uint secondPalette = (instance.firstFrame + nextFrame) * instance.boneCount;
+
+    ivec4 inBoneIDs = VertexBoneIDs();
+    vec4 inBoneWeights = VertexBoneWeights();
+
+    // Loop between 4 bones for position
+    mat4 finalBoneTransform = GetBoneTransform(firstPalette, secondPalette, t, inBoneIDs.x) * inBoneWeights.x;
+    finalBoneTransform += GetBoneTransform(firstPalette, secondPalette, t, inBoneIDs.y) * inBoneWeights.y;
+    finalBoneTransform += GetBoneTransform(firstPalette, secondPalette, t, inBoneIDs.z) * inBoneWeights.z;
+    finalBoneTransform += GetBoneTransform(firstPalette, secondPalette, t, inBoneIDs.w) * inBoneWeights.w;
+
+    // Calculate final vertex position, offset by the instance
+    vec4 newPosition = finalBoneTransform * vec4(VertexPosition(), 1.0f);
+    newPosition.xyz += instance.offset.xyz;
+
+    // Calculate final normal direction
+    vec4 newNormal = finalBoneTransform * vec4(VertexNormal(), 0.0f);
+
+    gl_Position = ubo.proj * ubo.view * ubo.model * newPosition;
+    fragNorm = mat3(transpose(inverse(ubo.model))) * newNormal.xyz;
+    fragColor = VertexColor();
+    fragTexCoord = VertexTexCoord();
+    fragPos = newPosition.xyz;
+}
@@ -0,0 +1,102 @@
+// *****************************************************
+// Bone palette UBO and blending of the 4 bones of a
+// vertex, for each palette encoding. Set when compiling:
+// PALETTE_ENCODING 0 = mat4, 1 = 3x4 affine,
+// 2 = dual quaternion (DQS)
+// *****************************************************
+
+#ifndef PALETTE_ENCODING
+#define PALETTE_ENCODING 0
+#endif
+
+const int MAX_BONES = 120;                      // We need a maximum number, and 120 should be safe for the vast majority of rigs
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec4 bonePalette[MAX_BONES * 4];            // Encoded bone transforms. Every encoding fits in the space of one mat4 per bone
+    float time;
+    bool explode;
+    vec4 positionMin;                           // Decodes compact vertex positions
+    vec4 positionExtent;
+} ubo;
+
+#if PALETTE_ENCODING == 1
+
+// 3 rows per bone, blended before the implied last row is added
+mat4 BlendBoneTransforms(ivec4 boneIDs, vec4 boneWeights)
+{
+    vec4 rows[3];
+    for (int r = 0; r < 3; r++)
+    {
+        rows[r] = ubo.bonePalette[boneIDs.x * 3 + r] * boneWeights.x;
+        rows[r] += ubo.bonePalette[boneIDs.y * 3 + r] * boneWeights.y;
+        rows[r] += ubo.bonePalette[boneIDs.z * 3 + r] * boneWeights.z;
+        rows[r] += ubo.bonePalette[boneIDs.w * 3 + r] * boneWeights.w;
+    }
+
+    return transpose(mat4(rows[0], rows[1], rows[2], vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+#elif PALETTE_ENCODING == 2
+
+// Real and dual quaternion per bone, as (x, y, z, w)
+void AddDualQuat(int boneID, float weight, vec4 pivot, inout vec4 real, inout vec4 dual)
+{
+    vec4 boneReal = ubo.bonePalette[boneID * 2];
+    vec4 boneDual = ubo.bonePalette[boneID * 2 + 1];
+
+    // Blend along the shortest path
+    if (dot(boneReal, pivot) < 0.0f)
+        weight = -weight;
+
+    real += boneReal * weight;
+    dual += boneDual * weight;
+}
+
+// Dual quaternion skinning, converted back to a matrix so it drops into the linear skinning shaders
+mat4 BlendBoneTransforms(ivec4 boneIDs, vec4 boneWeights)
+{
+    vec4 pivot = ubo.bonePalette[boneIDs.x * 2];
+    vec4 real = vec4(0.0f);
+    vec4 dual = vec4(0.0f);
+    AddDualQuat(boneIDs.x, boneWeights.x, pivot, real, dual);
+    AddDualQuat(boneIDs.y, boneWeights.y, pivot, real, dual);
+    AddDualQuat(boneIDs.z, boneWeights.z, pivot, real, dual);
+    AddDualQuat(boneIDs.w, boneWeights.w, pivot, real, dual);
+
+    float len = length(real);
+    real /= len;
+    dual /= len;
+
+    // Translation is 2 * dual * conjugate(real)
+    vec3 t = 2.0f * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+
+    float x = real.x, y = real.y, z = real.z, w = real.w;
+    return mat4(
+        1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f,
+        2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f,
+        2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f,
+        t, 1.0f);
+}
+
+#else
+
+mat4 GetBoneTransform(int boneID)
+{
+    return mat4(ubo.bonePalette[boneID * 4], ubo.bonePalette[boneID * 4 + 1], ubo.bonePalette[boneID * 4 + 2], ubo.bonePalette[boneID * 4 + 3]);
+}
+
+// Loop between 4 bones
+mat4 BlendBoneTransforms(ivec4 boneIDs, vec4 boneWeights)
+{
+    mat4 finalBoneTransform = GetBoneTransform(boneIDs.x) * boneWeights.x;
+    finalBoneTransform += GetBoneTransform(boneIDs.y) * boneWeights.y;
+    finalBoneTransform += GetBoneTransform(boneIDs.z) * boneWeights.z;
+    finalBoneTransform += GetBoneTransform(boneIDs.w) * boneWeights.w;
+
+    return finalBoneTransform;
+}
+
+#endif
@@ -1,17 +1,49 @@
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe simple_tri.vert -o vert.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe simple_tri.frag -o frag.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe linear_skinning.vert -o linear_skinning_vert.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe linear_skinning.frag -o linear_skinning_frag.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe skybox.vert -o skybox_vert.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe skybox.frag -o skybox_frag.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe blinn_phong.vert -o blinn_phong_vert.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe blinn_phong.frag -o blinn_phong_frag.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe grid.vert -o grid_vert.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe grid.frag -o grid_frag.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe normDisplay.vert -o normDisplay_vert.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe normDisplay.frag -o normDisplay_frag.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe linear_skinning_norm.vert -o linear_skinning_norm_vert.spv
+@echo off
+rem Compiles every shader and variant to SPIR-V. Run by the pre-build step of the project with "nopause"
+if defined VULKAN_SDK (set GLSLC="%VULKAN_SDK%/Bin/glslc.exe") else (set GLSLC=C:/VulkanSDK/1.3.290.0/Bin/glslc.exe)
 
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe normDisplay.geom -o normDisplay_geom.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe simple.geom -o geom.spv
-pause
\ No newline at end of file
+%GLSLC% simple_tri.vert -o simple_tri_vert.spv || exit /b 1
+%GLSLC% simple_tri.frag -o frag.spv || exit /b 1
+%GLSLC% linear_skinning.vert -o linear_skinning_vert.spv || exit /b 1
+%GLSLC% linear_skinning.frag -o linear_skinning_frag.spv || exit /b 1
+%GLSLC% skybox.vert -o skybox_vert.spv || exit /b 1
+%GLSLC% skybox.frag -o skybox_frag.spv || exit /b 1
+%GLSLC% blinn_phong.vert -o blinn_phong_vert.spv || exit /b 1
+%GLSLC% blinn_phong.frag -o blinn_phong_frag.spv || exit /b 1
+%GLSLC% grid.vert -o grid_vert.spv || exit /b 1
+%GLSLC% grid.frag -o grid_frag.spv || exit /b 1
+%GLSLC% normDisplay.vert -o normDisplay_vert.spv || exit /b 1
+%GLSLC% normDisplay.frag -o normDisplay_frag.spv || exit /b 1
+%GLSLC% linear_skinning_norm.vert -o linear_skinning_norm_vert.spv || exit /b 1
+%GLSLC% baked_skinning.vert -o baked_skinning_vert.spv || exit /b 1
+%GLSLC% skinning.comp -o skinning_comp.spv || exit /b 1
+%GLSLC% animation_eval.comp -o animation_eval_comp.spv || exit /b 1
+%GLSLC% -DPALETTE_ENCODING=1 linear_skinning.vert -o linear_skinning_affine_vert.spv || exit /b 1
+%GLSLC% -DPALETTE_ENCODING=1 linear_skinning_norm.vert -o linear_skinning_norm_affine_vert.spv || exit /b 1
+%GLSLC% -DPALETTE_ENCODING=1 skinning.comp -o skinning_affine_comp.spv || exit /b 1
+%GLSLC% -DPALETTE_ENCODING=2 linear_skinning.vert -o linear_skinning_dq_vert.spv || exit /b 1
+%GLSLC% -DPALETTE_ENCODING=2 linear_skinning_norm.vert -o linear_skinning_norm_dq_vert.spv || exit /b 1
+%GLSLC% -DPALETTE_ENCODING=2 skinning.comp -o skinning_dq_comp.spv || exit /b 1
+%GLSLC% -DCOMPACT_VERTICES=1 simple_tri.vert -o simple_tri_compact_vert.spv || exit /b 1
+%GLSLC% -DCOMPACT_VERTICES=1 blinn_phong.vert -o blinn_phong_compact_vert.spv || exit /b 1
+%GLSLC% -DCOMPACT_VERTICES=1 normDisplay.vert -o normDisplay_compact_vert.spv || exit /b 1
+%GLSLC% -DCOMPACT_VERTICES=1 linear_skinning.vert -o linear_skinning_compact_vert.spv || exit /b 1
+%GLSLC% -DCOMPACT_VERTICES=1 linear_skinning_norm.vert -o linear_skinning_norm_compact_vert.spv || exit /b 1
+%GLSLC% -DCOMPACT_VERTICES=1 baked_skinning.vert -o baked_skinning_compact_vert.spv || exit /b 1
+%GLSLC% -DPALETTE_ENCODING=1 -DCOMPACT_VERTICES=1 linear_skinning.vert -o linear_skinning_affine_compact_vert.spv || exit /b 1
+%GLSLC% -DPALETTE_ENCODING=1 -DCOMPACT_VERTICES=1 linear_skinning_norm.vert -o linear_skinning_norm_affine_compact_vert.spv || exit /b 1
+%GLSLC% -DPALETTE_ENCODING=2 -DCOMPACT_VERTICES=1 linear_skinning.vert -o linear_skinning_dq_compact_vert.spv || exit /b 1
+%GLSLC% -DPALETTE_ENCODING=2 -DCOMPACT_VERTICES=1 linear_skinning_norm.vert -o linear_skinning_norm_dq_compact_vert.spv || exit /b 1
+%GLSLC% depth_only.vert -o depth_only_vert.spv || exit /b 1
+%GLSLC% -DCOMPACT_VERTICES=1 depth_only.vert -o depth_only_compact_vert.spv || exit /b 1
+%GLSLC% -DSKINNED_VERTICES depth_only.vert -o depth_skinning_vert.spv || exit /b 1
+%GLSLC% -DSKINNED_VERTICES -DPALETTE_ENCODING=1 depth_only.vert -o depth_skinning_affine_vert.spv || exit /b 1
+%GLSLC% -DSKINNED_VERTICES -DPALETTE_ENCODING=2 depth_only.vert -o depth_skinning_dq_vert.spv || exit /b 1
+%GLSLC% -DSKINNED_VERTICES -DCOMPACT_VERTICES=1 depth_only.vert -o depth_skinning_compact_vert.spv || exit /b 1
+%GLSLC% -DSKINNED_VERTICES -DPALETTE_ENCODING=1 -DCOMPACT_VERTICES=1 depth_only.vert -o depth_skinning_affine_compact_vert.spv || exit /b 1
+%GLSLC% -DSKINNED_VERTICES -DPALETTE_ENCODING=2 -DCOMPACT_VERTICES=1 depth_only.vert -o depth_skinning_dq_compact_vert.spv || exit /b 1
+%GLSLC% cluster_cull.comp -o cluster_cull_comp.spv || exit /b 1
+
+%GLSLC% normDisplay.geom -o normDisplay_geom.spv || exit /b 1
+%GLSLC% simple.geom -o geom.spv || exit /b 1
+if not "%~1"=="nopause" pause
\ No newline at end of file
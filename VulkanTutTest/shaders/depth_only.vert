@@ -0,0 +1,24 @@
+#version 450
+// *****************************************************
+// Depth pre-pass: transforms the position stream only,
+// and skins it with the skin stream when compiled with
+// SKINNED_VERTICES. Has no fragment shader
+// *****************************************************
+
+#extension GL_GOOGLE_include_directive : require
+
+#define POSITION_ONLY
+#include "bone_palette.glsl"
+#include "vertex_input.glsl"
+
+void main()
+{
+    vec4 newPosition = vec4(VertexPosition(), 1.0f);
+
+#ifdef SKINNED_VERTICES
+    // Same blend as linear_skinning.vert, so the depth matches
+    newPosition = BlendBoneTransforms(VertexBoneIDs(), VertexBoneWeights()) * newPosition;
+#endif
+
+    gl_Position = ubo.proj * ubo.view * ubo.model * newPosition;
+}
@@ -3,22 +3,13 @@
 // Shader that implements Linear Skinning
 // *****************************************************
 
-const int MAX_BONES = 120;                      // We need a maximum number, and 120 should be safe for the vast majority of rigs
+#extension GL_GOOGLE_include_directive : require
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
-    mat4 inBoneTransforms[MAX_BONES];
-} ubo;
+#define SKINNED_VERTICES
+#include "bone_palette.glsl"
+#include "vertex_input.glsl"
 
 
-layout(location = 0) in vec3 inPos;
-layout(location = 1) in vec3 inColor;
-layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in vec3 inNorm;
-layout(location = 4) in ivec4 inBoneIDs;        // Size of 4 is in accordance with the 4 bone per vertex convention
-layout(location = 5) in vec4 inBoneWeights;
 
 layout(location = 0) out VS_OUT {
     mat4 geomProj;
@@ -29,17 +20,14 @@ void main()
 {
     vec4 newPosition;
 
-    // Loop between 4 bones for position
-    mat4 finalBoneTransform = ubo.inBoneTransforms[inBoneIDs.x] * inBoneWeights.x;
-    finalBoneTransform += ubo.inBoneTransforms[inBoneIDs.y] * inBoneWeights.y;
-    finalBoneTransform += ubo.inBoneTransforms[inBoneIDs.z] * inBoneWeights.z;
-    finalBoneTransform += ubo.inBoneTransforms[inBoneIDs.w] * inBoneWeights.w;
+    // Blend 4 bones for position, in the palette encoding
+    mat4 finalBoneTransform = BlendBoneTransforms(VertexBoneIDs(), VertexBoneWeights());
 
     // Calculate final vertex position
-    newPosition = finalBoneTransform * vec4(inPos, 1.0f);
+    newPosition = finalBoneTransform * vec4(VertexPosition(), 1.0f);
 
     // Calculate final normal direction
-    vec4 newNormal = finalBoneTransform * vec4(inNorm, 0.0f);
+    vec4 newNormal = finalBoneTransform * vec4(VertexNormal(), 0.0f);
 
     // TODO: Tangent and Bitangent will also be affected by finalBoneTransform!
 
@@ -1,5 +1,7 @@
 #version 450
 
+#extension GL_GOOGLE_include_directive : require
+
 const int MAX_BONES = 120;                      // We need a maximum number, and 120 should be safe for the vast majority of rigs
 
 layout(binding = 0) uniform UniformBufferObject {
@@ -7,14 +9,13 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 view;
     mat4 proj;
     mat4 inBoneTransforms[MAX_BONES];
+    float time;
+    bool explode;
+    vec4 positionMin;                           // Decodes compact vertex positions
+    vec4 positionExtent;
 } ubo;
 
-layout(location = 0) in vec3 inPos;
-layout(location = 1) in vec3 inColor;
-layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in vec3 inNorm;
-layout(location = 4) in ivec4 inBoneIDs;        // Size of 4 is in accordance with the 4 bone per vertex convention
-layout(location = 5) in vec4 inBoneWeights;
+#include "vertex_input.glsl"
 
 layout(location = 0) out VS_OUT {
     mat4 geomProj;
@@ -24,8 +25,8 @@ layout(location = 0) out VS_OUT {
 void main()
 {
     // gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPos, 1.0f);
-    gl_Position = ubo.view * ubo.model * vec4(inPos, 1.0f);
+    gl_Position = ubo.view * ubo.model * vec4(VertexPosition(), 1.0f);
     vs_out.geomProj = ubo.proj;
     mat3 normalMatrix = mat3(transpose(inverse(ubo.view * ubo.model)));
-    vs_out.geomNorm = normalize(vec3(vec4(normalMatrix * inNorm, 0.0)));
+    vs_out.geomNorm = normalize(vec3(vec4(normalMatrix * VertexNormal(), 0.0)));
 }
\ No newline at end of file
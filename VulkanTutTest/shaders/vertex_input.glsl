@@ -0,0 +1,158 @@
+// *****************************************************
+// Vertex attributes of model meshes and their decoding.
+// Set when compiling: COMPACT_VERTICES 0 = Vertex,
+// 1 = CompactVertex, with bone IDs and weights in the
+// SkinningVertex stream. Skinning shaders define
+// SKINNED_VERTICES. Depth-only shaders define
+// POSITION_ONLY and read the position stream, plus the
+// skin stream if skinned. Include after the UBO
+// *****************************************************
+
+#ifndef COMPACT_VERTICES
+#define COMPACT_VERTICES 0
+#endif
+
+// Depth-only and shading passes compute the same depth, so shading can test LESS_OR_EQUAL against the pre-pass
+invariant gl_Position;
+
+#if defined(POSITION_ONLY)
+
+#if COMPACT_VERTICES == 1
+layout(location = 0) in vec4 inPos;             // CompactPositionVertex, within the model bounds
+#else
+layout(location = 0) in vec3 inPos;             // PositionVertex
+#endif
+#ifdef SKINNED_VERTICES
+#if COMPACT_VERTICES == 1
+layout(location = 4) in uvec4 inBoneIDs;        // SkinningVertex
+#else
+layout(location = 4) in ivec4 inBoneIDs;        // FloatSkinningVertex
+#endif
+layout(location = 5) in vec4 inBoneWeights;
+#endif
+
+vec3 VertexPosition()
+{
+#if COMPACT_VERTICES == 1
+    return ubo.positionMin.xyz + inPos.xyz * ubo.positionExtent.xyz;
+#else
+    return inPos;
+#endif
+}
+
+#ifdef SKINNED_VERTICES
+ivec4 VertexBoneIDs()
+{
+    return ivec4(inBoneIDs);
+}
+
+vec4 VertexBoneWeights()
+{
+    return inBoneWeights;
+}
+#endif
+
+#elif COMPACT_VERTICES == 1
+
+layout(location = 0) in vec4 inPos;             // Position within the model bounds in xyz, bitangent sign in w
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec2 inNorm;            // Octahedral
+layout(location = 6) in vec2 inTangent;         // Octahedral
+#ifdef SKINNED_VERTICES
+layout(location = 4) in uvec4 inBoneIDs;        // Second stream
+layout(location = 5) in vec4 inBoneWeights;
+#endif
+
+// Inverse of OctahedralEncode in CompactVertex.cpp
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+        n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+
+    return normalize(n);
+}
+
+vec3 VertexPosition()
+{
+    return ubo.positionMin.xyz + inPos.xyz * ubo.positionExtent.xyz;
+}
+
+// Vertex colors are not stored
+vec3 VertexColor()
+{
+    return vec3(1.0f);
+}
+
+vec2 VertexTexCoord()
+{
+    return inTexCoord;
+}
+
+vec3 VertexNormal()
+{
+    return OctahedralDecode(inNorm);
+}
+
+vec3 VertexTangent()
+{
+    return OctahedralDecode(inTangent);
+}
+
+vec3 VertexBitangent()
+{
+    return cross(VertexNormal(), VertexTangent()) * (inPos.w * 2.0f - 1.0f);
+}
+
+#ifdef SKINNED_VERTICES
+ivec4 VertexBoneIDs()
+{
+    return ivec4(inBoneIDs);
+}
+
+vec4 VertexBoneWeights()
+{
+    return inBoneWeights;
+}
+#endif
+
+#else
+
+layout(location = 0) in vec3 inPos;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec3 inNorm;
+layout(location = 4) in ivec4 inBoneIDs;        // Size of 4 is in accordance with the 4 bone per vertex convention
+layout(location = 5) in vec4 inBoneWeights;
+
+vec3 VertexPosition()
+{
+    return inPos;
+}
+
+vec3 VertexColor()
+{
+    return inColor;
+}
+
+vec2 VertexTexCoord()
+{
+    return inTexCoord;
+}
+
+vec3 VertexNormal()
+{
+    return inNorm;
+}
+
+ivec4 VertexBoneIDs()
+{
+    return inBoneIDs;
+}
+
+vec4 VertexBoneWeights()
+{
+    return inBoneWeights;
+}
+
+#endif